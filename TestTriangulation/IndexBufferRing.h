@@ -0,0 +1,45 @@
+//
+//  IndexBufferRing.h
+//  TestTriangulation
+//
+//  Created by Dom Chiu on 2019/7/21.
+//  Copyright © 2019 Dom Chiu. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+// What the ring needs of a buffer: bytes the CPU can write and the GPU read.
+// id<MTLBuffer> in shared storage has both.
+@protocol IndexBuffer <NSObject>
+-(void*) contents;
+-(NSUInteger) length;
+@end
+
+@protocol IndexBufferAllocator <NSObject>
+-(id<IndexBuffer>) newIndexBufferWithLength:(NSUInteger)length;
+@end
+
+// A ring of index buffers kept mapped from one write to the next. A write goes
+// to the buffer after the one frames draw from, once no frame in flight still
+// reads it, and grows it geometrically when it is too small; endWrite makes it
+// the one frames draw from. With three buffers the CPU writes while the GPU
+// draws from the other two, and a steady editing loop allocates nothing.
+@interface IndexBufferRing : NSObject
+
+-(instancetype) initWithAllocator:(id<IndexBufferAllocator>)allocator count:(NSUInteger)count;
+
+// Writer: at least length bytes to write the indices to, waiting for frames still
+// reading that buffer. NULL if it cannot be allocated. A write not ended is dropped
+-(void*) beginWriteWithLength:(NSUInteger)length;
+-(void) endWrite;
+
+// Frames: the slot of the buffer last written, -1 if none, held until released,
+// typically from the command buffer's completed handler on any thread
+-(NSInteger) acquireFrameSlot;
+-(void) releaseFrameSlot:(NSInteger)slot;
+-(id<IndexBuffer>) bufferAtSlot:(NSInteger)slot;
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSUInteger allocationCount;
+
+@end
@@ -0,0 +1,100 @@
+//
+//  IndexBufferRing.m
+//  TestTriangulation
+//
+//  Created by Dom Chiu on 2019/7/21.
+//  Copyright © 2019 Dom Chiu. All rights reserved.
+//
+
+#import "IndexBufferRing.h"
+
+@interface IndexBufferRing ()
+
+@property (nonatomic, weak) id<IndexBufferAllocator> allocator;
+@property (nonatomic, strong) NSMutableArray<id<IndexBuffer> >* buffers;
+@property (nonatomic, strong) NSCondition* condition;
+@property (nonatomic, assign) NSUInteger* framesInFlight;
+@property (nonatomic, assign) NSInteger publishedSlot;
+@property (nonatomic, assign) NSInteger writingSlot;
+
+@end
+
+@implementation IndexBufferRing
+
+-(instancetype) initWithAllocator:(id<IndexBufferAllocator>)allocator count:(NSUInteger)count {
+    if (self = [super init])
+    {
+        _allocator = allocator;
+        _count = count > 0 ? count : 1;
+        _buffers = [[NSMutableArray alloc] initWithCapacity:_count];
+        for (NSUInteger i = 0; i < _count; ++i)
+            [_buffers addObject:(id<IndexBuffer>)[NSNull null]];
+        _condition = [[NSCondition alloc] init];
+        _framesInFlight = (NSUInteger*) calloc(_count, sizeof(NSUInteger));
+        _publishedSlot = -1;
+        _writingSlot = -1;
+    }
+    return self;
+}
+
+-(void) dealloc {
+    free(_framesInFlight);
+}
+
+-(void*) beginWriteWithLength:(NSUInteger)length {
+    NSInteger slot = (_publishedSlot + 1) % (NSInteger)_count;
+    [_condition lock];
+    while (_framesInFlight[slot] > 0)
+        [_condition wait];
+    id<IndexBuffer> buffer = _buffers[slot];
+    [_condition unlock];
+
+    NSUInteger capacity = [buffer isKindOfClass:[NSNull class]] ? 0 : buffer.length;
+    if (capacity < length)
+    {// Grow geometrically, so that a polygon growing an edit at a time reallocates rarely:
+        capacity = MAX(length, 2 * capacity);
+        buffer = [_allocator newIndexBufferWithLength:capacity];
+        if (!buffer) return NULL;
+        [_condition lock];
+        _buffers[slot] = buffer;
+        [_condition unlock];
+        _allocationCount++;
+    }
+    _writingSlot = slot;
+    return buffer.contents;
+}
+
+-(void) endWrite {
+    if (_writingSlot < 0) return;
+    [_condition lock];
+    _publishedSlot = _writingSlot;
+    [_condition unlock];
+    _writingSlot = -1;
+}
+
+-(NSInteger) acquireFrameSlot {
+    [_condition lock];
+    NSInteger slot = _publishedSlot;
+    if (slot >= 0)
+        _framesInFlight[slot]++;
+    [_condition unlock];
+    return slot;
+}
+
+-(void) releaseFrameSlot:(NSInteger)slot {
+    if (slot < 0) return;
+    [_condition lock];
+    if (_framesInFlight[slot] > 0 && 0 == --_framesInFlight[slot])
+        [_condition broadcast];
+    [_condition unlock];
+}
+
+-(id<IndexBuffer>) bufferAtSlot:(NSInteger)slot {
+    if (slot < 0 || slot >= (NSInteger)_count) return nil;
+    [_condition lock];
+    id<IndexBuffer> buffer = _buffers[slot];
+    [_condition unlock];
+    return [buffer isKindOfClass:[NSNull class]] ? nil : buffer;
+}
+
+@end
@@ -8,152 +8,11 @@
 
 #import "ViewController.h"
 #import "ShaderDefines.h"
+#import "IndexBufferRing.h"
 #import "triangulation_seidel.h"
 #import <MetalKit/MetalKit.h>
 #import <simd/simd.h>
 
-bool areLinesIntersect(vector_float2 line0s, vector_float2 line0e, vector_float2 line1s, vector_float2 line1e) {
-    const float Epsilon = 0.0000000000001;
-    const float A0 = line0e.y - line0s.y;
-    const float B0 = line0s.x - line0e.x;
-    const float C0 = line0e.x * line0s.y - line0s.x * line0e.y;
-    
-    const float A1 = line1e.y - line1s.y;
-    const float B1 = line1s.x - line1e.x;
-    const float C1 = line1e.x * line1s.y - line1s.x * line1e.y;
-    
-    const float D = A0 * B1 - A1 * B0;
-    const float E = B0 * C1 - B1 * C0;
-    const float F = A1 * C0 - A0 * C1;
-    if (fabsf(D) <= Epsilon)
-    {// Parallel
-        if (fabsf(E) <= Epsilon && fabsf(F) <= Epsilon)
-        {// On the same line
-            float maxX0, minX0, maxX1, minX1;
-            if (line0s.x > line0e.x)
-            {
-                maxX0 = line0s.x;
-                minX0 = line0e.x;
-            }
-            else
-            {
-                maxX0 = line0e.x;
-                minX0 = line0s.x;
-            }
-            if (line1s.x > line1e.x)
-            {
-                maxX1 = line1s.x;
-                minX1 = line1e.x;
-            }
-            else
-            {
-                maxX1 = line1e.x;
-                minX1 = line1s.x;
-            }
-            if (maxX0 < minX1 || maxX1 < minX0)
-            {// On the same line but apart
-                return false;
-            }
-            
-            float maxY0, minY0, maxY1, minY1;
-            if (line0s.y > line0e.y)
-            {
-                maxY0 = line0s.y;
-                minY0 = line0e.y;
-            }
-            else
-            {
-                maxY0 = line0e.y;
-                minY0 = line0s.y;
-            }
-            if (line1s.y > line1e.y)
-            {
-                maxY1 = line1s.y;
-                minY1 = line1e.y;
-            }
-            else
-            {
-                maxY1 = line1e.y;
-                minY1 = line1s.y;
-            }
-            if (maxY0 < minY1 || maxY1 < minY0)
-            {// On the same line but apart}
-                return false;
-            }
-            
-            return true;
-        }
-        else
-        {// Parallel and Not on the same line
-            return false;
-        }
-    }
-    else
-    {
-        vector_float2 intersection = (vector_float2){E/D, F/D};
-        float signX0 = (intersection.x - line0s.x) * (intersection.x - line0e.x);
-        float signX1 = (intersection.x - line1s.x) * (intersection.x - line1e.x);
-        if (signX0 <= 0 && signX1 <= 0)
-            return true;
-        
-        float signY0 = (intersection.y - line0s.y) * (intersection.y - line0e.y);
-        float signY1 = (intersection.y - line1s.y) * (intersection.y - line1e.y);
-        if (signY0 <= 0 && signY1 <= 0)
-            return true;
-        
-        return false;
-    }
-}
-
-bool isLinesIntersectWithLineStrip(vector_float2 line0s, vector_float2 line0e, const vector_float2* lines, size_t linesCount) {
-    const vector_float2* pPoint0 = lines;
-    for (size_t i=linesCount; i>0; --i)
-    {
-        if (areLinesIntersect(line0s, line0e, pPoint0[0], pPoint0[1])) return true;
-        pPoint0++;
-    }
-    return false;
-}
-
-bool isLinesIntersectWithLines(vector_float2 line0s, vector_float2 line0e, const vector_float2* points, const uint32_t* indices, size_t linesCount) {
-    const uint32_t* pIndex = indices;
-    for (size_t i=linesCount; i>0; --i)
-    {
-        if (areLinesIntersect(line0s, line0e, points[pIndex[0]], points[pIndex[1]])) return true;
-        pIndex += 2;
-    }
-    return false;
-}
-
-bool isPointInPolygon(vector_float2 point, const vector_float2* polygonVertices, size_t polygonSize) {
-    int signSum = 0;
-    const vector_float2* pVertex = polygonVertices;
-    vector_float2 p0 = pVertex[polygonSize - 1], p1 = pVertex[0];
-    for (size_t i = polygonSize; i > 0; --i, p0 = *pVertex++, p1 = *pVertex)
-    {
-        if (p0.y == p1.y) continue;
-        
-        float dY0 = point.y - p0.y;
-        float dY1 = p1.y - point.y;
-        if (dY0 * dY1 < 0) continue;
-        
-        // (x - x0) / (x1 - x0) = (y - y0) / (y1 - y0)
-        float intersectX = p0.x + (point.y - p0.y) * (p1.x - p0.x) / (p1.y - p0.y);
-        if (intersectX > point.x) continue;
-        
-        if (dY0 > 0)
-            signSum++;
-        else if (dY0 < 0)
-            signSum--;
-        
-        if (dY1 > 0)
-            signSum++;
-        else if (dY1 < 0)
-            signSum--;
-    }
-    return (signSum != 0);
-}
-
 bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     float leftMostX = vertices[0].x;
     size_t leftMostIndex = 0;
@@ -175,7 +34,7 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     return (crossProductZ <= 0);
 }
 
-@interface ViewController () <MTKViewDelegate>
+@interface ViewController () <MTKViewDelegate, IndexBufferAllocator>
 
 @property (nonatomic, strong) MTKView* mtView;
 @property (nonatomic, strong) id<MTLCommandQueue> mtCommandQueue;
@@ -204,17 +63,26 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
 @property (nonatomic, assign) NSUInteger totalVerticesCount;
 @property (nonatomic, strong) NSMutableArray<NSNumber* >* polygonSizes;
 
+@property (nonatomic, assign) SeidelEdgeGrid* edgeGrid;
+@property (nonatomic, assign) int currentPolygonFirstEdge;
+@property (nonatomic, assign) int currentPolygonLastEdge;
+
 @property (nonatomic, assign) bool isCurrentLineValid;
 @property (nonatomic, assign) bool isCloseLineValid;
 
 @property (nonatomic, strong) id<MTLBuffer> endLineIndicesBuffer;
-@property (nonatomic, strong) id<MTLBuffer> triangleLinesIndicesBuffer;
-@property (nonatomic, strong) id<MTLBuffer> trianglesIndicesBuffer;
+// Triangle indices, then the same as lines, triple buffered:
+@property (nonatomic, strong) IndexBufferRing* indexBufferRing;
+@property (nonatomic, assign) size_t trianglesCount;
 
 @end
 
 @implementation ViewController
 
+-(id<IndexBuffer>) newIndexBufferWithLength:(NSUInteger)length {
+    return (id<IndexBuffer>)[_mtView.device newBufferWithLength:length options:MTLResourceStorageModeShared];
+}
+
 -(void) updateEndLineIndicesBuffer {
     if (_polygonSizes.count > 0)
     {
@@ -247,6 +115,24 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     _profileLabel.hidden = !_triangulateButton.enabled;
 }
 
+-(void) rebuildEdgeGrid {
+    edge_grid_clear(_edgeGrid);
+    int vertexIndex = 0;
+    for (NSNumber* polygonSize in _polygonSizes)
+    {
+        int verticesCount = [polygonSize intValue];
+        for (int i = 0; i < verticesCount; ++i)
+        {
+            vector_float2 p0 = _polygonVerticesData[vertexIndex + i];
+            vector_float2 p1 = _polygonVerticesData[vertexIndex + (i + 1) % verticesCount];
+            edge_grid_add(_edgeGrid, p0.x, p0.y, p1.x, p1.y);
+        }
+        vertexIndex += verticesCount;
+    }
+    _currentPolygonFirstEdge = 0;
+    _currentPolygonLastEdge = 0;
+}
+
 -(void) validateGeometry {
     _isCurrentLineValid = true;
     _isCloseLineValid = true;
@@ -264,85 +150,24 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     {
         vector_float2 currentLine[] = {_polygonVerticesData[vertexIndex + _currentPolygonVerticesCount - 1], currentPoint};
         vector_float2 closeLine[] = {_polygonVerticesData[vertexIndex], currentPoint};
-        vertexIndex = 0;
-        for (NSNumber* polygonSize in _polygonSizes)
+        // Edges of the completed polygons and of the current one are all in _edgeGrid.
+        // The current line may only touch the last edge at their common vertex, the close line the first edge:
+        if (edge_grid_intersects(_edgeGrid, currentLine[0].x, currentLine[0].y, currentLine[1].x, currentLine[1].y, _currentPolygonLastEdge, 0))
         {
-            uint32_t verticesCount = (uint32_t)[polygonSize integerValue];
-            if (_isCurrentLineValid)
-            {
-                if (isLinesIntersectWithLineStrip(currentLine[0], currentLine[1], _polygonVerticesData + vertexIndex, verticesCount - 1))
-                {
-                    _isCurrentLineValid = false;
-                }
-            }
-            if (_isCloseLineValid)
-            {
-                if (isLinesIntersectWithLineStrip(closeLine[0], closeLine[1], _polygonVerticesData + vertexIndex, verticesCount - 1))
-                {
-                    _isCloseLineValid = false;
-                }
-            }
-            vertexIndex += verticesCount;
+            _isCurrentLineValid = false;
         }
-        
-        uint32_t* endLineIndices = (uint32_t*)_endLineIndicesBuffer.contents;
-        if (_isCurrentLineValid)
+        if (edge_grid_intersects(_edgeGrid, closeLine[0].x, closeLine[0].y, closeLine[1].x, closeLine[1].y, _currentPolygonFirstEdge, 0))
         {
-            if (isLinesIntersectWithLines(currentLine[0], currentLine[1], _polygonVerticesData, endLineIndices, _polygonSizes.count))
-            {
-                _isCurrentLineValid = false;
-            }
-        }
-        if (_isCloseLineValid)
-        {
-            if (isLinesIntersectWithLines(closeLine[0], closeLine[1], _polygonVerticesData, endLineIndices, _polygonSizes.count))
-            {
-                _isCloseLineValid = false;
-            }
-        }
-            
-        if (_currentPolygonVerticesCount > 2)
-        {
-            if (_isCurrentLineValid)
-            {
-                if (isLinesIntersectWithLineStrip(currentLine[0], currentLine[1], _polygonVerticesData + vertexIndex, _currentPolygonVerticesCount - 2))
-                {
-                    _isCurrentLineValid = false;
-                }
-            }
-            if (_isCloseLineValid)
-            {
-                if (isLinesIntersectWithLineStrip(closeLine[0], closeLine[1], _polygonVerticesData + vertexIndex + 1, _currentPolygonVerticesCount - 2))
-                {
-                    _isCloseLineValid = false;
-                }
-            }
+            _isCloseLineValid = false;
         }
     }
 
-    if (_isCurrentLineValid)
-    {
-        vector_float2* polygonStart = _polygonVerticesData;
-        for (NSInteger i = 0; i < _polygonSizes.count; ++i)
+    if (_isCurrentLineValid && _polygonSizes.count > 0)
+    {// The completed polygons' edges come first, one per vertex. A ray crossing them an odd number of times
+        // starts inside the outer polygon and outside every hole:
+        if (!(edge_grid_crossings(_edgeGrid, currentPoint.x, currentPoint.y, vertexIndex) & 1))
         {
-            size_t polygonSize = (size_t)[_polygonSizes[i] integerValue];
-            if (0 == i)
-            {
-                if (!isPointInPolygon(currentPoint, polygonStart, polygonSize))
-                {
-                    _isCurrentLineValid = false;
-                    break;
-                }
-            }
-            else
-            {
-                if (isPointInPolygon(currentPoint, polygonStart, polygonSize))
-                {
-                    _isCurrentLineValid = false;
-                    break;
-                }
-            }
-            polygonStart += polygonSize;
+            _isCurrentLineValid = false;
         }
     }
 
@@ -424,20 +249,26 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
             }
         }
     }
-    else if (1 == _stage && _triangleLinesIndicesBuffer)
+    else if (1 == _stage && _trianglesCount > 0)
     {
-        // The number of output triangles produced for a polygon with n points is, (n - 2) + 2*(#holes)
         size_t totalPolygonVertices = _totalVerticesCount - _currentPolygonVerticesCount;
-        size_t trianglesCount = totalPolygonVertices - 2 + 2 * (_polygonSizes.count - 1);
+        size_t trianglesCount = _trianglesCount;
+        // Hold the buffer until the GPU is done with this frame:
+        IndexBufferRing* indexBufferRing = _indexBufferRing;
+        NSInteger slot = [indexBufferRing acquireFrameSlot];
+        [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+            [indexBufferRing releaseFrameSlot:slot];
+        }];
+        id<MTLBuffer> indexBuffer = (id<MTLBuffer>)[indexBufferRing bufferAtSlot:slot];
         [renderEncoder setVertexBytes:_polygonVerticesData length:sizeof(vector_float2) * totalPolygonVertices atIndex:VertexSlot];
         [renderEncoder setFragmentBytes:&greenColor length:sizeof(vector_float4) atIndex:ColorSlot];
         if (_fillSwitch.isOn)
         {
-            [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle indexCount:(3 * trianglesCount) indexType:MTLIndexTypeUInt32 indexBuffer:_trianglesIndicesBuffer indexBufferOffset:0];
+            [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle indexCount:(3 * trianglesCount) indexType:MTLIndexTypeUInt32 indexBuffer:indexBuffer indexBufferOffset:0];
         }
         else
         {
-            [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeLine indexCount:(6 * trianglesCount) indexType:MTLIndexTypeUInt32 indexBuffer:_triangleLinesIndicesBuffer indexBufferOffset:0];
+            [renderEncoder drawIndexedPrimitives:MTLPrimitiveTypeLine indexCount:(6 * trianglesCount) indexType:MTLIndexTypeUInt32 indexBuffer:indexBuffer indexBufferOffset:(sizeof(uint32_t) * 3 * trianglesCount)];
         }
     }
     
@@ -460,6 +291,13 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     {
         case 0:
         {
+            if (_currentPolygonVerticesCount > 0)
+            {
+                vector_float2 p0 = _polygonVerticesData[_totalVerticesCount - 1];
+                _currentPolygonLastEdge = edge_grid_add(_edgeGrid, p0.x, p0.y, _cursor.x, _cursor.y);
+                if (1 == _currentPolygonVerticesCount)
+                    _currentPolygonFirstEdge = _currentPolygonLastEdge;
+            }
             _polygonVerticesData[_totalVerticesCount++] = _cursor;
             _polygonVerticesData[_totalVerticesCount] = (vector_float2){0.f, 0.f};
             _currentPolygonVerticesCount++;
@@ -475,19 +313,25 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
 -(void) triangulate {
     if (_polygonSizes.count == 0) return;
     int* polygonSizes = (int*) malloc(sizeof(int) * _polygonSizes.count);
-    size_t totalPolygonVertices = _totalVerticesCount - _currentPolygonVerticesCount;
+    for (NSInteger i = 0; i < _polygonSizes.count; ++i)
+        polygonSizes[i] = [_polygonSizes[i] intValue];
+    // The number of output triangles produced for a polygon with n points is, (n - 2) + 2*(#holes)
+    SeidelSizes sizes;
+    if (seidel_required_sizes((int)_polygonSizes.count, polygonSizes, &sizes) < 0)
+    {
+        free(polygonSizes);
+        return;
+    }
+    size_t totalPolygonVertices = sizes.npoints;
     double* vertices = (double*) malloc(sizeof(double) * 2 * (totalPolygonVertices + 1));
     size_t* reorderedIndices = (size_t*) malloc(sizeof(size_t) * totalPolygonVertices);
-    // The number of output triangles produced for a polygon with n points is, (n - 2) + 2*(#holes)
-    size_t trianglesCount = totalPolygonVertices - 2 + 2 * (_polygonSizes.count - 1);
-    int* triangles = (int*) malloc(sizeof(int) * 3 * trianglesCount);
+    size_t trianglesCount = sizes.ntriangles;
     size_t vertexStartIndex = 0;
     double* pDst = vertices + 2;//vertices[0] must NOT be used (i.e. i/p starts from vertices[1] instead
     size_t* pIndices = reorderedIndices;
     for (NSInteger i = 0; i < _polygonSizes.count; ++i)
     {
-        int polygonSize = [_polygonSizes[i] intValue];
-        polygonSizes[i] = polygonSize;
+        int polygonSize = polygonSizes[i];
         
         bool shouldReverse = isPolygonClockwise(_polygonVerticesData + vertexStartIndex, polygonSize) ^ (0 != i);
         if (shouldReverse)
@@ -520,42 +364,60 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
         vertexStartIndex += polygonSize;
     }
     
+    int segA, segB;
+    if (!validate_polygon((int)_polygonSizes.count, polygonSizes, (double(*)[2])vertices, &segA, &segB))
+    {// Seidel's algorithm needs a simple polygon:
+        _infoLabel.text = [NSString stringWithFormat:@"Edges %d and %d intersect", segA, segB];
+        _trianglesCount = 0;
+        free(polygonSizes);
+        free(vertices);
+        free(reorderedIndices);
+        return;
+    }
+    _infoLabel.text = @"";
+    
+    // The triangulator writes its int triangles straight into the next index buffer of the ring,
+    // 3 * 4 bytes each like the uint32 indices they become in place. The lines follow them:
+    uint32_t* trianglesIndices = (uint32_t*)[_indexBufferRing beginWriteWithLength:(3 * sizes.index32_bytes)];
     SeidelTriangulator* seidel = NULL;
-    triangulate_polygon(&seidel, (int)_polygonSizes.count, polygonSizes, (double(*)[2])vertices, (int(*)[3])triangles);
+    int result = trianglesIndices ? triangulate_polygon(&seidel, (int)_polygonSizes.count, polygonSizes, (double(*)[2])vertices, (int(*)[3])trianglesIndices) : SEIDEL_ERR_NOMEM;
     SeidelTriangulatorRelease(seidel);
+    if (result < 0)
+    {
+        _infoLabel.text = [NSString stringWithFormat:@"Triangulation failed (error %d)", result];
+        _trianglesCount = 0;
+        free(polygonSizes);
+        free(vertices);
+        free(reorderedIndices);
+        return;
+    }
     
-    uint32_t* triangleLinesIndices = (uint32_t*) malloc(sizeof(uint32_t) * 6 * trianglesCount);
-    uint32_t* trianglesIndices = (uint32_t*) malloc(sizeof(uint32_t) * 3 * trianglesCount);
-    uint32_t* pTriangleLines = triangleLinesIndices;
-    uint32_t* pDstTriangles = trianglesIndices;
-    int* pSrcTriangles = triangles;
+    uint32_t* pTriangleLines = trianglesIndices + 3 * trianglesCount;
+    uint32_t* pTriangles = trianglesIndices;
     for (int i=0; i<trianglesCount; ++i)
     {
-        uint32_t v0 = (uint32_t) reorderedIndices[pSrcTriangles[0] - 1];
-        uint32_t v1 = (uint32_t) reorderedIndices[pSrcTriangles[1] - 1];
-        uint32_t v2 = (uint32_t) reorderedIndices[pSrcTriangles[2] - 1];
+        const int* pSrcTriangle = (const int*) pTriangles;
+        uint32_t v0 = (uint32_t) reorderedIndices[pSrcTriangle[0] - 1];
+        uint32_t v1 = (uint32_t) reorderedIndices[pSrcTriangle[1] - 1];
+        uint32_t v2 = (uint32_t) reorderedIndices[pSrcTriangle[2] - 1];
         pTriangleLines[0] = v0;
         pTriangleLines[1] = v1;
         pTriangleLines[2] = v1;
         pTriangleLines[3] = v2;
         pTriangleLines[4] = v2;
         pTriangleLines[5] = v0;
-        pDstTriangles[0] = v0;
-        pDstTriangles[1] = v1;
-        pDstTriangles[2] = v2;
-        pSrcTriangles += 3;
+        pTriangles[0] = v0;
+        pTriangles[1] = v1;
+        pTriangles[2] = v2;
+        pTriangles += 3;
         pTriangleLines += 6;
-        pDstTriangles += 3;
     }
-    _triangleLinesIndicesBuffer = [_mtView.device newBufferWithBytes:triangleLinesIndices length:(sizeof(uint32_t) * 6 * trianglesCount) options:MTLResourceOptionCPUCacheModeDefault];
-    _trianglesIndicesBuffer = [_mtView.device newBufferWithBytes:trianglesIndices length:(sizeof(uint32_t) * 3 * trianglesCount) options:MTLResourceOptionCPUCacheModeDefault];
-    free(triangleLinesIndices);
-    free(trianglesIndices);
+    [_indexBufferRing endWrite];
+    _trianglesCount = trianglesCount;
     
     free(polygonSizes);
     free(vertices);
     free(reorderedIndices);
-    free(triangles);
 }
 
 -(void) profileTriangulation {
@@ -609,14 +471,25 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     const int TestCount = 1024;
     NSDate* startTime = [NSDate date];
     SeidelTriangulator* seidel = NULL;
+    int failures = 0;
     for (int i=TestCount; i>0; --i)
     {
-        triangulate_polygon(&seidel, (int)_polygonSizes.count, polygonSizes, (double(*)[2])vertices, (int(*)[3])triangles);
+        if (triangulate_polygon(&seidel, (int)_polygonSizes.count, polygonSizes, (double(*)[2])vertices, (int(*)[3])triangles) < 0)
+            failures++;
     }
-    SeidelTriangulatorRelease(seidel);
     NSTimeInterval timeUsage = [[NSDate date] timeIntervalSinceDate:startTime];
+    // The same requests through a tessellation cache: one miss, then hash-and-copy
+    SeidelCache* cache = SeidelCacheCreate(sizeof(int) * 3 * trianglesCount + sizeof(double) * 2 * totalPolygonVertices + 4096, 1);
+    startTime = [NSDate date];
+    for (int i=TestCount; i>0; --i)
+    {
+        seidel_cache_triangulate(cache, &seidel, (int)_polygonSizes.count, polygonSizes, (double(*)[2])vertices, (int(*)[3])triangles, NULL);
+    }
+    NSTimeInterval cachedTimeUsage = [[NSDate date] timeIntervalSinceDate:startTime];
+    SeidelCacheRelease(cache);
+    SeidelTriangulatorRelease(seidel);
     dispatch_async(dispatch_get_main_queue(), ^{
-        self.profileLabel.text = [NSString stringWithFormat:@"%ld vertices, %ld holes, total %f ms for %d times, average %f ms for one triangulation", totalPolygonVertices, self.polygonSizes.count - 1, timeUsage * 1000, TestCount, timeUsage * 1000 / TestCount];
+        self.profileLabel.text = [NSString stringWithFormat:@"%ld vertices, %ld holes, total %f ms for %d times, average %f ms for one triangulation, %d failed, average %f ms cached", totalPolygonVertices, self.polygonSizes.count - 1, timeUsage * 1000, TestCount, timeUsage * 1000 / TestCount, failures, cachedTimeUsage * 1000 / TestCount];
         _profileButton.enabled = YES;
         //[self setControlStates];
     });
@@ -641,6 +514,12 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     {
         case 0:
         {
+            vector_float2 first = _polygonVerticesData[_totalVerticesCount - _currentPolygonVerticesCount];
+            vector_float2 last = _polygonVerticesData[_totalVerticesCount - 1];
+            edge_grid_add(_edgeGrid, last.x, last.y, _cursor.x, _cursor.y);
+            edge_grid_add(_edgeGrid, _cursor.x, _cursor.y, first.x, first.y);
+            _currentPolygonFirstEdge = 0;
+            _currentPolygonLastEdge = 0;
             _totalVerticesCount++;
             [_polygonSizes addObject:@(_currentPolygonVerticesCount + 1)];
             _currentPolygonVerticesCount = 0;
@@ -671,6 +550,7 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
         _stage = 0;
         _totalVerticesCount -= _currentPolygonVerticesCount;
         _currentPolygonVerticesCount = 0;
+        [self rebuildEdgeGrid];
         [_triangulateButton setTitle:@"三角化" forState:UIControlStateNormal];
         [self setControlStates];
         break;
@@ -680,6 +560,7 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
 }
 
 -(void) dealloc {
+    SeidelEdgeGridRelease(_edgeGrid);
     free(_polygonVerticesData);
 }
 
@@ -710,6 +591,12 @@ bool isPolygonClockwise(const vector_float2* vertices, size_t verticesCount) {
     _currentPolygonVerticesCount = 0;
     _totalVerticesCount = 0;
     _polygonVerticesData = (vector_float2*) malloc(sizeof(vector_float2) * _maxVerticesCount);
+    // The cursor is in normalized device coordinates:
+    _edgeGrid = SeidelEdgeGridCreate(-1, -1, 1, 1, (int)_maxVerticesCount);
+    _indexBufferRing = [[IndexBufferRing alloc] initWithAllocator:self count:3];
+    _trianglesCount = 0;
+    _currentPolygonFirstEdge = 0;
+    _currentPolygonLastEdge = 0;
     _isCurrentLineValid = true;
     _isCloseLineValid = true;
     [self setControlStates];
@@ -0,0 +1,1631 @@
+/* Throughput benchmarks for the triangulator and its helper kernels.
+ *
+ * USAGE:
+ *	bench inpoly [#points] [#vertices]
+ *	bench validate [#vertices]
+ *	bench edit [#vertices] [#cursor moves]
+ *	bench cache [#polygons] [#vertices] [#requests]
+ *	bench lod [#vertices] [#levels]
+ *	bench tiles [#vertices] [#tiles per side] [#threads]
+ *	bench glyphs [#glyphs per size] [tolerance in pixels]
+ *	bench schedule [#vertices] [#runs]
+ *	bench weld [#vertices] [#repeats per vertex]
+ *	bench raster [#vertices] [pixels across]
+ *	bench moments [#vertices] [#runs]
+ *	bench monotone [#vertices] [#runs]
+ *	bench convex [#vertices]
+ *	bench clip [#vertices] [#runs]
+ *	bench query [#vertices] [#queries]
+ *	bench holes [#holes] [#small polygons]
+ *	bench pipeline [#polygons] [#vertices]
+ */
+
+#include "triangulation_seidel.h"
+#include <sys/time.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+static double now_ms()
+{
+  struct timeval tval;
+
+  gettimeofday(&tval, NULL);
+  return tval.tv_sec * 1000.0 + tval.tv_usec / 1000.0;
+}
+
+
+/* Anti-clockwise star-shaped blob with n vertices, written from
+ * vertices[1] on as triangulate_polygon() expects.
+ */
+static void make_blob(int n, double (*vertices)[2])
+{
+  register int i;
+  double t, r;
+
+  for (i = 1; i <= n; i++)
+    {
+      t = 2.0 * M_PI * (i - 1) / n;
+      r = 0.8 + 0.15 * sin(7.0 * t) + 0.5 * drand48() / n;
+      vertices[i][0] = r * cos(t);
+      vertices[i][1] = r * sin(t);
+    }
+}
+
+
+/* points_in_polygon() and point_edge_crossings() against the scalar
+ * loop and against point location in the triangulated polygon.
+ */
+static int bench_inpoly(int npoints, int nvert)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  double *vx = malloc(sizeof(double) * nvert);
+  double *vy = malloc(sizeof(double) * nvert);
+  double *ex = malloc(sizeof(double) * nvert);
+  double *ey = malloc(sizeof(double) * nvert);
+  double *px = malloc(sizeof(double) * npoints);
+  double *py = malloc(sizeof(double) * npoints);
+  unsigned char *inside = malloc(npoints);
+  SeidelTriangulator *state = NULL;
+  double t0, t_scalar, t_batch, t_edges, t_located;
+  int i, n_scalar = 0, n_batch, n_edges = 0, n_located = 0;
+  double p[2];
+
+  make_blob(nvert, vertices);
+  for (i = 0; i < nvert; i++)
+    {
+      vx[i] = vertices[i + 1][0];
+      vy[i] = vertices[i + 1][1];
+      ex[i] = vertices[(i + 1) % nvert + 1][0];
+      ey[i] = vertices[(i + 1) % nvert + 1][1];
+    }
+  for (i = 0; i < npoints; i++)
+    {
+      px[i] = 2.2 * drand48() - 1.1;
+      py[i] = 2.2 * drand48() - 1.1;
+    }
+
+  if ((i = triangulate_polygon(&state, 1, &nvert, vertices, triangles)) < 0)
+    {
+      fprintf(stderr, "triangulate_polygon: error %d\n", i);
+      return 1;
+    }
+
+  t0 = now_ms();
+  for (i = 0; i < npoints; i++)
+    n_scalar += point_in_polygon(px[i], py[i], nvert, vx, vy);
+  t_scalar = now_ms() - t0;
+
+  t0 = now_ms();
+  n_batch = points_in_polygon(npoints, px, py, nvert, vx, vy, inside);
+  t_batch = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < npoints; i++)
+    n_edges += point_edge_crossings(px[i], py[i], nvert, vx, vy, ex, ey) & 1;
+  t_edges = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < npoints; i++)
+    {
+      p[0] = px[i];
+      p[1] = py[i];
+      n_located += is_point_inside_polygon(state, p);
+    }
+  t_located = now_ms() - t0;
+
+  printf("%d points, %d vertices\n", npoints, nvert);
+  printf("  point_in_polygon        %10.3f ms  %d inside\n", t_scalar, n_scalar);
+  printf("  points_in_polygon       %10.3f ms  %d inside\n", t_batch, n_batch);
+  printf("  point_edge_crossings    %10.3f ms  %d inside\n", t_edges, n_edges);
+  printf("  is_point_inside_polygon %10.3f ms  %d inside\n", t_located, n_located);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices); free(triangles);
+  free(vx); free(vy); free(ex); free(ey);
+  free(px); free(py); free(inside);
+  return (n_scalar == n_batch && n_scalar == n_edges) ? 0 : 1;
+}
+
+
+/* validate_polygon() against testing every pair of edges, which is
+ * what the editor used to do. The pairwise test is skipped for large
+ * inputs.
+ */
+static int bench_validate(int nvert)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  point_t *v = malloc(sizeof(point_t) * (nvert + 1));
+  double t0, t_sweep, t_pairs = -1;
+  int i, j, simple, pairs_simple = -1, sega, segb;
+
+  make_blob(nvert, vertices);
+
+  t0 = now_ms();
+  simple = validate_polygon(1, &nvert, vertices, &sega, &segb);
+  t_sweep = now_ms() - t0;
+
+  if (nvert <= 20000)
+    {
+      for (i = 1; i <= nvert; i++)
+	{
+	  v[i].x = vertices[i][0];
+	  v[i].y = vertices[i][1];
+	}
+      t0 = now_ms();
+      pairs_simple = TRUE;
+      for (i = 1; i <= nvert && pairs_simple; i++)
+	for (j = i + 2; j <= nvert; j++)
+	  if (((i != 1) || (j != nvert)) &&
+	      segments_intersect(&v[i], &v[i % nvert + 1], &v[j], &v[j % nvert + 1]))
+	    {
+	      pairs_simple = FALSE;
+	      break;
+	    }
+      t_pairs = now_ms() - t0;
+    }
+
+  printf("%d vertices\n", nvert);
+  printf("  validate_polygon        %10.3f ms  simple=%d\n", t_sweep, simple);
+  if (pairs_simple >= 0)
+    printf("  all pairs               %10.3f ms  simple=%d\n", t_pairs, pairs_simple);
+
+  free(vertices);
+  free(v);
+  return (pairs_simple < 0 || pairs_simple == simple) ? 0 : 1;
+}
+
+
+/* The editor's check of a cursor move while a hole is drawn inside a
+ * blob: do the line from the last vertex and the line back to the
+ * first meet an edge, and is the cursor inside the blob and outside
+ * the hole so far. With the edges in a SeidelEdgeSet and a crossing
+ * count over the blob, as the editor used to, and with a
+ * SeidelEdgeGrid alone.
+ */
+static int bench_edit(int nvert, int nmoves)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  double *vx = malloc(sizeof(double) * nvert), *vy = malloc(sizeof(double) * nvert);
+  double (*cursor)[2] = malloc(sizeof(double) * 2 * nmoves);
+  static const double hole[3][2] = {{0.1, 0.0}, {0.0, 0.05}, {-0.1, 0.0}};
+  SeidelEdgeSet *es;
+  SeidelEdgeGrid *eg;
+  double t0, t_set_add, t_grid_add, t_set, t_grid;
+  int i, j, first = 0, last = 0, gfirst = 0, glast = 0, mismatches = 0;
+  int set_valid = 0, grid_valid = 0;
+
+  make_blob(nvert, vertices);
+  for (i = 0; i < nvert; i++)
+    {
+      vx[i] = vertices[i + 1][0];
+      vy[i] = vertices[i + 1][1];
+    }
+  for (i = 0; i < nmoves; i++)
+    {
+      cursor[i][0] = 2 * drand48() - 1;
+      cursor[i][1] = 2 * drand48() - 1;
+    }
+
+  t0 = now_ms();
+  es = SeidelEdgeSetCreate(16);
+  for (i = 1; i <= nvert; i++)
+    edge_set_add(es, vertices[i][0], vertices[i][1],
+		 vertices[i % nvert + 1][0], vertices[i % nvert + 1][1]);
+  for (j = 1; j < 3; j++)
+    {
+      last = edge_set_add(es, hole[j - 1][0], hole[j - 1][1], hole[j][0], hole[j][1]);
+      first = first ? first : last;
+    }
+  t_set_add = now_ms() - t0;
+
+  t0 = now_ms();
+  eg = SeidelEdgeGridCreate(-1, -1, 1, 1, 16);
+  for (i = 1; i <= nvert; i++)
+    edge_grid_add(eg, vertices[i][0], vertices[i][1],
+		  vertices[i % nvert + 1][0], vertices[i % nvert + 1][1]);
+  for (j = 1; j < 3; j++)
+    {
+      glast = edge_grid_add(eg, hole[j - 1][0], hole[j - 1][1], hole[j][0], hole[j][1]);
+      gfirst = gfirst ? gfirst : glast;
+    }
+  t_grid_add = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < nmoves; i++)
+    {
+      int valid = !edge_set_intersects(es, hole[2][0], hole[2][1], cursor[i][0], cursor[i][1], last, 0) &&
+	!edge_set_intersects(es, hole[0][0], hole[0][1], cursor[i][0], cursor[i][1], first, 0) &&
+	point_in_polygon(cursor[i][0], cursor[i][1], nvert, vx, vy);
+
+      set_valid += valid;
+    }
+  t_set = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < nmoves; i++)
+    {
+      int valid = !edge_grid_intersects(eg, hole[2][0], hole[2][1], cursor[i][0], cursor[i][1], glast, 0) &&
+	!edge_grid_intersects(eg, hole[0][0], hole[0][1], cursor[i][0], cursor[i][1], gfirst, 0) &&
+	(edge_grid_crossings(eg, cursor[i][0], cursor[i][1], nvert) & 1);
+
+      grid_valid += valid;
+    }
+  t_grid = now_ms() - t0;
+
+  for (i = 0; i < nmoves; i++)
+    if ((edge_set_intersects(es, 0, 0, cursor[i][0], cursor[i][1], 0, 0) != 0) !=
+	(edge_grid_intersects(eg, 0, 0, cursor[i][0], cursor[i][1], 0, 0) != 0) ||
+	point_in_polygon(cursor[i][0], cursor[i][1], nvert, vx, vy) !=
+	(edge_grid_crossings(eg, cursor[i][0], cursor[i][1], nvert) & 1))
+      mismatches++;
+
+  printf("%d vertices, %d cursor moves, %d allowed\n", nvert, nmoves, grid_valid);
+  printf("  edge set + crossings    %10.3f ms to add  %10.3f us/move\n",
+	 t_set_add, 1000 * t_set / nmoves);
+  printf("  edge grid               %10.3f ms to add  %10.3f us/move  (%d cells)\n",
+	 t_grid_add, 1000 * t_grid / nmoves, eg->side * eg->side);
+  if (mismatches)
+    printf("  %d moves answered differently\n", mismatches);
+
+  SeidelEdgeSetRelease(es);
+  SeidelEdgeGridRelease(eg);
+  free(vertices);
+  free(vx);
+  free(vy);
+  free(cursor);
+  return (!mismatches && (set_valid == grid_valid)) ? 0 : 1;
+}
+
+
+/* Requests drawn at random from a set of distinct polygons, as a tile
+ * server sees them: triangulated every time, then through a cache
+ * large enough to hold them all.
+ */
+static int bench_cache(int npolys, int nvert, int nrequests)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * npolys * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  int (*cached)[3] = malloc(sizeof(int) * 3 * nvert);
+  int *pick = malloc(sizeof(int) * nrequests);
+  SeidelCache *cache = SeidelCacheCreate((size_t) npolys * nvert * 64, 16);
+  SeidelTriangulator *state = NULL;
+  double t0, t_plain, t_cached;
+  long hits, misses;
+  int i, ntri, hit, errors = 0;
+
+  for (i = 0; i < npolys; i++)
+    make_blob(nvert, vertices + i * (nvert + 1));
+  for (i = 0; i < nrequests; i++)
+    pick[i] = lrand48() % npolys;
+
+  t0 = now_ms();
+  for (i = 0; i < nrequests; i++)
+    if (triangulate_polygon(&state, 1, &nvert, vertices + pick[i] * (nvert + 1), triangles) != nvert - 2)
+      errors++;
+  t_plain = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < nrequests; i++)
+    if (seidel_cache_triangulate(cache, &state, 1, &nvert, vertices + pick[i] * (nvert + 1), cached, NULL) != nvert - 2)
+      errors++;
+  t_cached = now_ms() - t0;
+  seidel_cache_stats(cache, &hits, &misses, NULL, NULL);
+
+  /* a hit must give back what the miss stored */
+  seidel_cache_clear(cache);
+  ntri = seidel_cache_triangulate(cache, &state, 1, &nvert, vertices, triangles, &hit);
+  if (hit || (seidel_cache_triangulate(cache, &state, 1, &nvert, vertices, cached, &hit) != ntri) ||
+      !hit || memcmp(triangles, cached, sizeof(int) * 3 * ntri))
+    errors++;
+
+  printf("%d requests for %d polygons of %d vertices\n", nrequests, npolys, nvert);
+  printf("  triangulate_polygon     %10.3f ms\n", t_plain);
+  printf("  cached                  %10.3f ms  %ld hits, %ld misses\n", t_cached, hits, misses);
+
+  SeidelCacheRelease(cache);
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  free(cached);
+  free(pick);
+  return errors ? 1 : 0;
+}
+
+
+/* Build a level-of-detail pyramid for a blob with a noisy outline,
+ * one level per doubling of the tolerance, and compare with
+ * triangulating at full resolution.
+ */
+static int bench_lod(int nvert, int nlevels)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  SeidelTriangulator *state = NULL;
+  SeidelLOD *lod;
+  double t0, t_full, t_lod;
+  int k, ntri;
+
+  make_blob(nvert, vertices);
+  for (k = 1; k <= nvert; k++)
+    {
+      double r = 1.0 + 0.002 * drand48();
+
+      vertices[k][0] *= r;
+      vertices[k][1] *= r;
+    }
+
+  t0 = now_ms();
+  ntri = triangulate_polygon(&state, 1, &nvert, vertices, triangles);
+  t_full = now_ms() - t0;
+
+  t0 = now_ms();
+  lod = SeidelLODCreate(1, &nvert, vertices, nlevels, 1e-4, 2.0);
+  t_lod = now_ms() - t0;
+
+  printf("%d vertices\n", nvert);
+  printf("  triangulate_polygon     %10.3f ms  %d triangles\n", t_full, ntri);
+  if (lod)
+    {
+      printf("  SeidelLODCreate         %10.3f ms  %d levels\n", t_lod, lod->nlevels);
+      for (k = 0; k < lod->nlevels; k++)
+	printf("    tolerance %-10g %8d vertices %8d triangles\n", lod->level[k].tolerance,
+	       lod->level[k].nvert, lod->level[k].ntriangles);
+    }
+
+  SeidelLODRelease(lod);
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  return (lod && (ntri == nvert - 2)) ? 0 : 1;
+}
+
+
+/* Cut a blob to a square grid of tiles and triangulate them on
+ * several threads, against triangulating it whole.
+ */
+static int bench_tiles(int nvert, int side, int nthreads)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  SeidelTriangulator *state = NULL;
+  SeidelTiling *tiling;
+  double t0, t_full, t_tiles, area = 0;
+  int i, k, ntri, ntiles = 0, nclipped = 0, failed = 0;
+
+  make_blob(nvert, vertices);
+
+  t0 = now_ms();
+  ntri = triangulate_polygon(&state, 1, &nvert, vertices, triangles);
+  t_full = now_ms() - t0;
+
+  t0 = now_ms();
+  tiling = SeidelTilingCreate(1, &nvert, vertices, -1.0, -1.0, 2.0 / side, 2.0 / side,
+			      side, side, nthreads);
+  t_tiles = now_ms() - t0;
+
+  if (tiling)
+    for (i = 0; i < side * side; i++)
+      {
+	seideltile_t *t = &tiling->tile[i];
+	if (t->ntriangles < 0)
+	  failed++;
+	if (t->ntriangles <= 0)
+	  continue;
+	ntiles++;
+	nclipped += t->nvert;
+	for (k = 0; k < t->ntriangles; k++)
+	  {
+	    double *a = t->vertices[t->triangles[k][0]];
+	    double *b = t->vertices[t->triangles[k][1]];
+	    double *c = t->vertices[t->triangles[k][2]];
+	    area += 0.5 * ((b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]));
+	  }
+      }
+
+  printf("%d vertices, %d x %d tiles, %d threads\n", nvert, side, side, nthreads);
+  printf("  triangulate_polygon     %10.3f ms  %d triangles\n", t_full, ntri);
+  printf("  SeidelTilingCreate      %10.3f ms  %d tiles, %d vertices, area %.9f\n",
+	 t_tiles, ntiles, nclipped, area);
+  if (failed)
+    printf("  %d tiles failed\n", failed);
+
+  SeidelTilingRelease(tiling);
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  return (tiling && !failed && (ntri == nvert - 2)) ? 0 : 1;
+}
+
+
+/* Glyph outlines in units of 1/1000 em, y up, outer contours */
+/* anti-clockwise and holes clockwise */
+
+typedef struct {
+  char op;			/* M, L, Q, C, Z, or 0 to end */
+  double p[6];
+} pathop_t;
+
+static const pathop_t glyph_O[] = {
+  {'M', {950, 500}},
+  {'C', {950, 748.5, 748.5, 950, 500, 950}}, {'C', {251.5, 950, 50, 748.5, 50, 500}},
+  {'C', {50, 251.5, 251.5, 50, 500, 50}}, {'C', {748.5, 50, 950, 251.5, 950, 500}},
+  {'Z', {0}},
+  {'M', {800, 500}},
+  {'C', {800, 334.3, 665.7, 200, 500, 200}}, {'C', {334.3, 200, 200, 334.3, 200, 500}},
+  {'C', {200, 665.7, 334.3, 800, 500, 800}}, {'C', {665.7, 800, 800, 665.7, 800, 500}},
+  {'Z', {0}},
+  {0, {0}}
+};
+
+static const pathop_t glyph_D[] = {
+  {'M', {100, 0}}, {'L', {450, 0}},
+  {'C', {750, 0, 900, 200, 900, 500}}, {'C', {900, 800, 750, 1000, 450, 1000}},
+  {'L', {100, 1000}}, {'Z', {0}},
+  {'M', {250, 150}}, {'L', {250, 850}}, {'L', {450, 850}},
+  {'C', {650, 850, 750, 700, 750, 500}}, {'C', {750, 300, 650, 150, 450, 150}},
+  {'Z', {0}},
+  {0, {0}}
+};
+
+static const pathop_t glyph_8[] = {
+  {'M', {300, 0}}, {'L', {700, 0}}, {'Q', {950, 0, 950, 250}}, {'L', {950, 750}},
+  {'Q', {950, 1000, 700, 1000}}, {'L', {300, 1000}}, {'Q', {50, 1000, 50, 750}},
+  {'L', {50, 250}}, {'Q', {50, 0, 300, 0}}, {'Z', {0}},
+  {'M', {650, 150}}, {'L', {350, 150}}, {'Q', {250, 150, 250, 250}}, {'L', {250, 350}},
+  {'Q', {250, 450, 350, 450}}, {'L', {650, 450}}, {'Q', {750, 450, 750, 350}},
+  {'L', {750, 250}}, {'Q', {750, 150, 650, 150}}, {'Z', {0}},
+  {'M', {650, 550}}, {'L', {350, 550}}, {'Q', {250, 550, 250, 650}}, {'L', {250, 750}},
+  {'Q', {250, 850, 350, 850}}, {'L', {650, 850}}, {'Q', {750, 850, 750, 750}},
+  {'L', {750, 650}}, {'Q', {750, 550, 650, 550}}, {'Z', {0}},
+  {0, {0}}
+};
+
+#define GLYPH_FIXED_STEPS 16	/* chords per curve the old way */
+#define GLYPH_MAX_VERTICES (40 * 1024) /* the glyphs above at the most */
+				/* chords path.c cuts a curve into */
+
+/* The old way: flatten every curve into GLYPH_FIXED_STEPS chords in */
+/* a vertex array of its own, then triangulate_polygon() */
+static int glyph_fixed(SeidelTriangulator **state, const pathop_t *g, double scale,
+		       int (*triangles)[3], int *nvert)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (64 * GLYPH_FIXED_STEPS + 1));
+  int cntr[8], ncontours = 0, n = 0, first = 1, i, k, ntri;
+  double x0 = 0, y0 = 0;
+
+  for (i = 0; g[i].op; i++)
+    {
+      const double *p = g[i].p;
+
+      switch (g[i].op)
+	{
+	case 'M':
+	  first = n + 1;
+	  /* fall through */
+	case 'L':
+	  n++;
+	  vertices[n][0] = p[0] * scale;
+	  vertices[n][1] = p[1] * scale;
+	  break;
+	case 'Q':
+	case 'C':
+	  for (k = 1; k <= GLYPH_FIXED_STEPS; k++)
+	    {
+	      double t = (double) k / GLYPH_FIXED_STEPS, s = 1 - t;
+
+	      n++;
+	      if (g[i].op == 'Q')
+		{
+		  vertices[n][0] = (s * s * x0 + 2 * s * t * p[0] + t * t * p[2]) * scale;
+		  vertices[n][1] = (s * s * y0 + 2 * s * t * p[1] + t * t * p[3]) * scale;
+		}
+	      else
+		{
+		  vertices[n][0] = (s * s * s * x0 + 3 * s * s * t * p[0] +
+				    3 * s * t * t * p[2] + t * t * t * p[4]) * scale;
+		  vertices[n][1] = (s * s * s * y0 + 3 * s * s * t * p[1] +
+				    3 * s * t * t * p[3] + t * t * t * p[5]) * scale;
+		}
+	    }
+	  break;
+	case 'Z':
+	  if ((vertices[n][0] == vertices[first][0]) && (vertices[n][1] == vertices[first][1]))
+	    n--;
+	  cntr[ncontours++] = n - first + 1;
+	  break;
+	}
+      if (g[i].op != 'Z')
+	{
+	  x0 = vertices[n][0] / scale;
+	  y0 = vertices[n][1] / scale;
+	}
+    }
+
+  if (*state && ((*state)->segSize <= n))
+    {
+      SeidelTriangulatorRelease(*state);
+      *state = NULL;
+    }
+  ntri = triangulate_polygon(state, ncontours, cntr, vertices, triangles);
+  free(vertices);
+  *nvert = n;
+  return ntri;
+}
+
+/* The path API, flattening to tolerance on the way in */
+static int glyph_path(SeidelTriangulator **state, const pathop_t *g, double scale,
+		      double tolerance, int (*triangles)[3], int *nvert)
+{
+  int i;
+
+  seidel_path_begin(state, tolerance);
+  for (i = 0; g[i].op; i++)
+    {
+      const double *p = g[i].p;
+
+      switch (g[i].op)
+	{
+	case 'M':
+	  seidel_path_move_to(*state, p[0] * scale, p[1] * scale);
+	  break;
+	case 'L':
+	  seidel_path_line_to(*state, p[0] * scale, p[1] * scale);
+	  break;
+	case 'Q':
+	  seidel_path_quad_to(*state, p[0] * scale, p[1] * scale, p[2] * scale, p[3] * scale);
+	  break;
+	case 'C':
+	  seidel_path_cubic_to(*state, p[0] * scale, p[1] * scale, p[2] * scale,
+			       p[3] * scale, p[4] * scale, p[5] * scale);
+	  break;
+	case 'Z':
+	  seidel_path_close(*state);
+	  break;
+	}
+    }
+  *nvert = seidel_path_vertices(*state, NULL);
+  return triangulate_path(*state, triangles);
+}
+
+/* Triangulate glyph outlines at several pixel sizes, flattened with */
+/* a fixed number of chords per curve and to a pixel tolerance */
+static int bench_glyphs(int nglyphs, double tolerance)
+{
+  static const pathop_t *glyphs[] = {glyph_O, glyph_D, glyph_8};
+  static const int sizes[] = {12, 24, 48, 96, 256};
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * GLYPH_MAX_VERTICES);
+  SeidelTriangulator *fixed = NULL, *path = NULL;
+  double t0, t_fixed, t_path;
+  int i, k, ntri, nvert, failed = 0;
+
+  printf("%d glyphs per size, tolerance %g pixels\n", nglyphs, tolerance);
+  for (k = 0; k < (int) (sizeof(sizes) / sizeof(sizes[0])); k++)
+    {
+      double scale = sizes[k] / 1000.0;
+      long vfixed = 0, vpath = 0;
+
+      t0 = now_ms();
+      for (i = 0; i < nglyphs; i++)
+	{
+	  if ((ntri = glyph_fixed(&fixed, glyphs[i % 3], scale, triangles, &nvert)) < 0)
+	    failed++;
+	  vfixed += nvert;
+	}
+      t_fixed = now_ms() - t0;
+
+      t0 = now_ms();
+      for (i = 0; i < nglyphs; i++)
+	{
+	  if ((ntri = glyph_path(&path, glyphs[i % 3], scale, tolerance, triangles, &nvert)) < 0)
+	    failed++;
+	  vpath += nvert;
+	}
+      t_path = now_ms() - t0;
+
+      printf("  %4d px  %d chords/curve %10.3f ms %6.1f vertices/glyph"
+	     "   path %10.3f ms %6.1f vertices/glyph\n", sizes[k], GLYPH_FIXED_STEPS,
+	     t_fixed, (double) vfixed / nglyphs, t_path, (double) vpath / nglyphs);
+    }
+  if (failed)
+    printf("  %d glyphs failed\n", failed);
+
+  SeidelTriangulatorRelease(fixed);
+  SeidelTriangulatorRelease(path);
+  free(triangles);
+  return failed ? 1 : 0;
+}
+
+
+/* Every insertion schedule on a smooth blob and on one with noise */
+/* in its radius, to pick the fastest for a kind of input. Each */
+/* result is also timed answering point-location queries */
+static int bench_schedule(int nvert, int nruns)
+{
+  static const struct {
+    const char *name;
+    int schedule;
+  } schedules[] = {
+    {"phased, random", SEIDEL_SCHEDULE_PHASED},
+    {"no phases, random", SEIDEL_SCHEDULE_NO_PHASES},
+    {"phased, hilbert", SEIDEL_SCHEDULE_PHASED | SEIDEL_ORDER_HILBERT},
+    {"no phases, hilbert", SEIDEL_SCHEDULE_NO_PHASES | SEIDEL_ORDER_HILBERT},
+    {"phased, brio", SEIDEL_SCHEDULE_PHASED | SEIDEL_ORDER_BRIO},
+    {"no phases, brio", SEIDEL_SCHEDULE_NO_PHASES | SEIDEL_ORDER_BRIO},
+    {"phased, random, compact", SEIDEL_SCHEDULE_PHASED | SEIDEL_LAYOUT_COMPACT},
+    {"phased, brio, compact", SEIDEL_SCHEDULE_PHASED | SEIDEL_ORDER_BRIO | SEIDEL_LAYOUT_COMPACT},
+  };
+  const int nqueries = 100000;
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  double (*queries)[2] = malloc(sizeof(double) * 2 * nqueries);
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  SeidelTriangulator *state = SeidelTriangulatorCreate(nvert);
+  double t0, t;
+  int i, k, noisy, ntri, inside, failed = 0;
+
+  for (i = 0; i < nqueries; i++)
+    {
+      queries[i][0] = 2.0 * drand48() - 1.0;
+      queries[i][1] = 2.0 * drand48() - 1.0;
+    }
+
+  printf("%d vertices, best of %d runs, %d queries\n", nvert, nruns, nqueries);
+  for (noisy = 0; noisy < 2; noisy++)
+    {
+      make_blob(nvert, vertices);
+      if (noisy)
+	for (k = 1; k <= nvert; k++)
+	  {
+	    double r = 1.0 + 0.05 * drand48();
+
+	    vertices[k][0] *= r;
+	    vertices[k][1] *= r;
+	  }
+      printf("  %s blob\n", noisy ? "noisy" : "smooth");
+
+      for (k = 0; k < (int) (sizeof(schedules) / sizeof(schedules[0])); k++)
+	{
+	  double best = 0;
+
+	  SeidelTriangulatorSetSchedule(state, schedules[k].schedule);
+	  for (i = 0; i < nruns; i++)
+	    {
+	      t0 = now_ms();
+	      ntri = triangulate_polygon(&state, 1, &nvert, vertices, triangles);
+	      t = now_ms() - t0;
+	      if ((i == 0) || (t < best))
+		best = t;
+	      if (ntri != nvert - 2)
+		failed++;
+	    }
+
+	  t0 = now_ms();
+	  for (i = inside = 0; i < nqueries; i++)
+	    inside += is_point_inside_polygon(state, queries[i]);
+	  t = now_ms() - t0;
+
+	  printf("    %-24s %10.3f ms  %8d query nodes  %10ld steps   queries %8.3f ms (%d in)\n",
+		 schedules[k].name, best, state->q_idx, state->steps, t, inside);
+	}
+    }
+  if (failed)
+    printf("  %d runs failed\n", failed);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(queries);
+  free(triangles);
+  return failed ? 1 : 0;
+}
+
+
+/* A point of the sort-based weld */
+typedef struct {
+  double x, y;
+  int i;
+} weldkey_t;
+
+static int cmp_weldkey(const void *a, const void *b)
+{
+  const weldkey_t *p = (const weldkey_t *) a, *q = (const weldkey_t *) b;
+
+  if (p->x != q->x)
+    return (p->x < q->x) ? -1 : 1;
+  return p->i - q->i;
+}
+
+/* A blob a kilometre across as GIS exports give it, in metres, every */
+/* vertex written several times over within a tolerance, welded by */
+/* sorting the points by grid cell and by triangulate_polygon_welded() */
+static int bench_weld(int nvert, int nrep)
+{
+  const double tolerance = 1e-6;
+  int n = nvert * nrep;
+  double (*blob)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+  double (*welded)[2] = malloc(sizeof(double) * 2 * (n + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * n);
+  weldkey_t *keys = malloc(sizeof(weldkey_t) * n);
+  int *rep = malloc(sizeof(int) * (n + 1));
+  int *orig = malloc(sizeof(int) * (n + 1));
+  SeidelTriangulator *state = SeidelTriangulatorCreate(n);
+  double t0, t_sort, t_weld;
+  int i, k, m, ntri_sort, ntri_weld;
+
+  make_blob(nvert, blob);
+  for (i = 1; i <= nvert; i++)
+    for (k = 0; k < nrep; k++)
+      {
+	vertices[(i - 1) * nrep + k + 1][0] = 1000 * blob[i][0] + 1e-3 * tolerance * drand48();
+	vertices[(i - 1) * nrep + k + 1][1] = 1000 * blob[i][1] + 1e-3 * tolerance * drand48();
+      }
+
+  t0 = now_ms();
+  for (i = 0; i < n; i++)
+    {
+      keys[i].x = vertices[i + 1][0];
+      keys[i].y = vertices[i + 1][1];
+      keys[i].i = i + 1;
+      rep[i + 1] = 0;
+    }
+  qsort(keys, n, sizeof(weldkey_t), cmp_weldkey);
+  for (i = 0; i < n; i++)
+    if (!rep[keys[i].i])
+      for (rep[keys[i].i] = keys[i].i, k = i + 1;
+	   (k < n) && (keys[k].x - keys[i].x <= tolerance); k++)
+	if (!rep[keys[k].i] && (fabs(keys[k].y - keys[i].y) <= tolerance))
+	  rep[keys[k].i] = keys[i].i;
+  for (i = 1, m = 0; i <= n; i++)
+    if ((m == 0) || (orig[m] != rep[i]))
+      {
+	m++;
+	orig[m] = rep[i];
+	welded[m][0] = vertices[rep[i]][0];
+	welded[m][1] = vertices[rep[i]][1];
+      }
+  if ((m > 1) && (orig[m] == orig[1]))
+    m--;
+  ntri_sort = triangulate_polygon(&state, 1, &m, welded, triangles);
+  for (i = 0; i < ntri_sort; i++)
+    for (k = 0; k < 3; k++)
+      triangles[i][k] = orig[triangles[i][k]];
+  t_sort = now_ms() - t0;
+
+  t0 = now_ms();
+  ntri_weld = triangulate_polygon_welded(&state, 1, &n, vertices, tolerance, triangles, rep);
+  t_weld = now_ms() - t0;
+
+  printf("%d vertices, each %d times\n", nvert, nrep);
+  printf("  sort, then triangulate_polygon   %10.3f ms  %d triangles\n", t_sort, ntri_sort);
+  printf("  triangulate_polygon_welded       %10.3f ms  %d triangles\n", t_weld, ntri_weld);
+
+  SeidelTriangulatorRelease(state);
+  free(blob);
+  free(vertices);
+  free(welded);
+  free(triangles);
+  free(keys);
+  free(rep);
+  free(orig);
+  return ((ntri_sort == nvert - 2) && (ntri_weld == nvert - 2)) ? 0 : 1;
+}
+
+
+/* Hard-edged triangle rasterizer, the way the raster exports work */
+/* now: a pixel is in a triangle if its centre is */
+static void raster_triangle(float *coverage, int width, int height, double (*v)[2],
+			    double x0, double y0, double scale)
+{
+  double px[3], py[3], ymin, ymax, y, xl, xr, x;
+  int i, j, a, b, row, r0, r1;
+
+  for (i = 0; i < 3; i++)
+    {
+      px[i] = (v[i][0] - x0) * scale;
+      py[i] = (v[i][1] - y0) * scale;
+    }
+  ymin = MIN(py[0], MIN(py[1], py[2]));
+  ymax = MAX(py[0], MAX(py[1], py[2]));
+  r0 = (int) MAX(ceil(ymin - 0.5), 0);
+  r1 = (int) MIN(ceil(ymax - 0.5), height);
+  for (row = r0; row < r1; row++)
+    {
+      y = row + 0.5;
+      xl = 1e300;
+      xr = -1e300;
+      for (a = 0; a < 3; a++)
+	{
+	  b = (a + 1) % 3;
+	  if ((py[a] <= y) == (py[b] <= y))
+	    continue;
+	  x = px[a] + (y - py[a]) * (px[b] - px[a]) / (py[b] - py[a]);
+	  xl = MIN(xl, x);
+	  xr = MAX(xr, x);
+	}
+      for (j = (int) MAX(ceil(xl - 0.5), 0); j < MIN(ceil(xr - 0.5), width); j++)
+	coverage[row * width + j] = 1.0f;
+    }
+}
+
+/* A blob a kilometre across rasterized through its triangles, and */
+/* straight from its trapezoids with hard edges and antialiased */
+static int bench_raster(int nvert, int size)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  float *tri_cov = malloc(sizeof(float) * size * size);
+  float *trap_cov = malloc(sizeof(float) * size * size);
+  SeidelTriangulator *state = SeidelTriangulatorCreate(nvert);
+  double t0, t_tri, t_trap, t_aa, scale = size / 2000.0, area = 0, exact = 0;
+  double v[3][2];
+  int i, k, ntri, differ = 0, err;
+
+  make_blob(nvert, vertices);
+  for (i = 1; i <= nvert; i++)
+    {
+      vertices[i][0] *= 1000;
+      vertices[i][1] *= 1000;
+    }
+  for (i = 1; i <= nvert; i++)
+    {
+      k = (i % nvert) + 1;
+      exact += 0.5 * (vertices[i][0] * vertices[k][1] - vertices[k][0] * vertices[i][1]);
+    }
+
+  t0 = now_ms();
+  ntri = triangulate_polygon(&state, 1, &nvert, vertices, triangles);
+  memset(tri_cov, 0, sizeof(float) * size * size);
+  for (i = 0; i < ntri; i++)
+    {
+      for (k = 0; k < 3; k++)
+	{
+	  v[k][0] = vertices[triangles[i][k]][0];
+	  v[k][1] = vertices[triangles[i][k]][1];
+	}
+      raster_triangle(tri_cov, size, size, v, -1000, -1000, scale);
+    }
+  t_tri = now_ms() - t0;
+
+  t0 = now_ms();
+  err = trapezoidate_polygon(&state, 1, &nvert, vertices);
+  if (!err)
+    err = seidel_rasterize(state, trap_cov, size, size, -1000, -1000, scale, 0);
+  t_trap = now_ms() - t0;
+  for (i = 0; i < size * size; i++)
+    differ += (tri_cov[i] != trap_cov[i]);
+
+  t0 = now_ms();
+  if (!err)
+    err = trapezoidate_polygon(&state, 1, &nvert, vertices);
+  if (!err)
+    err = seidel_rasterize(state, trap_cov, size, size, -1000, -1000, scale, 16);
+  t_aa = now_ms() - t0;
+  for (i = 0; i < size * size; i++)
+    area += trap_cov[i];
+
+  printf("%d vertices, %d x %d pixels\n", nvert, size, size);
+  printf("  triangulate, fill triangles      %10.3f ms  %d triangles\n", t_tri, ntri);
+  printf("  trapezoids, hard edges           %10.3f ms  %d pixels differ\n", t_trap, differ);
+  printf("  trapezoids, 16 sub-scanlines     %10.3f ms  area %.1f of %.1f\n",
+	 t_aa, area / (scale * scale), exact);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  free(tri_cov);
+  free(trap_cov);
+  return ((ntri == nvert - 2) && !err) ? 0 : 1;
+}
+
+
+/* Area, centroid and second moments of a blob with holes summed over */
+/* its triangles, the second pass analytics used to make, against */
+/* seidel_polygon_moments() over the trapezoids */
+static int bench_moments(int nvert, int nruns)
+{
+  int n = nvert + 4 * 16, cntr[5] = {nvert, 16, 16, 16, 16};
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 2 * 5));
+  SeidelTriangulator *state = SeidelTriangulatorCreate(n);
+  SeidelMoments tm, m;
+  double t0, t, t_tri = 0, t_trap = 0, *a, *b, *c, ar, ox, oy;
+  double ax, ay, bx, by, cx, cy;
+  int i, j, k, run, ntri = 0, err = 0;
+
+  make_blob(nvert, vertices);
+  for (k = 0; k < 4; k++)
+    for (j = 0; j < 16; j++)
+      {
+	double th = -2.0 * M_PI * j / 16;	/* clockwise */
+
+	i = nvert + 16 * k + j + 1;
+	vertices[i][0] = 0.3 * cos(M_PI / 2 * k) + 0.1 * cos(th);
+	vertices[i][1] = 0.3 * sin(M_PI / 2 * k) + 0.1 * sin(th);
+      }
+  for (i = 1; i <= n; i++)
+    {
+      vertices[i][0] = 1000 * vertices[i][0] + 5e5;
+      vertices[i][1] = 1000 * vertices[i][1] + 4e6;
+    }
+  ox = vertices[1][0];
+  oy = vertices[1][1];
+
+  for (run = 0; run < nruns; run++)
+    {
+      t0 = now_ms();
+      ntri = triangulate_polygon(&state, 5, cntr, vertices, triangles);
+      memset(&tm, 0, sizeof(tm));
+      for (i = 0; i < ntri; i++)
+	{
+	  a = vertices[triangles[i][0]];
+	  b = vertices[triangles[i][1]];
+	  c = vertices[triangles[i][2]];
+	  ax = a[0] - ox; ay = a[1] - oy;
+	  bx = b[0] - ox; by = b[1] - oy;
+	  cx = c[0] - ox; cy = c[1] - oy;
+	  ar = 0.5 * ((bx - ax) * (cy - ay) - (cx - ax) * (by - ay));
+	  tm.area += ar;
+	  tm.cx += ar * (ax + bx + cx) / 3;
+	  tm.cy += ar * (ay + by + cy) / 3;
+	  tm.sxx += ar * (ax * ax + bx * bx + cx * cx + ax * bx + bx * cx + cx * ax) / 6;
+	  tm.syy += ar * (ay * ay + by * by + cy * cy + ay * by + by * cy + cy * ay) / 6;
+	  tm.sxy += ar * (ax * (2 * ay + by + cy) + bx * (ay + 2 * by + cy) +
+			  cx * (ay + by + 2 * cy)) / 12;
+	}
+      tm.cx /= tm.area;
+      tm.cy /= tm.area;
+      tm.sxx -= tm.area * tm.cx * tm.cx;
+      tm.syy -= tm.area * tm.cy * tm.cy;
+      tm.sxy -= tm.area * tm.cx * tm.cy;
+      tm.cx += ox;
+      tm.cy += oy;
+      t = now_ms() - t0;
+      if ((run == 0) || (t < t_tri))
+	t_tri = t;
+
+      t0 = now_ms();
+      err = trapezoidate_polygon(&state, 5, cntr, vertices);
+      if (!err)
+	err = seidel_polygon_moments(state, &m);
+      t = now_ms() - t0;
+      if ((run == 0) || (t < t_trap))
+	t_trap = t;
+    }
+
+  printf("%d vertices, best of %d runs\n", n, nruns);
+  printf("  triangulate, sum triangles       %10.3f ms  area %.3f centroid (%.6f, %.6f)\n",
+	 t_tri, tm.area, tm.cx, tm.cy);
+  printf("  trapezoids, moments              %10.3f ms  area %.3f centroid (%.6f, %.6f)\n",
+	 t_trap, m.area, m.cx, m.cy);
+  printf("  second moments %.6e %.6e %.6e against %.6e %.6e %.6e\n",
+	 m.sxx, m.syy, m.sxy, tm.sxx, tm.syy, tm.sxy);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  return ((ntri == n - 2 + 2 * 4) && !err &&
+	  (fabs(m.area - tm.area) <= 1e-9 * tm.area)) ? 0 : 1;
+}
+
+
+/* The y-monotone polygons of a blob, packed into one index buffer, */
+/* against triangulating it, best of several runs */
+static int bench_monotone(int nvert, int nruns)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  int *first = malloc(sizeof(int) * (nvert + 1)), *index = malloc(sizeof(int) * 3 * nvert);
+  SeidelTriangulator *state = SeidelTriangulatorCreate(nvert);
+  double t0, t, t_tri = 0, t_mono = 0;
+  int i, run, ntri = 0, npoly = 0, pieces_tri = 0;
+
+  make_blob(nvert, vertices);
+  for (run = 0; run < nruns; run++)
+    {
+      t0 = now_ms();
+      ntri = triangulate_polygon(&state, 1, &nvert, vertices, triangles);
+      t = now_ms() - t0;
+      if ((run == 0) || (t < t_tri))
+	t_tri = t;
+
+      t0 = now_ms();
+      npoly = monotonate_polygon(&state, 1, &nvert, vertices);
+      if (npoly > 0)
+	seidel_monotone_polygons(state, first, index);
+      t = now_ms() - t0;
+      if ((run == 0) || (t < t_mono))
+	t_mono = t;
+    }
+
+  for (i = 0; i < npoly; i++)
+    pieces_tri += first[i + 1] - first[i] - 2;
+
+  printf("%d vertices, %d triangles, %d monotone polygons of %.1f vertices on average\n",
+	 nvert, ntri, npoly, (npoly > 0) ? (double) first[npoly] / npoly : 0.0);
+  printf("  triangulate_polygon     %10.3f ms\n", t_tri);
+  printf("  monotone polygons       %10.3f ms\n", t_mono);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  free(first);
+  free(index);
+  return (npoly > 0 && pieces_tri == ntri) ? 0 : 1;
+}
+
+
+/* Merge two pieces along a shared edge, if the union is convex: */
+/* the greedy merge below, the way the physics setup does it now */
+static int greedy_merge(double (*v)[2], int *pa, int na, int *pb, int nb, int *out)
+{
+  int i, j, k, n = 0;
+
+  for (i = 0; i < na; i++)
+    for (j = 0; j < nb; j++)
+      if ((pa[i] == pb[(j + 1) % nb]) && (pa[(i + 1) % na] == pb[j]))
+	{
+	  for (k = 1; k < na; k++)
+	    out[n++] = pa[(i + k) % na];
+	  for (k = 2; k < nb; k++)
+	    out[n++] = pb[(j + k) % nb];
+	  for (k = 0; k < n; k++)
+	    {
+	      double *a = v[out[k]], *b = v[out[(k + 1) % n]], *c = v[out[(k + 2) % n]];
+
+	      if ((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) < 0)
+		return 0;
+	    }
+	  return n;
+	}
+  return 0;
+}
+
+
+/* Convex pieces of a blob with holes from its triangles, by */
+/* convex_partition() and by merging pairs of pieces until no two */
+/* merge, which is skipped for large inputs */
+static int bench_convex(int nvert)
+{
+  int n = nvert + 4 * 16, cntr[5] = {nvert, 16, 16, 16, 16};
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 2 * 5));
+  int *first = malloc(sizeof(int) * (n + 2 * 5 + 1)), *index = malloc(sizeof(int) * 3 * (n + 2 * 5));
+  SeidelTriangulator *state = NULL;
+  double t0, t_hm, t_greedy = -1;
+  int i, j, k, ntri, npoly, ngreedy = -1, changed;
+
+  make_blob(nvert, vertices);
+  for (k = 0; k < 4; k++)
+    for (j = 0; j < 16; j++)
+      {
+	double th = -2.0 * M_PI * j / 16;	/* clockwise */
+
+	i = nvert + 16 * k + j + 1;
+	vertices[i][0] = 0.3 * cos(M_PI / 2 * k) + 0.1 * cos(th);
+	vertices[i][1] = 0.3 * sin(M_PI / 2 * k) + 0.1 * sin(th);
+      }
+  ntri = triangulate_polygon(&state, 5, cntr, vertices, triangles);
+  if (ntri < 0)
+    {
+      printf("triangulation failed: %d\n", ntri);
+      return 1;
+    }
+
+  t0 = now_ms();
+  npoly = convex_partition(vertices, ntri, triangles, first, index);
+  t_hm = now_ms() - t0;
+
+  if (n <= 3000)
+    {
+      int **piece = malloc(sizeof(int *) * ntri), *size = malloc(sizeof(int) * ntri);
+      int *merged = malloc(sizeof(int) * 3 * ntri), m;
+
+      t0 = now_ms();
+      for (i = 0; i < ntri; i++)
+	{
+	  piece[i] = malloc(sizeof(int) * 3);
+	  memcpy(piece[i], triangles[i], sizeof(int) * 3);
+	  size[i] = 3;
+	}
+      ngreedy = ntri;
+      do
+	{
+	  changed = FALSE;
+	  for (i = 0; i < ntri; i++)
+	    for (j = i + 1; size[i] && (j < ntri); j++)
+	      if (size[j] && (m = greedy_merge(vertices, piece[i], size[i], piece[j], size[j], merged)))
+		{
+		  piece[i] = realloc(piece[i], sizeof(int) * m);
+		  memcpy(piece[i], merged, sizeof(int) * m);
+		  size[i] = m;
+		  size[j] = 0;
+		  ngreedy--;
+		  changed = TRUE;
+		}
+	}
+      while (changed);
+      t_greedy = now_ms() - t0;
+
+      for (i = 0; i < ntri; i++)
+	free(piece[i]);
+      free(piece);
+      free(size);
+      free(merged);
+    }
+
+  printf("%d vertices, %d triangles\n", n, ntri);
+  printf("  convex_partition        %10.3f ms  %d pieces\n", t_hm, npoly);
+  if (ngreedy >= 0)
+    printf("  greedy pairwise merge   %10.3f ms  %d pieces\n", t_greedy, ngreedy);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  free(first);
+  free(index);
+  return (npoly > 0) ? 0 : 1;
+}
+
+
+/* polygon_boolean() on two overlapping blobs, each operation followed
+ * by triangulate_contours() straight from the same buffers.
+ */
+static int bench_clip(int nvert, int nruns)
+{
+  static const char *name[4] = {"union", "intersection", "difference", "xor"};
+  double (*va)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  double (*vb)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = NULL;
+  SeidelContours out;
+  SeidelTriangulator *state = NULL;
+  double t0, t_clip, t_tri;
+  int i, op, run, ret = 0, ntri = 0, maxtri = 0;
+
+  memset(&out, 0, sizeof(out));
+  make_blob(nvert, va);
+  for (i = 1; i <= nvert; i++)
+    {
+      vb[i][0] = 0.9 * va[i][1] + 0.3;
+      vb[i][1] = -0.9 * va[i][0] + 0.1;
+    }
+
+  printf("2 x %d vertices, %d runs\n", nvert, nruns);
+  for (op = SEIDEL_BOOL_UNION; op <= SEIDEL_BOOL_XOR; op++)
+    {
+      t0 = now_ms();
+      for (run = 0; run < nruns; run++)
+	ret = polygon_boolean(op, 1, &nvert, va, 1, &nvert, vb, &out);
+      t_clip = (now_ms() - t0) / nruns;
+      if (ret < 0)
+	{
+	  printf("polygon_boolean failed: %d\n", ret);
+	  return 1;
+	}
+
+      if (out.nvert + 2 * out.ncontours > maxtri)
+	{
+	  maxtri = out.nvert + 2 * out.ncontours;
+	  triangles = realloc(triangles, sizeof(int) * 3 * maxtri);
+	}
+      if (state && (state->segSize <= out.nvert))
+	{
+	  SeidelTriangulatorRelease(state);
+	  state = NULL;
+	}
+      t0 = now_ms();
+      for (run = 0; run < nruns; run++)
+	ntri = triangulate_contours(&state, &out, triangles);
+      t_tri = (now_ms() - t0) / nruns;
+      if (ntri < 0)
+	{
+	  printf("triangulate_contours failed: %d\n", ntri);
+	  return 1;
+	}
+      printf("  %-12s %10.3f ms clip %10.3f ms triangulate  %d contours, %d vertices, %d triangles\n",
+	     name[op], t_clip, t_tri, out.ncontours, out.nvert, ntri);
+    }
+
+  seidel_contours_free(&out);
+  if (state)
+    SeidelTriangulatorRelease(state);
+  free(triangles);
+  free(va);
+  free(vb);
+  return 0;
+}
+
+
+/* seidel_nearest_edge() and seidel_segment_crossings() against a loop
+ * over every edge, for points within 50 m of the boundary of a blob a
+ * kilometre across and segments of up to 10 m from them, steps of a
+ * track along a fence.
+ */
+static int bench_query(int nvert, int nqueries)
+{
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  double (*pts)[4] = malloc(sizeof(double) * 4 * nqueries);
+  SeidelTriangulator *state = NULL;
+  double t0, t_loop, t_walk, d, best, dx, dy, u, ex, ey, sum_loop = 0, sum_walk = 0;
+  point_t a, b;
+  int i, j, k, cross_loop = 0, cross_walk = 0, ntri, bad = 0;
+
+  make_blob(nvert, vertices);
+  for (i = 1; i <= nvert; i++)
+    {
+      vertices[i][0] *= 1000;
+      vertices[i][1] *= 1000;
+    }
+  ntri = triangulate_polygon(&state, 1, &nvert, vertices, triangles);
+  for (i = 0; i < nqueries; i++)
+    {
+      j = 1 + (int) (nvert * drand48());
+      pts[i][0] = vertices[j][0] + 100 * drand48() - 50;
+      pts[i][1] = vertices[j][1] + 100 * drand48() - 50;
+      pts[i][2] = pts[i][0] + 20 * drand48() - 10;
+      pts[i][3] = pts[i][1] + 20 * drand48() - 10;
+    }
+
+  t0 = now_ms();
+  for (i = 0; i < nqueries; i++)
+    {
+      best = HUGE_VAL;
+      a.x = pts[i][0];
+      a.y = pts[i][1];
+      b.x = pts[i][2];
+      b.y = pts[i][3];
+      for (j = 1; j <= nvert; j++)
+	{
+	  k = (j < nvert) ? j + 1 : 1;
+	  dx = vertices[k][0] - vertices[j][0];
+	  dy = vertices[k][1] - vertices[j][1];
+	  u = ((a.x - vertices[j][0]) * dx + (a.y - vertices[j][1]) * dy) / (dx * dx + dy * dy);
+	  u = MAX(0, MIN(1, u));
+	  ex = vertices[j][0] + u * dx - a.x;
+	  ey = vertices[j][1] + u * dy - a.y;
+	  best = MIN(best, ex * ex + ey * ey);
+	  cross_loop += segments_intersect(&a, &b, (point_t *) vertices[j], (point_t *) vertices[k]);
+	}
+      sum_loop += sqrt(best);
+    }
+  t_loop = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < nqueries; i++)
+    {
+      if (seidel_nearest_edge(state, pts[i], &d) <= 0)
+	bad++;
+      sum_walk += d;
+      cross_walk += seidel_segment_crossings(state, pts[i], pts[i] + 2, NULL, nvert);
+    }
+  t_walk = now_ms() - t0;
+
+  printf("%d vertices, %d points and segments\n", nvert, nqueries);
+  printf("  every edge           %10.3f ms  %10.3f us/query  crossings %d  mean distance %.6f\n",
+	 t_loop, 1000 * t_loop / nqueries, cross_loop, sum_loop / nqueries);
+  printf("  trapezoid walk       %10.3f ms  %10.3f us/query  crossings %d  mean distance %.6f\n",
+	 t_walk, 1000 * t_walk / nqueries, cross_walk, sum_walk / nqueries);
+
+  SeidelTriangulatorRelease(state);
+  free(vertices);
+  free(triangles);
+  free(pts);
+  return ((ntri == nvert - 2) && !bad && (cross_walk == cross_loop) &&
+	  (fabs(sum_walk - sum_loop) <= 1e-9 * sum_loop)) ? 0 : 1;
+}
+
+
+/* A square with a grid of small square holes against a blob with as
+ * many vertices and no holes, then a square with one hole over and over
+ * on the triangulator left sized for the grid and on one of its own.
+ */
+static int bench_holes(int nholes, int nsmall)
+{
+  int k = (int) ceil(sqrt(nholes)), nh = k * k, n = 4 + 4 * nh;
+  int *cntr = malloc(sizeof(int) * (nh + 1)), small[2] = {4, 4};
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 2 * nh));
+  double cell[9][2] = {{0, 0}, {0, 0}, {100, 0}, {100, 100}, {0, 100},
+		       {30, 30}, {30, 70}, {70, 70}, {70, 30}};
+  SeidelTriangulator *state = NULL, *fitted = NULL;
+  double t0, t_holes, t_blob, t_big, t_fit, x, y, w;
+  int i, j, m, nholes_tri, nblob_tri, nbig = 0, nfit = 0;
+
+  cntr[0] = 4;
+  vertices[1][0] = 0;		vertices[1][1] = 0;
+  vertices[2][0] = 100 * k;	vertices[2][1] = 0;
+  vertices[3][0] = 100 * k;	vertices[3][1] = 100 * k;
+  vertices[4][0] = 0;		vertices[4][1] = 100 * k;
+  for (i = 0, m = 4; i < k; i++)
+    for (j = 0; j < k; j++, m += 4)
+      {
+	x = 100 * i + 30 + 20 * drand48();
+	y = 100 * j + 30 + 20 * drand48();
+	w = 20 + 10 * drand48();
+	cntr[1 + i * k + j] = 4;	/* clockwise */
+	vertices[m + 1][0] = x;		vertices[m + 1][1] = y;
+	vertices[m + 2][0] = x;		vertices[m + 2][1] = y + w;
+	vertices[m + 3][0] = x + w;	vertices[m + 3][1] = y + w;
+	vertices[m + 4][0] = x + w;	vertices[m + 4][1] = y;
+      }
+  t0 = now_ms();
+  nholes_tri = triangulate_polygon(&state, nh + 1, cntr, vertices, triangles);
+  t_holes = now_ms() - t0;
+
+  make_blob(n, vertices);
+  for (i = 1; i <= n; i++)
+    {
+      vertices[i][0] *= 100 * k;
+      vertices[i][1] *= 100 * k;
+    }
+  t0 = now_ms();
+  nblob_tri = triangulate_polygon(&state, 1, &n, vertices, triangles);
+  t_blob = now_ms() - t0;
+
+  t0 = now_ms();
+  for (i = 0; i < nsmall; i++)
+    nbig += (triangulate_polygon(&state, 2, small, cell, triangles) == 8);
+  t_big = now_ms() - t0;
+  fitted = SeidelTriangulatorCreate(8);
+  t0 = now_ms();
+  for (i = 0; i < nsmall; i++)
+    nfit += (triangulate_polygon(&fitted, 2, small, cell, triangles) == 8);
+  t_fit = now_ms() - t0;
+
+  printf("%d vertices\n", n);
+  printf("  %7d holes          %10.3f ms  %10.3f us/vertex\n",
+	 nh, t_holes, 1000 * t_holes / n);
+  printf("  no holes             %10.3f ms  %10.3f us/vertex\n",
+	 t_blob, 1000 * t_blob / n);
+  printf("%d squares with a hole\n", nsmall);
+  printf("  on the large tables  %10.3f ms  %10.3f us/polygon\n",
+	 t_big, 1000 * t_big / nsmall);
+  printf("  on their own         %10.3f ms  %10.3f us/polygon\n",
+	 t_fit, 1000 * t_fit / nsmall);
+
+  SeidelTriangulatorRelease(state);
+  SeidelTriangulatorRelease(fitted);
+  free(cntr);
+  free(vertices);
+  free(triangles);
+  return ((nholes_tri == n - 2 + 2 * nh) && (nblob_tri == n - 2) &&
+	  (nbig == nsmall) && (nfit == nsmall)) ? 0 : 1;
+}
+
+
+/* Polygons as text, one per line: the number of points, then the
+ * coordinates. Parsing, triangulating and writing the indices out are
+ * the three stages of bench_pipeline().
+ */
+typedef struct {
+  char *text;
+  int npolys;
+  SeidelPipeline *pipeline;
+} polytext_t;
+
+/* Parse the polygon at *s into vertices[1..], if not NULL, and step */
+/* past it. Returns its number of points */
+static int parse_polygon(char **s, double (*vertices)[2])
+{
+  int n = (int) strtol(*s, s, 10), i;
+
+  for (i = 1; i <= n; i++)
+    {
+      vertices[i][0] = strtod(*s, s);
+      vertices[i][1] = strtod(*s, s);
+    }
+  return n;
+}
+
+/* Size of the polygon at s */
+static int peek_polygon(char *s)
+{
+  return (int) strtol(s, NULL, 10);
+}
+
+static void *pipeline_producer(void *arg)
+{
+  polytext_t *pt = (polytext_t *) arg;
+  char *s = pt->text;
+  seideljob_t *job;
+  int i;
+
+  for (i = 0; i < pt->npolys; i++)
+    {
+      job = seidel_pipeline_acquire(pt->pipeline, 1, peek_polygon(s));
+      if (!job)
+	break;
+      job->cntr[0] = parse_polygon(&s, job->vertices);
+      job->user = (void *) (long) i;
+      seidel_pipeline_submit(pt->pipeline, job);
+    }
+  seidel_pipeline_finish(pt->pipeline);
+  return NULL;
+}
+
+/* Indices of the triangles at base in the shared buffer, summed as a */
+/* stand-in for the upload */
+static long upload_indices(int ntri, int (*triangles)[3], int base, uint32_t *indices)
+{
+  long sum = 0;
+  int i;
+
+  if (seidel_write_indices(ntri, triangles, base, SEIDEL_INDEX_UINT32, indices) != ntri)
+    return -1;
+  for (i = 0; i < 3 * ntri; i++)
+    sum += indices[i];
+  return sum;
+}
+
+/* Parse, triangulate and upload one polygon after another, against the
+ * same in a SeidelPipeline: parsing on a thread of its own, the
+ * triangulation on the pipeline's, the upload on the calling thread.
+ */
+static int bench_pipeline(int npolys, int nvert)
+{
+  size_t len = (size_t) npolys * (nvert * 2 * 24 + 16), used = 0;
+  char *text = malloc(len), *s;
+  double (*vertices)[2] = malloc(sizeof(double) * 2 * (nvert + 1));
+  int (*triangles)[3] = malloc(sizeof(int) * 3 * nvert);
+  uint32_t *indices = malloc(sizeof(uint32_t) * 3 * nvert);
+  SeidelTriangulator *state = NULL;
+  polytext_t pt;
+  pthread_t producer;
+  seideljob_t *job;
+  double t0, t_serial, t_pipe;
+  long sum_serial = 0, sum_pipe = 0;
+  int i, j, n, ntri, base, next = 0, inorder = 1, bad = 0;
+
+  for (i = 0; i < npolys; i++)
+    {
+      make_blob(nvert, vertices);
+      used += sprintf(text + used, "%d", nvert);
+      for (j = 1; j <= nvert; j++)
+	used += sprintf(text + used, " %.6f %.6f",
+			1000 * vertices[j][0] + 2000 * (i % 100),
+			1000 * vertices[j][1] + 2000 * (i / 100));
+      used += sprintf(text + used, "\n");
+    }
+
+  t0 = now_ms();
+  for (i = 0, s = text, base = 0; i < npolys; i++, base += n)
+    {
+      n = parse_polygon(&s, vertices);
+      ntri = triangulate_polygon(&state, 1, &n, vertices, triangles);
+      if (ntri != n - 2)
+	bad++;
+      sum_serial += upload_indices(ntri, triangles, base, indices);
+    }
+  t_serial = now_ms() - t0;
+
+  t0 = now_ms();
+  pt.text = text;
+  pt.npolys = npolys;
+  pt.pipeline = SeidelPipelineCreate(3, nvert);
+  if (!pt.pipeline || pthread_create(&producer, NULL, pipeline_producer, &pt))
+    return 1;
+  base = 0;
+  while ((job = seidel_pipeline_next(pt.pipeline)))
+    {
+      if ((long) job->user != next++)
+	inorder = 0;
+      if (job->ntriangles != job->cntr[0] - 2)
+	bad++;
+      sum_pipe += upload_indices(job->ntriangles, job->triangles, base, indices);
+      base += job->cntr[0];
+      seidel_pipeline_recycle(pt.pipeline, job);
+    }
+  pthread_join(producer, NULL);
+  SeidelPipelineRelease(pt.pipeline);
+  t_pipe = now_ms() - t0;
+
+  printf("%d polygons of %d vertices, %.1f MB of text\n", npolys, nvert, used / 1e6);
+  printf("  one after another    %10.3f ms  %10.3f us/polygon  index sum %ld\n",
+	 t_serial, 1000 * t_serial / npolys, sum_serial);
+  printf("  pipeline             %10.3f ms  %10.3f us/polygon  index sum %ld\n",
+	 t_pipe, 1000 * t_pipe / npolys, sum_pipe);
+
+  SeidelTriangulatorRelease(state);
+  free(text);
+  free(vertices);
+  free(triangles);
+  free(indices);
+  return (!bad && inorder && (next == npolys) && (sum_pipe == sum_serial)) ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+  srand48(1);
+
+  if ((argc >= 2) && !strcmp(argv[1], "inpoly"))
+    return bench_inpoly((argc > 2) ? atoi(argv[2]) : 100000,
+			(argc > 3) ? atoi(argv[3]) : 1000);
+
+  if ((argc >= 2) && !strcmp(argv[1], "validate"))
+    return bench_validate((argc > 2) ? atoi(argv[2]) : 10000);
+
+  if ((argc >= 2) && !strcmp(argv[1], "edit"))
+    return bench_edit((argc > 2) ? atoi(argv[2]) : 100000,
+		      (argc > 3) ? atoi(argv[3]) : 10000);
+
+  if ((argc >= 2) && !strcmp(argv[1], "cache"))
+    return bench_cache((argc > 2) ? atoi(argv[2]) : 100,
+		       (argc > 3) ? atoi(argv[3]) : 1000,
+		       (argc > 4) ? atoi(argv[4]) : 10000);
+
+  if ((argc >= 2) && !strcmp(argv[1], "lod"))
+    return bench_lod((argc > 2) ? atoi(argv[2]) : 20000,
+		     (argc > 3) ? atoi(argv[3]) : 8);
+
+  if ((argc >= 2) && !strcmp(argv[1], "tiles"))
+    return bench_tiles((argc > 2) ? atoi(argv[2]) : 20000,
+		       (argc > 3) ? atoi(argv[3]) : 8,
+		       (argc > 4) ? atoi(argv[4]) : 4);
+
+  if ((argc >= 2) && !strcmp(argv[1], "glyphs"))
+    return bench_glyphs((argc > 2) ? atoi(argv[2]) : 3000,
+			(argc > 3) ? atof(argv[3]) : 0.25);
+
+  if ((argc >= 2) && !strcmp(argv[1], "schedule"))
+    return bench_schedule((argc > 2) ? atoi(argv[2]) : 20000,
+			  (argc > 3) ? atoi(argv[3]) : 5);
+
+  if ((argc >= 2) && !strcmp(argv[1], "weld"))
+    return bench_weld((argc > 2) ? atoi(argv[2]) : 100000,
+		      (argc > 3) ? atoi(argv[3]) : 3);
+
+  if ((argc >= 2) && !strcmp(argv[1], "raster"))
+    return bench_raster((argc > 2) ? atoi(argv[2]) : 20000,
+			(argc > 3) ? atoi(argv[3]) : 2048);
+
+  if ((argc >= 2) && !strcmp(argv[1], "moments"))
+    return bench_moments((argc > 2) ? atoi(argv[2]) : 20000,
+			 (argc > 3) ? atoi(argv[3]) : 5);
+
+  if ((argc >= 2) && !strcmp(argv[1], "monotone"))
+    return bench_monotone((argc > 2) ? atoi(argv[2]) : 20000,
+			  (argc > 3) ? atoi(argv[3]) : 5);
+
+  if ((argc >= 2) && !strcmp(argv[1], "convex"))
+    return bench_convex((argc > 2) ? atoi(argv[2]) : 20000);
+  if ((argc >= 2) && !strcmp(argv[1], "clip"))
+    return bench_clip((argc > 2) ? atoi(argv[2]) : 10000, (argc > 3) ? atoi(argv[3]) : 5);
+
+  if ((argc >= 2) && !strcmp(argv[1], "query"))
+    return bench_query((argc > 2) ? atoi(argv[2]) : 20000,
+		       (argc > 3) ? atoi(argv[3]) : 10000);
+
+  if ((argc >= 2) && !strcmp(argv[1], "holes"))
+    return bench_holes((argc > 2) ? atoi(argv[2]) : 100000,
+		       (argc > 3) ? atoi(argv[3]) : 10000);
+
+  if ((argc >= 2) && !strcmp(argv[1], "pipeline"))
+    return bench_pipeline((argc > 2) ? atoi(argv[2]) : 2000,
+			  (argc > 3) ? atoi(argv[3]) : 1000);
+
+  fprintf(stderr, "usage: bench inpoly [#points] [#vertices]\n"
+	  "       bench validate [#vertices]\n"
+	  "       bench edit [#vertices] [#cursor moves]\n"
+	  "       bench cache [#polygons] [#vertices] [#requests]\n"
+	  "       bench lod [#vertices] [#levels]\n"
+	  "       bench tiles [#vertices] [#tiles per side] [#threads]\n"
+	  "       bench glyphs [#glyphs per size] [tolerance in pixels]\n"
+	  "       bench schedule [#vertices] [#runs]\n"
+	  "       bench weld [#vertices] [#repeats per vertex]\n"
+	  "       bench raster [#vertices] [pixels across]\n"
+	  "       bench moments [#vertices] [#runs]\n"
+	  "       bench monotone [#vertices] [#runs]\n"
+	  "       bench convex [#vertices]\n"
+	  "       bench clip [#vertices] [#runs]\n"
+	  "       bench query [#vertices] [#queries]\n"
+	  "       bench holes [#holes] [#small polygons]\n"
+	  "       bench pipeline [#polygons] [#vertices]\n");
+  return 1;
+}
@@ -0,0 +1,373 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <pthread.h>
+
+
+/* Cache of triangulations keyed by the input itself. The key is the
+ * contour sizes followed by the raw coordinates; its 64-bit hash picks
+ * a shard and a bucket, and a hit is confirmed by comparing the whole
+ * key, so a hash collision costs a miss, never a wrong answer. Each
+ * shard has its own lock, hash table and LRU list, and evicts least
+ * recently used entries to stay within its share of the byte budget.
+ * The triangulation on a miss runs outside the lock.
+ */
+
+typedef struct cacheentry_s {
+  uint64_t hash;
+  struct cacheentry_s *chain;	/* next in the bucket */
+  struct cacheentry_s *prev, *next; /* LRU list, most recent first */
+  int ncontours, nvert;
+  int ntriangles;
+  size_t bytes;			/* all of the entry */
+  int *cntr;			/* key: cntr[ncontours] then the */
+  double (*vertices)[2];	/* coordinates vertices[1..nvert] */
+  int (*triangles)[3];
+} cacheentry_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  cacheentry_t **bucket;
+  int nbuckets, nentries;
+  cacheentry_t *head, *tail;
+  size_t bytes, max_bytes;
+  long hits, misses;
+} cacheshard_t;
+
+struct SeidelCache_s {
+  cacheshard_t *shard;
+  int nshards;			/* a power of 2 */
+};
+
+
+#define HASH_M1 0x9e3779b97f4a7c15ULL
+#define HASH_M2 0xbf58476d1ce4e5b9ULL
+#define HASH_M3 0x94d049bb133111ebULL
+
+static uint64_t hash_mix(uint64_t h, uint64_t w)
+{
+  h ^= w * HASH_M2;
+  h = (h << 27) | (h >> 37);
+  return h * HASH_M1 + HASH_M3;
+}
+
+/* 64-bit hash of the input of triangulate_polygon(): the contour */
+/* sizes and the bit patterns of the coordinates */
+uint64_t seidel_polygon_hash(int ncontours, int cntr[], double (*vertices)[2])
+{
+  uint64_t h = HASH_M1 ^ (uint64_t) ncontours, w;
+  int c, i, n = 0;
+
+  for (c = 0; c < ncontours; c++)
+    {
+      h = hash_mix(h, (uint64_t) (unsigned int) cntr[c]);
+      n += cntr[c];
+    }
+  for (i = 1; i <= n; i++)
+    {
+      memcpy(&w, &vertices[i][0], sizeof(w));
+      h = hash_mix(h, w);
+      memcpy(&w, &vertices[i][1], sizeof(w));
+      h = hash_mix(h, w);
+    }
+
+  h ^= h >> 31;
+  h *= HASH_M2;
+  return h ^ (h >> 29);
+}
+
+
+/* Create a cache holding up to max_bytes of keys and triangles over */
+/* nshards independently locked shards, rounded up to a power of 2 */
+SeidelCache* SeidelCacheCreate(size_t max_bytes, int nshards)
+{
+  SeidelCache *cache;
+  int k;
+
+  if (nshards < 1)
+    nshards = 1;
+  for (k = 1; k < nshards; k <<= 1)
+    ;
+  nshards = k;
+
+  cache = (SeidelCache *) malloc(sizeof(SeidelCache));
+  if (!cache)
+    return NULL;
+  cache->shard = (cacheshard_t *) calloc(nshards, sizeof(cacheshard_t));
+  if (!cache->shard)
+    {
+      free(cache);
+      return NULL;
+    }
+  cache->nshards = nshards;
+
+  for (k = 0; k < nshards; k++)
+    {
+      pthread_mutex_init(&cache->shard[k].lock, NULL);
+      cache->shard[k].max_bytes = max_bytes / nshards;
+    }
+  return cache;
+}
+
+static void free_entry(cacheentry_t *e)
+{
+  free(e->cntr);
+  free(e->vertices);
+  free(e->triangles);
+  free(e);
+}
+
+static void unlink_lru(cacheshard_t *sh, cacheentry_t *e)
+{
+  if (e->prev)
+    e->prev->next = e->next;
+  else
+    sh->head = e->next;
+  if (e->next)
+    e->next->prev = e->prev;
+  else
+    sh->tail = e->prev;
+}
+
+static void push_lru(cacheshard_t *sh, cacheentry_t *e)
+{
+  e->prev = NULL;
+  e->next = sh->head;
+  if (sh->head)
+    sh->head->prev = e;
+  else
+    sh->tail = e;
+  sh->head = e;
+}
+
+static void clear_shard(cacheshard_t *sh)
+{
+  cacheentry_t *e, *next;
+
+  for (e = sh->head; e; e = next)
+    {
+      next = e->next;
+      free_entry(e);
+    }
+  if (sh->bucket)
+    memset(sh->bucket, 0, sizeof(cacheentry_t *) * sh->nbuckets);
+  sh->head = sh->tail = NULL;
+  sh->nentries = 0;
+  sh->bytes = 0;
+}
+
+void SeidelCacheRelease(SeidelCache* cache)
+{
+  int k;
+
+  if (!cache)
+    return;
+  for (k = 0; k < cache->nshards; k++)
+    {
+      clear_shard(&cache->shard[k]);
+      free(cache->shard[k].bucket);
+      pthread_mutex_destroy(&cache->shard[k].lock);
+    }
+  free(cache->shard);
+  free(cache);
+}
+
+/* Drop all entries. The counters are kept */
+void seidel_cache_clear(SeidelCache* cache)
+{
+  int k;
+
+  for (k = 0; k < cache->nshards; k++)
+    {
+      pthread_mutex_lock(&cache->shard[k].lock);
+      clear_shard(&cache->shard[k]);
+      pthread_mutex_unlock(&cache->shard[k].lock);
+    }
+}
+
+/* Sums over all shards. Any pointer may be NULL */
+void seidel_cache_stats(SeidelCache* cache, long *hits, long *misses,
+			int *entries, size_t *bytes)
+{
+  long h = 0, m = 0;
+  size_t b = 0;
+  int k, n = 0;
+
+  for (k = 0; k < cache->nshards; k++)
+    {
+      pthread_mutex_lock(&cache->shard[k].lock);
+      h += cache->shard[k].hits;
+      m += cache->shard[k].misses;
+      n += cache->shard[k].nentries;
+      b += cache->shard[k].bytes;
+      pthread_mutex_unlock(&cache->shard[k].lock);
+    }
+  if (hits)
+    *hits = h;
+  if (misses)
+    *misses = m;
+  if (entries)
+    *entries = n;
+  if (bytes)
+    *bytes = b;
+}
+
+
+static cacheentry_t *lookup(cacheshard_t *sh, uint64_t hash, int ncontours,
+			    int cntr[], int nvert, double (*vertices)[2])
+{
+  cacheentry_t *e;
+
+  if (!sh->nbuckets)
+    return NULL;
+  for (e = sh->bucket[(hash >> 8) & (sh->nbuckets - 1)]; e; e = e->chain)
+    if ((e->hash == hash) && (e->ncontours == ncontours) && (e->nvert == nvert) &&
+	!memcmp(e->cntr, cntr, sizeof(int) * ncontours) &&
+	!memcmp(e->vertices, vertices + 1, sizeof(double) * 2 * nvert))
+      return e;
+  return NULL;
+}
+
+static void unlink_bucket(cacheshard_t *sh, cacheentry_t *e)
+{
+  cacheentry_t **p = &sh->bucket[(e->hash >> 8) & (sh->nbuckets - 1)];
+
+  while (*p != e)
+    p = &(*p)->chain;
+  *p = e->chain;
+}
+
+/* Keep about one entry per bucket */
+static int grow_buckets(cacheshard_t *sh)
+{
+  int nbuckets = sh->nbuckets ? 2 * sh->nbuckets : 16;
+  cacheentry_t **bucket = (cacheentry_t **) calloc(nbuckets, sizeof(cacheentry_t *));
+  cacheentry_t *e;
+
+  if (!bucket)
+    return SEIDEL_ERR_NOMEM;
+  for (e = sh->head; e; e = e->next)
+    {
+      int b = (e->hash >> 8) & (nbuckets - 1);
+      e->chain = bucket[b];
+      bucket[b] = e;
+    }
+  free(sh->bucket);
+  sh->bucket = bucket;
+  sh->nbuckets = nbuckets;
+  return 0;
+}
+
+/* Add a copy of the key and triangles, evicting from the LRU end */
+/* to make room. Entries too big for the shard are not kept */
+static void insert(cacheshard_t *sh, uint64_t hash, int ncontours, int cntr[],
+		   int nvert, double (*vertices)[2], int (*triangles)[3], int ntriangles)
+{
+  size_t bytes = sizeof(cacheentry_t) + sizeof(int) * ncontours +
+    sizeof(double) * 2 * nvert + sizeof(int) * 3 * ntriangles;
+  cacheentry_t *e;
+
+  if (bytes > sh->max_bytes)
+    return;
+  if (lookup(sh, hash, ncontours, cntr, nvert, vertices))
+    return;			/* another thread got there first */
+
+  while (sh->tail && (sh->bytes + bytes > sh->max_bytes))
+    {
+      e = sh->tail;
+      unlink_lru(sh, e);
+      unlink_bucket(sh, e);
+      sh->bytes -= e->bytes;
+      sh->nentries--;
+      free_entry(e);
+    }
+  if ((sh->nentries >= sh->nbuckets) && grow_buckets(sh))
+    return;
+
+  e = (cacheentry_t *) malloc(sizeof(cacheentry_t));
+  if (!e)
+    return;
+  e->cntr = (int *) malloc(sizeof(int) * ncontours);
+  e->vertices = (double (*)[2]) malloc(sizeof(double) * 2 * nvert);
+  e->triangles = (int (*)[3]) malloc(sizeof(int) * 3 * (ntriangles + 1));
+  if (!e->cntr || !e->vertices || !e->triangles)
+    {
+      free_entry(e);
+      return;
+    }
+  memcpy(e->cntr, cntr, sizeof(int) * ncontours);
+  memcpy(e->vertices, vertices + 1, sizeof(double) * 2 * nvert);
+  memcpy(e->triangles, triangles, sizeof(int) * 3 * ntriangles);
+  e->hash = hash;
+  e->ncontours = ncontours;
+  e->nvert = nvert;
+  e->ntriangles = ntriangles;
+  e->bytes = bytes;
+
+  e->chain = sh->bucket[(hash >> 8) & (sh->nbuckets - 1)];
+  sh->bucket[(hash >> 8) & (sh->nbuckets - 1)] = e;
+  push_lru(sh, e);
+  sh->bytes += bytes;
+  sh->nentries++;
+}
+
+
+/* The triangles of triangulate_polygon(), but an input seen before is
+ * answered from the cache by copying its triangles. Otherwise the
+ * polygon is triangulated with *inoutTriangulatorPtr and, if that
+ * succeeds, the result is kept. Failures are not cached. Safe to call
+ * from several threads at once, each with its own triangulator.
+ *
+ * A hit leaves *inoutTriangulatorPtr as it was, holding an earlier
+ * polygon or none, so is_point_inside_polygon() and the other queries
+ * only answer for this one after a miss. *hit, if hit is not NULL, is
+ * set to TRUE for a hit and FALSE otherwise.
+ */
+int seidel_cache_triangulate(SeidelCache* cache, SeidelTriangulator** inoutTriangulatorPtr,
+			     int ncontours, int cntr[], double (*vertices)[2], int (*triangles)[3],
+			     int *hit)
+{
+  cacheshard_t *sh;
+  cacheentry_t *e;
+  uint64_t hash;
+  int c, nvert = 0, ntriangles;
+
+  if (hit)
+    *hit = FALSE;
+  if (ncontours <= 0)
+    return SEIDEL_ERR_INPUT;
+  for (c = 0; c < ncontours; c++)
+    {
+      if (cntr[c] < 3)
+	return SEIDEL_ERR_INPUT;
+      nvert += cntr[c];
+    }
+
+  hash = seidel_polygon_hash(ncontours, cntr, vertices);
+  sh = &cache->shard[hash & (cache->nshards - 1)];
+
+  pthread_mutex_lock(&sh->lock);
+  if ((e = lookup(sh, hash, ncontours, cntr, nvert, vertices)))
+    {
+      sh->hits++;
+      unlink_lru(sh, e);
+      push_lru(sh, e);
+      ntriangles = e->ntriangles;
+      memcpy(triangles, e->triangles, sizeof(int) * 3 * ntriangles);
+      pthread_mutex_unlock(&sh->lock);
+      if (hit)
+	*hit = TRUE;
+      return ntriangles;
+    }
+  sh->misses++;
+  pthread_mutex_unlock(&sh->lock);
+
+  ntriangles = triangulate_polygon(inoutTriangulatorPtr, ncontours, cntr, vertices, triangles);
+  if (ntriangles < 0)
+    return ntriangles;
+
+  pthread_mutex_lock(&sh->lock);
+  insert(sh, hash, ncontours, cntr, nvert, vertices, triangles, ntriangles);
+  pthread_mutex_unlock(&sh->lock);
+  return ntriangles;
+}
@@ -0,0 +1,927 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/* Boolean operations on polygons, after Martinez, Rueda and Feito: a
+ * sweep from left to right over the endpoints of both polygons' edges,
+ * with the edges crossing the sweep line in a sweepline_t. Edges are
+ * split where they cross or overlap edges of the other polygon, and
+ * each piece learns, from the edge below it, whether it is inside the
+ * other polygon and on which side its own polygon lies. That decides
+ * whether it bounds the result and on which side the result is.
+ *
+ * The pieces that bound the result are then linked into contours with
+ * the result on their left, turning at each point into the face being
+ * traced, so outer contours come out anticlockwise and holes
+ * clockwise, as triangulate_polygon() wants them. Contours of either
+ * polygon may run either way; the inside is where a ray crosses an odd
+ * number of its edges.
+ *
+ * A face that touches itself at a point is traced as one ring through
+ * it twice, and faces touching each other meet at a point of both.
+ * split_pinches() cuts the rings there. Then the copies of such a point
+ * whose corner holds no other edge there, all but one, are pulled into
+ * their own contours, so no two contours of the result share a point.
+ */
+
+/* edge types, from how it overlaps an edge of the other polygon */
+#define CLIP_NORMAL		0
+#define CLIP_NON_CONTRIBUTING	1	/* the other copy of an overlap */
+#define CLIP_SAME_TRANSITION	2	/* both polygons on the same side */
+#define CLIP_DIFFERENT_TRANSITION 3	/* on opposite sides */
+
+#define CLIP_SNAP 1e-14		/* relative, see segment_intersection() */
+
+typedef struct {
+  point_t p;
+  point_t l0, l1;		/* the input edge it is a piece of, */
+				/* left to right */
+  int left;			/* TRUE at the left end of its edge */
+  int other;			/* event at the other end */
+  int clipping;			/* edge of the second polygon */
+  int type;			/* CLIP_* */
+  int inout;			/* below the edge is inside its polygon */
+  int otherinout;		/* the edge is outside the other polygon */
+  int inresult;			/* the edge bounds the result */
+  int above;			/* the result is above it */
+  int node;			/* in the sweep line, 0 if not there */
+  int id;			/* order of creation, to break ties */
+} clipevent_t;
+
+typedef struct {
+  clipevent_t *ev;
+  int nev, maxev;
+  int *heap;			/* events still to come, a binary heap */
+  int nheap;
+  sweepline_t sl;
+  int op;
+  int error;
+} clipper_t;
+
+
+/* Martinez' signed area: positive if p0, p1, p2 turn anticlockwise */
+static double signed_area(point_t *p0, point_t *p1, point_t *p2)
+{
+  return (p0->x - p2->x) * (p1->y - p2->y) - (p1->x - p2->x) * (p0->y - p2->y);
+}
+
+static int same_point(point_t *p, point_t *q)
+{
+  return (p->x == q->x) && (p->y == q->y);
+}
+
+/* Which side of the edge of event e is p on? Split points are */
+/* rounded, so the sides are always taken from the input edge */
+static double line_side(clipevent_t *e, point_t *p)
+{
+  return signed_area(&e->l0, &e->l1, p);
+}
+
+/* Is the edge of event e below p? */
+static int is_below(clipper_t *c, int e, point_t *p)
+{
+  return line_side(&c->ev[e], p) > 0;
+}
+
+/* Are the edges of events a and b on one line? */
+static int same_line(clipevent_t *a, clipevent_t *b)
+{
+  return (line_side(a, &b->l0) == 0) && (line_side(a, &b->l1) == 0);
+}
+
+static int is_vertical(clipper_t *c, int e)
+{
+  return c->ev[e].l0.x == c->ev[e].l1.x;
+}
+
+/* Does p come before q in the sweep? */
+static int point_before(point_t *p, point_t *q)
+{
+  return (p->x < q->x) || ((p->x == q->x) && (p->y < q->y));
+}
+
+
+/* Does event a come after event b in the sweep? Right ends go before */
+/* left ends at the same point, and lower edges before higher ones */
+static int event_after(clipper_t *c, int a, int b)
+{
+  clipevent_t *ev = c->ev, *ea = &ev[a], *eb = &ev[b];
+
+  if (ea->p.x != eb->p.x)
+    return ea->p.x > eb->p.x;
+  if (ea->p.y != eb->p.y)
+    return ea->p.y > eb->p.y;
+  if (ea->left != eb->left)
+    return ea->left;
+  if (!same_line(ea, eb) && (line_side(ea, &ev[eb->other].p) != 0))
+    return !is_below(c, a, &ev[eb->other].p);
+  if (ea->clipping != eb->clipping)
+    return ea->clipping;
+  return ea->id > eb->id;
+}
+
+
+/* Order of two edges on the sweep line, by their left events */
+static int segment_compare(void *ctx, int a, int b)
+{
+  clipper_t *c = (clipper_t *) ctx;
+  clipevent_t *ev = c->ev, *ea = &ev[a], *eb = &ev[b];
+
+  if (a == b)
+    return 0;
+  if (!same_line(ea, eb))
+    {
+      if (same_point(&ea->p, &eb->p))
+	return is_below(c, a, &ev[eb->other].p) ? -1 : 1;
+      if (ea->p.x == eb->p.x)
+	return (ea->p.y < eb->p.y) ? -1 : 1;
+      /* the later one starting on the other goes by its right end */
+      if (event_after(c, a, b))
+	{
+	  if (line_side(eb, &ea->p) == 0)
+	    return is_below(c, b, &ev[ea->other].p) ? 1 : -1;
+	  return !is_below(c, b, &ea->p) ? -1 : 1;
+	}
+      if (line_side(ea, &eb->p) == 0)
+	return is_below(c, a, &ev[eb->other].p) ? -1 : 1;
+      return is_below(c, a, &eb->p) ? -1 : 1;
+    }
+  /* collinear */
+  if (ea->clipping != eb->clipping)
+    return ea->clipping ? 1 : -1;
+  return event_after(c, a, b) ? 1 : -1;
+}
+
+
+static void heap_push(clipper_t *c, int e)
+{
+  int i = c->nheap++, parent;
+
+  while (i > 0)
+    {
+      parent = (i - 1) / 2;
+      if (!event_after(c, c->heap[parent], e))
+	break;
+      c->heap[i] = c->heap[parent];
+      i = parent;
+    }
+  c->heap[i] = e;
+}
+
+static int heap_pop(clipper_t *c)
+{
+  int top = c->heap[0], last = c->heap[--c->nheap], i = 0, child;
+
+  while ((child = 2 * i + 1) < c->nheap)
+    {
+      if ((child + 1 < c->nheap) && event_after(c, c->heap[child], c->heap[child + 1]))
+	child++;
+      if (!event_after(c, last, c->heap[child]))
+	break;
+      c->heap[i] = c->heap[child];
+      i = child;
+    }
+  if (c->nheap)
+    c->heap[i] = last;
+  return top;
+}
+
+
+/* A new event at p, in the table and, if queue, in the heap */
+static int new_event(clipper_t *c, point_t *p, int left, int other, int clipping, int queue)
+{
+  int e;
+
+  if (c->nev == c->maxev)
+    {
+      int maxev = 2 * c->maxev;
+      clipevent_t *ev = (clipevent_t *) realloc(c->ev, sizeof(clipevent_t) * maxev);
+      int *heap = (int *) realloc(c->heap, sizeof(int) * maxev);
+
+      if (ev)
+	c->ev = ev;
+      if (heap)
+	c->heap = heap;
+      if (!ev || !heap)
+	{
+	  c->error = SEIDEL_ERR_NOMEM;
+	  return -1;
+	}
+      c->maxev = maxev;
+    }
+
+  e = c->nev++;
+  memset(&c->ev[e], 0, sizeof(clipevent_t));
+  c->ev[e].p = *p;
+  c->ev[e].left = left;
+  c->ev[e].other = other;
+  c->ev[e].clipping = clipping;
+  c->ev[e].id = e;
+  if (queue)
+    heap_push(c, e);
+  return e;
+}
+
+
+/* Split the edge of left event le at p, which lies inside it */
+static void divide_segment(clipper_t *c, int le, point_t *p)
+{
+  int re = c->ev[le].other, r, l;
+
+  if (!point_before(&c->ev[le].p, p) || !point_before(p, &c->ev[re].p))
+    return;
+  r = new_event(c, p, FALSE, le, c->ev[le].clipping, FALSE);
+  l = new_event(c, p, TRUE, re, c->ev[le].clipping, FALSE);
+  if ((r < 0) || (l < 0))
+    return;
+  c->ev[r].l0 = c->ev[l].l0 = c->ev[le].l0;
+  c->ev[r].l1 = c->ev[l].l1 = c->ev[le].l1;
+  c->ev[re].other = l;
+  c->ev[le].other = r;
+  heap_push(c, l);
+  heap_push(c, r);
+}
+
+
+/* Where the edges of left events le1 and le2 meet: 0 if nowhere, 1 */
+/* at *p0, 2 if they overlap from *p0 to *p1. Ends are given exactly */
+static int segment_intersection(clipper_t *c, int le1, int le2, point_t *p0, point_t *p1)
+{
+  clipevent_t *ea = &c->ev[le1], *eb = &c->ev[le2];
+  point_t *a0 = &ea->p, *a1 = &c->ev[ea->other].p;
+  point_t *b0 = &eb->p, *b1 = &c->ev[eb->other].p;
+  double d0 = line_side(ea, b0), d1 = line_side(ea, b1);
+  double d2 = line_side(eb, a0), d3 = line_side(eb, a1);
+  double len, s0, s1, t, rx, ry, wx, wy;
+  point_t *end[4];
+  int i;
+
+  if (same_line(ea, eb))
+    {
+      /* collinear: positions of b0 and b1 along a, a0 at 0, a1 at 1 */
+      len = (a1->x - a0->x) * (a1->x - a0->x) + (a1->y - a0->y) * (a1->y - a0->y);
+      s0 = ((b0->x - a0->x) * (a1->x - a0->x) + (b0->y - a0->y) * (a1->y - a0->y)) / len;
+      s1 = ((b1->x - a0->x) * (a1->x - a0->x) + (b1->y - a0->y) * (a1->y - a0->y)) / len;
+      if ((s0 > 1) || (s1 < 0))
+	return 0;
+      *p0 = (s0 > 0) ? *b0 : *a0;
+      *p1 = (s1 < 1) ? *b1 : *a1;
+      return same_point(p0, p1) ? 1 : 2;
+    }
+
+  if (((d0 > 0) && (d1 > 0)) || ((d0 < 0) && (d1 < 0)) ||
+      ((d2 > 0) && (d3 > 0)) || ((d2 < 0) && (d3 < 0)))
+    return 0;
+  end[0] = a0, end[1] = a1, end[2] = b0, end[3] = b1;
+  if (d0 == 0)
+    *p0 = *b0;
+  else if (d1 == 0)
+    *p0 = *b1;
+  else if (d2 == 0)
+    *p0 = *a0;
+  else if (d3 == 0)
+    *p0 = *a1;
+  else
+    {
+      /* where the input edges cross, the same for all their pieces */
+      rx = ea->l1.x - ea->l0.x;
+      ry = ea->l1.y - ea->l0.y;
+      wx = eb->l1.x - eb->l0.x;
+      wy = eb->l1.y - eb->l0.y;
+      t = ((eb->l0.x - ea->l0.x) * wy - (eb->l0.y - ea->l0.y) * wx) / (rx * wy - ry * wx);
+      p0->x = ea->l0.x + t * rx;
+      p0->y = ea->l0.y + t * ry;
+
+      /* an end the crossing only misses by rounding is the crossing */
+      for (i = 0; i < 4; i++)
+	if ((fabs(p0->x - end[i]->x) <= CLIP_SNAP * (1 + fabs(end[i]->x))) &&
+	    (fabs(p0->y - end[i]->y) <= CLIP_SNAP * (1 + fabs(end[i]->y))))
+	  {
+	    *p0 = *end[i];
+	    break;
+	  }
+    }
+  /* and it cannot fall outside either piece */
+  for (i = 0; i < 4; i += 2)
+    if (point_before(p0, end[i]))
+      *p0 = *end[i];
+    else if (point_before(end[i + 1], p0))
+      *p0 = *end[i + 1];
+  return 1;
+}
+
+
+/* Split edges le1 and le2, neighbours on the sweep line, where they */
+/* meet. Returns 2 if their overlap changed the type of le1 */
+static int possible_intersection(clipper_t *c, int le1, int le2)
+{
+  clipevent_t *ev = c->ev;
+  int re1 = ev[le1].other, re2 = ev[le2].other;
+  int e[4], ne = 0, left_same, right_same;
+  point_t p0, p1;
+  int n = segment_intersection(c, le1, le2, &p0, &p1);
+
+  if (n == 0)
+    return 0;
+  if ((n == 1) && (same_point(&ev[le1].p, &ev[le2].p) || same_point(&ev[re1].p, &ev[re2].p)))
+    return 0;			/* they only share an end */
+  if ((n == 2) && (ev[le1].clipping == ev[le2].clipping))
+    return 0;			/* overlap within one polygon */
+
+  if (n == 1)
+    {
+      divide_segment(c, le1, &p0);
+      divide_segment(c, le2, &p0);
+      return 1;
+    }
+
+  /* the edges overlap: order their ends */
+  left_same = same_point(&ev[le1].p, &ev[le2].p);
+  right_same = same_point(&ev[re1].p, &ev[re2].p);
+  if (!left_same)
+    {
+      e[ne++] = event_after(c, le1, le2) ? le2 : le1;
+      e[ne++] = event_after(c, le1, le2) ? le1 : le2;
+    }
+  if (!right_same)
+    {
+      e[ne++] = event_after(c, re1, re2) ? re2 : re1;
+      e[ne++] = event_after(c, re1, re2) ? re1 : re2;
+    }
+
+  if (left_same)
+    {
+      /* one copy of the shared part bounds the result, the other not */
+      c->ev[le2].type = CLIP_NON_CONTRIBUTING;
+      c->ev[le1].type = (c->ev[le2].inout == c->ev[le1].inout) ?
+	CLIP_SAME_TRANSITION : CLIP_DIFFERENT_TRANSITION;
+      if (!right_same)
+	{
+	  point_t q0 = c->ev[e[0]].p;	/* the table may move */
+
+	  divide_segment(c, c->ev[e[1]].other, &q0);
+	}
+      return 2;
+    }
+  if (right_same)
+    {
+      point_t q1 = c->ev[e[1]].p;
+
+      divide_segment(c, e[0], &q1);
+      return 3;
+    }
+  if (e[0] != c->ev[e[3]].other)
+    {
+      /* neither contains the other */
+      point_t q1 = c->ev[e[1]].p, q2 = c->ev[e[2]].p;
+
+      divide_segment(c, e[0], &q1);
+      divide_segment(c, e[1], &q2);
+      return 3;
+    }
+  /* e[0]'s edge contains the other: split it at both its ends */
+  {
+    point_t q1 = c->ev[e[1]].p, q2 = c->ev[e[2]].p;
+
+    divide_segment(c, e[0], &q1);
+    divide_segment(c, c->ev[e[3]].other, &q2);
+  }
+  return 3;
+}
+
+
+/* Is the edge of left event e part of the boundary of the result? */
+static int in_result(clipper_t *c, clipevent_t *e)
+{
+  switch (e->type)
+    {
+    case CLIP_NORMAL:
+      switch (c->op)
+	{
+	case SEIDEL_BOOL_INTERSECTION:
+	  return !e->otherinout;
+	case SEIDEL_BOOL_UNION:
+	  return e->otherinout;
+	case SEIDEL_BOOL_DIFFERENCE:
+	  return (!e->clipping && e->otherinout) || (e->clipping && !e->otherinout);
+	default:
+	  return TRUE;
+	}
+    case CLIP_SAME_TRANSITION:
+      return (c->op == SEIDEL_BOOL_INTERSECTION) || (c->op == SEIDEL_BOOL_UNION);
+    case CLIP_DIFFERENT_TRANSITION:
+      return (c->op == SEIDEL_BOOL_DIFFERENCE);
+    default:
+      return FALSE;
+    }
+}
+
+
+/* Work out the flags of left event e from the edge below it */
+static void compute_fields(clipper_t *c, int e, int prev)
+{
+  clipevent_t *ev = c->ev, *ee = &ev[e];
+  int this_in, that_in;
+
+  if (prev < 0)
+    {
+      ee->inout = FALSE;
+      ee->otherinout = TRUE;
+    }
+  else if (ev[prev].clipping == ee->clipping)
+    {
+      ee->inout = !ev[prev].inout;
+      ee->otherinout = ev[prev].otherinout;
+    }
+  else
+    {
+      ee->inout = !ev[prev].otherinout;
+      ee->otherinout = is_vertical(c, prev) ? !ev[prev].inout : ev[prev].inout;
+    }
+
+  ee->inresult = in_result(c, ee);
+  this_in = !ee->inout;
+  that_in = !ee->otherinout;
+  /* along an overlap the result lies on the side of the first polygon */
+  if (ee->type == CLIP_SAME_TRANSITION)
+    ee->above = this_in;
+  else if (ee->type == CLIP_DIFFERENT_TRANSITION)
+    ee->above = ee->clipping ? !this_in : this_in;
+  else switch (c->op)
+    {
+    case SEIDEL_BOOL_INTERSECTION:
+      ee->above = this_in && that_in;
+      break;
+    case SEIDEL_BOOL_UNION:
+      ee->above = this_in || that_in;
+      break;
+    case SEIDEL_BOOL_DIFFERENCE:
+      ee->above = ee->clipping ? (that_in && !this_in) : (this_in && !that_in);
+      break;
+    default:
+      ee->above = this_in ^ that_in;
+      break;
+    }
+}
+
+
+static int item_of(clipper_t *c, int node)
+{
+  return node ? c->sl.node[node].item : -1;
+}
+
+
+/* Sweep over the edges of both polygons */
+static void clip_sweep(clipper_t *c, double stop_x)
+{
+  int e, le, node, prev, next, prevprev;
+
+  while (c->nheap && !c->error)
+    {
+      e = heap_pop(c);
+      if (c->ev[e].p.x > stop_x)
+	break;			/* nothing further can be in the result */
+
+      if (c->ev[e].left)
+	{
+	  if (!(node = sweepline_insert(&c->sl, e)))
+	    {
+	      c->error = SEIDEL_ERR_NOMEM;
+	      break;
+	    }
+	  c->ev[e].node = node;
+	  prev = item_of(c, sweepline_prev(&c->sl, node));
+	  next = item_of(c, sweepline_next(&c->sl, node));
+	  compute_fields(c, e, prev);
+	  if ((next >= 0) && (possible_intersection(c, e, next) == 2))
+	    {
+	      compute_fields(c, e, prev);
+	      compute_fields(c, next, e);
+	    }
+	  if ((prev >= 0) && (possible_intersection(c, prev, e) == 2))
+	    {
+	      prevprev = item_of(c, sweepline_prev(&c->sl, c->ev[prev].node));
+	      compute_fields(c, prev, prevprev);
+	      compute_fields(c, e, prev);
+	    }
+	}
+      else
+	{
+	  le = c->ev[e].other;
+	  if (!(node = c->ev[le].node))
+	    continue;
+	  prev = item_of(c, sweepline_prev(&c->sl, node));
+	  next = item_of(c, sweepline_next(&c->sl, node));
+	  sweepline_remove(&c->sl, node);
+	  c->ev[le].node = 0;
+	  if ((prev >= 0) && (next >= 0))
+	    possible_intersection(c, prev, next);
+	}
+    }
+}
+
+
+/* An edge of the result between points from and to, numbered by */
+/* position; directed with the result on its left unless vertical */
+typedef struct {
+  int from, to;
+  int directed;
+} clipedge_t;
+
+typedef struct {
+  point_t p;
+  int edge, end;
+} clipend_t;
+
+static int cmp_clipend(const void *a, const void *b)
+{
+  const clipend_t *p = (const clipend_t *) a, *q = (const clipend_t *) b;
+
+  if (p->p.x != q->p.x)
+    return (p->p.x < q->p.x) ? -1 : 1;
+  if (p->p.y != q->p.y)
+    return (p->p.y < q->p.y) ? -1 : 1;
+  return 0;
+}
+
+
+/* Clockwise angle from direction (bx, by) to (dx, dy), in (0, 2 pi] */
+static double clockwise_angle(double bx, double by, double dx, double dy)
+{
+  double a = -atan2(bx * dy - by * dx, bx * dx + by * dy);
+
+  return (a <= 0) ? a + 2 * M_PI : a;
+}
+
+
+static int contours_reserve(SeidelContours *out, int ncontours, int nvert)
+{
+  if (ncontours > out->maxcontours)
+    {
+      int *cntr = (int *) realloc(out->cntr, sizeof(int) * ncontours);
+
+      if (!cntr)
+	return SEIDEL_ERR_NOMEM;
+      out->cntr = cntr;
+      out->maxcontours = ncontours;
+    }
+  if (nvert > out->maxvert)
+    {
+      double (*vertices)[2] = (double (*)[2]) realloc(out->vertices, sizeof(double) * 2 * (nvert + 1));
+
+      if (!vertices)
+	return SEIDEL_ERR_NOMEM;
+      out->vertices = vertices;
+      out->maxvert = nvert;
+    }
+  return 0;
+}
+
+
+/* A loop through pt[a], pt[b], pt[c] can do without b where it goes */
+/* straight back, or straight on unless another loop has a corner */
+/* there */
+static int redundant(point_t *pt, int a, int b, int c, int *share)
+{
+  if (signed_area(&pt[a], &pt[b], &pt[c]) != 0)
+    return FALSE;
+  return (share[b] < 2) ||
+    ((pt[b].x - pt[a].x) * (pt[c].x - pt[b].x) + (pt[b].y - pt[a].y) * (pt[c].y - pt[b].y) <= 0);
+}
+
+
+/* Link the result edges into contours, outer ones first, and write */
+/* them to out. Returns the number of contours or an error */
+static int clip_contours(clipper_t *c, SeidelContours *out)
+{
+  clipedge_t *edge;
+  clipend_t *end;
+  point_t *pt;
+  int *first, *inc, *ring, *rfirst, *used, *order, *ostart, *share, *link, *loopof, *inner;
+  double *area;
+  int nedges = 0, npts = 0, nrings = 0, nring = 0, i, j, k, e, v, s, err = 0;
+  int nouter = 0, nvert = 0, nloops, l, pass;
+
+  for (e = 0; e < c->nev; e++)
+    if (c->ev[e].left && c->ev[e].inresult)
+      nedges++;
+
+  edge = (clipedge_t *) malloc(sizeof(clipedge_t) * (nedges + 1));
+  end = (clipend_t *) malloc(sizeof(clipend_t) * (2 * nedges + 1));
+  pt = (point_t *) malloc(sizeof(point_t) * (2 * nedges + 1));
+  first = (int *) calloc(2 * nedges + 2, sizeof(int));
+  inc = (int *) malloc(sizeof(int) * (2 * nedges + 1));
+  used = (int *) calloc(nedges + 1, sizeof(int));
+  ring = (int *) malloc(sizeof(int) * (nedges + 1));
+  rfirst = (int *) malloc(sizeof(int) * (nedges + 2));
+  area = (double *) malloc(sizeof(double) * (nedges + 1));
+  order = (int *) malloc(sizeof(int) * (nedges + 1));
+  ostart = (int *) malloc(sizeof(int) * (2 * nedges + 2));
+  share = (int *) calloc(2 * nedges + 1, sizeof(int));
+  link = (int *) malloc(sizeof(int) * (nedges + 1));
+  loopof = (int *) malloc(sizeof(int) * (nedges + 1));
+  inner = (int *) malloc(sizeof(int) * (nedges + 1));
+  if (!edge || !end || !pt || !first || !inc || !used || !ring || !rfirst || !area ||
+      !order || !ostart || !share || !link || !loopof || !inner)
+    {
+      err = SEIDEL_ERR_NOMEM;
+      goto done;
+    }
+
+  /* number the points, equal ones alike */
+  for (k = 0, e = 0; e < c->nev; e++)
+    if (c->ev[e].left && c->ev[e].inresult)
+      {
+	end[2 * k].p = c->ev[e].p;
+	end[2 * k + 1].p = c->ev[c->ev[e].other].p;
+	end[2 * k].edge = end[2 * k + 1].edge = k;
+	end[2 * k].end = 0;
+	end[2 * k + 1].end = 1;
+	edge[k].directed = !is_vertical(c, e);
+	if (edge[k].directed && !c->ev[e].above)
+	  end[2 * k].end = 1, end[2 * k + 1].end = 0;	/* runs right to left */
+	k++;
+      }
+  qsort(end, 2 * nedges, sizeof(clipend_t), cmp_clipend);
+  for (i = 0; i < 2 * nedges; i++)
+    {
+      if ((i == 0) || cmp_clipend(&end[i - 1], &end[i]))
+	pt[npts++] = end[i].p;
+      if (end[i].end == 0)
+	edge[end[i].edge].from = npts - 1;
+      else
+	edge[end[i].edge].to = npts - 1;
+      first[npts]++;
+    }
+  for (i = 1; i <= npts; i++)
+    first[i] += first[i - 1];
+  for (i = 0, v = 0; i < 2 * nedges; i++)
+    {
+      if ((i > 0) && cmp_clipend(&end[i - 1], &end[i]))
+	v++;
+      inc[first[v]++] = end[i].edge;
+    }
+  for (i = npts; i > 0; i--)
+    first[i] = first[i - 1];
+  first[0] = 0;
+
+  /* trace each face, turning at every point into the first edge */
+  /* clockwise from the one it came along */
+  rfirst[0] = 0;
+  for (e = 0; e < nedges; e++)
+    {
+      if (used[e] || !edge[e].directed)
+	continue;
+      used[e] = TRUE;
+      s = edge[e].from;
+      ring[nring++] = s;
+      for (j = s, v = edge[e].to; v != s; j = v, v = k)
+	{
+	  double best = 4 * M_PI, a;
+	  int next = -1, to;
+
+	  ring[nring++] = v;
+	  for (i = first[v]; i < first[v + 1]; i++)
+	    {
+	      int f = inc[i];
+
+	      if (used[f] || (edge[f].directed && (edge[f].from != v)))
+		continue;
+	      to = (edge[f].from == v) ? edge[f].to : edge[f].from;
+	      a = clockwise_angle(pt[j].x - pt[v].x, pt[j].y - pt[v].y,
+				  pt[to].x - pt[v].x, pt[to].y - pt[v].y);
+	      if (a < best)
+		{
+		  best = a;
+		  next = f;
+		}
+	    }
+	  if (next < 0)
+	    {
+	      err = SEIDEL_ERR_DEGENERATE;	/* an open chain */
+	      goto done;
+	    }
+	  used[next] = TRUE;
+	  k = (edge[next].from == v) ? edge[next].to : edge[next].from;
+	}
+
+      rfirst[++nrings] = nring;
+    }
+
+  /* a face that touches itself at a point is traced as one ring */
+  /* through it twice: cut it there, each point being its own group */
+  if ((nloops = split_pinches(nrings, rfirst, ring, npts, order, ostart)) < 0)
+    {
+      err = nloops;
+      goto done;
+    }
+  for (i = 0; i < nring; i++)
+    {
+      order[i] = ring[order[i]];
+      share[order[i]]++;
+    }
+
+  /* drop points where a loop goes straight on or back, and the loops */
+  /* with nothing left */
+  for (nring = nrings = 0, l = 0; l < nloops; l++)
+    {
+      for (i = ostart[l], k = nring; i < ostart[l + 1]; i++)
+	{
+	  while ((k - nring >= 2) &&
+		 redundant(pt, ring[k - 2], ring[k - 1], order[i], share))
+	    k--;
+	  ring[k++] = order[i];
+	}
+      for (j = nring; k - j >= 3;)
+	if (redundant(pt, ring[k - 2], ring[k - 1], ring[j], share))
+	  k--;
+	else if (redundant(pt, ring[k - 1], ring[j], ring[j + 1], share))
+	  j++;
+	else
+	  break;
+      memmove(&ring[nring], &ring[j], sizeof(int) * (k - j));
+      k = nring + (k - j);
+
+      for (area[nrings] = 0, i = nring; i < k; i++)
+	{
+	  point_t *p = &pt[ring[i]], *q = &pt[ring[(i + 1 < k) ? i + 1 : nring]];
+
+	  area[nrings] += p->x * q->y - q->x * p->y;
+	}
+      if ((k - nring >= 3) && (area[nrings] != 0))
+	rfirst[++nrings] = nring = k;
+    }
+
+  /* outer contours, anticlockwise, then the holes, each copy of a */
+  /* point linked to the one written before it */
+  for (i = 0; i < nrings; i++)
+    nouter += (area[i] > 0);
+  if ((err = contours_reserve(out, nrings, nring)))
+    goto done;
+  for (i = 0; i < npts; i++)
+    share[i] = 0;
+  for (k = 0, pass = 0; pass < 2; pass++)
+    for (i = 0; i < nrings; i++)
+      if ((area[i] > 0) == (pass == 0))
+	{
+	  out->cntr[k++] = rfirst[i + 1] - rfirst[i];
+	  for (j = rfirst[i]; j < rfirst[i + 1]; j++)
+	    {
+	      nvert++;
+	      out->vertices[nvert][0] = pt[ring[j]].x;
+	      out->vertices[nvert][1] = pt[ring[j]].y;
+	      link[nvert] = share[ring[j]];
+	      share[ring[j]] = nvert;
+	      loopof[nvert] = k - 1;
+	    }
+	}
+  for (rfirst[0] = 1, k = 0; k < nrings; k++)
+    rfirst[k + 1] = rfirst[k] + out->cntr[k];
+  out->nouter = nouter;
+  for (i = 0; i < npts; i++)
+    if (share[i] && link[share[i]])
+      separate_copies(out->vertices, rfirst, out->nouter, loopof, link, inner, share[i]);
+  out->ncontours = nrings;
+  out->nvert = nvert;
+
+ done:
+  free(edge);
+  free(end);
+  free(pt);
+  free(first);
+  free(inc);
+  free(used);
+  free(ring);
+  free(rfirst);
+  free(area);
+  free(order);
+  free(ostart);
+  free(share);
+  free(link);
+  free(loopof);
+  free(inner);
+  return err ? err : nrings;
+}
+
+
+/* Add the edges of a polygon given as for triangulate_polygon() */
+static void add_polygon(clipper_t *c, int ncontours, int cntr[], double (*vertices)[2],
+			int clipping, double box[4])
+{
+  int i, j, first, a, b, l, r;
+  point_t p, q;
+
+  for (i = 1, j = 0; (j < ncontours) && !c->error; i += cntr[j++])
+    for (first = i, a = i; (a < i + cntr[j]) && !c->error; a++)
+      {
+	b = (a + 1 < i + cntr[j]) ? a + 1 : first;
+	p.x = vertices[a][0];
+	p.y = vertices[a][1];
+	q.x = vertices[b][0];
+	q.y = vertices[b][1];
+	if (same_point(&p, &q))
+	  continue;
+	box[0] = MIN(box[0], p.x);
+	box[1] = MIN(box[1], p.y);
+	box[2] = MAX(box[2], p.x);
+	box[3] = MAX(box[3], p.y);
+	if ((p.x < q.x) || ((p.x == q.x) && (p.y < q.y)))
+	  {
+	    l = new_event(c, &p, TRUE, -1, clipping, FALSE);
+	    r = new_event(c, &q, FALSE, l, clipping, FALSE);
+	  }
+	else
+	  {
+	    l = new_event(c, &q, TRUE, -1, clipping, FALSE);
+	    r = new_event(c, &p, FALSE, l, clipping, FALSE);
+	  }
+	if ((l < 0) || (r < 0))
+	  return;
+	c->ev[l].other = r;
+	c->ev[l].l0 = c->ev[r].l0 = c->ev[l].p;
+	c->ev[l].l1 = c->ev[r].l1 = c->ev[r].p;
+	heap_push(c, l);
+	heap_push(c, r);
+      }
+}
+
+
+/* Combine polygon a (na contours, cntra, va) with polygon b by op, one
+ * of the SEIDEL_BOOL_* operations (SEIDEL_BOOL_DIFFERENCE is a less b),
+ * both in the layout triangulate_polygon() takes. The result goes to
+ * out in the same layout, buffers and all, anticlockwise outer contours
+ * first and clockwise holes after. out must be zeroed before its first
+ * use; its buffers only grow, and seidel_contours_free() frees them.
+ * Returns the number of contours, 0 for an empty result, or one of the
+ * negative SEIDEL_ERR_* codes.
+ *
+ * Where the result touches itself at a point, the contours there are
+ * split apart and all but one copy of the point pulled a little way into
+ * its own contour, so triangulate_contours() can take any result.
+ */
+int polygon_boolean(int op, int na, int cntra[], double (*va)[2], int nb, int cntrb[], double (*vb)[2],
+		    SeidelContours *out)
+{
+  clipper_t c;
+  double boxa[4] = {HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+  double boxb[4] = {HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+  double stop_x = HUGE_VAL;
+  int i, n = 0, ret;
+
+  if ((op < SEIDEL_BOOL_UNION) || (op > SEIDEL_BOOL_XOR) || (na < 0) || (nb < 0))
+    return SEIDEL_ERR_INPUT;
+  for (i = 0; i < na; i++)
+    n += cntra[i];
+  for (i = 0; i < nb; i++)
+    n += cntrb[i];
+
+  memset(&c, 0, sizeof(c));
+  c.op = op;
+  c.maxev = 4 * n + 16;
+  c.ev = (clipevent_t *) malloc(sizeof(clipevent_t) * c.maxev);
+  c.heap = (int *) malloc(sizeof(int) * c.maxev);
+  if (!c.ev || !c.heap || sweepline_init(&c.sl, n + 16, segment_compare, NULL, &c))
+    {
+      free(c.ev);
+      free(c.heap);
+      return SEIDEL_ERR_NOMEM;
+    }
+
+  add_polygon(&c, na, cntra, va, FALSE, boxa);
+  add_polygon(&c, nb, cntrb, vb, TRUE, boxb);
+
+  /* past the end of a, or of either for an intersection, nothing */
+  /* more can be in the result */
+  if (op == SEIDEL_BOOL_INTERSECTION)
+    stop_x = MIN(boxa[2], boxb[2]);
+  else if (op == SEIDEL_BOOL_DIFFERENCE)
+    stop_x = boxa[2];
+  if ((op == SEIDEL_BOOL_INTERSECTION) &&
+      ((boxa[0] > boxb[2]) || (boxb[0] > boxa[2]) || (boxa[1] > boxb[3]) || (boxb[1] > boxa[3])))
+    c.nheap = 0;		/* boxes apart: empty */
+
+  if (!c.error)
+    clip_sweep(&c, stop_x);
+  ret = c.error ? c.error : clip_contours(&c, out);
+  if (ret < 0)
+    out->ncontours = out->nouter = out->nvert = 0;
+
+  sweepline_free(&c.sl);
+  free(c.ev);
+  free(c.heap);
+  return ret;
+}
+
+
+void seidel_contours_free(SeidelContours *out)
+{
+  free(out->cntr);
+  free(out->vertices);
+  memset(out, 0, sizeof(*out));
+}
@@ -2,23 +2,84 @@
 #include <math.h>
 #include <string.h>
 
-/* Return a new node to be added into the query tree */
+#ifndef FIX_SIZED_ARRAY
+/* The tables are sized for the trapezoids a typical insertion order */
+/* leaves behind; the trapezoids merge_trapezoids() invalidates take */
+/* room too, and an unlucky order can need more. Grow by half. The */
+/* monotone chains and visited flags are indexed by trapezoid */
+static int grow_traps(SeidelTriangulator* state)
+{
+  int size = state->trSize + state->trSize / 2 + 4;
+  trap_t *tr = (trap_t *) realloc(state->tr - 1, sizeof(trap_t) * (size + 1));
+  monchain_t *mchain;
+  int *visited;
+
+  if (!tr)
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->tr = tr + 1;
+  memset((void *)&state->tr[state->trSize], 0, sizeof(trap_t) * (size - state->trSize));
+
+  mchain = (monchain_t *) realloc(state->mchain, sizeof(monchain_t) * size);
+  if (!mchain)
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->mchain = mchain;
+  visited = (int *) realloc(state->visited, sizeof(int) * size);
+  if (!visited)
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->visited = visited;
+
+  state->trSize = size;
+  return 0;
+}
+
+static int grow_nodes(SeidelTriangulator* state)
+{
+  int size = state->qSize + state->qSize / 2 + 8;
+  node_t *qs = (node_t *) realloc(state->qs, sizeof(node_t) * size);
+
+  if (!qs)
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->qs = qs;
+  memset((void *)&state->qs[state->qSize], 0, sizeof(node_t) * (size - state->qSize));
+  state->qSize = size;
+  return 0;
+}
+#endif
+
+
+/* Return a new node to be added into the query tree, cleared. On */
+/* overflow of a fixed-size table the error is recorded and the */
+/* unused entry 0 is handed out, so that the caller can finish its */
+/* update without leaving the table */
 static int newnode(SeidelTriangulator* state)
 {
+#ifndef FIX_SIZED_ARRAY
+  if ((state->q_idx == state->qSize) && !state->error)
+    grow_nodes(state);
+#endif
   if (state->q_idx < state->qSize)
-    return state->q_idx++;
+    {
+      memset((void *)&state->qs[state->q_idx], 0, sizeof(node_t));
+      return state->q_idx++;
+    }
   else
     {
-      fprintf(stderr, "newnode(state): Query-table overflow\n");
-      return -1;
+      seidel_fail(state, SEIDEL_ERR_QTABLE);
+      return 0;
     }
 }
 
-/* Return a free trapezoid */
+/* Return a free trapezoid, cleared. Overflow is handled as in */
+/* newnode() */
 static int newtrap(SeidelTriangulator* state)
 {
+#ifndef FIX_SIZED_ARRAY
+  if ((state->tr_idx == state->trSize) && !state->error)
+    grow_traps(state);
+#endif
   if (state->tr_idx < state->trSize)
     {
+      memset((void *)&state->tr[state->tr_idx], 0, sizeof(trap_t));
       state->tr[state->tr_idx].lseg = -1;
       state->tr[state->tr_idx].rseg = -1;
       state->tr[state->tr_idx].state = ST_VALID;
@@ -26,8 +87,8 @@ static int newtrap(SeidelTriangulator* state)
     }
   else
     {
-      fprintf(stderr, "newtrap: Trapezoid-table overflow\n");
-      return -1;
+      seidel_fail(state, SEIDEL_ERR_TRTABLE);
+      return 0;
     }
 }
 
@@ -140,9 +201,13 @@ static int init_query_structure(SeidelTriangulator* state, int segnum)
   int t1, t2, t3, t4;
   segment_t *s = &state->seg[segnum];
 
+  /* Entries are cleared as they are handed out, so that a large */
+  /* triangulator reused for a small polygon does not pay for its */
+  /* whole tables. Only the guard tr[-1] and the entries 0 handed */
+  /* out on overflow are cleared here */
   state->q_idx = state->tr_idx = 1;
-  memset((void *)state->tr, 0, sizeof(state->tr[0]) * state->trSize);
-  memset((void *)state->qs, 0, sizeof(state->qs[0]) * state->qSize);
+  memset((void *)(state->tr - 1), 0, sizeof(state->tr[0]) * 2);
+  memset((void *)state->qs, 0, sizeof(state->qs[0]));
 
   i1 = newnode(state);
   state->qs[i1].nodetype = T_Y;
@@ -280,58 +345,89 @@ static int inserted(SeidelTriangulator* state, int segnum, int whichpt)
 }
 
 /* This is query routine which determines which trapezoid does the 
- * point v lie in. The return value is the trapezoid number. 
+ * point v lie in. The return value is the trapezoid number, or 0 if
+ * the query structure is inconsistent or the step budget runs out.
  */
 
 int locate_endpoint(SeidelTriangulator* state, point_t *v, point_t *vo, int r)
 {
-  node_t *rptr = &state->qs[r];
-  
-  switch (rptr->nodetype)
+  return locate_beside(state, v, vo, 0, r);
+}
+
+/* As locate_endpoint(), for a point v on segment segnum: v is taken */
+/* to be on the side of the segment that vo is on */
+int locate_beside(SeidelTriangulator* state, point_t *v, point_t *vo, int segnum, int r)
+{
+  node_t *rptr;
+
+  for (;;)
     {
-    case T_SINK:
-      return rptr->trnum;
-      
-    case T_Y:
-      if (_greater_than(v, &rptr->yval)) /* above */
-	return locate_endpoint(state, v, vo, rptr->right);
-      else if (_equal_to(v, &rptr->yval)) /* the point is already */
-	{			          /* inserted. */
-	  if (_greater_than(vo, &rptr->yval)) /* above */
-	    return locate_endpoint(state, v, vo, rptr->right);
-	  else 
-	    return locate_endpoint(state, v, vo, rptr->left); /* below */
+      if (OVER_BUDGET(state))
+	{
+	  seidel_fail(state, SEIDEL_ERR_BUDGET);
+	  return 0;
 	}
-      else
-	return locate_endpoint(state, v, vo, rptr->left); /* below */
+      if (r <= 0)
+	break;
 
-    case T_X:
-      if (_equal_to(v, &state->seg[rptr->segnum].v0) ||
-	       _equal_to(v, &state->seg[rptr->segnum].v1))
+      rptr = &state->qs[r];
+      switch (rptr->nodetype)
 	{
-	  if (FP_EQUAL(v->y, vo->y)) /* horizontal segment */
+	case T_SINK:
+	  return rptr->trnum;
+
+	case T_Y:
+	  if (_greater_than(v, &rptr->yval)) /* above */
+	    r = rptr->right;
+	  else if (_equal_to(v, &rptr->yval)) /* the point is already */
+	    {			              /* inserted. */
+	      if (_greater_than(vo, &rptr->yval)) /* above */
+		r = rptr->right;
+	      else
+		r = rptr->left; /* below */
+	    }
+	  else
+	    r = rptr->left; /* below */
+	  continue;
+
+	case T_X:
+	  if (rptr->segnum == segnum)
 	    {
-	      if (vo->x < v->x)
-		return locate_endpoint(state, v, vo, rptr->left); /* left */
+	      if (is_left_of(state, segnum, vo))
+		r = rptr->left;
 	      else
-		return locate_endpoint(state, v, vo, rptr->right); /* right */
+		r = rptr->right;
 	    }
+	  else if (_equal_to(v, &state->seg[rptr->segnum].v0) ||
+	      _equal_to(v, &state->seg[rptr->segnum].v1))
+	    {
+	      if (FP_EQUAL(v->y, vo->y)) /* horizontal segment */
+		{
+		  if (vo->x < v->x)
+		    r = rptr->left; /* left */
+		  else
+		    r = rptr->right; /* right */
+		}
 
-	  else if (is_left_of(state, rptr->segnum, vo))
-	    return locate_endpoint(state, v, vo, rptr->left); /* left */
+	      else if (is_left_of(state, rptr->segnum, vo))
+		r = rptr->left; /* left */
+	      else
+		r = rptr->right; /* right */
+	    }
+	  else if (is_left_of(state, rptr->segnum, v))
+	    r = rptr->left; /* left */
 	  else
-	    return locate_endpoint(state, v, vo, rptr->right); /* right */
-	}
-      else if (is_left_of(state, rptr->segnum, v))
-	return locate_endpoint(state, v, vo, rptr->left); /* left */
-      else
-	return locate_endpoint(state, v, vo, rptr->right); /* right */
+	    r = rptr->right; /* right */
+	  continue;
 
-    default:
-      fprintf(stderr, "Haggu !!!!!\n");
+	default:
+	  break;
+	}
       break;
     }
-    return -1;
+
+  seidel_fail(state, SEIDEL_ERR_DEGENERATE);
+  return 0;
 }
 
 
@@ -351,6 +447,9 @@ static int merge_trapezoids(SeidelTriangulator* state, int segnum, int tfirst, i
   t = tfirst;
   while ((t > 0) && _greater_than_equal_to(&state->tr[t].lo, &state->tr[tlast].lo))
     {
+      if (OVER_BUDGET(state))
+	return seidel_fail(state, SEIDEL_ERR_BUDGET);
+
       if (side == S_LEFT)
 	cond = ((((tnext = state->tr[t].d0) > 0) && (state->tr[tnext].rseg == segnum)) ||
 		(((tnext = state->tr[t].d1) > 0) && (state->tr[tnext].rseg == segnum)));
@@ -414,7 +513,7 @@ static int add_segment(SeidelTriangulator* state, int segnum)
   segment_t s;
   segment_t *so = &state->seg[segnum];
   int tu, tl, sk, tfirst, tlast, tnext;
-  int tfirstr, tlastr, tfirstl, tlastl;
+  int tfirstr = 0, tlastr = 0, tfirstl, tlastl;
   int i1, i2, t, t1, t2, tn;
   point_t tpt;
   int tritop = 0, tribot = 0, is_swapped = 0;
@@ -553,6 +652,9 @@ static int add_segment(SeidelTriangulator* state, int segnum)
   /* First, split all the trapezoids which are intersected by s into */
   /* two */
 
+  if (state->error)
+    return state->error;
+
   t = tfirst;			/* topmost trapezoid */
   
   while ((t > 0) && 
@@ -560,6 +662,11 @@ static int add_segment(SeidelTriangulator* state, int segnum)
 				/* traverse from top to bot */
     {
       int t_sav, tn_sav;
+
+      if (OVER_BUDGET(state))
+	return seidel_fail(state, SEIDEL_ERR_BUDGET);
+      if (state->error)
+	return state->error;
       sk = state->tr[t].sink;
       i1 = newnode(state);		/* left trapezoid sink */
       i2 = newnode(state);		/* right trapezoid sink */
@@ -593,8 +700,7 @@ static int add_segment(SeidelTriangulator* state, int segnum)
 
       if ((state->tr[t].d0 <= 0) && (state->tr[t].d1 <= 0)) /* case cannot arise */
 	{
-	  fprintf(stderr, "add_segment: error\n");
-	  break;
+	  return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
 	}
       
       /* only one trapezoid below. partition t into two and make the */
@@ -775,14 +881,12 @@ static int add_segment(SeidelTriangulator* state, int segnum)
 	  if (FP_EQUAL(state->tr[t].lo.y, state->tr[tlast].lo.y) &&
 	      FP_EQUAL(state->tr[t].lo.x, state->tr[tlast].lo.x) && tribot)
 	    {		/* bottom forms a triangle */
-	      int tmpseg;
-
 	      if (is_swapped)	
 		tmptriseg = state->seg[segnum].prev;
 	      else
 		tmptriseg = state->seg[segnum].next;
 
-	      if ((tmpseg > 0) && is_left_of(state, tmpseg, &s.v0))
+	      if ((tmptriseg > 0) && is_left_of(state, tmptriseg, &s.v0))
 		{
 		  /* L-R downward cusp */
 		  state->tr[state->tr[t].d1].u0 = t;
@@ -971,13 +1075,16 @@ static int add_segment(SeidelTriangulator* state, int segnum)
   /* works only because all these new trapezoids have been formed */
   /* due to splitting by the segment, and hence have only one parent */
 
+  if ((tfirstr <= 0) || (tlastr <= 0)) /* s was not threaded through */
+    return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
+
   tfirstl = tfirst; 
   tlastl = tlast;
   merge_trapezoids(state, segnum, tfirstl, tlastl, S_LEFT);
   merge_trapezoids(state, segnum, tfirstr, tlastr, S_RIGHT);
 
   state->seg[segnum].is_inserted = TRUE;
-  return 0;
+  return state->error;
 }
 
 
@@ -997,15 +1104,18 @@ static int find_new_roots(SeidelTriangulator* state, int segnum)
 
   s->root1 = locate_endpoint(state, &s->v1, &s->v0, s->root1);
   s->root1 = state->tr[s->root1].sink;
-  return 0;
+  return state->error;
 }
 
 
-/* Main routine to perform trapezoidation */
+/* Main routine to perform trapezoidation. Returns 0 or the first */
+/* error met */
 int construct_trapezoids(SeidelTriangulator* state, int nseg)
 {
   register int i;
-  int root, h;
+  int root, h, nphases;
+  int bound[MAX_PHASES + 1];	/* segments inserted by the end of */
+				/* each phase, N(n, h) */
   
   /* Add the first segment and get the query structure and trapezoid */
   /* list initialised */
@@ -1014,21 +1124,169 @@ int construct_trapezoids(SeidelTriangulator* state, int nseg)
 
   for (i = 1; i <= nseg; i++)
     state->seg[i].root0 = state->seg[i].root1 = root;
+
+  nphases = (state->schedule & SEIDEL_SCHEDULE_NO_PHASES) ? 0 : math_logstar_n(nseg);
+  for (h = 0; h <= nphases; h++)
+    bound[h] = math_N(nseg, h);
   
-  for (h = 1; h <= math_logstar_n(nseg); h++)
+  for (h = 1; h <= nphases; h++)
     {
-      for (i = math_N(nseg, h -1) + 1; i <= math_N(nseg, h); i++)
-	add_segment(state, choose_segment(state));
+      for (i = bound[h - 1] + 1; i <= bound[h]; i++)
+	if (add_segment(state, choose_segment(state)))
+	  return state->error;
       
-      /* Find a new root for each of the segment endpoints */
-      for (i = 1; i <= nseg; i++)
-	find_new_roots(state, i);
+      /* Find a new root for each of the segment endpoints still */
+      /* to come, the rest of the permutation */
+      for (i = state->choose_idx; i <= nseg; i++)
+	if (find_new_roots(state, state->permute[i]))
+	  return state->error;
     }
   
-  for (i = math_N(nseg, math_logstar_n(nseg)) + 1; i <= nseg; i++)
-    add_segment(state, choose_segment(state));
+  for (i = bound[nphases] + 1; i <= nseg; i++)
+    if (add_segment(state, choose_segment(state)))
+      return state->error;
 
   return 0;
 }
 
 
+/* Renumber the tables of a finished trapezoidation for locality. The
+ * trapezoids merge_trapezoids() invalidated are dropped and the rest
+ * numbered breadth first from the topmost one, lower neighbours
+ * before upper ones, which is close to the order of a sweep from the
+ * top down. The query nodes still reachable are numbered depth first
+ * from the root, which stays node 1, so a walk from the root to a
+ * sink mostly moves forward through the table.
+ */
+int compact_tables(SeidelTriangulator* state)
+{
+  int ntr = state->tr_idx, nq = state->q_idx;
+  trap_t *tr = (trap_t *) malloc(sizeof(trap_t) * ntr);
+  node_t *qs = (node_t *) malloc(sizeof(node_t) * nq);
+  int *trmap = (int *) calloc(ntr, sizeof(int));
+  int *qmap = (int *) calloc(nq, sizeof(int));
+  int *order = (int *) malloc(sizeof(int) * (ntr + 1));
+  int *qorder = (int *) malloc(sizeof(int) * (nq + 1));
+  int *stack = (int *) malloc(sizeof(int) * nq);
+  int i, k, s, t, r, nt, nn, head, sp, top = 0;
+
+  if (!tr || !qs || !trmap || !qmap || !order || !qorder || !stack)
+    {
+      free(tr);
+      free(qs);
+      free(trmap);
+      free(qmap);
+      free(order);
+      free(qorder);
+      free(stack);
+      return seidel_fail(state, SEIDEL_ERR_NOMEM);
+    }
+  memcpy(tr, state->tr, sizeof(trap_t) * ntr);
+  memcpy(qs, state->qs, sizeof(node_t) * nq);
+
+  /* Trapezoids, breadth first. Any the links do not reach follow */
+  for (i = 1; i < ntr; i++)
+    if ((tr[i].state == ST_VALID) && (!top || (tr[i].hi.y > tr[top].hi.y)))
+      top = i;
+  head = nt = 0;
+  for (s = 0; s < ntr; s++)
+    {
+      t = s ? s : top;
+      if ((t <= 0) || trmap[t] || (tr[t].state != ST_VALID))
+	continue;
+      trmap[t] = ++nt;
+      order[nt] = t;
+      while (head < nt)
+	{
+	  int nb[4];
+
+	  t = order[++head];
+	  nb[0] = tr[t].d0;
+	  nb[1] = tr[t].d1;
+	  nb[2] = tr[t].u0;
+	  nb[3] = tr[t].u1;
+	  for (k = 0; k < 4; k++)
+	    if ((nb[k] > 0) && (nb[k] < ntr) && !trmap[nb[k]] &&
+		(tr[nb[k]].state == ST_VALID))
+	      {
+		trmap[nb[k]] = ++nt;
+		order[nt] = nb[k];
+	      }
+	}
+    }
+
+  /* Query nodes, depth first, left before right. A node is */
+  /* numbered when popped and pushed only once (marked -1) */
+  nn = sp = 0;
+  if (nq > 1)
+    {
+      stack[sp++] = 1;
+      qmap[1] = -1;
+    }
+  while (sp > 0)
+    {
+      r = stack[--sp];
+      qmap[r] = ++nn;
+      qorder[nn] = r;
+      if ((qs[r].nodetype == T_X) || (qs[r].nodetype == T_Y))
+	{
+	  if ((qs[r].right > 0) && (qs[r].right < nq) && !qmap[qs[r].right])
+	    {
+	      qmap[qs[r].right] = -1;
+	      stack[sp++] = qs[r].right;
+	    }
+	  if ((qs[r].left > 0) && (qs[r].left < nq) && !qmap[qs[r].left])
+	    {
+	      qmap[qs[r].left] = -1;
+	      stack[sp++] = qs[r].left;
+	    }
+	}
+    }
+
+#define TRMAP(x) ((((x) > 0) && ((x) < ntr)) ? trmap[x] : (x))
+#define QMAP(x) ((((x) > 0) && ((x) < nq) && (qmap[x] > 0)) ? qmap[x] : 0)
+
+  for (i = 1; i <= nt; i++)
+    {
+      trap_t *p = &state->tr[i];
+
+      *p = tr[order[i]];
+      p->u0 = TRMAP(p->u0);
+      p->u1 = TRMAP(p->u1);
+      p->d0 = TRMAP(p->d0);
+      p->d1 = TRMAP(p->d1);
+      p->usave = TRMAP(p->usave);
+      p->sink = QMAP(p->sink);
+    }
+  memset((void *)&state->tr[nt + 1], 0, sizeof(trap_t) * (ntr - nt - 1));
+  state->tr_idx = nt + 1;
+
+  for (i = 1; i <= nn; i++)
+    {
+      node_t *p = &state->qs[i];
+
+      *p = qs[qorder[i]];
+      p->parent = QMAP(p->parent);
+      if (p->nodetype == T_SINK)
+	p->trnum = TRMAP(p->trnum);
+      else
+	{
+	  p->left = QMAP(p->left);
+	  p->right = QMAP(p->right);
+	}
+    }
+  memset((void *)&state->qs[nn + 1], 0, sizeof(node_t) * (nq - nn - 1));
+  state->q_idx = nn + 1;
+
+#undef TRMAP
+#undef QMAP
+
+  free(tr);
+  free(qs);
+  free(trmap);
+  free(qmap);
+  free(order);
+  free(qorder);
+  free(stack);
+  return 0;
+}
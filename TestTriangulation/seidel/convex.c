@@ -0,0 +1,155 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <stdint.h>
+
+
+/* Convex decomposition after Hertel and Mehlhorn: start from the
+ * triangles and drop every diagonal whose two ends stay convex without
+ * it. Each diagonal is looked at once, against the pieces as merged so
+ * far, so the pass is linear, and no piece is left with a diagonal that
+ * could go. That makes at most four times as many pieces as the fewest
+ * possible.
+ *
+ * The triangles become half-edges, three to a triangle, linked around
+ * each piece anticlockwise. A diagonal is a half-edge whose twin, the
+ * same edge the other way round, is found through a hash of the pair
+ * of vertices; dropping it splices the two rings into one.
+ */
+
+#define CONVEX_NONE (-1)
+
+typedef struct {
+  int from, to;			/* vertices */
+  int next, prev;		/* around the piece */
+  int twin;			/* CONVEX_NONE on the boundary */
+  int chain;			/* next in the hash bucket */
+} halfedge_t;
+
+
+static uint32_t edge_bucket(int a, int b, uint32_t mask)
+{
+  uint64_t h = (uint64_t) a * 0x9e3779b97f4a7c15ULL ^ (uint64_t) b * 0xc2b2ae3d27d4eb4fULL;
+
+  return (uint32_t) (h ^ (h >> 29)) & mask;
+}
+
+
+/* Twice the signed area of (a, b, c), positive if anticlockwise */
+static double cross3(double (*v)[2], int a, int b, int c)
+{
+  return (v[b][0] - v[a][0]) * (v[c][1] - v[a][1]) -
+    (v[b][1] - v[a][1]) * (v[c][0] - v[a][0]);
+}
+
+
+/* Would the corner at the start of half-edge h, coming in along */
+/* h_in and leaving along h_out, be convex? Straight counts as convex */
+static int convex_corner(double (*v)[2], halfedge_t *he, int h_in, int h_out)
+{
+  return cross3(v, he[h_in].from, he[h_in].to, he[h_out].to) >= 0;
+}
+
+
+/* Merge the ntri triangles over vertices[] into convex polygons,
+ * packed as seidel_monotone_polygons() packs the monotone ones: polygon
+ * i has the vertices index[first[i]] to index[first[i + 1] - 1],
+ * anticlockwise. first[] must have room for ntri + 1 entries and
+ * index[] for 3 * ntri. The triangles may run either way and share
+ * edges only with their neighbours across the polygon, as
+ * triangulate_polygon() gives them. Returns the number of polygons or
+ * one of the negative SEIDEL_ERR_* codes.
+ */
+int convex_partition(double (*vertices)[2], int ntri, int (*triangles)[3], int *first, int *index)
+{
+  halfedge_t *he;
+  int *head;
+  unsigned char *done;
+  uint32_t mask = 1, b;
+  int nhe = 3 * ntri, i, j, h, t, k, npoly = 0;
+
+  if (ntri < 0)
+    return SEIDEL_ERR_INPUT;
+  while (mask < (uint32_t) nhe)
+    mask <<= 1;
+  mask--;
+
+  he = (halfedge_t *) malloc(sizeof(halfedge_t) * (nhe + 1));
+  head = (int *) malloc(sizeof(int) * (mask + 1));
+  done = (unsigned char *) calloc(nhe + 1, 1);
+  if (!he || !head || !done)
+    {
+      free(he);
+      free(head);
+      free(done);
+      return SEIDEL_ERR_NOMEM;
+    }
+  for (b = 0; b <= mask; b++)
+    head[b] = CONVEX_NONE;
+
+  /* three half-edges per triangle, anticlockwise, each hashed and */
+  /* paired with its twin if that came before */
+  for (i = 0; i < ntri; i++)
+    {
+      int *tv = triangles[i], ccw = (cross3(vertices, tv[0], tv[1], tv[2]) >= 0);
+
+      for (j = 0; j < 3; j++)
+	{
+	  h = 3 * i + j;
+	  he[h].from = tv[ccw ? j : 2 - j];
+	  he[h].to = tv[ccw ? (j + 1) % 3 : (4 - j) % 3];
+	  he[h].next = 3 * i + (j + 1) % 3;
+	  he[h].prev = 3 * i + (j + 2) % 3;
+	  he[h].twin = CONVEX_NONE;
+
+	  for (t = head[edge_bucket(he[h].to, he[h].from, mask)]; t != CONVEX_NONE; t = he[t].chain)
+	    if ((he[t].from == he[h].to) && (he[t].to == he[h].from) && (he[t].twin == CONVEX_NONE))
+	      {
+		he[t].twin = h;
+		he[h].twin = t;
+		break;
+	      }
+	  b = edge_bucket(he[h].from, he[h].to, mask);
+	  he[h].chain = head[b];
+	  head[b] = h;
+	}
+    }
+
+  /* drop the diagonals that leave both their ends convex */
+  for (h = 0; h < nhe; h++)
+    {
+      t = he[h].twin;
+      if ((t == CONVEX_NONE) || (t < h))
+	continue;
+      if (convex_corner(vertices, he, he[h].prev, he[t].next) &&
+	  convex_corner(vertices, he, he[t].prev, he[h].next))
+	{
+	  he[he[h].prev].next = he[t].next;
+	  he[he[t].next].prev = he[h].prev;
+	  he[he[t].prev].next = he[h].next;
+	  he[he[h].next].prev = he[t].prev;
+	  done[h] = done[t] = TRUE;	/* no longer on any ring */
+	}
+    }
+
+  /* each ring left is a piece */
+  for (k = 0, h = 0; h < nhe; h++)
+    {
+      if (done[h])
+	continue;
+      first[npoly++] = k;
+      t = h;
+      do
+	{
+	  index[k++] = he[t].from;
+	  done[t] = TRUE;
+	  t = he[t].next;
+	}
+      while (t != h);
+    }
+  first[npoly] = k;
+
+  free(he);
+  free(head);
+  free(done);
+  return npoly;
+}
@@ -0,0 +1,211 @@
+#include "triangulate.h"
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX
+#define VLANES 4
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#define VLANES 2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON
+#define VLANES 2
+#else
+#define VLANES 1
+#endif
+
+
+/* Crossing-number tests for points that have not been triangulated.
+ * Edge (x0, y0)-(x1, y1) is crossed by the ray going from (x, y)
+ * towards +x iff (y0 > y) != (y1 > y) and (x, y) is left of the edge,
+ * i.e. x < x0 + (x1 - x0) * (y - y0) / (y1 - y0). The second test is
+ * done without the division, by comparing the two products
+ *
+ *	(x - x0) * (y1 - y0)  and  (x1 - x0) * (y - y0)
+ *
+ * the right way round for an upward or a downward edge. The vector
+ * kernels below evaluate exactly the same products, so they give the
+ * same answers as the scalar loop. Coordinates are given in SoA
+ * layout: one array of x and one of y.
+ */
+
+#define EDGE_CROSSES(x, y, x0, y0, x1, y1)				\
+  ((((y0) > (y)) != ((y1) > (y))) &&					\
+   (((y1) > (y0)) ?							\
+    (((x) - (x0)) * ((y1) - (y0)) < ((x1) - (x0)) * ((y) - (y0))) :	\
+    (((x1) - (x0)) * ((y) - (y0)) < ((x) - (x0)) * ((y1) - (y0)))))
+
+
+/* Scalar version. Returns TRUE if (x, y) is inside the polygon of
+ * nvert vertices (vx[i], vy[i]), closed from the last to the first.
+ */
+int point_in_polygon(double x, double y, int nvert, const double *vx, const double *vy)
+{
+  register int i, j;
+  int inside = FALSE;
+
+  for (i = 0, j = nvert - 1; i < nvert; j = i++)
+    if (EDGE_CROSSES(x, y, vx[j], vy[j], vx[i], vy[i]))
+      inside = !inside;
+
+  return inside;
+}
+
+
+#if defined(SIMD_AVX)
+
+typedef __m256d vdouble;
+#define VSET1(a)	_mm256_set1_pd(a)
+#define VLOAD(p)	_mm256_loadu_pd(p)
+#define VSUB(a, b)	_mm256_sub_pd(a, b)
+#define VMUL(a, b)	_mm256_mul_pd(a, b)
+#define VOR(a, b)	_mm256_or_pd(a, b)
+#define VANDNOT(a, b)	_mm256_andnot_pd(a, b)
+#define VGT(a, b)	_mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define VLT(a, b)	_mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define VAND(a, b)	_mm256_and_pd(a, b)
+#define VXOR(a, b)	_mm256_xor_pd(a, b)
+#define VZERO()		_mm256_setzero_pd()
+#define VMASK(a)	_mm256_movemask_pd(a)
+
+#elif defined(SIMD_SSE2)
+
+typedef __m128d vdouble;
+#define VSET1(a)	_mm_set1_pd(a)
+#define VLOAD(p)	_mm_loadu_pd(p)
+#define VSUB(a, b)	_mm_sub_pd(a, b)
+#define VMUL(a, b)	_mm_mul_pd(a, b)
+#define VOR(a, b)	_mm_or_pd(a, b)
+#define VANDNOT(a, b)	_mm_andnot_pd(a, b)
+#define VGT(a, b)	_mm_cmpgt_pd(a, b)
+#define VLT(a, b)	_mm_cmplt_pd(a, b)
+#define VAND(a, b)	_mm_and_pd(a, b)
+#define VXOR(a, b)	_mm_xor_pd(a, b)
+#define VZERO()		_mm_setzero_pd()
+#define VMASK(a)	_mm_movemask_pd(a)
+
+#elif defined(SIMD_NEON)
+
+typedef float64x2_t vdouble;
+#define VSET1(a)	vdupq_n_f64(a)
+#define VLOAD(p)	vld1q_f64(p)
+#define VSUB(a, b)	vsubq_f64(a, b)
+#define VMUL(a, b)	vmulq_f64(a, b)
+#define VGT(a, b)	vreinterpretq_f64_u64(vcgtq_f64(a, b))
+#define VLT(a, b)	vreinterpretq_f64_u64(vcltq_f64(a, b))
+#define VAND(a, b)	vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(a), \
+							vreinterpretq_u64_f64(b)))
+#define VXOR(a, b)	vreinterpretq_f64_u64(veorq_u64(vreinterpretq_u64_f64(a), \
+							vreinterpretq_u64_f64(b)))
+#define VOR(a, b)	vreinterpretq_f64_u64(vorrq_u64(vreinterpretq_u64_f64(a), \
+							vreinterpretq_u64_f64(b)))
+#define VANDNOT(a, b)	vreinterpretq_f64_u64(vbicq_u64(vreinterpretq_u64_f64(b), \
+							vreinterpretq_u64_f64(a)))
+#define VZERO()		vdupq_n_f64(0.0)
+#define VMASK(a)	((int) (vgetq_lane_u64(vreinterpretq_u64_f64(a), 0) & 1) | \
+			 (int) ((vgetq_lane_u64(vreinterpretq_u64_f64(a), 1) & 1) << 1))
+
+#endif
+
+
+#if VLANES > 1
+
+/* All-ones lanes where edge (x0, y0)-(x1, y1) is crossed. dx and dy */
+/* are x1 - x0 and y1 - y0, up is all-ones where dy > 0 */
+#define VEDGE_CROSSES(x, y, x0, y0, y1, dx, dy, up)			\
+  VAND(VXOR(VGT(y0, y), VGT(y1, y)),					\
+       VOR(VAND(up, VLT(VMUL(VSUB(x, x0), dy), VMUL(dx, VSUB(y, y0)))),	\
+	   VANDNOT(up, VLT(VMUL(dx, VSUB(y, y0)), VMUL(VSUB(x, x0), dy)))))
+
+#endif
+
+
+/* Many points against one polygon. inside[k] is set to TRUE or FALSE
+ * for each of the npoints points (px[k], py[k]). The points are taken
+ * two vectors at a time; each edge is broadcast once and its crossings
+ * toggle a parity mask per lane. Returns the number of points inside.
+ */
+int points_in_polygon(int npoints, const double *px, const double *py,
+		      int nvert, const double *vx, const double *vy,
+		      unsigned char *inside)
+{
+  register int i, j, k;
+  int count = 0;
+
+  k = 0;
+#if VLANES > 1
+  for (; k + 2 * VLANES <= npoints; k += 2 * VLANES)
+    {
+      vdouble xa = VLOAD(px + k), ya = VLOAD(py + k);
+      vdouble xb = VLOAD(px + k + VLANES), yb = VLOAD(py + k + VLANES);
+      vdouble pa = VZERO(), pb = VZERO();
+      int mask, l;
+
+      for (i = 0, j = nvert - 1; i < nvert; j = i++)
+	{
+	  vdouble x0 = VSET1(vx[j]), y0 = VSET1(vy[j]), y1 = VSET1(vy[i]);
+	  vdouble dx = VSET1(vx[i] - vx[j]), dy = VSET1(vy[i] - vy[j]);
+	  vdouble up = VGT(y1, y0);
+
+	  pa = VXOR(pa, VEDGE_CROSSES(xa, ya, x0, y0, y1, dx, dy, up));
+	  pb = VXOR(pb, VEDGE_CROSSES(xb, yb, x0, y0, y1, dx, dy, up));
+	}
+
+      mask = VMASK(pa) | (VMASK(pb) << VLANES);
+      for (l = 0; l < 2 * VLANES; l++)
+	{
+	  inside[k + l] = (mask >> l) & 1;
+	  count += inside[k + l];
+	}
+    }
+#endif
+
+  for (; k < npoints; k++)
+    {
+      inside[k] = point_in_polygon(px[k], py[k], nvert, vx, vy);
+      count += inside[k];
+    }
+
+  return count;
+}
+
+
+/* One point against many edges, given as four SoA arrays of the edge
+ * endpoints. The edges need not form a single closed contour: pass
+ * all edges of a polygon with holes, or only those of one cell of a
+ * spatial index. Returns the number of edges the ray crosses; the
+ * point is inside the polygon iff the number is odd.
+ */
+int point_edge_crossings(double x, double y, int nedges,
+			 const double *x0, const double *y0,
+			 const double *x1, const double *y1)
+{
+  register int i = 0;
+  int count = 0;
+
+#if VLANES > 1
+  vdouble vx = VSET1(x), vy = VSET1(y);
+
+  for (; i + VLANES <= nedges; i += VLANES)
+    {
+      vdouble ex0 = VLOAD(x0 + i), ey0 = VLOAD(y0 + i), ey1 = VLOAD(y1 + i);
+      vdouble dx = VSUB(VLOAD(x1 + i), ex0), dy = VSUB(ey1, ey0);
+      int mask = VMASK(VEDGE_CROSSES(vx, vy, ex0, ey0, ey1, dx, dy,
+				     VGT(ey1, ey0)));
+      while (mask)
+	{
+	  count += mask & 1;
+	  mask >>= 1;
+	}
+    }
+#endif
+
+  for (; i < nedges; i++)
+    if (EDGE_CROSSES(x, y, x0[i], y0[i], x1[i], y1[i]))
+      count++;
+
+  return count;
+}
@@ -1,5 +1,7 @@
 #include "triangulate.h"
 #include <sys/time.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
 
 #ifdef __STDC__
@@ -9,31 +11,179 @@ extern double log2();
 #endif
 
 
-/* Generate a random permutation of the segments 1..n */
+/* Record err as the error of the current run, unless an earlier */
+/* one is already pending. Returns the pending error */
+int seidel_fail(SeidelTriangulator* state, int err)
+{
+  if (!state->error)
+    state->error = err;
+  return state->error;
+}
+
+
+/* Generate a random permutation of the segments 1..n in permute[].
+ * A Fisher-Yates shuffle in place: step i swaps in one of the points
+ * i..n not yet placed, each as likely, with no scratch copy to
+ * malloc for every run. It draws one number fewer than the copying
+ * version did, so a given second seeds a different order than before.
+ */
 int generate_random_ordering(SeidelTriangulator* state, int n)
 {
   struct timeval tval;
   struct timezone tzone;
   register int i;
-  int m, *p;
-  int* st = (int*)malloc(sizeof(int) * state->segSize);
-  
+  int m, tmp, *p = state->permute;
+
+  state->choose_idx = 1;
+  gettimeofday(&tval, &tzone);
+  srand48(tval.tv_sec);
+
+  for (i = 1; i <= n; i++)
+    p[i] = i;
+
+  for (i = 1; i < n; i++)
+    {
+      m = i + lrand48() % (n + 1 - i);
+      tmp = p[i];
+      p[i] = p[m];
+      p[m] = tmp;
+    }
+  return 0;
+}
+
+
+/* Index of (x, y) along the Hilbert curve through the 2^16 x 2^16 grid */
+static uint32_t hilbert_index(uint32_t x, uint32_t y)
+{
+  uint32_t d = 0, s, rx, ry, t;
+
+  for (s = 1u << 15; s > 0; s >>= 1)
+    {
+      rx = (x & s) != 0;
+      ry = (y & s) != 0;
+      d += s * s * ((3 * rx) ^ ry);
+      if (!ry)			/* rotate the quadrant */
+	{
+	  if (rx)
+	    {
+	      x = 0xffff - x;
+	      y = 0xffff - y;
+	    }
+	  t = x;
+	  x = y;
+	  y = t;
+	}
+    }
+  return d;
+}
+
+static int cmp_key(const void *a, const void *b)
+{
+  uint64_t ka = *(const uint64_t *) a, kb = *(const uint64_t *) b;
+
+  return (ka > kb) - (ka < kb);
+}
+
+/* Fill key[1..n] with the segments 1..n sorted by the Hilbert index */
+/* of their midpoints, the index in the high half of each key and */
+/* the segment in the low half */
+static void sort_along_hilbert(SeidelTriangulator* state, int n, uint64_t *key)
+{
+  double xmin, xmax, ymin, ymax, sx, sy, x, y;
+  register int i;
+
+  xmin = xmax = state->seg[1].v0.x;
+  ymin = ymax = state->seg[1].v0.y;
+  for (i = 2; i <= n; i++)
+    {
+      xmin = MIN(xmin, state->seg[i].v0.x);
+      xmax = MAX(xmax, state->seg[i].v0.x);
+      ymin = MIN(ymin, state->seg[i].v0.y);
+      ymax = MAX(ymax, state->seg[i].v0.y);
+    }
+  sx = (xmax > xmin) ? 65535.0 / (xmax - xmin) : 0;
+  sy = (ymax > ymin) ? 65535.0 / (ymax - ymin) : 0;
+
+  for (i = 1; i <= n; i++)
+    {
+      x = 0.5 * (state->seg[i].v0.x + state->seg[i].v1.x) - xmin;
+      y = 0.5 * (state->seg[i].v0.y + state->seg[i].v1.y) - ymin;
+      key[i] = ((uint64_t) hilbert_index((uint32_t) (x * sx), (uint32_t) (y * sy)) << 32) |
+	(uint32_t) i;
+    }
+  qsort(key + 1, n, sizeof(uint64_t), cmp_key);
+}
+
+/* Order the segments 1..n by the Hilbert index of their midpoints, */
+/* so that each one goes in next to the last */
+int generate_hilbert_ordering(SeidelTriangulator* state, int n)
+{
+  uint64_t *key = (uint64_t *) malloc(sizeof(uint64_t) * (n + 1));
+  register int i;
+
+  if (key == NULL)
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->choose_idx = 1;
+
+  sort_along_hilbert(state, n, key);
+  for (i = 1; i <= n; i++)
+    state->permute[i] = (int) (key[i] & 0xffffffff);
+
+  free(key);
+  return 0;
+}
+
+/* Biased randomized insertion order. Each segment joins the last of
+ * about log2(n) rounds with probability 1/2, the one before with 1/4
+ * and so on, and the rounds go in one after the other, each along the
+ * Hilbert curve. Which segments make up a round is as random as in a
+ * uniform permutation, which is what the expected bounds rest on,
+ * while within a round consecutive segments lie close together, and
+ * so do the trapezoids and query nodes they create.
+ */
+int generate_brio_ordering(SeidelTriangulator* state, int n)
+{
+  struct timeval tval;
+  struct timezone tzone;
+  uint64_t *key = (uint64_t *) malloc(sizeof(uint64_t) * (n + 1));
+  int *round = (int *) malloc(sizeof(int) * (n + 1));
+  int count[BRIO_MAX_ROUNDS + 1];
+  register int i;
+  int r, nrounds;
+
+  if ((key == NULL) || (round == NULL))
+    {
+      free(key);
+      free(round);
+      return seidel_fail(state, SEIDEL_ERR_NOMEM);
+    }
   state->choose_idx = 1;
   gettimeofday(&tval, &tzone);
   srand48(tval.tv_sec);
 
-  for (i = 0; i <= n; i++)
-    st[i] = i;
+  for (nrounds = 1; (nrounds < BRIO_MAX_ROUNDS) && ((1L << nrounds) < n); nrounds++)
+    ;
+  memset(count, 0, sizeof(count));
+  for (i = 1; i <= n; i++)
+    {
+      for (r = nrounds - 1; (r > 0) && (lrand48() & 1); r--)
+	;
+      round[i] = r;
+      count[r + 1]++;
+    }
+  for (r = 1; r <= nrounds; r++)	/* first slot of each round */
+    count[r] += count[r - 1];
 
-  p = st;
-  for (i = 1; i <= n; i++, p++)
+  sort_along_hilbert(state, n, key);
+  for (i = 1; i <= n; i++)
     {
-      m = lrand48() % (n + 1 - i) + 1;
-      state->permute[i] = p[m];
-      if (m != 1)
-	p[m] = p[1];
+      int segnum = (int) (key[i] & 0xffffffff);
+
+      state->permute[1 + count[round[segnum]]++] = segnum;
     }
-  free(st);
+
+  free(key);
+  free(round);
   return 0;
 }
 
@@ -53,15 +203,24 @@ int choose_segment(SeidelTriangulator* state)
 
 #ifdef STANDALONE
 
-/* Read in the list of vertices from infile */
-int read_segments(filename, genus)
+/* Read in the list of vertices from infile: the number of contours,
+ * then for every contour its number of points followed by the
+ * points. The outer-most contour comes first, anti-clockwise, the
+ * inner ones follow clockwise. The arrays are returned in the layout
+ * triangulate_polygon() takes, to be freed by the caller. Returns the
+ * total number of points or -1.
+ */
+int read_segments(filename, ncontours, cntr, vertices)
      char *filename;
-     int *genus;
+     int *ncontours;
+     int **cntr;
+     double (**vertices)[2];
 {
   FILE *infile;
   int ccount;
   register int i;
-  int ncontours, npoints, first, last;
+  int npoints, j, size = 64;
+  double (*v)[2];
 
   if ((infile = fopen(filename, "r")) == NULL)
     {
@@ -69,54 +228,45 @@ int read_segments(filename, genus)
       return -1;
     }
 
-  fscanf(infile, "%d", &ncontours);
-  if (ncontours <= 0)
-    return -1;
-  
-  /* For every contour, read in all the points for the contour. The */
-  /* outer-most contour is read in first (points specified in */
-  /* anti-clockwise order). Next, the inner contours are input in */
-  /* clockwise order */
+  if ((fscanf(infile, "%d", ncontours) != 1) || (*ncontours <= 0))
+    {
+      fclose(infile);
+      return -1;
+    }
 
-  ccount = 0;
+  *cntr = (int *) malloc(sizeof(int) * *ncontours);
+  v = (double (*)[2]) malloc(sizeof(double) * 2 * size);
   i = 1;
   
-  while (ccount < ncontours)
+  for (ccount = 0; ccount < *ncontours; ccount++)
     {
-      int j;
+      if ((fscanf(infile, "%d", &npoints) != 1) || (npoints < 3))
+	break;
+      (*cntr)[ccount] = npoints;
 
-      fscanf(infile, "%d", &npoints);
-      first = i;
-      last = first + npoints - 1;
       for (j = 0; j < npoints; j++, i++)
 	{
-	  fscanf(infile, "%lf%lf", &seg[i].v0.x, &seg[i].v0.y);
-	  if (i == last)
+	  if (i == size)
 	    {
-	      seg[i].next = first;
-	      seg[i].prev = i-1;
-	      seg[i-1].v1 = seg[i].v0;
+	      size *= 2;
+	      v = (double (*)[2]) realloc(v, sizeof(double) * 2 * size);
 	    }
-	  else if (i == first)
-	    {
-	      seg[i].next = i+1;
-	      seg[i].prev = last;
-	      seg[last].v1 = seg[i].v0;
-	    }
-	  else
-	    {
-	      seg[i].prev = i-1;
-	      seg[i].next = i+1;
-	      seg[i-1].v1 = seg[i].v0;
-	    }
-	  
-	  seg[i].is_inserted = FALSE;
+	  if (fscanf(infile, "%lf%lf", &v[i][0], &v[i][1]) != 2)
+	    break;
 	}
+      if (j < npoints)
+	break;
+    }
 
-      ccount++;
+  fclose(infile);
+  if (ccount < *ncontours)
+    {
+      free(*cntr);
+      free(v);
+      return -1;
     }
 
-  *genus = ncontours - 1;
+  *vertices = v;
   return i-1;
 }
 
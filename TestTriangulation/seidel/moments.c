@@ -0,0 +1,113 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+
+
+/* Area, centroid and second moments of the polygon from its trapezoids.
+ * Across a trapezoid the left and right edges L(y) and R(y) are linear
+ * in y, so every integral needed is of a polynomial in y of degree 3 at
+ * most,
+ *
+ *	dA = (R - L) dy		x dA = (R^2 - L^2) / 2 dy
+ *	x^2 dA = (R^3 - L^3) / 3 dy	x y dA = y (R^2 - L^2) / 2 dy
+ *
+ * and Simpson's rule over [y0, y1] gives each exactly. No triangle is
+ * made and nothing is written but the totals. Coordinates are taken
+ * relative to the first point, so that a polygon far from the origin
+ * does not lose the moments to cancellation.
+ */
+
+typedef struct {
+  double a, x, y, xx, yy, xy;
+} integrand_t;
+
+/* x of segment s at height y */
+static double edge_x(segment_t *s, double y)
+{
+  if (s->v1.y == s->v0.y)
+    return s->v0.x;
+  return s->v0.x + (y - s->v0.y) * (s->v1.x - s->v0.x) / (s->v1.y - s->v0.y);
+}
+
+/* The integrands at height y, for edges at xl and xr, all relative */
+/* to the first point */
+static void integrands(double y, double xl, double xr, integrand_t *f)
+{
+  double w = xr - xl, s = xr * xr - xl * xl;
+
+  f->a = w;
+  f->x = 0.5 * s;
+  f->y = y * w;
+  f->xx = (xr * xr * xr - xl * xl * xl) / 3;
+  f->yy = y * y * w;
+  f->xy = 0.5 * y * s;
+}
+
+
+/* Fill in the moments of the polygon last given to
+ * trapezoidate_polygon() or triangulate_polygon(): its area, its
+ * centroid and the second moments about the centroid,
+ *
+ *	sxx = integral of (x - cx)^2,  syy = of (y - cy)^2,
+ *	sxy = of (x - cx)(y - cy)
+ *
+ * over the polygon. Returns 0 or the error of the last run.
+ */
+int seidel_polygon_moments(SeidelTriangulator* state, SeidelMoments *m)
+{
+  integrand_t f0, fm, f1, sum;
+  double ox, oy, y0, y1, ym, h;
+  segment_t *l, *r;
+  trap_t *t;
+  int i;
+
+  if (state->error)
+    return state->error;
+  memset(&sum, 0, sizeof(sum));
+  ox = state->seg[1].v0.x;
+  oy = state->seg[1].v0.y;
+
+  for (i = 1; i < state->tr_idx; i++)
+    {
+      t = &state->tr[i];
+      if ((t->state == ST_INVALID) || (t->lseg <= 0) || (t->rseg <= 0) ||
+	  !(t->hi.y > t->lo.y) ||
+	  !_greater_than(&state->seg[t->rseg].v1, &state->seg[t->rseg].v0))
+	continue;
+
+      l = &state->seg[t->lseg];
+      r = &state->seg[t->rseg];
+      y0 = t->lo.y;
+      y1 = t->hi.y;
+      ym = 0.5 * (y0 + y1);
+      integrands(y0 - oy, edge_x(l, y0) - ox, edge_x(r, y0) - ox, &f0);
+      integrands(ym - oy, edge_x(l, ym) - ox, edge_x(r, ym) - ox, &fm);
+      integrands(y1 - oy, edge_x(l, y1) - ox, edge_x(r, y1) - ox, &f1);
+
+      h = (y1 - y0) / 6;
+      sum.a += h * (f0.a + 4 * fm.a + f1.a);
+      sum.x += h * (f0.x + 4 * fm.x + f1.x);
+      sum.y += h * (f0.y + 4 * fm.y + f1.y);
+      sum.xx += h * (f0.xx + 4 * fm.xx + f1.xx);
+      sum.yy += h * (f0.yy + 4 * fm.yy + f1.yy);
+      sum.xy += h * (f0.xy + 4 * fm.xy + f1.xy);
+    }
+
+  m->area = sum.a;
+  if (!(sum.a > 0))
+    {
+      m->cx = ox;
+      m->cy = oy;
+      m->sxx = m->syy = m->sxy = 0;
+      return 0;
+    }
+  /* to the centroid, by the parallel axis theorem */
+  m->cx = sum.x / sum.a;
+  m->cy = sum.y / sum.a;
+  m->sxx = sum.xx - sum.a * m->cx * m->cx;
+  m->syy = sum.yy - sum.a * m->cy * m->cy;
+  m->sxy = sum.xy - sum.a * m->cx * m->cy;
+  m->cx += ox;
+  m->cy += oy;
+  return 0;
+}
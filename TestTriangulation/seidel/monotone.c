@@ -1,12 +1,15 @@
 #include "triangulate.h"
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
 
 #define CROSS_SINE(v0, v1) ((v0).x * (v1).y - (v1).x * (v0).y)
 #define LENGTH(v0) (sqrt((v0).x * (v0).x + (v0).y * (v0).y))
 
 
-static int triangulate_single_polygon(SeidelTriangulator*, int, int, int, int (*)[3]);
+#define TRAVERSE_STACK 256	/* first size of state->visits */
+
+static int triangulate_single_polygon(SeidelTriangulator*, int, int, int, int, int (*)[3], int*);
 static int traverse_polygon(SeidelTriangulator*, int, int, int, int);
 
 /* Function returns TRUE if the trapezoid lies inside the polygon */
@@ -35,10 +38,11 @@ static int newmon(SeidelTriangulator* state)
 }
 
 
-/* return a new chain element from the table */
+/* return a new chain element from the table, unmarked */
 static int new_chain_element(SeidelTriangulator* state)
 {
-  return ++state->chain_idx;
+  state->mchain[++state->chain_idx].marked = FALSE;
+  return state->chain_idx;
 }
 
 
@@ -121,10 +125,28 @@ static int get_vertex_positions(SeidelTriangulator* state, int v0, int v1, int*
 static int make_new_monotone_poly(SeidelTriangulator* state, int mcur, int v0, int v1)
 {
   int p, q, ip, iq;
-  int mnew = newmon(state);
+  int mnew;
   int i, j, nf0, nf1;
   vertexchain_t *vp0, *vp1;
-  
+
+  /* a bad trapezoidation shows up here as diagonals to nowhere or */
+  /* as more splits than the tables have room for */
+  if (state->error)
+    return mcur;
+  if ((v0 <= 0) || (v0 >= state->segSize) || (v1 <= 0) || (v1 >= state->segSize) ||
+      (state->vert[v0].nextfree > 3) || (state->vert[v1].nextfree > 3))
+    {
+      seidel_fail(state, SEIDEL_ERR_DEGENERATE);
+      return mcur;
+    }
+  if ((state->mon_idx + 1 >= state->segSize) ||
+      (state->chain_idx + 2 >= state->trSize))
+    {
+      seidel_fail(state, SEIDEL_ERR_CHAIN);
+      return mcur;
+    }
+
+  mnew = newmon(state);
   vp0 = &state->vert[v0];
   vp1 = &state->vert[v1];
 
@@ -177,7 +199,7 @@ static int make_new_monotone_poly(SeidelTriangulator* state, int mcur, int v0, i
 }
 
 /* Main routine to get monotone polygons from the trapezoidation of 
- * the polygon.
+ * the polygon. Returns their number, or a negative error code.
  */
 
 int monotonate_trapezoids(SeidelTriangulator* state, int n)
@@ -185,17 +207,21 @@ int monotonate_trapezoids(SeidelTriangulator* state, int n)
   register int i;
   int tr_start;
 
-  memset((void *)state->vert, 0, sizeof(state->vert[0]) * state->segSize);
-  memset((void *)state->visited, 0, sizeof(state->visited[0]) * state->trSize);
-  memset((void *)state->mchain, 0, sizeof(state->mchain[0]) * state->trSize);
-  memset((void *)state->mon, 0, sizeof(state->mon[0]) * state->segSize);
+  /* Clear what this polygon uses, not the whole tables: chain */
+  /* elements beyond the n of the boundary are cleared as they are */
+  /* made, and the mon entries as the polygons are */
+  memset((void *)state->vert, 0, sizeof(state->vert[0]) * (n + 1));
+  memset((void *)state->visited, 0, sizeof(state->visited[0]) * state->tr_idx);
+  memset((void *)state->mchain, 0, sizeof(state->mchain[0]) * (n + 1));
   
   /* First locate a trapezoid which lies inside the polygon */
   /* and which is triangular */
-  for (i = 0; i < state->trSize; i++)
+  for (i = 0; i < state->tr_idx; i++)
     if (inside_polygon(state, &state->tr[i]))
       break;
   tr_start = i;
+  if (tr_start == state->tr_idx)
+    return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
   
   /* Initialise the mon data-structure and start spanning all the */
   /* trapezoids within the polygon */
@@ -235,8 +261,10 @@ int monotonate_trapezoids(SeidelTriangulator* state, int n)
 
   state->chain_idx = n;
   state->mon_idx = 0;
-  state->mon[0] = 1;			/* position of any vertex in the first */
-				/* chain  */
+  state->mon[0] = state->tr[tr_start].rseg; /* position of any vertex */
+				/* on the boundary the traversal */
+				/* starts from. With one outer */
+				/* contour vertex 1 would do */
 
 #endif
   
@@ -245,25 +273,61 @@ int monotonate_trapezoids(SeidelTriangulator* state, int n)
     traverse_polygon(state, 0, tr_start, state->tr[tr_start].u0, TR_FROM_UP);
   else if (state->tr[tr_start].d0 > 0)
     traverse_polygon(state, 0, tr_start, state->tr[tr_start].d0, TR_FROM_DN);
+
+  /* Several outer contours leave parts of the inside that the */
+  /* traversal cannot reach. Each starts a monotone polygon of its */
+  /* own, on a boundary none of the splits so far has touched */
+  for (i = tr_start + 1; (i < state->tr_idx) && !state->error; i++)
+    if (!state->visited[i] && inside_polygon(state, &state->tr[i]))
+      {
+	int mcur;
+
+	if (state->mon_idx + 1 >= state->segSize)
+	  return seidel_fail(state, SEIDEL_ERR_CHAIN);
+	mcur = newmon(state);
+	state->mon[mcur] = state->tr[i].rseg;
+	if (state->tr[i].u0 > 0)
+	  traverse_polygon(state, mcur, i, state->tr[i].u0, TR_FROM_UP);
+	else if (state->tr[i].d0 > 0)
+	  traverse_polygon(state, mcur, i, state->tr[i].d0, TR_FROM_DN);
+      }
   
+  if (state->error)
+    return state->error;
+
   /* return the number of polygons created */
   return newmon(state);
 }
 
 
-/* recursively visit all the trapezoids */
-static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int from, int dir)
+static void defer(visit_t *v, int mcur, int trnum, int from, int dir)
+{
+  v->mcur = mcur;
+  v->trnum = trnum;
+  v->from = from;
+  v->dir = dir;
+}
+
+
+/* Visit one trapezoid, splitting off a monotone polygon where it */
+/* has to, and put its neighbours into next[] in the order they are */
+/* to be visited. Returns their number */
+static int visit_trapezoid(SeidelTriangulator* state, int mcur, int trnum, int from, int dir, visit_t *next)
 {
   trap_t *t = &state->tr[trnum];
-  int howsplit, mnew;
-  int v0, v1, v0next, v1next;
-  int retval, tmp;
-  int do_switch = FALSE;
+  int mnew, k = 0;
+  int v0, v1;
 
-  if ((trnum <= 0) || state->visited[trnum])
+  if (OVER_BUDGET(state))
+    seidel_fail(state, SEIDEL_ERR_BUDGET);
+  if ((trnum <= 0) || state->visited[trnum] || state->error)
     return 0;
 
   state->visited[trnum] = TRUE;
+
+  /* every trapezoid inside the polygon lies between two segments */
+  if ((t->lseg <= 0) || (t->rseg <= 0))
+    return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
   
   /* We have much more information available here. */
   /* rseg: goes upwards   */
@@ -283,25 +347,23 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	  v1 = t->lseg;
 	  if (from == t->d1)
 	    {
-	      do_switch = TRUE;
 	      mnew = make_new_monotone_poly(state, mcur, v1, v0);
-	      traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-	      traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
+	      defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+	      defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
 	    }
 	  else
 	    {
 	      mnew = make_new_monotone_poly(state, mcur, v0, v1);
-	      traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-	      traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
+	      defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+	      defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
 	    }
 	}
       else
-	{
-	  retval = SP_NOSPLIT;	/* Just traverse all neighbours */
-	  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-	  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-	  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-	  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
+	{/* Just traverse all neighbours */
+	  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+	  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+	  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+	  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
 	}
     }
   
@@ -313,25 +375,23 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	  v1 = state->tr[t->u0].rseg;
 	  if (from == t->u1)
 	    {
-	      do_switch = TRUE;
 	      mnew = make_new_monotone_poly(state, mcur, v1, v0);
-	      traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
+	      defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+	      defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
 	    }
 	  else
 	    {
 	      mnew = make_new_monotone_poly(state, mcur, v0, v1);
-	      traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
+	      defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+	      defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
 	    }
 	}
       else
-	{
-	  retval = SP_NOSPLIT;	/* Just traverse all neighbours */
-	  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-	  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-	  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-	  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
+	{/* Just traverse all neighbours */
+	  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+	  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+	  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+	  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
 	}
     }
   
@@ -341,24 +401,22 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	{
 	  v0 = state->tr[t->d1].lseg;
 	  v1 = state->tr[t->u0].rseg;
-	  retval = SP_2UP_2DN;
 	  if (((dir == TR_FROM_DN) && (t->d1 == from)) ||
 	      ((dir == TR_FROM_UP) && (t->u1 == from)))
 	    {
-	      do_switch = TRUE;
 	      mnew = make_new_monotone_poly(state, mcur, v1, v0);
-	      traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-	      traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
+	      defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+	      defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+	      defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
+	      defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
 	    }
 	  else
 	    {
 	      mnew = make_new_monotone_poly(state, mcur, v0, v1);
-	      traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-	      traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
+	      defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+	      defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+	      defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
+	      defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
 	    }
 	}
       else			/* only downward cusp */
@@ -368,46 +426,42 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	      v0 = state->tr[t->u0].rseg;
 	      v1 = state->seg[t->lseg].next;
 
-	      retval = SP_2UP_LEFT;
 	      if ((dir == TR_FROM_UP) && (t->u0 == from))
 		{
-		  do_switch = TRUE;
 		  mnew = make_new_monotone_poly(state, mcur, v1, v0);
-		  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
 		}
 	      else
 		{
 		  mnew = make_new_monotone_poly(state, mcur, v0, v1);
-		  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
 		}
 	    }
 	  else
 	    {
 	      v0 = t->rseg;
 	      v1 = state->tr[t->u0].rseg;
-	      retval = SP_2UP_RIGHT;
 	      if ((dir == TR_FROM_UP) && (t->u1 == from))
 		{
-		  do_switch = TRUE;
 		  mnew = make_new_monotone_poly(state, mcur, v1, v0);
-		  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
 		}
 	      else
 		{
 		  mnew = make_new_monotone_poly(state, mcur, v0, v1);
-		  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
 		}
 	    }
 	}
@@ -420,23 +474,21 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	    {
 	      v0 = state->tr[t->d1].lseg;
 	      v1 = t->lseg;
-	      retval = SP_2DN_LEFT;
 	      if (!((dir == TR_FROM_DN) && (t->d0 == from)))
 		{
-		  do_switch = TRUE;
 		  mnew = make_new_monotone_poly(state, mcur, v1, v0);
-		  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
 		}
 	      else
 		{
 		  mnew = make_new_monotone_poly(state, mcur, v0, v1);
-		  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
 		}
 	    }
 	  else
@@ -444,23 +496,21 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	      v0 = state->tr[t->d1].lseg;
 	      v1 = state->seg[t->rseg].next;
 
-	      retval = SP_2DN_RIGHT;	    
 	      if ((dir == TR_FROM_DN) && (t->d1 == from))
 		{
-		  do_switch = TRUE;
 		  mnew = make_new_monotone_poly(state, mcur, v1, v0);
-		  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
 		}
 	      else
 		{
 		  mnew = make_new_monotone_poly(state, mcur, v0, v1);
-		  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
 		}
 	    }
 	}
@@ -471,23 +521,21 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	    {
 	      v0 = t->rseg;
 	      v1 = t->lseg;
-	      retval = SP_SIMPLE_LRDN;
 	      if (dir == TR_FROM_UP)
 		{
-		  do_switch = TRUE;
 		  mnew = make_new_monotone_poly(state, mcur, v1, v0);
-		  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
 		}
 	      else
 		{
 		  mnew = make_new_monotone_poly(state, mcur, v0, v1);
-		  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
 		}
 	    }
 	  else if (_equal_to(&t->hi, &state->seg[t->rseg].v1) &&
@@ -496,69 +544,97 @@ static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int
 	      v0 = state->seg[t->rseg].next;
 	      v1 = state->seg[t->lseg].next;
 
-	      retval = SP_SIMPLE_LRUP;
 	      if (dir == TR_FROM_UP)
 		{
-		  do_switch = TRUE;
 		  mnew = make_new_monotone_poly(state, mcur, v1, v0);
-		  traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->d0, trnum, TR_FROM_UP);
 		}
 	      else
 		{
 		  mnew = make_new_monotone_poly(state, mcur, v0, v1);
-		  traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-		  traverse_polygon(state, mnew, t->u0, trnum, TR_FROM_DN);
-		  traverse_polygon(state, mnew, t->u1, trnum, TR_FROM_DN);
+		  defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
+		  defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+		  defer(&next[k++], mnew, t->u0, trnum, TR_FROM_DN);
+		  defer(&next[k++], mnew, t->u1, trnum, TR_FROM_DN);
 		}
 	    }
 	  else			/* no split possible */
 	    {
-	      retval = SP_NOSPLIT;
-	      traverse_polygon(state, mcur, t->u0, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mcur, t->d0, trnum, TR_FROM_UP);
-	      traverse_polygon(state, mcur, t->u1, trnum, TR_FROM_DN);
-	      traverse_polygon(state, mcur, t->d1, trnum, TR_FROM_UP);
+	      defer(&next[k++], mcur, t->u0, trnum, TR_FROM_DN);
+	      defer(&next[k++], mcur, t->d0, trnum, TR_FROM_UP);
+	      defer(&next[k++], mcur, t->u1, trnum, TR_FROM_DN);
+	      defer(&next[k++], mcur, t->d1, trnum, TR_FROM_UP);
 	    }
 	}
     }
 
-  return retval;
+  return k;
+}
+
+
+/* Make room for size pending visits in state->visits, which is kept */
+/* from run to run. Returns 0 or SEIDEL_ERR_NOMEM */
+static int grow_visits(SeidelTriangulator* state, int size)
+{
+  visit_t *grown;
+
+  if (size <= state->visitSize)
+    return 0;
+  size = MAX(size, MAX(2 * state->visitSize, TRAVERSE_STACK));
+  if (!(grown = (visit_t *) realloc(state->visits, sizeof(visit_t) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->visits = grown;
+  state->visitSize = size;
+  return 0;
+}
+
+/* Visit all the trapezoids inside the polygon reachable from trnum,
+ * depth first. The pending visits are kept on an explicit stack, each
+ * trapezoid's neighbours pushed in reverse so that they come off in
+ * the order visit_trapezoid() gives them: the same order as recursing
+ * would take, without a call frame per trapezoid on the way, which a
+ * long winding polygon would run off a small thread stack.
+ */
+static int traverse_polygon(SeidelTriangulator* state, int mcur, int trnum, int from, int dir)
+{
+  visit_t next[4], cur;
+  int top = 0, k;
+
+  if (grow_visits(state, 1))
+    return 0;
+  defer(&state->visits[top++], mcur, trnum, from, dir);
+  while ((top > 0) && !state->error)
+    {
+      cur = state->visits[--top];
+      k = visit_trapezoid(state, cur.mcur, cur.trnum, cur.from, cur.dir, next);
+      if (grow_visits(state, top + k))
+	break;
+      while (k > 0)
+	state->visits[top++] = next[--k];
+    }
+  return 0;
 }
 
 
 /* For each monotone polygon, find the ymax and ymin (to determine the */
-/* two y-monotone chains) and pass on this monotone polygon for greedy */
-/* triangulation. */
-/* Take care not to triangulate duplicate monotone polygons */
+/* two y-monotone chains) and record it in mpoly[] along with the */
+/* first output triangle it owns. Every polygon with vcount vertices */
+/* yields vcount - 2 triangles, so the offsets are a prefix sum whose */
+/* total goes to *ntotal. Take care not to record duplicate */
+/* monotone polygons */
 
-int triangulate_monotone_polygons(SeidelTriangulator* state, int nvert, int nmonpoly, int op[][3])
+static int collect_monotone_polygons(SeidelTriangulator* state, int nmonpoly, int *ntotal)
 {
   register int i;
   point_t ymax, ymin;
   int p, vfirst, posmax, posmin, v;
   int vcount, processed;
+  int npoly = 0, ntri = 0;
+  monpoly_t *mp;
 
-#ifdef DEBUG_SEIDEL
-  for (i = 0; i < nmonpoly; i++)
-    {
-      fprintf(stderr, "\n\nPolygon %d: ", i);
-      vfirst = state->mchain[state->mon[i]].vnum;
-      p = state->mchain[state->mon[i]].next;
-      fprintf (stderr, "%d ", state->mchain[state->mon[i]].vnum);
-      while (state->mchain[p].vnum != vfirst)
-	{
-	  fprintf(stderr, "%d ", state->mchain[p].vnum);
-	  p = state->mchain[p].next;
-	}
-    }
-  fprintf(stderr, "\n");
-#endif
-
-  state->op_idx = 0;
   for (i = 0; i < nmonpoly; i++)
     {
       vcount = 1;
@@ -594,25 +670,250 @@ int triangulate_monotone_polygons(SeidelTriangulator* state, int nvert, int nmon
 
       if (processed)		/* Go to next polygon */
 	continue;
-      
+
+      mp = &state->mpoly[npoly++];
+      mp->vcount = vcount;
+      mp->op_ofs = ntri;
+      mp->posmax = posmax;
+      ntri += vcount - 2;
+
       if (vcount == 3)		/* already a triangle */
-	{
-	  op[state->op_idx][0] = state->mchain[p].vnum;
-	  op[state->op_idx][1] = state->mchain[state->mchain[p].next].vnum;
-	  op[state->op_idx][2] = state->mchain[state->mchain[p].prev].vnum;
-	  state->op_idx++;
-	}
-      else			/* triangulate the polygon */
+	mp->side = 0;
+      else
 	{
 	  v = state->mchain[state->mchain[posmax].next].vnum;
 	  if (_equal_to(&state->vert[v].pt, &ymin))
-	    {			/* LHS is a single line */
-	      triangulate_single_polygon(state, nvert, posmax, TRI_LHS, op);
-	    }
+	    mp->side = TRI_LHS;	/* LHS is a single line */
 	  else
-	    triangulate_single_polygon(state, nvert, posmax, TRI_RHS, op);
+	    mp->side = TRI_RHS;
 	}
     }
+
+  *ntotal = ntri;
+  state->mpoly_idx = npoly;
+  return npoly;
+}
+
+
+/* Record the monotone polygons without triangulating them, for */
+/* seidel_monotone_polygons(). Returns their number, or a negative */
+/* error code */
+int record_monotone_polygons(SeidelTriangulator* state, int nmonpoly)
+{
+  int npoly, ntri;
+
+  if (nmonpoly < 0)
+    return nmonpoly;
+  npoly = collect_monotone_polygons(state, nmonpoly, &ntri);
+  if ((state->maxtri > 0) && (ntri != state->maxtri))
+    return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
+  return npoly;
+}
+
+
+/* The y-monotone polygons of the polygon last given to
+ * monotonate_polygon() or triangulate_polygon(), packed: polygon i has
+ * the vertices index[first[i]] to index[first[i + 1] - 1], anticlockwise
+ * from its topmost one. first[] takes one entry more than there are
+ * polygons and index[] first[npoly] entries, at most n - 2 + 2 * #holes
+ * + 2 * npoly; either may be NULL. Returns the number of polygons or
+ * the error of the last run.
+ */
+int seidel_monotone_polygons(SeidelTriangulator* state, int *first, int *index)
+{
+  register int i, j, p;
+  int k = 0;
+  monpoly_t *mp;
+
+  if (state->error)
+    return state->error;
+  for (i = 0; i < state->mpoly_idx; i++)
+    {
+      mp = &state->mpoly[i];
+      if (first)
+	first[i] = k;
+      if (index)
+	for (j = 0, p = mp->posmax; j < mp->vcount; j++, p = state->mchain[p].next)
+	  index[k + j] = state->mchain[p].vnum;
+      k += mp->vcount;
+    }
+  if (first)
+    first[i] = k;
+  return state->mpoly_idx;
+}
+
+
+/* Triangulate the recorded polygons first..last-1 into op, which is */
+/* indexed by the op_ofs of each polygon when packed is FALSE, or */
+/* filled sequentially when it is TRUE. The reflex chain goes in */
+/* state->rchain if own is FALSE, and in a buffer of the call's own */
+/* otherwise, for the worker threads. Returns #triangles written, or */
+/* -1 if out of memory. */
+
+static int triangulate_polygon_range(SeidelTriangulator* state, int nvert, int first, int last, int op[][3], int packed, int own)
+{
+  register int i;
+  int *rc;
+  int maxv = 3, ntri = 0, ofs, p;
+  monpoly_t *mp;
+
+  for (i = first; i < last; i++)
+    if (state->mpoly[i].vcount > maxv)
+      maxv = state->mpoly[i].vcount;
+
+  /* reflex chain, shared by all the polygons of the range */
+  own = own || (maxv >= state->segSize);
+  rc = own ? (int*)malloc(sizeof(int) * (maxv + 1)) : state->rchain;
+  if (rc == NULL)
+    return -1;
+
+  for (i = first; i < last; i++)
+    {
+      mp = &state->mpoly[i];
+      ofs = (packed) ? ntri : mp->op_ofs;
+      
+      if (mp->side == 0)	/* already a triangle */
+	{
+	  p = mp->posmax;
+	  op[ofs][0] = state->mchain[p].vnum;
+	  op[ofs][1] = state->mchain[state->mchain[p].next].vnum;
+	  op[ofs][2] = state->mchain[state->mchain[p].prev].vnum;
+	  ntri++;
+	}
+      else			/* triangulate the polygon */
+	ntri += triangulate_single_polygon(state, nvert, mp->posmax, mp->side,
+					   mp->vcount - 2, &op[ofs], rc);
+    }
+
+  if (own)
+    free(rc);
+  return ntri;
+}
+
+
+typedef struct {
+  SeidelTriangulator *state;
+  int nvert;
+  int first, last;		/* range of mpoly[] */
+  int (*op)[3];
+  pthread_t thread;
+  int started;
+  int ntri;			/* #triangles written, -1 if failed */
+} monworker_t;
+
+static void *monotone_worker(void *arg)
+{
+  monworker_t *w = (monworker_t *) arg;
+
+  w->ntri = triangulate_polygon_range(w->state, w->nvert, w->first,
+				      w->last, w->op, FALSE, TRUE);
+  return NULL;
+}
+
+
+/* Split the polygons into nthreads runs of roughly equal vertex */
+/* count. Each run writes to its own disjoint slice of op. The */
+/* calling thread takes the last run. Returns #triangles written, */
+/* or -1 if out of memory. */
+
+static int triangulate_parallel(SeidelTriangulator* state, int nvert, int npoly, int op[][3])
+{
+  monworker_t *w;
+  int nthreads = state->nthreads;
+  int i, k, first, total = 0, acc = 0, ntri = 0;
+
+  if (nthreads > npoly)
+    nthreads = npoly;
+
+  for (i = 0; i < npoly; i++)
+    total += state->mpoly[i].vcount;
+
+  w = (monworker_t *) malloc(sizeof(monworker_t) * nthreads);
+  if (w == NULL)
+    return -1;
+
+  first = 0;
+  for (k = 0; k < nthreads; k++)
+    {
+      w[k].state = state;
+      w[k].nvert = nvert;
+      w[k].op = op;
+      w[k].first = first;
+      
+      if (k == nthreads - 1)
+	first = npoly;
+      else
+	while ((first < npoly) &&
+	       (acc < (long) total * (k + 1) / nthreads))
+	  acc += state->mpoly[first++].vcount;
+      w[k].last = first;
+    }
+
+  for (k = 0; k < nthreads - 1; k++)
+    {
+      w[k].started = (pthread_create(&w[k].thread, NULL,
+				     monotone_worker, &w[k]) == 0);
+      if (!w[k].started)
+	monotone_worker(&w[k]);	/* no thread to be had: do it here */
+    }
+
+  monotone_worker(&w[nthreads - 1]);
+
+  for (k = 0; k < nthreads - 1; k++)
+    if (w[k].started)
+      pthread_join(w[k].thread, NULL);
+
+  for (k = 0; k < nthreads; k++)
+    ntri = (ntri < 0 || w[k].ntri < 0) ? -1 : ntri + w[k].ntri;
+
+  free(w);
+  return ntri;
+}
+
+
+/* Returns the number of triangles written to op, or a negative */
+/* error code */
+int triangulate_monotone_polygons(SeidelTriangulator* state, int nvert, int nmonpoly, int op[][3])
+{
+  int npoly, ntri;
+
+#ifdef DEBUG_SEIDEL
+  register int i;
+  int p, vfirst;
+  for (i = 0; i < nmonpoly; i++)
+    {
+      fprintf(stderr, "\n\nPolygon %d: ", i);
+      vfirst = state->mchain[state->mon[i]].vnum;
+      p = state->mchain[state->mon[i]].next;
+      fprintf (stderr, "%d ", state->mchain[state->mon[i]].vnum);
+      while (state->mchain[p].vnum != vfirst)
+	{
+	  fprintf(stderr, "%d ", state->mchain[p].vnum);
+	  p = state->mchain[p].next;
+	}
+    }
+  fprintf(stderr, "\n");
+#endif
+
+  if (nmonpoly < 0)
+    return nmonpoly;
+
+  npoly = collect_monotone_polygons(state, nmonpoly, &ntri);
+
+  /* a simple polygon always gives n - 2 + 2 * #holes triangles: */
+  /* anything else means the monotone polygons do not cover it */
+  if ((state->maxtri > 0) && (ntri != state->maxtri))
+    return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
+
+  if ((state->nthreads > 1) && (nvert >= PAR_MIN_VERTICES) && (npoly > 1))
+    state->op_idx = triangulate_parallel(state, nvert, npoly, op);
+  else
+    state->op_idx = triangulate_polygon_range(state, nvert, 0, npoly, op, TRUE, FALSE);
+
+  if (state->op_idx < 0)
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  if (state->op_idx != ntri)
+    return seidel_fail(state, SEIDEL_ERR_DEGENERATE);
   
 #ifdef DEBUG_SEIDEL
   for (i = 0; i < state->op_idx; i++)
@@ -626,13 +927,15 @@ int triangulate_monotone_polygons(SeidelTriangulator* state, int nvert, int nmon
 /* A greedy corner-cutting algorithm to triangulate a y-monotone 
  * polygon in O(n) time.
  * Joseph O-Rourke, Computational Geometry in C.
+ * At most maxtri triangles are written to op. rc is the reflex
+ * chain and must hold one more entry than the polygon has vertices.
  */
-static int triangulate_single_polygon(SeidelTriangulator* state, int nvert, int posmax, int side, int op[][3])
+static int triangulate_single_polygon(SeidelTriangulator* state, int nvert, int posmax, int side, int maxtri, int op[][3], int* rc)
 {
   register int v;
   int ri = 0;	/* reflex chain */
-  int* rc = (int*)malloc(sizeof(int) * state->segSize);
   int endv, tmp, vpos;
+  int ntri = 0;
   
   if (side == TRI_RHS)		/* RHS segment is a single segment */
     {
@@ -668,14 +971,18 @@ static int triangulate_single_polygon(SeidelTriangulator* state, int nvert, int
 	  if (CROSS(state->vert[v].pt, state->vert[rc[ri - 1]].pt,
 		    state->vert[rc[ri]].pt) > 0)
 	    {			/* convex corner: cut if off */
-	      op[state->op_idx][0] = rc[ri - 1];
-	      op[state->op_idx][1] = rc[ri];
-	      op[state->op_idx][2] = v;
-	      state->op_idx++;
+	      if (ntri == maxtri)
+		return ntri;
+	      op[ntri][0] = rc[ri - 1];
+	      op[ntri][1] = rc[ri];
+	      op[ntri][2] = v;
+	      ntri++;
 	      ri--;
 	    }
 	  else		/* non-convex */
 	    {		/* add v to the chain */
+	      if (ri == maxtri + 1)
+		return ntri;
 	      ri++;
 	      rc[ri] = v;
 	      vpos = state->mchain[vpos].next;
@@ -691,13 +998,13 @@ static int triangulate_single_polygon(SeidelTriangulator* state, int nvert, int
     } /* end-while */
   
   /* reached the bottom vertex. Add in the triangle formed */
-  op[state->op_idx][0] = rc[ri - 1];
-  op[state->op_idx][1] = rc[ri];
-  op[state->op_idx][2] = v;
-  state->op_idx++;
+  if (ntri < maxtri)
+    {
+      op[ntri][0] = rc[ri - 1];
+      op[ntri][1] = rc[ri];
+      op[ntri][2] = v;
+      ntri++;
+    }
   ri--;
-  free(rc);
-  return 0;
+  return ntri;
 }
-
-
@@ -0,0 +1,314 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <math.h>
+#include <string.h>
+
+
+/* Path input. Contours are given as moves, lines and quadratic or
+ * cubic Béziers, and every point goes straight into the segment table
+ * of the triangulator as it is produced, so the caller never builds a
+ * vertex array. A curve is cut into the fewest equal parameter steps
+ * that keep each chord within the tolerance of the curve, a number
+ * read off its control points up front (Wang's formula): a glyph at
+ * 12 pixels gets a handful of points where the same glyph at 200
+ * pixels gets many, and a straight "curve" gets none.
+ *
+ * Outer contours must run one way and holes the other, as in font
+ * outlines; whichever way the largest contour runs is taken as outer,
+ * and if that is clockwise every contour is turned round. Several
+ * outer contours, as in "i" or "%", are fine.
+ */
+
+#define PATH_MIN_POINTS 64	/* a triangulator made by seidel_path_begin() */
+				/* starts with room for this many points */
+#define PATH_MAX_STEPS 1024	/* most chords for a single curve */
+
+
+#ifndef FIX_SIZED_ARRAY
+/* Grow the tables indexed by point by half. The trapezoid and query */
+/* tables grow on their own while the trapezoids are built */
+static int grow_segments(SeidelTriangulator* state)
+{
+  int size = state->segSize + state->segSize / 2 + 8;
+  segment_t *seg;
+  int *permute, *mon, *rchain;
+  vertexchain_t *vert;
+  monpoly_t *mpoly;
+
+  if (!(seg = (segment_t *) realloc(state->seg, sizeof(segment_t) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->seg = seg;
+  if (!(permute = (int *) realloc(state->permute, sizeof(int) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->permute = permute;
+  if (!(vert = (vertexchain_t *) realloc(state->vert, sizeof(vertexchain_t) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->vert = vert;
+  if (!(mon = (int *) realloc(state->mon, sizeof(int) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->mon = mon;
+  if (!(mpoly = (monpoly_t *) realloc(state->mpoly, sizeof(monpoly_t) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->mpoly = mpoly;
+  if (!(rchain = (int *) realloc(state->rchain, sizeof(int) * size)))
+    return seidel_fail(state, SEIDEL_ERR_NOMEM);
+  state->rchain = rchain;
+
+  state->segSize = size;
+  return 0;
+}
+#endif
+
+/* Append a point to the open contour, dropping repeats */
+static int path_point(SeidelTriangulator* state, double x, double y)
+{
+  point_t *last;
+
+  if (state->error)
+    return state->error;
+  if (!state->path_first)
+    return seidel_fail(state, SEIDEL_ERR_INPUT);
+
+  if (state->path_n >= state->path_first)
+    {
+      last = &state->seg[state->path_n].v0;
+      if (FP_EQUAL(last->x, x) && FP_EQUAL(last->y, y))
+	return 0;
+    }
+
+  if (state->path_n + 1 >= state->segSize)
+    {
+#ifdef FIX_SIZED_ARRAY
+      return seidel_fail(state, SEIDEL_ERR_CAPACITY);
+#else
+      if (grow_segments(state))
+	return state->error;
+#endif
+    }
+#ifdef FIX_SIZED_ARRAY
+  if (state->path_n + 1 >= SEGSIZE)
+    return seidel_fail(state, SEIDEL_ERR_CAPACITY);
+#endif
+
+  state->path_n++;
+  state->seg[state->path_n].v0.x = x;
+  state->seg[state->path_n].v0.y = y;
+  return 0;
+}
+
+/* Link the open contour into a ring. A closing point on top of the */
+/* first is dropped, and so is a contour that encloses nothing */
+static void path_end_contour(SeidelTriangulator* state)
+{
+  int first = state->path_first, last = state->path_n;
+  segment_t *seg = state->seg;
+  point_t *o;
+  double area = 0;
+  int i, j;
+
+  if (!first)
+    return;
+  state->path_first = 0;
+
+  if ((last > first) && FP_EQUAL(seg[last].v0.x, seg[first].v0.x) &&
+      FP_EQUAL(seg[last].v0.y, seg[first].v0.y))
+    last--;
+
+  o = &seg[first].v0;
+  for (i = first; i <= last; i++)
+    {
+      j = (i < last) ? i + 1 : first;
+      area += (seg[i].v0.x - o->x) * (seg[j].v0.y - o->y) -
+	(seg[j].v0.x - o->x) * (seg[i].v0.y - o->y);
+    }
+  if ((last - first < 2) || (area == 0))
+    {
+      state->path_n = first - 1;
+      return;
+    }
+
+  for (i = first; i <= last; i++)
+    {
+      j = (i < last) ? i + 1 : first;
+      seg[i].next = j;
+      seg[j].prev = i;
+      seg[i].v1 = seg[j].v0;
+    }
+  state->path_n = last;
+
+  if (area > 0)
+    state->path_nccw++;
+  else
+    state->path_ncw++;
+  if (fabs(area) > fabs(state->path_maxarea))
+    state->path_maxarea = area;
+}
+
+/* Number of chords for a curve whose second differences are at most */
+/* dd after scaling by the degree */
+static int curve_steps(SeidelTriangulator* state, double dd)
+{
+  double k = ceil(sqrt(dd / state->path_tolerance));
+
+  if (!(k >= 1))
+    return 1;
+  return (k > PATH_MAX_STEPS) ? PATH_MAX_STEPS : (int) k;
+}
+
+
+/* Start a path on *inoutTriangulatorPtr, made if NULL. Curves are */
+/* flattened to within tolerance, in the units of the coordinates: */
+/* for a glyph scaled to pixels, 0.25 is a quarter of a pixel */
+int seidel_path_begin(SeidelTriangulator** inoutTriangulatorPtr, double tolerance)
+{
+  SeidelTriangulator* state = *inoutTriangulatorPtr;
+
+  if (!(tolerance > 0))
+    return SEIDEL_ERR_INPUT;
+  if (NULL == state)
+    {
+      state = SeidelTriangulatorCreate(PATH_MIN_POINTS);
+      *inoutTriangulatorPtr = state;
+      if (NULL == state)
+	return SEIDEL_ERR_NOMEM;
+    }
+
+  SeidelTriangulatorReset(state);
+  state->path_n = state->path_first = 0;
+  state->path_nccw = state->path_ncw = 0;
+  state->path_maxarea = 0;
+  state->path_tolerance = tolerance;
+  return 0;
+}
+
+/* Start a new contour at (x, y), closing the open one if any */
+int seidel_path_move_to(SeidelTriangulator* state, double x, double y)
+{
+  if (state->error)
+    return state->error;
+  path_end_contour(state);
+  state->path_first = state->path_n + 1;
+  return path_point(state, x, y);
+}
+
+int seidel_path_line_to(SeidelTriangulator* state, double x, double y)
+{
+  return path_point(state, x, y);
+}
+
+/* Quadratic Bézier from the current point through control point */
+/* (x1, y1) to (x, y) */
+int seidel_path_quad_to(SeidelTriangulator* state, double x1, double y1, double x, double y)
+{
+  double x0, y0, t, s;
+  int i, m;
+
+  if (state->error || !state->path_first)
+    return path_point(state, x, y);
+  x0 = state->seg[state->path_n].v0.x;
+  y0 = state->seg[state->path_n].v0.y;
+
+  m = curve_steps(state, 0.25 * hypot(x0 - 2 * x1 + x, y0 - 2 * y1 + y));
+  for (i = 1; i < m; i++)
+    {
+      t = (double) i / m;
+      s = 1 - t;
+      if (path_point(state, s * s * x0 + 2 * s * t * x1 + t * t * x,
+		     s * s * y0 + 2 * s * t * y1 + t * t * y))
+	return state->error;
+    }
+  return path_point(state, x, y);
+}
+
+/* Cubic Bézier from the current point through control points */
+/* (x1, y1) and (x2, y2) to (x, y) */
+int seidel_path_cubic_to(SeidelTriangulator* state, double x1, double y1,
+			 double x2, double y2, double x, double y)
+{
+  double x0, y0, t, s, a, b, c, d;
+  int i, m;
+
+  if (state->error || !state->path_first)
+    return path_point(state, x, y);
+  x0 = state->seg[state->path_n].v0.x;
+  y0 = state->seg[state->path_n].v0.y;
+
+  m = curve_steps(state, 0.75 * MAX(hypot(x0 - 2 * x1 + x2, y0 - 2 * y1 + y2),
+				    hypot(x1 - 2 * x2 + x, y1 - 2 * y2 + y)));
+  for (i = 1; i < m; i++)
+    {
+      t = (double) i / m;
+      s = 1 - t;
+      a = s * s * s;
+      b = 3 * s * s * t;
+      c = 3 * s * t * t;
+      d = t * t * t;
+      if (path_point(state, a * x0 + b * x1 + c * x2 + d * x,
+		     a * y0 + b * y1 + c * y2 + d * y))
+	return state->error;
+    }
+  return path_point(state, x, y);
+}
+
+int seidel_path_close(SeidelTriangulator* state)
+{
+  if (state->error)
+    return state->error;
+  path_end_contour(state);
+  return 0;
+}
+
+
+/* Points of the path so far, 1..n, copied to vertices[1..n] unless */
+/* vertices is NULL. The triangles of triangulate_path() index them */
+int seidel_path_vertices(SeidelTriangulator* state, double (*vertices)[2])
+{
+  int i;
+
+  if (vertices)
+    for (i = 1; i <= state->path_n; i++)
+      {
+	vertices[i][0] = state->seg[i].v0.x;
+	vertices[i][1] = state->seg[i].v0.y;
+      }
+  return state->path_n;
+}
+
+/* Close the path and triangulate it. triangles needs room for */
+/* n + 2 * #contours, n from seidel_path_vertices(). Returns the */
+/* number of triangles, n - 2 * #outer + 2 * #holes, or one of the */
+/* negative SEIDEL_ERR_* codes, including the first error met while */
+/* the path was built */
+int triangulate_path(SeidelTriangulator* state, int (*triangles)[3])
+{
+  int i, n, tmp, nouter, nholes;
+
+  if (state->error)
+    return state->error;
+  path_end_contour(state);
+  n = state->path_n;
+  if (!n)
+    return SEIDEL_ERR_INPUT;
+
+  nouter = state->path_nccw;
+  nholes = state->path_ncw;
+  if (state->path_maxarea < 0)
+    {
+      for (i = 1; i <= n; i++)
+	{
+	  tmp = state->seg[i].next;
+	  state->seg[i].next = state->seg[i].prev;
+	  state->seg[i].prev = tmp;
+	}
+      for (i = 1; i <= n; i++)
+	state->seg[i].v1 = state->seg[state->seg[i].next].v0;
+      state->path_maxarea = -state->path_maxarea;
+      state->path_nccw = nholes;
+      state->path_ncw = nouter;
+      nouter = state->path_nccw;
+      nholes = state->path_ncw;
+    }
+
+  SeidelTriangulatorReset(state);
+  return triangulate_segments(state, n, n - 2 * nouter + 2 * nholes, triangles);
+}
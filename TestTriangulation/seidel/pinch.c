@@ -0,0 +1,224 @@
+#include "triangulate.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/* Loops that touch themselves or each other at a point, which the
+ * triangulator cannot take. Cutting a polygon to tiles and boolean
+ * operations on polygons both leave them.
+ *
+ * A loop is pt[start[k] .. start[k+1]-1]. find_repeats() numbers the
+ * points that occur more than once, split_pinches() cuts every loop
+ * that passes through a point twice into loops that do not, and
+ * pull_into_loop() then moves a copy of a point that loops still
+ * share a little way into its own loop, so that no two coincide, and
+ * separate_copies() picks the copies that can be moved so.
+ */
+
+#define PINCH_PULL (16 * C_EPS)	/* from the lines of the edges */
+#define PINCH_STRAIGHT 1e-6	/* bisector length of a straight corner */
+
+typedef struct {
+  double x, y;
+  int index;
+} sortpt_t;
+
+static int cmp_point(const void *a, const void *b)
+{
+  const sortpt_t *p = (const sortpt_t *) a, *q = (const sortpt_t *) b;
+
+  if (p->x != q->x)
+    return (p->x < q->x) ? -1 : 1;
+  if (p->y != q->y)
+    return (p->y < q->y) ? -1 : 1;
+  return p->index - q->index;
+}
+
+/* Number the points of pt[0 .. npts-1] that occur more than once, */
+/* dup[i] = -1 for the others. Returns the number of such groups or */
+/* SEIDEL_ERR_NOMEM */
+int find_repeats(double (*pt)[2], int npts, int *dup)
+{
+  sortpt_t *s = (sortpt_t *) malloc(sizeof(sortpt_t) * (npts + 1));
+  int i, j, ngroups = 0;
+
+  if (!s)
+    return SEIDEL_ERR_NOMEM;
+  for (i = 0; i < npts; i++)
+    {
+      s[i].x = pt[i][0];
+      s[i].y = pt[i][1];
+      s[i].index = i;
+      dup[i] = -1;
+    }
+  qsort(s, npts, sizeof(sortpt_t), cmp_point);
+
+  for (i = 0; i < npts; i = j)
+    {
+      for (j = i + 1; (j < npts) && (s[j].x == s[i].x) && (s[j].y == s[i].y); j++)
+	dup[s[j].index] = ngroups;
+      if (j > i + 1)
+	dup[s[i].index] = ngroups++;
+    }
+  free(s);
+  return ngroups;
+}
+
+/* Split every loop of start[0 .. nloops] that passes through a point
+ * twice, dup[] numbering the repeated ones in [0, ngroups), into loops
+ * that do not, keeping the order of the points. Loop k of the result
+ * is the points order[ostart[k] .. ostart[k+1]-1]: each point is used
+ * once, so order[] has start[nloops] entries, and there are at most
+ * nloops + start[nloops] loops. Returns their number or
+ * SEIDEL_ERR_NOMEM.
+ */
+int split_pinches(int nloops, int *start, int *dup, int ngroups, int *order, int *ostart)
+{
+  int *where = (int *) malloc(sizeof(int) * (ngroups + 1));
+  int *stack = (int *) malloc(sizeof(int) * (start[nloops] + 1));
+  int loop, i, j, top, n = 0, nout = 0;
+
+  if (!where || !stack)
+    {
+      free(where);
+      free(stack);
+      return SEIDEL_ERR_NOMEM;
+    }
+  for (i = 0; i < ngroups; i++)
+    where[i] = -1;
+
+  ostart[0] = 0;
+  for (loop = 0; loop < nloops; loop++)
+    {
+      top = 0;
+      for (i = start[loop]; i < start[loop + 1]; i++)
+	{
+	  int g = dup[i];
+
+	  if ((g >= 0) && (where[g] >= 0))
+	    {
+	      /* stack[where[g]] .. top is a loop of its own */
+	      for (j = where[g]; j < top; j++)
+		{
+		  order[n++] = stack[j];
+		  if ((j > where[g]) && (dup[stack[j]] >= 0))
+		    where[dup[stack[j]]] = -1;
+		}
+	      ostart[++nout] = n;
+	      top = where[g] + 1;
+	      continue;
+	    }
+	  if (g >= 0)
+	    where[g] = top;
+	  stack[top++] = i;
+	}
+      for (j = 0; j < top; j++)
+	{
+	  order[n++] = stack[j];
+	  if (dup[stack[j]] >= 0)
+	    where[dup[stack[j]]] = -1;
+	}
+      ostart[++nout] = n;
+    }
+
+  free(where);
+  free(stack);
+  return nout;
+}
+
+/* Pull point i of the loop pt[first .. first+n-1] into the loop, */
+/* along the bisector of its corner, to PINCH_PULL from the lines of */
+/* its edges or a quarter of the way along them. hole is TRUE for a */
+/* clockwise loop, whose inside is on its right */
+void pull_into_loop(double (*pt)[2], int first, int n, int i, int hole)
+{
+  double *u = pt[first + (i - first + n - 1) % n], *v = pt[i];
+  double *w = pt[first + (i - first + 1) % n];
+  double du = hypot(u[0] - v[0], u[1] - v[1]), dw = hypot(w[0] - v[0], w[1] - v[1]);
+  double d[2], len, turn, sine;
+
+  d[0] = (u[0] - v[0]) / du + (w[0] - v[0]) / dw;
+  d[1] = (u[1] - v[1]) / du + (w[1] - v[1]) / dw;
+  turn = (v[0] - u[0]) * (w[1] - v[1]) - (v[1] - u[1]) * (w[0] - v[0]);
+  sine = hypot((u[0] - v[0]) / du - (w[0] - v[0]) / dw, (u[1] - v[1]) / du - (w[1] - v[1]) / dw) / 2;
+  if (hypot(d[0], d[1]) < PINCH_STRAIGHT)
+    {
+      /* straight on, the bisector is noise: across the edge */
+      d[0] = (hole ? (w[1] - v[1]) : (v[1] - w[1])) / dw;
+      d[1] = (hole ? (v[0] - w[0]) : (w[0] - v[0])) / dw;
+    }
+  else if (hole ? (turn > 0) : (turn < 0))	/* a reflex corner of the loop */
+    {
+      d[0] = -d[0];
+      d[1] = -d[1];
+    }
+  len = hypot(d[0], d[1]);
+  if (!(len > 0))
+    return;
+  len = MIN(PINCH_PULL / sine, MIN(du, dw) / 4) / len;
+  v[0] += len * d[0];
+  v[1] += len * d[1];
+}
+
+
+/* Anticlockwise angle from the direction of v to u to that of v to w, */
+/* in [0, 2 pi) */
+static double corner_angle(double *v, double *u, double *w)
+{
+  double a = atan2(w[1] - v[1], w[0] - v[0]) - atan2(u[1] - v[1], u[0] - v[0]);
+
+  return (a < 0) ? a + 2 * M_PI : a;
+}
+
+/* Whether the corner of point v holds one of the edges of the other */
+/* copies of its point, first and those linked from it, on the side of */
+/* the region its loop bounds: the left of an outer one */
+static int holds_edges(double (*pt)[2], int *start, int nouter, int *loopof, int *link,
+		       int first, int v)
+{
+  int k = loopof[v], n = start[k + 1] - start[k], c, e;
+  double *p = pt[v];
+  double *u = pt[start[k] + (v - start[k] + n - 1) % n];
+  double *w = pt[start[k] + (v - start[k] + 1) % n];
+  double *from = (k < nouter) ? w : u, *to = (k < nouter) ? u : w;
+  double span = corner_angle(p, from, to), a;
+
+  for (c = first; c; c = link[c])
+    if (c != v)
+      for (e = -1; e <= 1; e += 2)
+	{
+	  int kc = loopof[c], nc = start[kc + 1] - start[kc];
+
+	  a = corner_angle(p, from, pt[start[kc] + (c - start[kc] + nc + e) % nc]);
+	  if ((a > 0) && (a < span))
+	    return TRUE;
+	}
+  return FALSE;
+}
+
+/* Pull apart the copies of a point that several loops pass through,
+ * first and those linked from it by link[], 0 ending the list. Loop k
+ * is pt[start[k] .. start[k+1]-1], loopof[] giving that k for each
+ * point, and the first nouter loops are anticlockwise, the rest holes.
+ * The corners of the loops there nest or lie side by side, and one
+ * that holds no other loop's edges can be pulled into its loop without
+ * crossing them. All such are, except a copy that stays put: one whose
+ * corner holds others if there is one, and else the first. inner[] is
+ * scratch, indexed like pt.
+ */
+void separate_copies(double (*pt)[2], int *start, int nouter, int *loopof, int *link, int *inner,
+		     int first)
+{
+  int c, keep = first;
+
+  for (c = first; c; c = link[c])
+    if (!(inner[c] = !holds_edges(pt, start, nouter, loopof, link, first, c)))
+      keep = c;
+  for (c = first; c; c = link[c])
+    if (inner[c] && (c != keep))
+      pull_into_loop(pt, start[loopof[c]], start[loopof[c] + 1] - start[loopof[c]], c,
+		     loopof[c] >= nouter);
+}
@@ -0,0 +1,359 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+
+/* A three stage pipeline: the caller's producer fills jobs with
+ * polygons, a thread of the pipeline triangulates them, and the
+ * caller's consumer takes the triangles in the order they went in.
+ * Three single-producer single-consumer rings connect the stages:
+ *
+ *	free --acquire--> producer --submit--> input --> triangulator
+ *	  ^						|
+ *	  +--recycle-- consumer <--next-- output <------+
+ *
+ * Each ring has one thread pushing and one popping, so a push is a
+ * store of the slot and a release store of the tail, and a pop an
+ * acquire load of the tail it has not yet seen. There are only depth
+ * jobs, so no ring ever fills. A stage that finds its ring empty polls
+ * it a while, then sleeps on a condition variable that a push only
+ * touches when someone sleeps. Jobs keep their buffers from one
+ * polygon to the next, and the triangulator keeps its tables.
+ */
+
+#define CACHE_LINE 64
+#define RING_SPIN 256		/* polls of an empty ring before sleeping */
+
+typedef struct {
+  /* the pushing side */
+  atomic_uint tail;
+  char pad0[CACHE_LINE - sizeof(atomic_uint)];
+  /* the popping side */
+  unsigned head, tail_seen;
+  char pad1[CACHE_LINE - 2 * sizeof(unsigned)];
+  /* shared, read mostly */
+  seideljob_t **slot;
+  unsigned mask;
+  atomic_int closed, sleepers;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+} ring_t;
+
+struct SeidelPipeline_s {
+  ring_t free, input, output;
+  seideljob_t *job;		/* all depth of them */
+  int depth;
+  seideljob_t *spare;		/* acquired, but could not be sized */
+  SeidelTriangulator *state;	/* the triangulator's own */
+  pthread_t thread;
+  int started, finished;
+};
+
+
+static int ring_init(ring_t *r, int depth)
+{
+  unsigned size = 1;
+
+  while (size < (unsigned) depth)
+    size <<= 1;
+  memset(r, 0, sizeof(*r));
+  r->slot = (seideljob_t **) malloc(sizeof(seideljob_t *) * size);
+  if (!r->slot)
+    return SEIDEL_ERR_NOMEM;
+  r->mask = size - 1;
+  atomic_init(&r->tail, 0);
+  atomic_init(&r->closed, 0);
+  atomic_init(&r->sleepers, 0);
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->wake, NULL);
+  return 0;
+}
+
+static void ring_destroy(ring_t *r)
+{
+  if (!r->slot)
+    return;
+  pthread_mutex_destroy(&r->lock);
+  pthread_cond_destroy(&r->wake);
+  free(r->slot);
+}
+
+/* Wake whoever sleeps on the ring. The fence orders the store that
+ * made the ring worth looking at before the load of sleepers, as
+ * ring_wait() orders its count before its last look; one of the two
+ * sees the other */
+static void ring_wake(ring_t *r)
+{
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&r->sleepers, memory_order_relaxed))
+    {
+      pthread_mutex_lock(&r->lock);
+      pthread_cond_broadcast(&r->wake);
+      pthread_mutex_unlock(&r->lock);
+    }
+}
+
+static void ring_push(ring_t *r, seideljob_t *job)
+{
+  unsigned t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+  r->slot[t & r->mask] = job;
+  atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+  ring_wake(r);
+}
+
+/* No more pushes */
+static void ring_close(ring_t *r)
+{
+  atomic_store_explicit(&r->closed, 1, memory_order_release);
+  ring_wake(r);
+}
+
+static seideljob_t *ring_pop(ring_t *r)
+{
+  seideljob_t *job;
+
+  if (r->head == r->tail_seen)
+    {
+      r->tail_seen = atomic_load_explicit(&r->tail, memory_order_acquire);
+      if (r->head == r->tail_seen)
+	return NULL;
+    }
+  job = r->slot[r->head & r->mask];
+  r->head++;
+  return job;
+}
+
+/* Pop a job, waiting for one. NULL once the ring is closed and empty */
+static seideljob_t *ring_wait(ring_t *r)
+{
+  seideljob_t *job;
+  int spin;
+
+  for (spin = 0; spin < RING_SPIN; spin++)
+    {
+      if ((job = ring_pop(r)))
+	return job;
+      if (atomic_load_explicit(&r->closed, memory_order_acquire))
+	return ring_pop(r);	/* pushed before the close */
+      sched_yield();
+    }
+
+  pthread_mutex_lock(&r->lock);
+  atomic_fetch_add_explicit(&r->sleepers, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  while (!(job = ring_pop(r)) &&
+	 !atomic_load_explicit(&r->closed, memory_order_acquire))
+    pthread_cond_wait(&r->wake, &r->lock);
+  if (!job)
+    job = ring_pop(r);
+  atomic_fetch_sub_explicit(&r->sleepers, 1, memory_order_relaxed);
+  pthread_mutex_unlock(&r->lock);
+  return job;
+}
+
+
+/* Make room in the job for a polygon of ncontours contours and nvert */
+/* points. Buffers only grow */
+static int job_reserve(seideljob_t *job, int ncontours, int nvert)
+{
+  int *cntr;
+  double (*vertices)[2];
+
+  if (ncontours > job->maxcontours)
+    {
+      cntr = (int *) realloc(job->cntr, sizeof(int) * ncontours);
+      if (!cntr)
+	return SEIDEL_ERR_NOMEM;
+      job->cntr = cntr;
+      job->maxcontours = ncontours;
+    }
+  if (nvert > job->maxvert)
+    {
+      vertices = (double (*)[2]) realloc(job->vertices, sizeof(double) * 2 * (nvert + 1));
+      if (!vertices)
+	return SEIDEL_ERR_NOMEM;
+      job->vertices = vertices;
+      job->maxvert = nvert;
+    }
+  return 0;
+}
+
+/* Triangulate the job on *state, remade if it is too small. Returns */
+/* the number of triangles or an error */
+static int triangulate_job(SeidelTriangulator **state, seideljob_t *job)
+{
+  int ntri = seidel_triangle_count(job->ncontours, job->cntr), nvert;
+  int (*triangles)[3];
+
+  if (ntri < 0)
+    return ntri;
+  nvert = ntri + 2 - 2 * (job->ncontours - 1);
+  if ((nvert > job->maxvert) || (job->ncontours > job->maxcontours))
+    return SEIDEL_ERR_INPUT;
+  if (ntri > job->maxtriangles)
+    {
+      triangles = (int (*)[3]) realloc(job->triangles, sizeof(int) * 3 * ntri);
+      if (!triangles)
+	return SEIDEL_ERR_NOMEM;
+      job->triangles = triangles;
+      job->maxtriangles = ntri;
+    }
+
+  if (*state && ((*state)->segSize <= nvert))
+    {
+      SeidelTriangulatorRelease(*state);
+      *state = NULL;
+    }
+  return triangulate_polygon(state, job->ncontours, job->cntr, job->vertices,
+			     job->triangles);
+}
+
+static void *pipeline_worker(void *arg)
+{
+  SeidelPipeline *p = (SeidelPipeline *) arg;
+  seideljob_t *job;
+
+  while ((job = ring_wait(&p->input)))
+    {
+      job->ntriangles = triangulate_job(&p->state, job);
+      ring_push(&p->output, job);
+    }
+  ring_close(&p->output);
+  return NULL;
+}
+
+
+/* A pipeline with depth jobs, each with room for nvert points to
+ * start with, and its triangulating thread. If the thread cannot be
+ * started, seidel_pipeline_submit() triangulates on the producer.
+ */
+SeidelPipeline* SeidelPipelineCreate(int depth, int nvert)
+{
+  SeidelPipeline *p;
+  int i;
+
+  if (depth < 1)
+    depth = 1;
+  p = (SeidelPipeline *) calloc(1, sizeof(SeidelPipeline));
+  if (!p)
+    return NULL;
+  p->depth = depth;
+  p->job = (seideljob_t *) calloc(depth, sizeof(seideljob_t));
+  if (!p->job || ring_init(&p->free, depth) || ring_init(&p->input, depth) ||
+      ring_init(&p->output, depth))
+    goto fail;
+  for (i = 0; i < depth; i++)
+    {
+      if (job_reserve(&p->job[i], 1, nvert))
+	goto fail;
+      if (nvert > 2)
+	{
+	  p->job[i].triangles = (int (*)[3]) malloc(sizeof(int) * 3 * (nvert - 2));
+	  if (!p->job[i].triangles)
+	    goto fail;
+	  p->job[i].maxtriangles = nvert - 2;
+	}
+      ring_push(&p->free, &p->job[i]);
+    }
+
+  p->started = (pthread_create(&p->thread, NULL, pipeline_worker, p) == 0);
+  return p;
+
+ fail:
+  SeidelPipelineRelease(p);
+  return NULL;
+}
+
+/* Finish the pipeline if the producer has not, wait for the thread to
+ * triangulate what was submitted, and free everything. Jobs not yet
+ * recycled go with it.
+ */
+void SeidelPipelineRelease(SeidelPipeline* p)
+{
+  int i;
+
+  if (!p)
+    return;
+  if (p->started)
+    {
+      seidel_pipeline_finish(p);
+      pthread_join(p->thread, NULL);
+    }
+  ring_destroy(&p->free);
+  ring_destroy(&p->input);
+  ring_destroy(&p->output);
+  for (i = 0; p->job && (i < p->depth); i++)
+    {
+      free(p->job[i].cntr);
+      free(p->job[i].vertices);
+      free(p->job[i].triangles);
+    }
+  free(p->job);
+  SeidelTriangulatorRelease(p->state);
+  free(p);
+}
+
+/* Producer: a free job with room for ncontours contours and nvert
+ * points, for the caller to fill in cntr[], vertices[1..nvert] and
+ * user. Waits while all jobs are in flight, so a producer that also
+ * consumes must take from seidel_pipeline_next() before acquiring
+ * more than depth jobs. NULL if the room cannot be made.
+ */
+seideljob_t *seidel_pipeline_acquire(SeidelPipeline* p, int ncontours, int nvert)
+{
+  seideljob_t *job = p->spare;
+
+  p->spare = NULL;
+  if (!job)
+    job = ring_wait(&p->free);
+  if (job_reserve(job, ncontours, nvert))
+    {
+      p->spare = job;
+      return NULL;
+    }
+  job->ncontours = ncontours;
+  job->nvert = nvert;
+  job->ntriangles = 0;
+  return job;
+}
+
+/* Producer: hand the filled job on to be triangulated */
+void seidel_pipeline_submit(SeidelPipeline* p, seideljob_t *job)
+{
+  if (p->started)
+    ring_push(&p->input, job);
+  else
+    {
+      job->ntriangles = triangulate_job(&p->state, job);
+      ring_push(&p->output, job);
+    }
+}
+
+/* Producer: no more jobs. seidel_pipeline_next() returns NULL once */
+/* the last one is taken */
+void seidel_pipeline_finish(SeidelPipeline* p)
+{
+  if (p->finished)
+    return;
+  p->finished = TRUE;
+  ring_close(p->started ? &p->input : &p->output);
+}
+
+/* Consumer: the next job in the order submitted, its triangles or
+ * error in ntriangles and triangles[], waiting for it if need be.
+ * NULL after the last job once the pipeline is finished.
+ */
+seideljob_t *seidel_pipeline_next(SeidelPipeline* p)
+{
+  return ring_wait(&p->output);
+}
+
+/* Consumer: done with the job; its buffers go back to the producer */
+void seidel_pipeline_recycle(SeidelPipeline* p, seideljob_t *job)
+{
+  ring_push(&p->free, job);
+}
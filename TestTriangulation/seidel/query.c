@@ -0,0 +1,435 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <math.h>
+
+
+/* Queries answered by walking the trapezoids of a finished
+ * decomposition, from the one the query structure locates, through
+ * their u0/u1/d0/d1 neighbours. A segment crosses the trapezoids along
+ * it in order, from bottom to top: it leaves each through the top,
+ * into an upper neighbour, or through a side, that is through an edge
+ * of the polygon, and the trapezoid beyond the edge is located again.
+ * The nearest edge to a point bounds a trapezoid of the region the
+ * point is in, within that distance of it, so a best first search of
+ * the region outwards stops as soon as nothing closer is left. Either
+ * query only visits the trapezoids near its answer rather than every
+ * edge of the polygon.
+ */
+
+#define FRONTIER_STACK 64	/* entries kept on the stack */
+
+
+/* x of segment s at height y */
+static double side_x(segment_t *s, double y)
+{
+  if (s->v1.y == s->v0.y)
+    return s->v0.x;
+  return s->v0.x + (y - s->v0.y) * (s->v1.x - s->v0.x) / (s->v1.y - s->v0.y);
+}
+
+static int is_horizontal(segment_t *s)
+{
+  return FP_EQUAL(s->v0.y, s->v1.y);
+}
+
+/* Whether x at height y is within the sides of trapezoid t */
+static int spans_x(SeidelTriangulator* state, trap_t *t, double x, double y)
+{
+  segment_t *s;
+
+  if (t->lseg > 0)
+    {
+      s = &state->seg[t->lseg];
+      if (!is_horizontal(s) && (x < side_x(s, y)))
+	return FALSE;
+    }
+  if (t->rseg > 0)
+    {
+      s = &state->seg[t->rseg];
+      if (!is_horizontal(s) && (x > side_x(s, y)))
+	return FALSE;
+    }
+  return TRUE;
+}
+
+/* Parameter along p + u (q - p) at which the segment leaves the side */
+/* of s it starts on, once it has got to u0; 2 if it does not before */
+/* q. sign is 1 for a left side, -1 for a right one. A horizontal s */
+/* bounds trapezoids of no height, which a rising segment leaves */
+/* through s at once if it is within the ends of s */
+static double side_exit(segment_t *s, point_t *p, point_t *q, double u0, int sign)
+{
+  double g0 = sign * (p->x - side_x(s, p->y)), g1 = sign * (q->x - side_x(s, q->y));
+  double u, x;
+
+  if (is_horizontal(s))
+    {
+      x = p->x + u0 * (q->x - p->x);
+      return ((q->y > p->y) && (x > MIN(s->v0.x, s->v1.x)) &&
+	      (x < MAX(s->v0.x, s->v1.x))) ? u0 : 2;
+    }
+  if (!(g1 < 0) || !(g1 < g0))
+    return 2;
+  u = (g0 > 0) ? g0 / (g0 - g1) : 0;
+  return MAX(u, u0);
+}
+
+
+/* Whether segment (p, q) meets side s of trapezoid t within the */
+/* height of t, so that every edge is met in the trapezoids next to */
+/* where the walk crosses it rather than further along */
+static int meets_side(SeidelTriangulator* state, trap_t *t, int s, point_t *p, point_t *q)
+{
+  segment_t *e = &state->seg[s];
+  double a0, a1, y;
+
+  if (!segments_intersect(p, q, &e->v0, &e->v1))
+    return FALSE;
+  a0 = CROSS(e->v0, e->v1, (*p));
+  a1 = CROSS(e->v0, e->v1, (*q));
+  if (is_horizontal(e) || (a0 == a1))
+    return TRUE;
+  y = p->y + (q->y - p->y) * a0 / (a0 - a1);
+  return ((y >= t->lo.y - C_EPS) && (y <= t->hi.y + C_EPS));
+}
+
+/* Report segment s as met by the query, unless it was one of the last */
+/* two reported. Returns TRUE once maxsegs are reported */
+static int report_segment(int s, int *segs, int maxsegs, int *n, int last[2])
+{
+  if ((s == last[0]) || (s == last[1]))
+    return FALSE;
+  if (segs)
+    segs[*n] = s;
+  (*n)++;
+  last[1] = last[0];
+  last[0] = s;
+  return (*n >= maxsegs);
+}
+
+
+/* The edges of the polygon last given to trapezoidate_polygon() or
+ * triangulate_polygon() that segment (p0, p1) meets, touching
+ * included, segment i running from point i to the next point of its
+ * contour. Up to maxsegs of them are written to segs[] unless it is
+ * NULL, in the order the walk meets them, and the walk stops there: a
+ * maxsegs of 1 asks whether the segment meets the boundary at all. A
+ * ray is a segment out past the polygon. Returns their number or a
+ * negative SEIDEL_ERR_* code. A segment through a vertex may report
+ * either edge at it, or both.
+ */
+int seidel_segment_crossings(SeidelTriangulator* state, double *p0, double *p1,
+			     int *segs, int maxsegs)
+{
+  point_t p, q, c;
+  segment_t *seg = state->seg, *e;
+  trap_t *t;
+  int tnum, from = 0, n = 0, steps, last[2] = {0, 0};
+  double dx, dy, u = 0, uh, ul, ur, x;
+
+  if (state->error)
+    return state->error;
+  if (maxsegs <= 0)
+    return SEIDEL_ERR_INPUT;
+
+  /* walk from the lower end up */
+  p.x = p0[0];
+  p.y = p0[1];
+  q.x = p1[0];
+  q.y = p1[1];
+  if (_greater_than(&p, &q))
+    {
+      c = p;
+      p = q;
+      q = c;
+    }
+  dx = q.x - p.x;
+  dy = q.y - p.y;
+
+  if ((tnum = locate_endpoint(state, &p, &q, 1)) <= 0)
+    return state->error;
+  for (steps = 0; steps <= state->tr_idx; steps++)
+    {
+      t = &state->tr[tnum];
+      if ((t->lseg > 0) && meets_side(state, t, t->lseg, &p, &q) &&
+	  report_segment(t->lseg, segs, maxsegs, &n, last))
+	return n;
+      if ((t->rseg > 0) && meets_side(state, t, t->rseg, &p, &q) &&
+	  report_segment(t->rseg, segs, maxsegs, &n, last))
+	return n;
+
+      /* where the segment leaves t: through its top, at uh, or */
+      /* through either side */
+      if (dy > 0)
+	uh = (t->hi.y - p.y) / dy;
+      else if (FP_EQUAL(t->hi.y, p.y) && (dx > 0))
+	uh = (t->hi.x - p.x) / dx;
+      else
+	uh = 2;
+      uh = MAX(uh, u);
+      ul = ur = 2;
+      if ((t->lseg > 0) && (t->lseg != from))
+	ul = side_exit(&seg[t->lseg], &p, &q, u, 1);
+      if ((t->rseg > 0) && (t->rseg != from))
+	ur = side_exit(&seg[t->rseg], &p, &q, u, -1);
+
+      if ((uh >= 1) && (ul >= 1) && (ur >= 1))
+	return n;
+
+      if ((ul <= uh) || (ur <= uh))
+	{
+	  /* across an edge, into the trapezoid beyond it */
+	  from = (ul <= ur) ? t->lseg : t->rseg;
+	  u = MIN(ul, ur);
+	  c.x = p.x + u * dx;
+	  c.y = p.y + u * dy;
+	  tnum = locate_beside(state, &c, &q, from, 1);
+
+	  /* at an end of the edge, where c may round to below it, go */
+	  /* on from the vertex itself */
+	  if ((tnum > 0) && (state->tr[tnum].lseg != from) && (state->tr[tnum].rseg != from))
+	    {
+	      e = &seg[from];
+	      c = (hypot(c.x - e->v0.x, c.y - e->v0.y) <= hypot(c.x - e->v1.x, c.y - e->v1.y)) ?
+		e->v0 : e->v1;
+	      tnum = locate_endpoint(state, &c, &q, 1);
+	    }
+	}
+      else
+	{
+	  /* up, into the neighbour the segment enters, or past the */
+	  /* vertex that caps t */
+	  u = uh;
+	  x = p.x + u * dx;
+	  from = 0;
+	  if ((t->u0 > 0) && (t->u1 > 0))
+	    tnum = spans_x(state, &state->tr[t->u0], x, t->hi.y) ? t->u0 : t->u1;
+	  else if (t->u0 > 0)
+	    tnum = t->u0;
+	  else if (t->u1 > 0)
+	    tnum = t->u1;
+	  else
+	    tnum = locate_endpoint(state, &t->hi, &q, 1);
+	}
+      if (tnum <= 0)
+	return state->error;
+    }
+  return SEIDEL_ERR_DEGENERATE;
+}
+
+
+/* Trapezoids waiting to be searched, nearest first, and those seen */
+
+typedef struct {
+  double d;
+  int t;
+} qitem_t;
+
+typedef struct {
+  qitem_t *heap;
+  int nheap, heapcap;
+  int *seen;			/* open addressed, 0 empty */
+  int nseen, seenmask;
+  qitem_t heap0[FRONTIER_STACK];
+  int seen0[2 * FRONTIER_STACK];
+} frontier_t;
+
+static void frontier_init(frontier_t *f)
+{
+  f->heap = f->heap0;
+  f->nheap = 0;
+  f->heapcap = FRONTIER_STACK;
+  f->seen = f->seen0;
+  f->nseen = 0;
+  f->seenmask = 2 * FRONTIER_STACK - 1;
+  memset(f->seen0, 0, sizeof(f->seen0));
+}
+
+static void frontier_free(frontier_t *f)
+{
+  if (f->heap != f->heap0)
+    free(f->heap);
+  if (f->seen != f->seen0)
+    free(f->seen);
+}
+
+static int frontier_push(frontier_t *f, int t, double d)
+{
+  qitem_t *h;
+  int i, j;
+
+  if (f->nheap == f->heapcap)
+    {
+      if (!(h = (qitem_t *) malloc(sizeof(qitem_t) * 2 * f->heapcap)))
+	return SEIDEL_ERR_NOMEM;
+      memcpy(h, f->heap, sizeof(qitem_t) * f->nheap);
+      if (f->heap != f->heap0)
+	free(f->heap);
+      f->heap = h;
+      f->heapcap *= 2;
+    }
+  for (i = f->nheap++; i > 0; i = j)
+    {
+      j = (i - 1) / 2;
+      if (f->heap[j].d <= d)
+	break;
+      f->heap[i] = f->heap[j];
+    }
+  f->heap[i].d = d;
+  f->heap[i].t = t;
+  return 0;
+}
+
+static qitem_t frontier_pop(frontier_t *f)
+{
+  qitem_t top = f->heap[0], last = f->heap[--f->nheap];
+  int i = 0, j;
+
+  while ((j = 2 * i + 1) < f->nheap)
+    {
+      if ((j + 1 < f->nheap) && (f->heap[j + 1].d < f->heap[j].d))
+	j++;
+      if (last.d <= f->heap[j].d)
+	break;
+      f->heap[i] = f->heap[j];
+      i = j;
+    }
+  f->heap[i] = last;
+  return top;
+}
+
+/* 1 if t had not been seen yet, and marks it, 0 if it had, or */
+/* SEIDEL_ERR_NOMEM */
+static int frontier_mark(frontier_t *f, int t)
+{
+  int *old = f->seen, mask = f->seenmask, i, k;
+
+  for (i = (int) ((unsigned) t * 2654435761u) & mask; f->seen[i]; i = (i + 1) & mask)
+    if (f->seen[i] == t)
+      return 0;
+  f->seen[i] = t;
+  if (2 * ++f->nseen <= mask)
+    return 1;
+
+  /* rehash into twice the room, or keep filling if that fails */
+  if (!(f->seen = (int *) calloc(2 * (mask + 1), sizeof(int))))
+    {
+      f->seen = old;
+      return (f->nseen <= mask) ? 1 : SEIDEL_ERR_NOMEM;
+    }
+  f->seenmask = 2 * mask + 1;
+  for (k = 0; k <= mask; k++)
+    if (old[k])
+      {
+	for (i = (int) ((unsigned) old[k] * 2654435761u) & f->seenmask; f->seen[i];
+	     i = (i + 1) & f->seenmask)
+	  ;
+	f->seen[i] = old[k];
+      }
+  if (old != f->seen0)
+    free(old);
+  return 1;
+}
+
+
+/* Distance from v to segment s */
+static double segment_distance(segment_t *s, point_t *v)
+{
+  double dx = s->v1.x - s->v0.x, dy = s->v1.y - s->v0.y;
+  double len2 = dx * dx + dy * dy, u = 0, ex, ey;
+
+  if (len2 > 0)
+    u = MAX(0, MIN(1, ((v->x - s->v0.x) * dx + (v->y - s->v0.y) * dy) / len2));
+  ex = s->v0.x + u * dx - v->x;
+  ey = s->v0.y + u * dy - v->y;
+  return sqrt(ex * ex + ey * ey);
+}
+
+/* A lower bound on the distance from v to trapezoid t, that of its */
+/* bounding box */
+static double trapezoid_distance(SeidelTriangulator* state, trap_t *t, point_t *v)
+{
+  segment_t *s;
+  double xmin = -HUGE_VAL, xmax = HUGE_VAL, ex, ey;
+
+  if (t->lseg > 0)
+    {
+      s = &state->seg[t->lseg];
+      xmin = is_horizontal(s) ? MIN(s->v0.x, s->v1.x) :
+	MIN(side_x(s, t->lo.y), side_x(s, t->hi.y));
+    }
+  if (t->rseg > 0)
+    {
+      s = &state->seg[t->rseg];
+      xmax = is_horizontal(s) ? MAX(s->v0.x, s->v1.x) :
+	MAX(side_x(s, t->lo.y), side_x(s, t->hi.y));
+    }
+  ex = MAX(0, MAX(xmin - v->x, v->x - xmax));
+  ey = MAX(0, MAX(t->lo.y - v->y, v->y - t->hi.y));
+  return sqrt(ex * ex + ey * ey);
+}
+
+
+/* The edge of the polygon last given to trapezoidate_polygon() or
+ * triangulate_polygon() nearest to point vertex, numbered as by
+ * seidel_segment_crossings(), with its distance in *dist unless dist
+ * is NULL. Returns the edge or a negative SEIDEL_ERR_* code.
+ */
+int seidel_nearest_edge(SeidelTriangulator* state, double *vertex, double *dist)
+{
+  frontier_t f;
+  qitem_t it;
+  point_t v;
+  trap_t *t;
+  int k, nb, s, best = 0, err = 0;
+  double d, bestd = HUGE_VAL;
+
+  if (state->error)
+    return state->error;
+  v.x = vertex[0];
+  v.y = vertex[1];
+  if ((nb = locate_endpoint(state, &v, &v, 1)) <= 0)
+    return state->error;
+
+  frontier_init(&f);
+  frontier_mark(&f, nb);
+  frontier_push(&f, nb, 0);
+  while (f.nheap && !err)
+    {
+      it = frontier_pop(&f);
+      if (it.d >= bestd)
+	break;
+      t = &state->tr[it.t];
+      for (k = 0; k < 2; k++)
+	if (((s = k ? t->rseg : t->lseg) > 0) &&
+	    ((d = segment_distance(&state->seg[s], &v)) < bestd))
+	  {
+	    bestd = d;
+	    best = s;
+	  }
+
+      /* the neighbours across the top and the bottom, in the same */
+      /* region of the plane */
+      for (k = 0; (k < 4) && !err; k++)
+	{
+	  nb = (k == 0) ? t->u0 : (k == 1) ? t->u1 : (k == 2) ? t->d0 : t->d1;
+	  if ((nb <= 0) || (state->tr[nb].state == ST_INVALID))
+	    continue;
+	  if ((err = frontier_mark(&f, nb)) <= 0)
+	    continue;
+	  err = 0;
+	  if ((d = trapezoid_distance(state, &state->tr[nb], &v)) < bestd)
+	    err = frontier_push(&f, nb, d);
+	}
+    }
+  frontier_free(&f);
+
+  if (err)
+    return err;
+  if (best <= 0)
+    return SEIDEL_ERR_DEGENERATE;
+  if (dist)
+    *dist = bestd;
+  return best;
+}
@@ -0,0 +1,233 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_AVX
+#define FLANES 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#define FLANES 4
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON
+#define FLANES 4
+#else
+#define FLANES 1
+#endif
+
+
+/* Pixels straight from the trapezoidal decomposition. Once the
+ * trapezoids are built, the inside ones already tile the polygon, each
+ * bounded by two segments and two horizontal lines, so a coverage
+ * mask needs neither the monotone polygons nor the triangles. Every
+ * sub-scanline crossing a trapezoid adds a span between its left and
+ * right segment: the pixels wholly inside the span take the full
+ * weight of the sub-scanline, done a vector at a time, and the two at
+ * its ends the part of it they cover. The trapezoids share their edges
+ * and each sub-scanline is in exactly one trapezoid per span, so
+ * nothing is counted twice.
+ */
+
+#if defined(SIMD_AVX)
+
+typedef __m256 vfloat;
+#define VSET1(a)	_mm256_set1_ps(a)
+#define VLOAD(p)	_mm256_loadu_ps(p)
+#define VSTORE(p, a)	_mm256_storeu_ps(p, a)
+#define VADD(a, b)	_mm256_add_ps(a, b)
+
+#elif defined(SIMD_SSE2)
+
+typedef __m128 vfloat;
+#define VSET1(a)	_mm_set1_ps(a)
+#define VLOAD(p)	_mm_loadu_ps(p)
+#define VSTORE(p, a)	_mm_storeu_ps(p, a)
+#define VADD(a, b)	_mm_add_ps(a, b)
+
+#elif defined(SIMD_NEON)
+
+typedef float32x4_t vfloat;
+#define VSET1(a)	vdupq_n_f32(a)
+#define VLOAD(p)	vld1q_f32(p)
+#define VSTORE(p, a)	vst1q_f32(p, a)
+#define VADD(a, b)	vaddq_f32(a, b)
+
+#endif
+
+
+/* Whether trapezoid t is inside the polygon, the test of */
+/* is_point_inside_polygon(), and has any height */
+static int inside_trapezoid(SeidelTriangulator* state, trap_t *t)
+{
+  if ((t->state == ST_INVALID) || (t->lseg <= 0) || (t->rseg <= 0) ||
+      !(t->hi.y > t->lo.y))
+    return FALSE;
+  return _greater_than(&state->seg[t->rseg].v1, &state->seg[t->rseg].v0);
+}
+
+/* x of segment s at height y */
+static double segment_x(segment_t *s, double y)
+{
+  if (s->v1.y == s->v0.y)
+    return s->v0.x;
+  return s->v0.x + (y - s->v0.y) * (s->v1.x - s->v0.x) / (s->v1.y - s->v0.y);
+}
+
+static void export_trapezoid(SeidelTriangulator* state, trap_t *t, seideltrap_t *out)
+{
+  out->y0 = t->lo.y;
+  out->y1 = t->hi.y;
+  out->xl0 = segment_x(&state->seg[t->lseg], t->lo.y);
+  out->xr0 = segment_x(&state->seg[t->rseg], t->lo.y);
+  out->xl1 = segment_x(&state->seg[t->lseg], t->hi.y);
+  out->xr1 = segment_x(&state->seg[t->rseg], t->hi.y);
+}
+
+static int cmp_trapezoid(const void *a, const void *b)
+{
+  const seideltrap_t *p = (const seideltrap_t *) a, *q = (const seideltrap_t *) b;
+
+  if (p->y0 != q->y0)
+    return (p->y0 < q->y0) ? -1 : 1;
+  return (p->xl0 < q->xl0) ? -1 : (p->xl0 > q->xl0);
+}
+
+
+/* The trapezoids inside the polygon last given to trapezoidate_polygon()
+ * or triangulate_polygon(), bottom up, into traps[] unless it is NULL.
+ * There are at most state->tr_idx of them. Returns their number or the
+ * error of the last run.
+ */
+int seidel_trapezoids(SeidelTriangulator* state, seideltrap_t *traps)
+{
+  int i, n = 0;
+
+  if (state->error)
+    return state->error;
+  for (i = 1; i < state->tr_idx; i++)
+    if (inside_trapezoid(state, &state->tr[i]))
+      {
+	if (traps)
+	  export_trapezoid(state, &state->tr[i], &traps[n]);
+	n++;
+      }
+  if (traps)
+    qsort(traps, n, sizeof(seideltrap_t), cmp_trapezoid);
+  return n;
+}
+
+
+/* row[0..n-1] += w */
+static void fill_span(float *row, int n, float w)
+{
+  int i = 0;
+
+#if FLANES > 1
+  vfloat vw = VSET1(w);
+
+  for (; i + FLANES <= n; i += FLANES)
+    VSTORE(row + i, VADD(VLOAD(row + i), vw));
+#endif
+  for (; i < n; i++)
+    row[i] += w;
+}
+
+/* Add weight w to the pixels of row covered by [xl, xr). Without */
+/* antialiasing a pixel is in if its centre is */
+static void add_span(float *row, int width, double xl, double xr, float w, int aa)
+{
+  int il, ir;
+
+  if (!aa)
+    {
+      /* clamped while still double: far off the row is no int */
+      il = (int) ceil(MIN(MAX(xl - 0.5, 0), width));
+      ir = (int) ceil(MIN(MAX(xr - 0.5, 0), width));
+      if (ir > il)
+	fill_span(row + il, ir - il, w);
+      return;
+    }
+
+  xl = MAX(xl, 0);
+  xr = MIN(xr, width);
+  if (!(xr > xl))
+    return;
+  il = (int) xl;
+  ir = (int) xr;
+  if (il == ir)
+    {
+      row[il] += w * (float) (xr - xl);
+      return;
+    }
+  row[il] += w * (float) (il + 1 - xl);
+  fill_span(row + il + 1, ir - il - 1, w);
+  if (ir < width)
+    row[ir] += w * (float) (xr - ir);
+}
+
+/* Fill coverage[width * height] with how much of each pixel the
+ * polygon last given to trapezoidate_polygon() or triangulate_polygon()
+ * covers, 0 to 1. Pixel (i, j) is coverage[j * width + i] and covers
+ * [x0 + i / scale, x0 + (i + 1) / scale) across and the same from y0 up;
+ * flip the rows for an image with y down. samples is 0 for hard edges,
+ * a pixel being in if its centre is, or the number of sub-scanlines a
+ * row is sampled with for antialiasing, coverage across each being
+ * exact. Returns 0 or the error of the last run.
+ */
+int seidel_rasterize(SeidelTriangulator* state, float *coverage, int width, int height,
+		     double x0, double y0, double scale, int samples)
+{
+  int i, k, k0, k1, nsub = (samples > 0) ? samples : 1;
+  double py0, py1, xl0, xr0, dl, dr, ys;
+  float w = 1.0f / nsub, *row;
+  seideltrap_t t;
+  trap_t *tr;
+
+  if (state->error)
+    return state->error;
+  if ((width <= 0) || (height <= 0) || !(scale > 0))
+    return SEIDEL_ERR_INPUT;
+  memset(coverage, 0, sizeof(float) * width * height);
+
+  for (i = 1; i < state->tr_idx; i++)
+    {
+      tr = &state->tr[i];
+      if (!inside_trapezoid(state, tr))
+	continue;
+      export_trapezoid(state, tr, &t);
+
+      /* to pixels, and to the sub-scanlines (k + 0.5) / nsub in */
+      /* [py0, py1) that cross it */
+      py0 = (t.y0 - y0) * scale;
+      py1 = (t.y1 - y0) * scale;
+      xl0 = (t.xl0 - x0) * scale;
+      xr0 = (t.xr0 - x0) * scale;
+      if (!(py1 > 0) || !(py0 < height) ||
+	  !(MAX(xr0, (t.xr1 - x0) * scale) > 0) ||
+	  !(MIN(xl0, (t.xl1 - x0) * scale) < width))
+	continue;		/* wholly off the raster */
+      k0 = (int) ceil(MAX(py0 * nsub - 0.5, 0));
+      k1 = (int) ceil(MIN(py1 * nsub - 0.5, (double) height * nsub));
+      if (k1 <= k0)
+	continue;
+      dl = (t.xl1 - t.xl0) * scale / (py1 - py0);
+      dr = (t.xr1 - t.xr0) * scale / (py1 - py0);
+
+      for (k = k0; k < k1; k++)
+	{
+	  ys = (k + 0.5) / nsub - py0;
+	  row = coverage + (size_t) (k / nsub) * width;
+	  add_span(row, width, xl0 + dl * ys, xr0 + dr * ys, w, samples > 0);
+	}
+    }
+
+  if (samples > 0)
+    for (i = 0; i < width * height; i++)
+      if (coverage[i] > 1.0f)
+	coverage[i] = 1.0f;
+  return 0;
+}
@@ -0,0 +1,451 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <math.h>
+
+
+/* Visvalingam-Whyatt simplification that keeps the polygon simple.
+ * Each vertex is weighted by the area of the triangle it forms with
+ * its two neighbours, and the lightest vertex is removed until every
+ * remaining weight is at least tolerance * tolerance. A vertex is only
+ * removed when no other vertex lies in or on that triangle: the new
+ * edge then cannot meet any other edge, so no contour crosses itself,
+ * another hole or the outer contour. Contours keep at least three
+ * points and their orientation; holes whose area drops below the
+ * threshold are dropped. Candidate vertices are looked up in a uniform
+ * grid, so each removal costs O(log n) plus the points near the
+ * triangle.
+ */
+
+typedef struct {
+  double (*v)[2];
+  int *prev, *next;		/* ring of each contour */
+  int *contour;			/* contour of each vertex */
+  int *alive;
+  int *count;			/* points left per contour */
+  double *carea;		/* signed area per contour */
+  double *weight;
+  int *heap, *pos, nheap;	/* min-heap on weight, pos 0 if out */
+  int *cellhead, *cellnext, *cellprev, *cellof;
+  int gw, gh;
+  double x0, y0, cw, ch;
+} simplify_t;
+
+
+static double tri_cross(double *a, double *b, double *c)
+{
+  return (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+}
+
+
+static void heap_swap(simplify_t *s, int i, int j)
+{
+  int t = s->heap[i];
+
+  s->heap[i] = s->heap[j];
+  s->heap[j] = t;
+  s->pos[s->heap[i]] = i;
+  s->pos[s->heap[j]] = j;
+}
+
+static void heap_up(simplify_t *s, int i)
+{
+  while ((i > 1) && (s->weight[s->heap[i]] < s->weight[s->heap[i / 2]]))
+    {
+      heap_swap(s, i, i / 2);
+      i /= 2;
+    }
+}
+
+static void heap_down(simplify_t *s, int i)
+{
+  for (;;)
+    {
+      int m = i, l = 2 * i, r = 2 * i + 1;
+
+      if ((l <= s->nheap) && (s->weight[s->heap[l]] < s->weight[s->heap[m]]))
+	m = l;
+      if ((r <= s->nheap) && (s->weight[s->heap[r]] < s->weight[s->heap[m]]))
+	m = r;
+      if (m == i)
+	return;
+      heap_swap(s, i, m);
+      i = m;
+    }
+}
+
+static void heap_remove(simplify_t *s, int v)
+{
+  int i = s->pos[v];
+
+  if (!i)
+    return;
+  heap_swap(s, i, s->nheap);
+  s->nheap--;
+  s->pos[v] = 0;
+  if (i <= s->nheap)
+    {
+      heap_up(s, i);
+      heap_down(s, i);
+    }
+}
+
+/* (Re)insert v with the weight of its current triangle */
+static void heap_update(simplify_t *s, int v)
+{
+  s->weight[v] = 0.5 * fabs(tri_cross(s->v[s->prev[v]], s->v[v], s->v[s->next[v]]));
+  if (!s->pos[v])
+    {
+      s->pos[v] = ++s->nheap;
+      s->heap[s->nheap] = v;
+    }
+  heap_up(s, s->pos[v]);
+  heap_down(s, s->pos[v]);
+}
+
+
+static int cell_x(simplify_t *s, double x)
+{
+  int i = (int) ((x - s->x0) / s->cw);
+  return (i < 0) ? 0 : ((i >= s->gw) ? s->gw - 1 : i);
+}
+
+static int cell_y(simplify_t *s, double y)
+{
+  int j = (int) ((y - s->y0) / s->ch);
+  return (j < 0) ? 0 : ((j >= s->gh) ? s->gh - 1 : j);
+}
+
+static void cell_unlink(simplify_t *s, int v)
+{
+  if (s->cellprev[v])
+    s->cellnext[s->cellprev[v]] = s->cellnext[v];
+  else
+    s->cellhead[s->cellof[v]] = s->cellnext[v];
+  if (s->cellnext[v])
+    s->cellprev[s->cellnext[v]] = s->cellprev[v];
+}
+
+/* TRUE if a vertex other than a, b and c lies in or on triangle abc */
+static int triangle_blocked(simplify_t *s, int a, int b, int c)
+{
+  double *pa = s->v[a], *pb = s->v[b], *pc = s->v[c];
+  int i0 = cell_x(s, MIN(pa[0], MIN(pb[0], pc[0])));
+  int i1 = cell_x(s, MAX(pa[0], MAX(pb[0], pc[0])));
+  int j0 = cell_y(s, MIN(pa[1], MIN(pb[1], pc[1])));
+  int j1 = cell_y(s, MAX(pa[1], MAX(pb[1], pc[1])));
+  int i, j, p;
+
+  for (j = j0; j <= j1; j++)
+    for (i = i0; i <= i1; i++)
+      for (p = s->cellhead[j * s->gw + i]; p; p = s->cellnext[p])
+	{
+	  double d0, d1, d2;
+
+	  if ((p == a) || (p == b) || (p == c))
+	    continue;
+	  d0 = tri_cross(pa, pb, s->v[p]);
+	  d1 = tri_cross(pb, pc, s->v[p]);
+	  d2 = tri_cross(pc, pa, s->v[p]);
+	  if (!(((d0 < 0) || (d1 < 0) || (d2 < 0)) &&
+		((d0 > 0) || (d1 > 0) || (d2 > 0))))
+	    return TRUE;
+	}
+  return FALSE;
+}
+
+
+/* Simplify the polygon given by ncontours, cntr and vertices (in the
+ * triangulate_polygon() layout) to the given tolerance. The kept
+ * vertices are written as indices into vertices, contour by contour,
+ * to keep[0..]; the sizes of the kept contours go to outcntr. Both
+ * may be as large as the input. The outer contour is always kept.
+ * Returns the number of contours kept, or SEIDEL_ERR_INPUT or
+ * SEIDEL_ERR_NOMEM.
+ */
+int simplify_polygon(int ncontours, int cntr[], double (*vertices)[2],
+		     double tolerance, int outcntr[], int keep[])
+{
+  simplify_t s;
+  double threshold = tolerance * tolerance, xmax, ymax;
+  int c, i, k, n = 0, first, nout;
+
+  if (ncontours <= 0)
+    return SEIDEL_ERR_INPUT;
+  for (c = 0; c < ncontours; c++)
+    {
+      if (cntr[c] < 3)
+	return SEIDEL_ERR_INPUT;
+      n += cntr[c];
+    }
+
+  memset(&s, 0, sizeof(s));
+  s.v = vertices;
+  s.prev = (int *) malloc(sizeof(int) * (n + 1));
+  s.next = (int *) malloc(sizeof(int) * (n + 1));
+  s.contour = (int *) malloc(sizeof(int) * (n + 1));
+  s.alive = (int *) malloc(sizeof(int) * (n + 1));
+  s.count = (int *) malloc(sizeof(int) * ncontours);
+  s.carea = (double *) calloc(ncontours, sizeof(double));
+  s.weight = (double *) malloc(sizeof(double) * (n + 1));
+  s.heap = (int *) malloc(sizeof(int) * (n + 1));
+  s.pos = (int *) calloc(n + 1, sizeof(int));
+  s.cellnext = (int *) malloc(sizeof(int) * (n + 1));
+  s.cellprev = (int *) malloc(sizeof(int) * (n + 1));
+  s.cellof = (int *) malloc(sizeof(int) * (n + 1));
+
+  /* about one point per cell */
+  s.x0 = xmax = vertices[1][0];
+  s.y0 = ymax = vertices[1][1];
+  for (i = 2; i <= n; i++)
+    {
+      s.x0 = MIN(s.x0, vertices[i][0]);
+      s.y0 = MIN(s.y0, vertices[i][1]);
+      xmax = MAX(xmax, vertices[i][0]);
+      ymax = MAX(ymax, vertices[i][1]);
+    }
+  for (s.gw = 1; s.gw * s.gw < n; s.gw++)
+    ;
+  s.gh = s.gw;
+  s.cw = (xmax > s.x0) ? (xmax - s.x0) / s.gw : 1;
+  s.ch = (ymax > s.y0) ? (ymax - s.y0) / s.gh : 1;
+  s.cellhead = (int *) calloc(s.gw * s.gh, sizeof(int));
+
+  if (!s.prev || !s.next || !s.contour || !s.alive || !s.count || !s.carea ||
+      !s.weight || !s.heap || !s.pos || !s.cellnext || !s.cellprev ||
+      !s.cellof || !s.cellhead)
+    {
+      nout = SEIDEL_ERR_NOMEM;
+      goto done;
+    }
+
+  for (c = 0, i = 1; c < ncontours; c++)
+    {
+      s.count[c] = cntr[c];
+      for (first = i, k = 0; k < cntr[c]; k++, i++)
+	{
+	  s.prev[i] = (k == 0) ? first + cntr[c] - 1 : i - 1;
+	  s.next[i] = (k == cntr[c] - 1) ? first : i + 1;
+	  s.contour[i] = c;
+	  s.alive[i] = TRUE;
+	  s.carea[c] += 0.5 * (vertices[i][0] * vertices[s.next[i]][1] -
+			       vertices[s.next[i]][0] * vertices[i][1]);
+	}
+    }
+
+  for (i = 1; i <= n; i++)
+    {
+      int cell = cell_y(&s, vertices[i][1]) * s.gw + cell_x(&s, vertices[i][0]);
+
+      s.cellof[i] = cell;
+      s.cellprev[i] = 0;
+      s.cellnext[i] = s.cellhead[cell];
+      if (s.cellhead[cell])
+	s.cellprev[s.cellhead[cell]] = i;
+      s.cellhead[cell] = i;
+      heap_update(&s, i);
+    }
+
+  while (s.nheap && (s.weight[s.heap[1]] < threshold))
+    {
+      int b = s.heap[1], a = s.prev[b], d = s.next[b];
+      double area;
+
+      c = s.contour[b];
+      heap_remove(&s, b);
+
+      /* keep three points, the orientation, and a clear triangle. A */
+      /* vertex left out here is weighed again when a neighbour goes */
+      area = s.carea[c] - 0.5 * tri_cross(s.v[a], s.v[b], s.v[d]);
+      if ((s.count[c] <= 3) || (area * s.carea[c] <= 0) ||
+	  triangle_blocked(&s, a, b, d))
+	continue;
+
+      s.alive[b] = FALSE;
+      s.count[c]--;
+      s.carea[c] = area;
+      s.next[a] = d;
+      s.prev[d] = a;
+      cell_unlink(&s, b);
+      heap_update(&s, a);
+      heap_update(&s, d);
+    }
+
+  /* write out the survivors, dropping holes below the threshold */
+  for (c = 0, i = 1, nout = 0, k = 0; c < ncontours; i += cntr[c], c++)
+    {
+      int v = i;
+
+      if ((c > 0) && (fabs(s.carea[c]) < threshold))
+	continue;
+      while (!s.alive[v])
+	v++;
+      outcntr[nout++] = s.count[c];
+      first = v;
+      do
+	{
+	  keep[k++] = v;
+	  v = s.next[v];
+	}
+      while (v != first);
+    }
+
+ done:
+  free(s.prev);
+  free(s.next);
+  free(s.contour);
+  free(s.alive);
+  free(s.count);
+  free(s.carea);
+  free(s.weight);
+  free(s.heap);
+  free(s.pos);
+  free(s.cellhead);
+  free(s.cellnext);
+  free(s.cellprev);
+  free(s.cellof);
+  return nout;
+}
+
+
+/* Level-of-detail pyramid. Level 0 is the polygon simplified to
+ * tolerance, each further level to factor times the tolerance of the
+ * one before, starting from the points the previous level kept. Every
+ * level is triangulated once, its triangles given as indices into the
+ * original vertices so that all levels share one vertex buffer.
+ */
+SeidelLOD* SeidelLODCreate(int ncontours, int cntr[], double (*vertices)[2],
+			   int nlevels, double tolerance, double factor)
+{
+  SeidelLOD *lod;
+  SeidelTriangulator *state = NULL;
+  double (*pts)[2];
+  int *keep, *prevkeep, *lcntr, *prevcntr;
+  int c, i, k, n = 0, prevcontours, err = 0;
+
+  if ((ncontours <= 0) || (nlevels <= 0))
+    return NULL;
+  for (c = 0; c < ncontours; c++)
+    {
+      if (cntr[c] < 3)
+	return NULL;
+      n += cntr[c];
+    }
+
+  lod = (SeidelLOD *) calloc(1, sizeof(SeidelLOD));
+  if (!lod)
+    return NULL;
+  lod->level = (seidellevel_t *) calloc(nlevels, sizeof(seidellevel_t));
+  pts = (double (*)[2]) malloc(sizeof(double) * 2 * (n + 1));
+  keep = (int *) malloc(sizeof(int) * n);
+  prevkeep = (int *) malloc(sizeof(int) * n);
+  lcntr = (int *) malloc(sizeof(int) * ncontours);
+  prevcntr = (int *) malloc(sizeof(int) * ncontours);
+  if (!lod->level || !pts || !keep || !prevkeep || !lcntr || !prevcntr)
+    err = SEIDEL_ERR_NOMEM;
+
+  /* the previous level starts out as the input */
+  prevcontours = ncontours;
+  for (c = 0; !err && c < ncontours; c++)
+    prevcntr[c] = cntr[c];
+  for (i = 0; !err && i < n; i++)
+    prevkeep[i] = i + 1;
+
+  for (k = 0; !err && k < nlevels; k++)
+    {
+      seidellevel_t *lv = &lod->level[k];
+      int m = 0, ncont, *t;
+
+      for (c = 0; c < prevcontours; c++)
+	m += prevcntr[c];
+      for (i = 0; i < m; i++)
+	{
+	  pts[i + 1][0] = vertices[prevkeep[i]][0];
+	  pts[i + 1][1] = vertices[prevkeep[i]][1];
+	}
+
+      ncont = simplify_polygon(prevcontours, prevcntr, pts, tolerance, lcntr, keep);
+      if (ncont < 0)
+	{
+	  err = ncont;
+	  break;
+	}
+      for (c = 0, m = 0; c < ncont; c++)
+	m += lcntr[c];
+      for (i = 0; i < m; i++)
+	{
+	  keep[i] = prevkeep[keep[i] - 1];	/* back to the input */
+	  pts[i + 1][0] = vertices[keep[i]][0];
+	  pts[i + 1][1] = vertices[keep[i]][1];
+	}
+
+      lv->tolerance = tolerance;
+      lv->nvert = m;
+      lv->ncontours = ncont;
+      lv->triangles = (int (*)[3]) malloc(sizeof(int) * 3 * (m + 2 * ncont));
+      lod->nlevels = k + 1;
+      if (!lv->triangles)
+	{
+	  err = SEIDEL_ERR_NOMEM;
+	  break;
+	}
+      if (state && (state->segSize <= m))
+	{
+	  SeidelTriangulatorRelease(state);
+	  state = NULL;
+	}
+      lv->ntriangles = triangulate_polygon(&state, ncont, lcntr, pts, lv->triangles);
+      if (lv->ntriangles < 0)
+	{
+	  err = lv->ntriangles;
+	  break;
+	}
+      for (t = &lv->triangles[0][0], i = 0; i < 3 * lv->ntriangles; i++)
+	t[i] = keep[t[i] - 1];
+
+      memcpy(prevkeep, keep, sizeof(int) * m);
+      memcpy(prevcntr, lcntr, sizeof(int) * ncont);
+      prevcontours = ncont;
+      tolerance *= factor;
+    }
+
+  SeidelTriangulatorRelease(state);
+  free(pts);
+  free(keep);
+  free(prevkeep);
+  free(lcntr);
+  free(prevcntr);
+  if (err)
+    {
+      SeidelLODRelease(lod);
+      return NULL;
+    }
+  return lod;
+}
+
+
+void SeidelLODRelease(SeidelLOD* lod)
+{
+  int k;
+
+  if (!lod)
+    return;
+  if (lod->level)
+    for (k = 0; k < lod->nlevels; k++)
+      free(lod->level[k].triangles);
+  free(lod->level);
+  free(lod);
+}
+
+
+/* The coarsest level whose tolerance does not exceed the given one, */
+/* e.g. the size of a pixel in polygon units. Level 0 if none does */
+int seidel_lod_select(SeidelLOD* lod, double tolerance)
+{
+  int k;
+
+  for (k = lod->nlevels - 1; k > 0; k--)
+    if (lod->level[k].tolerance <= tolerance)
+      return k;
+  return 0;
+}
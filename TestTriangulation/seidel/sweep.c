@@ -0,0 +1,939 @@
+#include "triangulate.h"
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+
+/* Sweep-line status: a treap of items ordered by a caller supplied
+ * comparison, with parent links so that the neighbours of an item can
+ * be found from its node alone. Node 0 is the nil node. An optional
+ * update routine is called bottom-up on every node whose subtree
+ * changed, for structures that keep subtree aggregates.
+ */
+
+int sweepline_init(sweepline_t *sl, int capacity, int (*cmp)(void *, int, int),
+		   void (*update)(void *, sweepline_t *, int), void *ctx)
+{
+  sl->node = (sweepnode_t *) malloc(sizeof(sweepnode_t) * (capacity + 1));
+  if (sl->node == NULL)
+    return -1;
+  memset(&sl->node[0], 0, sizeof(sweepnode_t));
+  sl->size = 1;
+  sl->capacity = capacity + 1;
+  sl->root = 0;
+  sl->freelist = 0;
+  sl->seed = 0x9e3779b9u;
+  sl->cmp = cmp;
+  sl->update = update;
+  sl->ctx = ctx;
+  return 0;
+}
+
+
+void sweepline_free(sweepline_t *sl)
+{
+  free(sl->node);
+  sl->node = NULL;
+  sl->root = sl->size = sl->capacity = 0;
+}
+
+
+static void sweepline_fix(sweepline_t *sl, int n)
+{
+  if (sl->update && (n > 0))
+    sl->update(sl->ctx, sl, n);
+}
+
+
+/* Rotate n above its parent */
+static void sweepline_rotate_up(sweepline_t *sl, int n)
+{
+  sweepnode_t *nd = sl->node;
+  int p = nd[n].parent, g = nd[p].parent;
+
+  if (nd[p].left == n)
+    {
+      nd[p].left = nd[n].right;
+      if (nd[n].right)
+	nd[nd[n].right].parent = p;
+      nd[n].right = p;
+    }
+  else
+    {
+      nd[p].right = nd[n].left;
+      if (nd[n].left)
+	nd[nd[n].left].parent = p;
+      nd[n].left = p;
+    }
+  nd[p].parent = n;
+  nd[n].parent = g;
+
+  if (g == 0)
+    sl->root = n;
+  else if (nd[g].left == p)
+    nd[g].left = n;
+  else
+    nd[g].right = n;
+
+  sweepline_fix(sl, p);
+  sweepline_fix(sl, n);
+}
+
+
+/* Insert item. Items comparing equal to one already present go after
+ * it. Returns the node holding the item, or 0 if out of memory.
+ */
+int sweepline_insert(sweepline_t *sl, int item)
+{
+  sweepnode_t *nd;
+  int n, t, p = 0, goleft = FALSE;
+
+  if (sl->freelist)
+    {
+      n = sl->freelist;
+      sl->freelist = sl->node[n].right;
+    }
+  else
+    {
+      if (sl->size == sl->capacity)
+	{
+	  int capacity = 2 * sl->capacity;
+	  sweepnode_t *grown = (sweepnode_t *)
+	    realloc(sl->node, sizeof(sweepnode_t) * capacity);
+
+	  if (grown == NULL)
+	    return 0;
+	  sl->node = grown;
+	  sl->capacity = capacity;
+	}
+      n = sl->size++;
+    }
+
+  nd = sl->node;
+  sl->seed = sl->seed * 1664525u + 1013904223u;
+  nd[n].prio = sl->seed;
+  nd[n].item = item;
+  nd[n].left = nd[n].right = 0;
+
+  for (t = sl->root; t; t = goleft ? nd[t].left : nd[t].right)
+    {
+      p = t;
+      goleft = (sl->cmp(sl->ctx, item, nd[t].item) < 0);
+    }
+
+  nd[n].parent = p;
+  if (p == 0)
+    sl->root = n;
+  else if (goleft)
+    nd[p].left = n;
+  else
+    nd[p].right = n;
+
+  sweepline_fix(sl, n);
+  while (nd[n].parent && (nd[nd[n].parent].prio > nd[n].prio))
+    sweepline_rotate_up(sl, n);
+  for (t = nd[n].parent; t; t = nd[t].parent)
+    sweepline_fix(sl, t);
+
+  return n;
+}
+
+
+void sweepline_remove(sweepline_t *sl, int n)
+{
+  sweepnode_t *nd = sl->node;
+  int c, p;
+
+  /* rotate down until n is a leaf or has a single child */
+  while (nd[n].left && nd[n].right)
+    {
+      c = (nd[nd[n].left].prio < nd[nd[n].right].prio) ?
+	nd[n].left : nd[n].right;
+      sweepline_rotate_up(sl, c);
+    }
+
+  c = nd[n].left ? nd[n].left : nd[n].right;
+  p = nd[n].parent;
+  if (c)
+    nd[c].parent = p;
+  if (p == 0)
+    sl->root = c;
+  else if (nd[p].left == n)
+    nd[p].left = c;
+  else
+    nd[p].right = c;
+
+  for (; p; p = nd[p].parent)
+    sweepline_fix(sl, p);
+
+  nd[n].right = sl->freelist;
+  sl->freelist = n;
+}
+
+
+int sweepline_prev(sweepline_t *sl, int n)
+{
+  sweepnode_t *nd = sl->node;
+
+  if (nd[n].left)
+    {
+      for (n = nd[n].left; nd[n].right; n = nd[n].right)
+	;
+      return n;
+    }
+  while (nd[n].parent && (nd[nd[n].parent].left == n))
+    n = nd[n].parent;
+  return nd[n].parent;
+}
+
+
+int sweepline_next(sweepline_t *sl, int n)
+{
+  sweepnode_t *nd = sl->node;
+
+  if (nd[n].right)
+    {
+      for (n = nd[n].right; nd[n].left; n = nd[n].left)
+	;
+      return n;
+    }
+  while (nd[n].parent && (nd[nd[n].parent].right == n))
+    n = nd[n].parent;
+  return nd[n].parent;
+}
+
+
+/* Sign of the area of (v0, v1, v2) */
+static int orient(point_t *v0, point_t *v1, point_t *v2)
+{
+  double area = CROSS((*v0), (*v1), (*v2));
+
+  return (area > 0) - (area < 0);
+}
+
+
+/* v is known to be collinear with segment (v0, v1): is it on it? */
+static int on_segment(point_t *v0, point_t *v1, point_t *v)
+{
+  return ((MIN(v0->x, v1->x) <= v->x) && (v->x <= MAX(v0->x, v1->x)) &&
+	  (MIN(v0->y, v1->y) <= v->y) && (v->y <= MAX(v0->y, v1->y)));
+}
+
+
+/* TRUE if the closed segments (a0, a1) and (b0, b1) have a point in
+ * common, touching included.
+ */
+int segments_intersect(point_t *a0, point_t *a1, point_t *b0, point_t *b1)
+{
+  int o1 = orient(a0, a1, b0), o2 = orient(a0, a1, b1);
+  int o3 = orient(b0, b1, a0), o4 = orient(b0, b1, a1);
+
+  if ((o1 != o2) && (o3 != o4))
+    return TRUE;
+
+  return (((o1 == 0) && on_segment(a0, a1, b0)) ||
+	  ((o2 == 0) && on_segment(a0, a1, b1)) ||
+	  ((o3 == 0) && on_segment(b0, b1, a0)) ||
+	  ((o4 == 0) && on_segment(b0, b1, a1)));
+}
+
+
+/* Segments (u, v) and (v, w) follow each other along a contour. They
+ * only meet improperly if the contour doubles back on itself.
+ */
+static int adjacent_overlap(point_t *u, point_t *v, point_t *w)
+{
+  return ((orient(u, v, w) == 0) &&
+	  ((v->x - u->x) * (w->x - v->x) + (v->y - u->y) * (w->y - v->y) <= 0));
+}
+
+
+/* Shamos-Hoey sweep over the contours of a polygon. */
+
+typedef struct {
+  point_t *v;			/* input vertices, v[1..n] */
+  int *next;			/* next vertex along the contour */
+} sweepctx_t;
+
+typedef struct {
+  double x, y;
+  int insert;			/* TRUE at the left end of a segment */
+  int segnum;
+} sweepevent_t;
+
+
+/* y of segment s (from v[s] to v[next[s]]) at abscissa x. Vertical
+ * segments answer with their lower end.
+ */
+static double seg_y_at(sweepctx_t *sc, int s, double x)
+{
+  point_t *p = &sc->v[s], *q = &sc->v[sc->next[s]];
+
+  if (p->x == q->x)
+    return MIN(p->y, q->y);
+  if (x <= MIN(p->x, q->x))
+    return (p->x < q->x) ? p->y : q->y;
+  if (x >= MAX(p->x, q->x))
+    return (p->x < q->x) ? q->y : p->y;
+  return p->y + (q->y - p->y) * (x - p->x) / (q->x - p->x);
+}
+
+
+static int seg_compare(void *ctx, int a, int b)
+{
+  sweepctx_t *sc = (sweepctx_t *) ctx;
+  point_t *a0 = &sc->v[a], *a1 = &sc->v[sc->next[a]];
+  point_t *b0 = &sc->v[b], *b1 = &sc->v[sc->next[b]];
+  double x = MAX(MIN(a0->x, a1->x), MIN(b0->x, b1->x));
+  double ya = seg_y_at(sc, a, x), yb = seg_y_at(sc, b, x);
+  double da, db;
+
+  if (ya < yb - C_EPS)
+    return -1;
+  if (ya > yb + C_EPS)
+    return 1;
+
+  /* meeting at x, e.g. leaving a common vertex: the lesser slope is
+   * below from there on. Vertical segments go above.
+   */
+  if ((a0->x == a1->x) || (b0->x == b1->x))
+    return (a0->x == a1->x) - (b0->x == b1->x);
+  da = (a1->y - a0->y) * fabs(b1->x - b0->x) * ((a1->x > a0->x) ? 1 : -1);
+  db = (b1->y - b0->y) * fabs(a1->x - a0->x) * ((b1->x > b0->x) ? 1 : -1);
+  return (da > db) - (da < db);
+}
+
+
+static int event_compare(const void *p, const void *q)
+{
+  const sweepevent_t *a = (const sweepevent_t *) p;
+  const sweepevent_t *b = (const sweepevent_t *) q;
+
+  if (a->x != b->x)
+    return (a->x < b->x) ? -1 : 1;
+  if (a->insert != b->insert)
+    return a->insert ? -1 : 1;	/* inserts first */
+  if (a->y != b->y)
+    return (a->y < b->y) ? -1 : 1;
+  return a->segnum - b->segnum;
+}
+
+
+/* Do segments a and b cross, or touch anywhere but at the vertex
+ * they share along a contour?
+ */
+static int segs_conflict(sweepctx_t *sc, int a, int b)
+{
+  point_t *v = sc->v;
+
+  if (sc->next[a] == b)
+    return adjacent_overlap(&v[a], &v[b], &v[sc->next[b]]) ||
+      ((sc->next[b] == a) && (a != b));
+  if (sc->next[b] == a)
+    return adjacent_overlap(&v[b], &v[a], &v[sc->next[a]]);
+
+  return segments_intersect(&v[a], &v[sc->next[a]], &v[b], &v[sc->next[b]]);
+}
+
+
+/* Check that the contours of a polygon, given in the same layout as
+ * for triangulate_polygon(), form a simple polygon: no two edges
+ * cross or touch except consecutive edges at their common vertex, and
+ * every contour has at least three points. Runs in O(n log n).
+ *
+ * Returns TRUE if so. Otherwise returns FALSE and, when sega and segb
+ * are not NULL, the first offending pair in sweep order. Segment i
+ * runs from vertices[i] to the next vertex of its contour. Running out
+ * of memory also returns FALSE, with both segments 0.
+ */
+int validate_polygon(int ncontours, int cntr[], double (*vertices)[2], int *sega, int *segb)
+{
+  sweepctx_t sc;
+  sweepline_t sl;
+  sweepevent_t *ev;
+  int *where;
+  int i, j, c, n = 0, first, nb, pb;
+  int fa = 0, fb = 0;
+
+  for (c = 0; c < ncontours; c++)
+    {
+      if (cntr[c] < 3)
+	{
+	  if (sega)
+	    *sega = n + 1;
+	  if (segb)
+	    *segb = n + 1;
+	  return FALSE;
+	}
+      n += cntr[c];
+    }
+
+  sc.v = (point_t *) malloc(sizeof(point_t) * (n + 1));
+  sc.next = (int *) malloc(sizeof(int) * (n + 1));
+  where = (int *) malloc(sizeof(int) * (n + 1));
+  ev = (sweepevent_t *) malloc(sizeof(sweepevent_t) * (2 * n + 1));
+  if (!sc.v || !sc.next || !where || !ev ||
+      sweepline_init(&sl, n, seg_compare, NULL, &sc))
+    {
+      free(ev);
+      free(where);
+      free(sc.next);
+      free(sc.v);
+      if (sega)
+	*sega = 0;
+      if (segb)
+	*segb = 0;
+      return FALSE;
+    }
+
+  for (i = 1, c = 0; c < ncontours; c++)
+    for (first = i, j = 0; j < cntr[c]; j++, i++)
+      {
+	sc.v[i].x = vertices[i][0];
+	sc.v[i].y = vertices[i][1];
+	sc.next[i] = (j == cntr[c] - 1) ? first : i + 1;
+      }
+
+  for (i = 1; i <= n; i++)
+    {
+      point_t *p = &sc.v[i], *q = &sc.v[sc.next[i]];
+      int pleft = (p->x < q->x) || ((p->x == q->x) && (p->y < q->y));
+
+      ev[2 * i - 2].x = pleft ? p->x : q->x;
+      ev[2 * i - 2].y = pleft ? p->y : q->y;
+      ev[2 * i - 2].insert = TRUE;
+      ev[2 * i - 1].x = pleft ? q->x : p->x;
+      ev[2 * i - 1].y = pleft ? q->y : p->y;
+      ev[2 * i - 1].insert = FALSE;
+      ev[2 * i - 2].segnum = ev[2 * i - 1].segnum = i;
+    }
+  qsort(ev, 2 * n, sizeof(sweepevent_t), event_compare);
+
+  for (i = 0; (i < 2 * n) && (fa == 0); i++)
+    {
+      int s = ev[i].segnum;
+
+      if (ev[i].insert)
+	{
+	  where[s] = sweepline_insert(&sl, s);
+	  if ((nb = sweepline_next(&sl, where[s])) &&
+	      segs_conflict(&sc, s, sl.node[nb].item))
+	    {
+	      fa = s;
+	      fb = sl.node[nb].item;
+	    }
+	  else if ((pb = sweepline_prev(&sl, where[s])) &&
+		   segs_conflict(&sc, s, sl.node[pb].item))
+	    {
+	      fa = s;
+	      fb = sl.node[pb].item;
+	    }
+	}
+      else
+	{
+	  nb = sweepline_next(&sl, where[s]);
+	  pb = sweepline_prev(&sl, where[s]);
+	  if (nb && pb && segs_conflict(&sc, sl.node[pb].item, sl.node[nb].item))
+	    {
+	      fa = sl.node[pb].item;
+	      fb = sl.node[nb].item;
+	    }
+	  sweepline_remove(&sl, where[s]);
+	}
+    }
+
+  if (sega)
+    *sega = fa;
+  if (segb)
+    *segb = fb;
+
+  sweepline_free(&sl);
+  free(ev);
+  free(where);
+  free(sc.next);
+  free(sc.v);
+  return (fa == 0);
+}
+
+
+/* Incremental variant for edges appended one at a time, e.g. while a
+ * contour is being drawn. The edges are kept in a treap keyed on
+ * their leftmost x, each node holding the largest rightmost x of its
+ * subtree, so a query only visits edges whose x-extent overlaps that
+ * of the new edge: O(log n + k).
+ */
+
+static int edge_compare(void *ctx, int a, int b)
+{
+  SeidelEdgeSet *es = (SeidelEdgeSet *) ctx;
+  double xa = es->edge[a].xmin, xb = es->edge[b].xmin;
+
+  return (xa < xb) ? -1 : (xa > xb);
+}
+
+
+static void edge_update(void *ctx, sweepline_t *sl, int n)
+{
+  SeidelEdgeSet *es = (SeidelEdgeSet *) ctx;
+  sweepnode_t *nd = sl->node;
+  double m = es->edge[nd[n].item].xmax;
+
+  if (nd[n].left && (es->edge[nd[nd[n].left].item].maxx > m))
+    m = es->edge[nd[nd[n].left].item].maxx;
+  if (nd[n].right && (es->edge[nd[nd[n].right].item].maxx > m))
+    m = es->edge[nd[nd[n].right].item].maxx;
+  es->edge[nd[n].item].maxx = m;
+}
+
+
+/* An empty set with room for capacity edges, or NULL if out of memory */
+SeidelEdgeSet* SeidelEdgeSetCreate(int capacity)
+{
+  SeidelEdgeSet *es = (SeidelEdgeSet *) malloc(sizeof(SeidelEdgeSet));
+
+  if (es == NULL)
+    return NULL;
+  if (capacity < 16)
+    capacity = 16;
+  es->edge = (edgeentry_t *) malloc(sizeof(edgeentry_t) * (capacity + 1));
+  es->nedges = 0;
+  es->capacity = capacity + 1;
+  if ((es->edge == NULL) ||
+      sweepline_init(&es->tree, capacity, edge_compare, edge_update, es))
+    {
+      free(es->edge);
+      free(es);
+      return NULL;
+    }
+  return es;
+}
+
+
+void SeidelEdgeSetRelease(SeidelEdgeSet *es)
+{
+  if (!es) return;
+  sweepline_free(&es->tree);
+  free(es->edge);
+  free(es);
+}
+
+
+void edge_set_clear(SeidelEdgeSet *es)
+{
+  es->nedges = 0;
+  es->tree.root = 0;
+  es->tree.size = 1;
+  es->tree.freelist = 0;
+}
+
+
+/* Add edge (x0, y0)-(x1, y1). Returns its id, counted from 1, or 0 */
+/* if out of memory. */
+int edge_set_add(SeidelEdgeSet *es, double x0, double y0, double x1, double y1)
+{
+  edgeentry_t *e;
+  int id;
+
+  if (es->nedges + 1 == es->capacity)
+    {
+      int capacity = 2 * es->capacity;
+      edgeentry_t *grown = (edgeentry_t *)
+	realloc(es->edge, sizeof(edgeentry_t) * capacity);
+
+      if (grown == NULL)
+	return 0;
+      es->edge = grown;
+      es->capacity = capacity;
+    }
+
+  id = ++es->nedges;
+  e = &es->edge[id];
+  e->v0.x = x0;
+  e->v0.y = y0;
+  e->v1.x = x1;
+  e->v1.y = y1;
+  e->xmin = MIN(x0, x1);
+  e->xmax = e->maxx = MAX(x0, x1);
+  if (!sweepline_insert(&es->tree, id))
+    {
+      es->nedges--;
+      return 0;
+    }
+  return id;
+}
+
+
+/* Query state for edge_set_intersects() and edge_grid_intersects() */
+
+typedef struct {
+  point_t a0, a1;
+  double xmin, xmax, ymin, ymax;
+  int adj0, adj1;
+} edgequery_t;
+
+
+static void edge_query_init(edgequery_t *q, double x0, double y0, double x1, double y1, int adj0, int adj1)
+{
+  q->a0.x = x0;
+  q->a0.y = y0;
+  q->a1.x = x1;
+  q->a1.y = y1;
+  q->xmin = MIN(x0, x1);
+  q->xmax = MAX(x0, x1);
+  q->ymin = MIN(y0, y1);
+  q->ymax = MAX(y0, y1);
+  q->adj0 = adj0;
+  q->adj1 = adj1;
+}
+
+
+/* Does the query edge meet edge id, running from v0 to v1? */
+static int edge_meets(edgequery_t *q, int id, point_t *v0, point_t *v1)
+{
+  if ((MAX(v0->x, v1->x) < q->xmin) || (MIN(v0->x, v1->x) > q->xmax) ||
+      (MAX(v0->y, v1->y) < q->ymin) || (MIN(v0->y, v1->y) > q->ymax))
+    return FALSE;
+
+  if ((id == q->adj0) || (id == q->adj1))
+    {
+      point_t *shared = (id == q->adj0) ? &q->a0 : &q->a1;
+      point_t *far = (id == q->adj0) ? &q->a1 : &q->a0;
+      point_t *other = _equal_to(v0, shared) ? v1 : v0;
+
+      return adjacent_overlap(other, shared, far);
+    }
+  return segments_intersect(&q->a0, &q->a1, v0, v1);
+}
+
+
+static int edge_query(SeidelEdgeSet *es, edgequery_t *q, int n)
+{
+  sweepnode_t *nd = es->tree.node;
+  edgeentry_t *e;
+  int id, found;
+
+  if (n == 0)
+    return 0;
+  id = nd[n].item;
+  e = &es->edge[id];
+  if (e->maxx < q->xmin)
+    return 0;			/* whole subtree is to the left */
+  if ((found = edge_query(es, q, nd[n].left)))
+    return found;
+  if (e->xmin > q->xmax)
+    return 0;			/* this and the right subtree are beyond */
+
+  if (edge_meets(q, id, &e->v0, &e->v1))
+    return id;
+
+  return edge_query(es, q, nd[n].right);
+}
+
+
+/* Returns the id of an edge of the set that edge (x0, y0)-(x1, y1)
+ * meets, or 0 if there is none. adj0 and adj1 are ids of edges that
+ * end at (x0, y0) and at (x1, y1) respectively (0 for none): meeting
+ * those at the shared vertex is allowed, doubling back over them is
+ * not.
+ */
+int edge_set_intersects(SeidelEdgeSet *es, double x0, double y0, double x1, double y1, int adj0, int adj1)
+{
+  edgequery_t q;
+
+  edge_query_init(&q, x0, y0, x1, y1, adj0, adj1);
+  return edge_query(es, &q, es->tree.root);
+}
+
+
+/* The edges in a uniform grid over the area they are drawn in. Each
+ * edge is entered in every cell it passes through, so a new edge only
+ * looks at the edges of its own cells, and a ray from a point only at
+ * those of the cells it goes through. When the edges come to outnumber
+ * the cells GRID_LOAD times over, the grid is made finer and filled
+ * again, which keeps the cost of adding an edge constant on average.
+ * Edges outside the area go to the border cells: still found, only
+ * slower.
+ */
+
+#define GRID_LOAD 2		/* edges per cell before refining */
+#define GRID_MAX_SIDE 2048
+#define GRID_SLACK 1e-6		/* of a cell, against rounding at cell boundaries */
+
+
+static int grid_cell_of(double t, int side)
+{
+  if (!(t >= 1.0))
+    return 0;
+  if (t >= side)
+    return side - 1;
+  return (int) t;
+}
+
+
+/* Call visit() for every cell segment (a, b) passes through, a little
+ * more, row by row. Stops at, and returns, the first nonzero it gives.
+ */
+static int grid_walk(SeidelEdgeGrid *eg, point_t *a, point_t *b,
+		     int (*visit)(SeidelEdgeGrid *, int, void *), void *ctx)
+{
+  double ymin = MIN(a->y, b->y), ymax = MAX(a->y, b->y);
+  double lo, hi, xa, xb;
+  int r, r0, r1, c, c0, c1, found;
+
+  r0 = grid_cell_of((ymin - eg->y0) / eg->ch - GRID_SLACK, eg->side);
+  r1 = grid_cell_of((ymax - eg->y0) / eg->ch + GRID_SLACK, eg->side);
+  for (r = r0; r <= r1; r++)
+    {
+      /* the part of the segment within the row, the border rows */
+      /* reaching out to infinity */
+      lo = (r == 0) ? ymin : MAX(ymin, eg->y0 + (r - GRID_SLACK) * eg->ch);
+      hi = (r == eg->side - 1) ? ymax : MIN(ymax, eg->y0 + (r + 1 + GRID_SLACK) * eg->ch);
+      if (a->y == b->y)
+	{
+	  xa = MIN(a->x, b->x);
+	  xb = MAX(a->x, b->x);
+	}
+      else
+	{
+	  xa = a->x + (b->x - a->x) * (lo - a->y) / (b->y - a->y);
+	  xb = a->x + (b->x - a->x) * (hi - a->y) / (b->y - a->y);
+	  if (xa > xb)
+	    {
+	      double t = xa;
+
+	      xa = xb;
+	      xb = t;
+	    }
+	}
+      c0 = grid_cell_of((xa - eg->x0) / eg->cw - GRID_SLACK, eg->side);
+      c1 = grid_cell_of((xb - eg->x0) / eg->cw + GRID_SLACK, eg->side);
+      for (c = c0; c <= c1; c++)
+	if ((found = visit(eg, r * eg->side + c, ctx)))
+	  return found;
+    }
+  return 0;
+}
+
+
+static int grid_enter(SeidelEdgeGrid *eg, int cell, void *ctx)
+{
+  int e = eg->nentries;
+
+  if (e == eg->maxentries)
+    {
+      int maxentries = 2 * eg->maxentries;
+      int *next = (int *) realloc(eg->next, sizeof(int) * maxentries);
+      int *item;
+
+      if (next == NULL)
+	return SEIDEL_ERR_NOMEM;
+      eg->next = next;
+      if ((item = (int *) realloc(eg->item, sizeof(int) * maxentries)) == NULL)
+	return SEIDEL_ERR_NOMEM;
+      eg->item = item;
+      eg->maxentries = maxentries;
+    }
+
+  eg->item[e] = *(int *) ctx;
+  eg->next[e] = eg->head[cell];
+  eg->head[cell] = e;
+  eg->nentries++;
+  return 0;
+}
+
+
+/* Enter edges 1..nedges again, in a grid of side cells across */
+static void grid_fill(SeidelEdgeGrid *eg, int side, double x1, double y1)
+{
+  int id;
+
+  eg->side = side;
+  eg->cw = (x1 - eg->x0) / side;
+  eg->ch = (y1 - eg->y0) / side;
+  eg->nentries = 0;
+  memset(eg->head, 0xff, sizeof(int) * side * side);
+  for (id = 1; id <= eg->nedges; id++)
+    if (grid_walk(eg, &eg->edge[id].v0, &eg->edge[id].v1, grid_enter, &id))
+      break;			/* out of memory: keep what fits */
+}
+
+
+void SeidelEdgeGridRelease(SeidelEdgeGrid *eg)
+{
+  if (!eg) return;
+  free(eg->edge);
+  free(eg->head);
+  free(eg->next);
+  free(eg->item);
+  free(eg);
+}
+
+
+/* A grid over the area from (x0, y0) to (x1, y1), with room for
+ * capacity edges to start with.
+ */
+SeidelEdgeGrid* SeidelEdgeGridCreate(double x0, double y0, double x1, double y1, int capacity)
+{
+  SeidelEdgeGrid *eg = (SeidelEdgeGrid *) calloc(1, sizeof(SeidelEdgeGrid));
+  int side = 1;
+
+  if (eg == NULL)
+    return NULL;
+  if (capacity < 16)
+    capacity = 16;
+  if (!(x1 > x0))
+    x1 = x0 + 1.0;
+  if (!(y1 > y0))
+    y1 = y0 + 1.0;
+  while ((GRID_LOAD * side * side < capacity) && (side < GRID_MAX_SIDE))
+    side *= 2;
+
+  eg->edge = (gridedge_t *) malloc(sizeof(gridedge_t) * (capacity + 1));
+  eg->capacity = capacity + 1;
+  eg->head = (int *) malloc(sizeof(int) * side * side);
+  eg->maxentries = 2 * capacity;
+  eg->next = (int *) malloc(sizeof(int) * eg->maxentries);
+  eg->item = (int *) malloc(sizeof(int) * eg->maxentries);
+  if (!eg->edge || !eg->head || !eg->next || !eg->item)
+    {
+      SeidelEdgeGridRelease(eg);
+      return NULL;
+    }
+  eg->x0 = x0;
+  eg->y0 = y0;
+  grid_fill(eg, side, x1, y1);
+  return eg;
+}
+
+
+void edge_grid_clear(SeidelEdgeGrid *eg)
+{
+  eg->nedges = 0;
+  eg->nentries = 0;
+  memset(eg->head, 0xff, sizeof(int) * eg->side * eg->side);
+}
+
+
+/* Add edge (x0, y0)-(x1, y1). Returns its id, counted from 1, or 0 */
+/* if there is no memory for it */
+int edge_grid_add(SeidelEdgeGrid *eg, double x0, double y0, double x1, double y1)
+{
+  gridedge_t *e;
+  int id;
+
+  if (eg->nedges + 1 == eg->capacity)
+    {
+      int capacity = 2 * eg->capacity;
+      gridedge_t *grown = (gridedge_t *)
+	realloc(eg->edge, sizeof(gridedge_t) * capacity);
+
+      if (grown == NULL)
+	return 0;
+      eg->edge = grown;
+      eg->capacity = capacity;
+    }
+
+  id = ++eg->nedges;
+  e = &eg->edge[id];
+  e->v0.x = x0;
+  e->v0.y = y0;
+  e->v1.x = x1;
+  e->v1.y = y1;
+  e->stamp = 0;
+
+  if ((eg->nedges > GRID_LOAD * eg->side * eg->side) && (eg->side < GRID_MAX_SIDE))
+    {
+      int side = 2 * eg->side;
+      int *head = (int *) realloc(eg->head, sizeof(int) * side * side);
+
+      if (head)
+	{
+	  eg->head = head;
+	  grid_fill(eg, side, eg->x0 + eg->side * eg->cw, eg->y0 + eg->side * eg->ch);
+	  return id;		/* entered with the others */
+	}
+    }
+
+  if (grid_walk(eg, &e->v0, &e->v1, grid_enter, &id))
+    {
+      /* take back the entries it has */
+      eg->nedges--;
+      grid_fill(eg, eg->side, eg->x0 + eg->side * eg->cw, eg->y0 + eg->side * eg->ch);
+      return 0;
+    }
+  return id;
+}
+
+
+/* Start a query: edges marked with the new stamp have been looked at */
+static void grid_stamp(SeidelEdgeGrid *eg)
+{
+  int id;
+
+  if (++eg->stamp == INT_MAX)
+    {
+      for (id = 1; id <= eg->nedges; id++)
+	eg->edge[id].stamp = 0;
+      eg->stamp = 1;
+    }
+}
+
+
+static int grid_query(SeidelEdgeGrid *eg, int cell, void *ctx)
+{
+  edgequery_t *q = (edgequery_t *) ctx;
+  gridedge_t *e;
+  int i, id;
+
+  for (i = eg->head[cell]; i >= 0; i = eg->next[i])
+    {
+      e = &eg->edge[id = eg->item[i]];
+      if (e->stamp == eg->stamp)
+	continue;
+      e->stamp = eg->stamp;
+      if (edge_meets(q, id, &e->v0, &e->v1))
+	return id;
+    }
+  return 0;
+}
+
+
+/* As edge_set_intersects(), looking only at the edges that share a */
+/* cell with the new one */
+int edge_grid_intersects(SeidelEdgeGrid *eg, double x0, double y0, double x1, double y1, int adj0, int adj1)
+{
+  edgequery_t q;
+
+  edge_query_init(&q, x0, y0, x1, y1, adj0, adj1);
+  grid_stamp(eg);
+  return grid_walk(eg, &q.a0, &q.a1, grid_query, &q);
+}
+
+
+/* Number of edges 1..maxid that a ray from (x, y) towards +x crosses,
+ * going through the cells of its row only. When those edges are whole
+ * contours, the point is inside them if the number is odd; for an
+ * outer contour and holes in it, that is inside the outer one and in
+ * none of the holes.
+ */
+int edge_grid_crossings(SeidelEdgeGrid *eg, double x, double y, int maxid)
+{
+  int r = grid_cell_of((y - eg->y0) / eg->ch, eg->side);
+  int c = grid_cell_of((x - eg->x0) / eg->cw, eg->side);
+  int i, id, crossings = 0;
+  gridedge_t *e;
+
+  grid_stamp(eg);
+  for (; c < eg->side; c++)
+    for (i = eg->head[r * eg->side + c]; i >= 0; i = eg->next[i])
+      {
+	e = &eg->edge[id = eg->item[i]];
+	if ((id > maxid) || (e->stamp == eg->stamp))
+	  continue;
+	e->stamp = eg->stamp;
+	if (((e->v0.y > y) != (e->v1.y > y)) &&
+	    (x < e->v0.x + (e->v1.x - e->v0.x) * (y - e->v0.y) / (e->v1.y - e->v0.y)))
+	  crossings++;
+      }
+  return crossings;
+}
@@ -0,0 +1,838 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+
+/* Cutting a polygon to a grid of tiles and triangulating each tile.
+ *
+ * The polygon is cut by one grid line at a time, Weiler-Atherton
+ * style: every contour that crosses the line is broken into chains
+ * lying wholly on one side, the crossing points are sorted along the
+ * line, and the chains of each side are joined back into closed loops
+ * by walking the line from each exit to the next entry. Columns are
+ * split by bisection and each column then by rows, so every point is
+ * handled O(log(#tiles)) times and the last cuts only see what is
+ * left in their tile.
+ *
+ * A point on a line counts as lying on its upper side, which makes the
+ * tiles half-open, unless both its neighbours are above the line: a
+ * hole touching the line from above must be opened up to the walk.
+ * Crossings at the same point are ordered as if the line were moved
+ * an infinitesimal step away, i.e. by the slopes of their edges, and
+ * points closer to the line than C_EPS are moved onto it. Each
+ * crossing point is computed once and copied into both sides, and a
+ * line at coordinate c cuts an edge along a perpendicular line at
+ * exactly c, so neighbouring tiles share their seam vertices bit for
+ * bit: no cracks and no T-junctions.
+ *
+ * Tiles are triangulated independently, on several threads. A vertex
+ * on a grid line can pinch a piece into loops that touch at a point,
+ * which the triangulator cannot take. Such loops are split apart;
+ * the anti-clockwise ones become polygons of their own, and a
+ * clockwise one (a hole touching its outer contour) has its copy of
+ * the point pulled into the hole, to a few C_EPS from its edges.
+ * That covers a sliver outside the polygon but never moves a point
+ * that lies on a seam.
+ */
+
+typedef struct {
+  double (*pt)[2];
+  int npts, ptcap;
+  int *start;			/* loop i is pt[start[i] .. start[i+1]-1] */
+  int nloops, loopcap;
+} loops_t;
+
+typedef struct {
+  double pos, slope;		/* along the line, then the tie-break */
+  double p[2];
+  int lochain, hichain;		/* the chains that meet here */
+  int id;			/* -1 for a point on the line */
+  int loexit;			/* the edge goes from the lower side */
+} crossing_t;
+
+typedef struct {
+  int loop, first, count;	/* input points, cyclic in the loop */
+  int entry, exit;		/* crossings */
+  int side, done;
+} chain_t;
+
+typedef struct {
+  SeidelTiling tiling;		/* must be first */
+  loops_t *piece;		/* what is left in each tile */
+  double origin[2], size[2];
+  int count[2];			/* cols, rows */
+} tiler_t;
+
+
+static int loops_init(loops_t *l, int npts)
+{
+  l->ptcap = (npts > 16) ? npts : 16;
+  l->loopcap = 8;
+  l->npts = l->nloops = 0;
+  l->pt = (double (*)[2]) malloc(sizeof(double) * 2 * l->ptcap);
+  l->start = (int *) malloc(sizeof(int) * (l->loopcap + 1));
+  if (!l->pt || !l->start)
+    {
+      free(l->pt);
+      free(l->start);
+      l->pt = NULL;
+      l->start = NULL;
+      return SEIDEL_ERR_NOMEM;
+    }
+  l->start[0] = 0;
+  return 0;
+}
+
+static void loops_free(loops_t *l)
+{
+  free(l->pt);
+  free(l->start);
+  l->pt = NULL;
+  l->start = NULL;
+}
+
+/* Append a point to the open loop, dropping repeats */
+static int loops_point(loops_t *l, double *p)
+{
+  if ((l->npts > l->start[l->nloops]) &&
+      (l->pt[l->npts - 1][0] == p[0]) && (l->pt[l->npts - 1][1] == p[1]))
+    return 0;
+  if (l->npts == l->ptcap)
+    {
+      double (*pt)[2] = (double (*)[2]) realloc(l->pt, sizeof(double) * 4 * l->ptcap);
+      if (!pt)
+	return SEIDEL_ERR_NOMEM;
+      l->pt = pt;
+      l->ptcap *= 2;
+    }
+  l->pt[l->npts][0] = p[0];
+  l->pt[l->npts][1] = p[1];
+  l->npts++;
+  return 0;
+}
+
+/* Twice the signed area of pt[first .. first+n-1], taken about the */
+/* first point so that collinear loops come out at exactly 0 */
+static double loop_area(double (*pt)[2], int first, int n)
+{
+  double a = 0, *o = pt[first];
+  int i;
+
+  for (i = first + 1; i < first + n - 1; i++)
+    a += (pt[i][0] - o[0]) * (pt[i + 1][1] - o[1]) -
+      (pt[i + 1][0] - o[0]) * (pt[i][1] - o[1]);
+  return a;
+}
+
+/* b turns straight back from a to c */
+static int spike(double *a, double *b, double *c)
+{
+  double ux = b[0] - a[0], uy = b[1] - a[1], vx = c[0] - b[0], vy = c[1] - b[1];
+
+  return (ux * vy - uy * vx == 0) && (ux * vx + uy * vy <= 0);
+}
+
+/* Close the open loop. Walking along a line can leave spikes that */
+/* run out and straight back; they are cut off, and loops with no */
+/* area left are dropped */
+static int loops_close(loops_t *l)
+{
+  double (*pt)[2] = l->pt;
+  int first = l->start[l->nloops], i, n = first, changed;
+
+  for (i = first; i < l->npts; i++)
+    {
+      while ((n - first >= 2) && spike(pt[n - 2], pt[n - 1], pt[i]))
+	n--;
+      if ((n > first) && (pt[n - 1][0] == pt[i][0]) && (pt[n - 1][1] == pt[i][1]))
+	continue;
+      pt[n][0] = pt[i][0];
+      pt[n][1] = pt[i][1];
+      n++;
+    }
+  do
+    {
+      changed = 0;
+      if ((n - first > 1) && (pt[n - 1][0] == pt[first][0]) && (pt[n - 1][1] == pt[first][1]))
+	changed = n--;
+      else if ((n - first >= 3) && spike(pt[n - 2], pt[n - 1], pt[first]))
+	changed = n--;
+      else if ((n - first >= 3) && spike(pt[n - 1], pt[first], pt[first + 1]))
+	{
+	  memmove(pt + first, pt + first + 1, sizeof(double) * 2 * (n - first - 1));
+	  changed = n--;
+	}
+    }
+  while (changed);
+  l->npts = n;
+
+  if ((l->npts - first < 3) || (loop_area(l->pt, first, l->npts - first) == 0))
+    {
+      l->npts = first;
+      return 0;
+    }
+
+  if (l->nloops == l->loopcap)
+    {
+      int *start = (int *) realloc(l->start, sizeof(int) * (2 * l->loopcap + 1));
+      if (!start)
+	return SEIDEL_ERR_NOMEM;
+      l->start = start;
+      l->loopcap *= 2;
+    }
+  l->start[++l->nloops] = l->npts;
+  return 0;
+}
+
+static int loops_copy(loops_t *l, loops_t *in, int loop)
+{
+  int i, rc = 0;
+
+  for (i = in->start[loop]; (i < in->start[loop + 1]) && !rc; i++)
+    rc = loops_point(l, in->pt[i]);
+  return rc ? rc : loops_close(l);
+}
+
+
+static int cmp_crossing(const void *a, const void *b)
+{
+  const crossing_t *s = (const crossing_t *) a, *t = (const crossing_t *) b;
+
+  if (s->pos != t->pos)
+    return (s->pos < t->pos) ? -1 : 1;
+  if (s->slope != t->slope)
+    return (s->slope < t->slope) ? -1 : 1;
+  return 0;
+}
+
+
+/* Cut the loops of in by the line where coordinate axis equals at.
+ * Points below it go to lo, points on or above it to hi; either may
+ * be NULL to throw that side away. Returns 0 or a negative error
+ * code, SEIDEL_ERR_DEGENERATE if the crossings do not pair up as
+ * they would for a simple polygon.
+ */
+static int cut_loops(loops_t *in, int axis, double at, loops_t *lo, loops_t *hi)
+{
+  crossing_t *cross = NULL;
+  chain_t *chain = NULL;
+  crossing_t *order = NULL;
+  int *rank = NULL;
+  char *side = NULL;
+  int ncross = 0, nchains = 0, nsorted, rc = 0;
+  int o = 1 - axis, loop, i, j, k, s;
+
+  if (in->npts)
+    {
+      cross = (crossing_t *) malloc(sizeof(crossing_t) * in->npts);
+      chain = (chain_t *) malloc(sizeof(chain_t) * in->npts);
+      order = (crossing_t *) malloc(sizeof(crossing_t) * 2 * in->npts);
+      rank = (int *) malloc(sizeof(int) * in->npts);
+      side = (char *) malloc(in->npts);
+      if (!cross || !chain || !order || !rank || !side)
+	{
+	  rc = SEIDEL_ERR_NOMEM;
+	  goto done;
+	}
+    }
+
+  /* points within C_EPS of the line are taken to be on it, or */
+  /* their crossings would come out next to them */
+  for (i = 0; i < in->npts; i++)
+    if (fabs(in->pt[i][axis] - at) <= C_EPS)
+      in->pt[i][axis] = at;
+
+  for (loop = 0; (loop < in->nloops) && !rc; loop++)
+    {
+      double (*pt)[2] = in->pt + in->start[loop];
+      char *up = side + in->start[loop];
+      int m = in->start[loop + 1] - in->start[loop];
+      int i0 = -1, c0, cur;
+
+      /* Points on the line go up, except where the contour comes */
+      /* down to touch the line from above with the polygon below */
+      /* it: there it is taken as below, which joins it to the walk */
+      for (i = 0, i0 = -1; i < m; i++)
+	{
+	  up[i] = (pt[i][axis] > at) ? 1 : ((pt[i][axis] < at) ? 0 : -1);
+	  if (up[i] >= 0)
+	    i0 = i;
+	}
+      for (j = 0; (j < m) && (i0 >= 0); j = k)
+	{
+	  int from = (i0 + j) % m, touch;
+
+	  for (k = j + 1; (k < m) && (up[(i0 + k) % m] < 0); k++)
+	    ;
+	  if (k == j + 1)
+	    continue;
+	  touch = up[from] && up[(i0 + k) % m];
+	  if (touch && (k == j + 2))	/* a corner: is it reflex? */
+	    {
+	      double *u = pt[from], *v = pt[(i0 + j + 1) % m], *w = pt[(i0 + k) % m];
+	      touch = ((v[0] - u[0]) * (w[1] - v[1]) - (v[1] - u[1]) * (w[0] - v[0]) < 0);
+	    }
+	  else if (touch)		/* an edge: is the polygon below? */
+	    {
+	      double d = pt[(i0 + k - 1) % m][o] - pt[(i0 + j + 1) % m][o];
+	      touch = ((axis == 0) ? (d > 0) : (d < 0));
+	    }
+	  for (i = j + 1; i < k; i++)
+	    up[(i0 + i) % m] = !touch;
+	}
+      if (i0 < 0)		/* all of it on the line */
+	for (i = 0; i < m; i++)
+	  up[i] = 1;
+
+      for (i = 0, i0 = -1; (i < m) && (i0 < 0); i++)
+	if (up[i] != up[(i + m - 1) % m])
+	  i0 = i;
+      if (i0 < 0)
+	{
+	  loops_t *to = up[0] ? hi : lo;
+	  if (to)
+	    rc = loops_copy(to, in, loop);
+	  continue;
+	}
+
+      /* one chain per run of points on the same side, from the */
+      /* crossing that enters it to the one that leaves */
+      c0 = ncross;
+      cur = -1;
+      for (j = 0; j < m; j++)
+	{
+	  int ip = (i0 + j + m - 1) % m, iq = (i0 + j) % m;
+
+	  if (up[ip] != up[iq])
+	    {
+	      crossing_t *c = &cross[ncross];
+	      double *a = up[ip] ? pt[iq] : pt[ip]; /* the lower end */
+	      double *b = up[ip] ? pt[ip] : pt[iq];
+
+	      /* Crossings at a point on the line are ordered as if the */
+	      /* line moved a little off it, to the side the point is */
+	      /* not taken to be on: the order of their slopes */
+	      c->slope = (b[o] - a[o]) / (b[axis] - a[axis]);
+	      if (b[axis] == at)
+		{
+		  c->p[0] = b[0];
+		  c->p[1] = b[1];
+		  c->slope = -c->slope;
+		}
+	      else if (a[axis] == at)
+		{
+		  c->p[0] = a[0];
+		  c->p[1] = a[1];
+		}
+	      else
+		{
+		  c->p[o] = a[o] + (at - a[axis]) / (b[axis] - a[axis]) * (b[o] - a[o]);
+		  c->p[axis] = at;
+		}
+	      c->pos = c->p[o];
+	      c->id = ncross;
+	      c->loexit = !up[ip];
+	      if (cur >= 0)
+		chain[cur].exit = ncross;
+	      cur = nchains++;
+	      chain[cur].loop = loop;
+	      chain[cur].first = iq;
+	      chain[cur].count = 0;
+	      chain[cur].entry = ncross++;
+	      chain[cur].side = up[iq];
+	      chain[cur].done = 0;
+	    }
+	  chain[cur].count++;
+	}
+      chain[cur].exit = c0;	/* back where it started */
+    }
+  if (rc)
+    goto done;
+
+  /* the chains on either side of each crossing */
+  for (k = 0; k < nchains; k++)
+    {
+      if (chain[k].side)
+	cross[chain[k].entry].hichain = cross[chain[k].exit].hichain = k;
+      else
+	cross[chain[k].entry].lochain = cross[chain[k].exit].lochain = k;
+    }
+
+  /* Sort the crossings along the line, together with the points */
+  /* on it: a walk passes through those on its way, so that both */
+  /* sides of a seam get the same vertices */
+  if (ncross)
+    memcpy(order, cross, sizeof(crossing_t) * ncross);
+  for (i = 0, nsorted = ncross; i < in->npts; i++)
+    if (in->pt[i][axis] == at)
+      {
+	crossing_t *c = &order[nsorted++];
+	c->p[0] = in->pt[i][0];
+	c->p[1] = in->pt[i][1];
+	c->pos = c->p[o];
+	c->slope = 0;
+	c->id = -1;
+      }
+  if (nsorted)
+    qsort(order, nsorted, sizeof(crossing_t), cmp_crossing);
+  for (i = 0; i < nsorted; i++)
+    if (order[i].id >= 0)
+      rank[order[i].id] = i;
+
+  /* Walk each side's boundary. Along a vertical line the lower */
+  /* (left) side runs up, along a horizontal one the lower side */
+  /* runs right to left; the upper sides run the other way */
+  for (s = 0; (s < 2) && !rc; s++)
+    {
+      loops_t *to = s ? hi : lo;
+      int dir = ((s == 0) == (axis == 0)) ? 1 : -1;
+
+      if (!to)
+	continue;
+      for (k = 0; (k < nchains) && !rc; k++)
+	{
+	  int cur = k;
+
+	  if ((chain[k].side != s) || chain[k].done)
+	    continue;
+	  do
+	    {
+	      chain_t *ch = &chain[cur];
+	      double (*pt)[2] = in->pt + in->start[ch->loop];
+	      int m = in->start[ch->loop + 1] - in->start[ch->loop];
+	      crossing_t *next;
+
+	      ch->done = 1;
+	      rc = loops_point(to, cross[ch->entry].p);
+	      for (j = 0; (j < ch->count) && !rc; j++)
+		rc = loops_point(to, pt[(ch->first + j) % m]);
+	      if (!rc)
+		rc = loops_point(to, cross[ch->exit].p);
+
+	      for (i = rank[ch->exit] + dir; !rc && (i >= 0) && (i < nsorted) &&
+		     (order[i].id < 0); i += dir)
+		rc = loops_point(to, order[i].p);
+	      if (!rc && ((i < 0) || (i >= nsorted)))
+		rc = SEIDEL_ERR_DEGENERATE;
+	      if (rc)
+		break;
+	      next = &order[i];
+	      if ((next->loexit == 0) != (s == 0)) /* not an entry */
+		rc = SEIDEL_ERR_DEGENERATE;
+	      cur = s ? next->hichain : next->lochain;
+	      if (!rc && chain[cur].done && (cur != k))
+		rc = SEIDEL_ERR_DEGENERATE;
+	    }
+	  while (!rc && (cur != k));
+	  if (!rc)
+	    rc = loops_close(to);
+	}
+    }
+
+ done:
+  free(cross);
+  free(chain);
+  free(order);
+  free(rank);
+  free(side);
+  return rc;
+}
+
+
+/* Bisect the columns lo..hi-1 (axis 0) or, within column col, the */
+/* rows lo..hi-1 (axis 1); each tile ends up with its own piece */
+static int cut_range(tiler_t *t, loops_t *in, int axis, int lo, int hi, int col)
+{
+  loops_t below, above;
+  int mid, rc;
+
+  if (hi - lo == 1)
+    {
+      if (axis == 0)
+	return cut_range(t, in, 1, 0, t->count[1], lo);
+      t->piece[lo * t->count[0] + col] = *in;
+      in->pt = NULL;
+      in->start = NULL;
+      return 0;
+    }
+
+  mid = (lo + hi) / 2;
+  if ((rc = loops_init(&below, in->npts / 2)))
+    return rc;
+  if ((rc = loops_init(&above, in->npts / 2)))
+    {
+      loops_free(&below);
+      return rc;
+    }
+  rc = cut_loops(in, axis, t->origin[axis] + mid * t->size[axis], &below, &above);
+  loops_free(in);
+  if (!rc)
+    rc = cut_range(t, &below, axis, lo, mid, col);
+  if (!rc)
+    rc = cut_range(t, &above, axis, mid, hi, col);
+  loops_free(&below);
+  loops_free(&above);
+  return rc;
+}
+
+
+static int point_in_loop(loops_t *l, int loop, double *p)
+{
+  int i, in = 0;
+
+  for (i = l->start[loop]; i < l->start[loop + 1]; i++)
+    {
+      double *a = l->pt[i];
+      double *b = l->pt[(i + 1 < l->start[loop + 1]) ? i + 1 : l->start[loop]];
+      if (((a[1] > p[1]) != (b[1] > p[1])) &&
+	  (p[0] < a[0] + (b[0] - a[0]) * (p[1] - a[1]) / (b[1] - a[1])))
+	in = !in;
+    }
+  return in;
+}
+
+
+/* Triangulate the piece of one tile into its own vertices and */
+/* triangles. Returns #triangles or a negative error code */
+static int triangulate_piece(SeidelTriangulator** state, loops_t *piece, seideltile_t *tile)
+{
+  loops_t split, *l = piece;
+  int *dup = NULL, *order = NULL, *ostart = NULL, *owner = NULL, *cntr = NULL;
+  double *area = NULL;
+  int ngroups, nsplit, i, j, k, rc = 0, ntri = 0, nvert = 0;
+
+  tile->nvert = 0;
+  tile->vertices = NULL;
+  tile->triangles = NULL;
+  if (!piece->nloops)
+    return 0;
+
+  split.pt = NULL;
+  split.start = NULL;
+  dup = (int *) malloc(sizeof(int) * piece->npts);
+  order = (int *) malloc(sizeof(int) * piece->npts);
+  ostart = (int *) malloc(sizeof(int) * (piece->npts + piece->nloops + 1));
+  if (!dup || !order || !ostart)
+    {
+      rc = SEIDEL_ERR_NOMEM;
+      goto done;
+    }
+
+  if ((ngroups = find_repeats(piece->pt, piece->npts, dup)) < 0)
+    {
+      rc = ngroups;
+      goto done;
+    }
+  if (ngroups)
+    {
+      if ((nsplit = split_pinches(piece->nloops, piece->start, dup, ngroups, order, ostart)) < 0)
+	{
+	  rc = nsplit;
+	  goto done;
+	}
+      if ((rc = loops_init(&split, piece->npts)))
+	goto done;
+      l = &split;
+      for (k = 0; (k < nsplit) && !rc; k++)
+	{
+	  for (i = ostart[k]; (i < ostart[k + 1]) && !rc; i++)
+	    rc = loops_point(&split, piece->pt[order[i]]);
+	  if (!rc)
+	    rc = loops_close(&split);
+	}
+      if (rc || ((rc = find_repeats(l->pt, l->npts, dup)) < 0))
+	goto done;
+      rc = 0;
+    }
+
+  area = (double *) malloc(sizeof(double) * l->nloops);
+  owner = (int *) malloc(sizeof(int) * l->nloops);
+  cntr = (int *) malloc(sizeof(int) * l->nloops);
+  tile->vertices = (double (*)[2]) malloc(sizeof(double) * 2 * (l->npts + 1));
+  tile->triangles = (int (*)[3]) malloc(sizeof(int) * 3 * (l->npts + 2 * l->nloops));
+  if (!area || !owner || !cntr || !tile->vertices || !tile->triangles)
+    {
+      rc = SEIDEL_ERR_NOMEM;
+      goto done;
+    }
+  for (k = 0; k < l->nloops; k++)
+    area[k] = loop_area(l->pt, l->start[k], l->start[k + 1] - l->start[k]);
+
+  /* each hole belongs to the smallest outer contour around it */
+  for (k = 0; k < l->nloops; k++)
+    {
+      double probe[2];
+
+      owner[k] = (area[k] > 0) ? k : -1;
+      if (area[k] > 0)
+	continue;
+      for (i = l->start[k]; (i < l->start[k + 1]) && (dup[i] >= 0); i++)
+	;
+      if (i < l->start[k + 1])
+	{
+	  probe[0] = l->pt[i][0];
+	  probe[1] = l->pt[i][1];
+	}
+      else
+	{
+	  i = l->start[k];
+	  probe[0] = (l->pt[i][0] + l->pt[i + 1][0]) / 2;
+	  probe[1] = (l->pt[i][1] + l->pt[i + 1][1]) / 2;
+	}
+      for (j = 0; j < l->nloops; j++)
+	if ((area[j] > 0) && ((owner[k] < 0) || (area[j] < area[owner[k]])) &&
+	    point_in_loop(l, j, probe))
+	  owner[k] = j;
+      if (owner[k] < 0)
+	{
+	  rc = SEIDEL_ERR_DEGENERATE;
+	  goto done;
+	}
+      for (i = l->start[k]; i < l->start[k + 1]; i++)
+	if (dup[i] >= 0)
+	  pull_into_loop(l->pt, l->start[k], l->start[k + 1] - l->start[k], i, TRUE);
+    }
+
+  /* one triangulate_polygon() per outer contour and its holes */
+  for (k = 0; k < l->nloops; k++)
+    {
+      int ncontours = 0, base = nvert, n;
+
+      if (owner[k] != k)
+	continue;
+      for (j = -1; j < l->nloops; j++)
+	{
+	  int c = (j < 0) ? k : j;	/* the outer contour first */
+
+	  if ((j >= 0) && ((j == k) || (owner[j] != k)))
+	    continue;
+	  cntr[ncontours++] = l->start[c + 1] - l->start[c];
+	  for (i = l->start[c]; i < l->start[c + 1]; i++)
+	    {
+	      nvert++;
+	      tile->vertices[nvert][0] = l->pt[i][0];
+	      tile->vertices[nvert][1] = l->pt[i][1];
+	    }
+	}
+
+      if (*state && ((*state)->segSize <= nvert - base))
+	{
+	  SeidelTriangulatorRelease(*state);
+	  *state = NULL;
+	}
+      if (!*state && !(*state = SeidelTriangulatorCreate(nvert - base)))
+	{
+	  rc = SEIDEL_ERR_NOMEM;
+	  goto done;
+	}
+      n = triangulate_polygon(state, ncontours, cntr, tile->vertices + base,
+			      tile->triangles + ntri);
+      if (n < 0)
+	{
+	  rc = n;
+	  goto done;
+	}
+      for (i = ntri; i < ntri + n; i++)
+	for (j = 0; j < 3; j++)
+	  tile->triangles[i][j] += base;
+      ntri += n;
+    }
+  tile->nvert = nvert;
+
+ done:
+  if (rc)
+    {
+      free(tile->vertices);
+      free(tile->triangles);
+      tile->vertices = NULL;
+      tile->triangles = NULL;
+    }
+  if (l == &split)
+    loops_free(&split);
+  free(dup);
+  free(order);
+  free(ostart);
+  free(area);
+  free(owner);
+  free(cntr);
+  return rc ? rc : ntri;
+}
+
+
+typedef struct {
+  tiler_t *t;
+  int first, last;		/* range of tiles */
+  pthread_t thread;
+  int started;
+} tileworker_t;
+
+static void *tile_worker(void *arg)
+{
+  tileworker_t *w = (tileworker_t *) arg;
+  SeidelTriangulator *state = NULL;
+  int i;
+
+  for (i = w->first; i < w->last; i++)
+    {
+      w->t->tiling.tile[i].ntriangles =
+	triangulate_piece(&state, &w->t->piece[i], &w->t->tiling.tile[i]);
+      loops_free(&w->t->piece[i]);
+    }
+  SeidelTriangulatorRelease(state);
+  return NULL;
+}
+
+
+/* Cut the polygon to a cols x rows grid of tiles of w x h, the first
+ * one's lower left corner at (x0, y0), and triangulate each tile on
+ * up to nthreads threads. Whatever lies outside the grid is dropped.
+ * Each tile gets its own vertices, numbered from 1, and triangles
+ * indexing them; a tile that fails has a negative error code as its
+ * triangle count and no triangles, and does not stop the others.
+ * Returns NULL if out of memory or the input cannot be cut, which
+ * only happens if it is not a simple polygon.
+ */
+SeidelTiling* SeidelTilingCreate(int ncontours, int cntr[], double (*vertices)[2],
+				 double x0, double y0, double w, double h,
+				 int cols, int rows, int nthreads)
+{
+  tiler_t *t;
+  tileworker_t *wk;
+  loops_t in, clipped;
+  int c, i, k, n = 0, ntiles = cols * rows, first, rc;
+  long total = 0, acc = 0;
+
+  if ((ncontours <= 0) || (cols <= 0) || (rows <= 0) || !(w > 0) || !(h > 0))
+    return NULL;
+  if (nthreads < 1)
+    nthreads = 1;
+
+  t = (tiler_t *) calloc(1, sizeof(tiler_t));
+  if (!t)
+    return NULL;
+  t->tiling.cols = cols;
+  t->tiling.rows = rows;
+  t->origin[0] = x0;
+  t->origin[1] = y0;
+  t->size[0] = w;
+  t->size[1] = h;
+  t->count[0] = cols;
+  t->count[1] = rows;
+  t->tiling.tile = (seideltile_t *) calloc(ntiles, sizeof(seideltile_t));
+  t->piece = (loops_t *) calloc(ntiles, sizeof(loops_t));
+  if (!t->tiling.tile || !t->piece)
+    goto fail;
+
+  for (c = 0; c < ncontours; c++)
+    n += cntr[c];
+  if (loops_init(&in, n))
+    goto fail;
+  for (c = 0, i = 1, rc = 0; (c < ncontours) && !rc; c++)
+    {
+      for (k = 0; (k < cntr[c]) && !rc; k++, i++)
+	rc = loops_point(&in, vertices[i]);
+      if (!rc)
+	rc = loops_close(&in);
+    }
+
+  /* trim to the grid, then cut it up */
+  clipped.pt = NULL;
+  clipped.start = NULL;
+  if (!rc)
+    rc = loops_init(&clipped, n);
+  for (k = 0; (k < 4) && !rc; k++)
+    {
+      int axis = k & 1, upper = k >> 1;
+      double at = t->origin[axis] + (upper ? t->count[axis] : 0) * t->size[axis];
+
+      clipped.npts = clipped.nloops = 0;
+      if (!(rc = cut_loops(&in, axis, at, upper ? &clipped : NULL, upper ? NULL : &clipped)))
+	{
+	  loops_t tmp = in;
+	  in = clipped;
+	  clipped = tmp;
+	}
+    }
+  loops_free(&clipped);
+  if (!rc)
+    rc = cut_range(t, &in, 0, 0, cols, 0);
+  loops_free(&in);
+  if (rc)
+    goto fail;
+
+  for (i = 0; i < ntiles; i++)
+    {
+      seideltile_t *tile = &t->tiling.tile[i];
+      tile->col = i % cols;
+      tile->row = i / cols;
+      tile->x0 = x0 + tile->col * w;
+      tile->x1 = x0 + (tile->col + 1) * w;
+      tile->y0 = y0 + tile->row * h;
+      tile->y1 = y0 + (tile->row + 1) * h;
+      total += t->piece[i].npts;
+    }
+
+  /* runs of tiles with about the same number of points each; the */
+  /* calling thread takes the last run */
+  if (nthreads > ntiles)
+    nthreads = ntiles;
+  wk = (tileworker_t *) malloc(sizeof(tileworker_t) * nthreads);
+  if (!wk)
+    goto fail;
+  first = 0;
+  for (k = 0; k < nthreads; k++)
+    {
+      wk[k].t = t;
+      wk[k].first = first;
+      if (k == nthreads - 1)
+	first = ntiles;
+      else
+	while ((first < ntiles) && (acc < total * (k + 1) / nthreads))
+	  acc += t->piece[first++].npts;
+      wk[k].last = first;
+    }
+
+  for (k = 0; k < nthreads - 1; k++)
+    {
+      wk[k].started = (pthread_create(&wk[k].thread, NULL, tile_worker, &wk[k]) == 0);
+      if (!wk[k].started)
+	tile_worker(&wk[k]);
+    }
+  tile_worker(&wk[nthreads - 1]);
+  for (k = 0; k < nthreads - 1; k++)
+    if (wk[k].started)
+      pthread_join(wk[k].thread, NULL);
+  free(wk);
+
+  free(t->piece);
+  t->piece = NULL;
+  return &t->tiling;
+
+ fail:
+  SeidelTilingRelease(&t->tiling);
+  return NULL;
+}
+
+void SeidelTilingRelease(SeidelTiling* tiling)
+{
+  tiler_t *t = (tiler_t *) tiling;
+  int i;
+
+  if (!t)
+    return;
+  for (i = 0; i < tiling->cols * tiling->rows; i++)
+    {
+      if (t->piece)
+	loops_free(&t->piece[i]);
+      if (tiling->tile)
+	{
+	  free(tiling->tile[i].vertices);
+	  free(tiling->tile[i].triangles);
+	}
+    }
+  free(t->piece);
+  free(tiling->tile);
+  free(t);
+}
@@ -1,4 +1,5 @@
 #include "triangulate.h"
+#include "triangulation_seidel.h"
 #include <sys/time.h>
 #include <string.h>
 
@@ -13,9 +14,11 @@ static int initialise(SeidelTriangulator* state, int n)
   for (i = 1; i <= n; i++)
     state->seg[i].is_inserted = FALSE;
 
-  generate_random_ordering(state, n);
-  
-  return 0;
+  if (state->schedule & SEIDEL_ORDER_BRIO)
+    return generate_brio_ordering(state, n);
+  if (state->schedule & SEIDEL_ORDER_HILBERT)
+    return generate_hilbert_ordering(state, n);
+  return generate_random_ordering(state, n);
 }
 
 void SeidelTriangulatorReset(SeidelTriangulator* state) {
@@ -34,21 +37,34 @@ void SeidelTriangulatorReset(SeidelTriangulator* state) {
     state->chain_idx = 0;
     state->op_idx = 0;
     state->mon_idx = 0;
+    state->mpoly_idx = 0;
+    state->error = 0;
+    state->steps = state->max_steps = 0;
+    state->maxtri = 0;
+}
+
+/* Table sizes for n points, as SeidelTriangulatorCreate() makes them */
+static void table_sizes(int n, int *segSize, int *trSize, int *qSize)
+{
+  *segSize = n + 1;
+  *qSize = 8 * *segSize;
+  *trSize = 4 * *segSize;
 }
 
 SeidelTriangulator* SeidelTriangulatorCreate(int n) {
 #ifdef GLOBAL_TRIANGULATOR
-    g_seidel.segSize = n + 1;
-    g_seidel.qSize = 8 * g_seidel.segSize;
-    g_seidel.trSize = 4 * g_seidel.segSize;
+    table_sizes(n, &g_seidel.segSize, &g_seidel.trSize, &g_seidel.qSize);
+    g_seidel.nthreads = 1;
+    g_seidel.step_budget = 0;
+    g_seidel.schedule = SEIDEL_SCHEDULE_PHASED;
+    g_seidel.path_n = g_seidel.path_first = 0;
     SeidelTriangulatorReset(&g_seidel);
     return &g_seidel;
 #else
     SeidelTriangulator* ret = (SeidelTriangulator*) malloc(sizeof(SeidelTriangulator));
+    if (!ret) return NULL;
     //*
-    ret->segSize = n + 1;
-    ret->qSize = 8 * ret->segSize;
-    ret->trSize = 4 * ret->segSize;
+    table_sizes(n, &ret->segSize, &ret->trSize, &ret->qSize);
     /*/
     ret->segSize = SEGSIZE;
     ret->qSize = QSIZE;
@@ -56,7 +72,8 @@ SeidelTriangulator* SeidelTriangulatorCreate(int n) {
     //*/
 #ifndef FIX_SIZED_ARRAY
     ret->qs = (node_t*) malloc(sizeof(node_t) * ret->qSize);        /* Query structure */ //qSize
-    ret->tr = (trap_t*) malloc(sizeof(trap_t) * ret->trSize);        /* Trapezoid structure */ //trSize
+    ret->tr = (trap_t*) malloc(sizeof(trap_t) * (ret->trSize + 1));        /* Trapezoid structure */ //trSize
+    if (ret->tr) ret->tr++; /* tr[-1] is a guard, see triangulate.h */
     ret->seg = (segment_t*) malloc(sizeof(segment_t) * ret->segSize);        /* Segment table */ //SEGSIZE
 
     ret->permute = (int*) malloc(sizeof(int) * ret->segSize);//SEGSIZE
@@ -76,7 +93,24 @@ SeidelTriangulator* SeidelTriangulatorCreate(int n) {
     /* the monotone chain for the polygon */
 
     ret->visited = (int*) malloc(sizeof(int) * ret->trSize); //TRSIZE
+
+    ret->mpoly = (monpoly_t*) malloc(sizeof(monpoly_t) * ret->segSize); //SEGSIZE
+
+    ret->rchain = (int*) malloc(sizeof(int) * ret->segSize); //SEGSIZE
+
+    if (!ret->qs || !ret->tr || !ret->seg || !ret->permute || !ret->mchain ||
+        !ret->vert || !ret->mon || !ret->visited || !ret->mpoly || !ret->rchain)
+    {
+        SeidelTriangulatorRelease(ret);
+        return NULL;
+    }
 #endif
+    ret->visits = NULL;
+    ret->visitSize = 0;
+    ret->nthreads = 1;
+    ret->step_budget = 0;
+    ret->schedule = SEIDEL_SCHEDULE_PHASED;
+    ret->path_n = ret->path_first = 0;
     SeidelTriangulatorReset(ret);
     
     return ret;
@@ -88,89 +122,195 @@ void SeidelTriangulatorRelease(SeidelTriangulator* state) {
     if (!state) return;
 #ifndef FIX_SIZED_ARRAY
     free(state->qs);
-    free(state->tr);
+    if (state->tr) free(state->tr - 1);
     free(state->seg);
     free(state->permute);
     free(state->mchain);
     free(state->vert);
     free(state->mon);
     free(state->visited);
+    free(state->mpoly);
+    free(state->rchain);
 #endif
+    free(state->visits);
     free(state);
 #endif
 }
 
-#ifdef STANDALONE
+/* Number of threads used to triangulate the monotone polygons. The
+ * polygons are only farmed out when the input has at least
+ * PAR_MIN_VERTICES points; smaller inputs stay on the calling thread.
+ */
+void SeidelTriangulatorSetThreads(SeidelTriangulator* state, int nthreads) {
+    state->nthreads = (nthreads > 1) ? nthreads : 1;
+}
 
-int main(argc, argv)
-     int argc;
-     char *argv[];
+/* Watchdog for triangulate_polygon(): the run is abandoned with
+ * SEIDEL_ERR_BUDGET after this many steps, a step being one node of
+ * the query structure or one trapezoid visited. 0 picks a budget from
+ * the input size, STEPS_PER_SEGMENT * n * (log2(n) + 1); a negative
+ * value turns the watchdog off.
+ */
+void SeidelTriangulatorSetStepBudget(SeidelTriangulator* state, long steps) {
+    state->step_budget = steps;
+}
+
+/* How triangulate_polygon() builds the trapezoidation, an OR of
+ * SEIDEL_SCHEDULE_*, SEIDEL_ORDER_* and SEIDEL_LAYOUT_* flags from
+ * triangulate.h. The default, Seidel's phased schedule over a random
+ * order, has the best bound; the others can be faster on a given kind
+ * of input, see 'bench schedule'. SEIDEL_LAYOUT_COMPACT renumbers the
+ * finished tables for the monotone pass and for later queries. Every
+ * schedule gives a valid triangulation.
+ */
+void SeidelTriangulatorSetSchedule(SeidelTriangulator* state, int schedule) {
+    state->schedule = schedule;
+}
+
+/* Number of triangles of the polygon, n - 2 + 2 * #holes, or */
+/* SEIDEL_ERR_INPUT if a contour has fewer than 3 points */
+int seidel_triangle_count(int ncontours, int cntr[])
 {
-  int n, nmonpoly, genus;
-  int i, ntriangles;
-//    int op[SEGSIZE][3];
+  int i, n = 0;
 
-  if ((argc < 2) || ((n = read_segments(argv[1], &genus)) < 0))
+  if (ncontours <= 0)
+    return SEIDEL_ERR_INPUT;
+  for (i = 0; i < ncontours; i++)
     {
-      fprintf(stderr, "usage: triangulate <filename>\n");
-      exit(1);
+      if (cntr[i] < 3)
+	return SEIDEL_ERR_INPUT;
+      n += cntr[i];
     }
+  return n - 2 + 2 * (ncontours - 1);
+}
+
+/* Fill in what triangulating the polygon takes, so that the output can
+ * be sized exactly up front: the triangle count and the bytes of the
+ * output in each format. The tables are only what a triangulator made
+ * for the polygon starts with. Merged trapezoids are not reused, so how
+ * far the trapezoid and query tables grow depends on the insertion
+ * order and has no useful bound; the sizes are not limits. Returns the
+ * number of triangles or SEIDEL_ERR_INPUT.
+ */
+int seidel_required_sizes(int ncontours, int cntr[], SeidelSizes *sizes)
+{
+  int n, ntriangles;
 
-  initialise(state, n);
-  construct_trapezoids(state, n);
-  nmonpoly = monotonate_trapezoids(state, n);
-  ntriangles = triangulate_monotone_polygons(state, n, nmonpoly, op);
+  if ((ntriangles = seidel_triangle_count(ncontours, cntr)) < 0)
+    return ntriangles;
+  n = ntriangles + 2 - 2 * (ncontours - 1);
+
+  sizes->npoints = n;
+  sizes->ntriangles = ntriangles;
+#ifdef FIX_SIZED_ARRAY
+  sizes->initSegSize = SEGSIZE;
+  sizes->initTrSize = TRSIZE;
+  sizes->initQSize = QSIZE;
+#else
+  table_sizes(n, &sizes->initSegSize, &sizes->initTrSize, &sizes->initQSize);
+#endif
+  sizes->init_table_bytes = sizeof(SeidelTriangulator);
+#ifndef FIX_SIZED_ARRAY
+  sizes->init_table_bytes += sizeof(node_t) * sizes->initQSize +
+    (sizeof(trap_t) + sizeof(monchain_t) + sizeof(int)) * sizes->initTrSize +
+    sizeof(trap_t) +		/* the tr[-1] guard */
+    (sizeof(segment_t) + sizeof(vertexchain_t) + sizeof(monpoly_t) +
+     3 * sizeof(int)) * sizes->initSegSize;
+#endif
+  sizes->triangle_bytes = sizeof(int) * 3 * (size_t) ntriangles;
+  sizes->index16_bytes = seidel_index_bytes(ntriangles, SEIDEL_INDEX_UINT16);
+  if (n > 65536)
+    sizes->index16_bytes = 0;
+  sizes->index32_bytes = seidel_index_bytes(ntriangles, SEIDEL_INDEX_UINT32);
+  return ntriangles;
+}
+
+/* Bytes of ntriangles triangles as indices in format */
+size_t seidel_index_bytes(int ntriangles, int format)
+{
+  return (ntriangles > 0) ? (size_t) 3 * ntriangles * format : 0;
+}
 
+/* Write the triangles from triangulate_polygon() to dst as a GPU index
+ * buffer in format, numbered from 0 and offset by base, the position
+ * of the polygon's first point in a vertex buffer shared by several
+ * polygons. Returns ntriangles, or SEIDEL_ERR_CAPACITY without writing
+ * anything if an index does not fit the format.
+ */
+int seidel_write_indices(int ntriangles, int (*triangles)[3], int base, int format, void *dst)
+{
+  uint16_t *d16 = (uint16_t *) dst;
+  uint32_t *d32 = (uint32_t *) dst;
+  long long v, max = (format == SEIDEL_INDEX_UINT16) ? 0xffff : 0xffffffffLL;
+  int i, j;
+
+  if ((format != SEIDEL_INDEX_UINT16) && (format != SEIDEL_INDEX_UINT32))
+    return SEIDEL_ERR_INPUT;
   for (i = 0; i < ntriangles; i++)
-    printf("triangle #%d: %d %d %d\n", i, 
-	   state->op[i][0], state->op[i][1], state->op[i][2]);
+    for (j = 0; j < 3; j++)
+      {
+	v = (long long) base + triangles[i][j] - 1;
+	if ((v < 0) || (v > max))
+	  return SEIDEL_ERR_CAPACITY;
+      }
 
-  return 0;
+  for (i = 0; i < ntriangles; i++)
+    for (j = 0; j < 3; j++)
+      {
+	v = (long long) base + triangles[i][j] - 1;
+	if (format == SEIDEL_INDEX_UINT16)
+	  *d16++ = (uint16_t) v;
+	else
+	  *d32++ = (uint32_t) v;
+      }
+  return ntriangles;
 }
 
+/* Step budget for a run over n segments */
+static long step_budget(SeidelTriangulator* state, int n)
+{
+  long levels = 1;
 
-#else  /* Not standalone. Use this as an interface routine */
+  if (state->step_budget != 0)
+    return (state->step_budget > 0) ? state->step_budget : 0;
+  while ((1L << levels) <= n)
+    levels++;
+  return (long) STEPS_PER_SEGMENT * n * (levels + 1);
+}
 
 
-/* Input specified as contours.
- * Outer contour must be anti-clockwise.
- * All inner contours must be clockwise.
- *  
- * Every contour is specified by giving all its points in order. No
- * point shoud be repeated. i.e. if the outer contour is a square,
- * only the four distinct endpoints shopudl be specified in order.
- *  
- * ncontours: #contours
- * cntr: An array describing the number of points in each
- *	 contour. Thus, cntr[i] = #points in the i'th contour.
- * vertices: Input array of vertices. Vertices for each contour
- *           immediately follow those for previous one. Array location
- *           vertices[0] must NOT be used (i.e. i/p starts from
- *           vertices[1] instead. The output triangles are
- *	     specified  w.r.t. the indices of these vertices.
- * triangles: Output array to hold triangles.
- *  
- * Enough space must be allocated for all the arrays before calling
- * this routine
- */
-void triangulate_polygon(SeidelTriangulator** inoutTriangulatorPtr, int ncontours, int cntr[], double (*vertices)[2], int (*triangles)[3])
+
+/* Fill the segment table of *inoutTriangulatorPtr, made if NULL, */
+/* with the contours. Returns the number of points or one of the */
+/* negative SEIDEL_ERR_* codes */
+static int load_polygon(SeidelTriangulator** inoutTriangulatorPtr, int ncontours, int cntr[], double (*vertices)[2])
 {
   register int i;
-  int nmonpoly, ccount, npoints, genus;
-  int n;
+  int ccount, npoints;
+    
+    int vertexCount = 0;
+    for (int c=0; c<ncontours; c++)
+    {
+        if (cntr[c] < 3) return SEIDEL_ERR_INPUT;
+        vertexCount += cntr[c];
+    }
+    if (ncontours <= 0) return SEIDEL_ERR_INPUT;
     
     SeidelTriangulator* state = *inoutTriangulatorPtr;
     if (NULL == state)
     {
-        int vertexCount = 0;
-        for (int c=0; c<ncontours; c++) vertexCount += cntr[c];
         state = SeidelTriangulatorCreate(vertexCount);
         *inoutTriangulatorPtr = state;
+        if (NULL == state) return SEIDEL_ERR_NOMEM;
     }
     else
     {
         SeidelTriangulatorReset(state);
     }
+    if (vertexCount >= state->segSize) return SEIDEL_ERR_CAPACITY;
+#ifdef FIX_SIZED_ARRAY
+    if (vertexCount >= SEGSIZE) return SEIDEL_ERR_CAPACITY;
+#endif
     
   ccount = 0;
   i = 1;
@@ -213,13 +353,140 @@ void triangulate_polygon(SeidelTriangulator** inoutTriangulatorPtr, int ncontour
       ccount++;
     }
   
-  genus = ncontours - 1;
-  n = i-1;
+  return i - 1;
+}
+
+
+/* Input specified as contours.
+ * Outer contour must be anti-clockwise.
+ * All inner contours must be clockwise.
+ *  
+ * Every contour is specified by giving all its points in order. No
+ * point shoud be repeated. i.e. if the outer contour is a square,
+ * only the four distinct endpoints shopudl be specified in order.
+ *  
+ * ncontours: #contours
+ * cntr: An array describing the number of points in each
+ *	 contour. Thus, cntr[i] = #points in the i'th contour.
+ * vertices: Input array of vertices. Vertices for each contour
+ *           immediately follow those for previous one. Array location
+ *           vertices[0] must NOT be used (i.e. i/p starts from
+ *           vertices[1] instead. The output triangles are
+ *	     specified  w.r.t. the indices of these vertices.
+ * triangles: Output array to hold triangles.
+ *  
+ * Enough space must be allocated for all the arrays before calling
+ * this routine
+ *
+ * Returns the number of triangles, n - 2 + 2 * #holes, or one of the
+ * negative SEIDEL_ERR_* codes. On error the contents of triangles are
+ * undefined but nothing is written outside that many triangles.
+ */
+int triangulate_polygon(SeidelTriangulator** inoutTriangulatorPtr, int ncontours, int cntr[], double (*vertices)[2], int (*triangles)[3])
+{
+  int n = load_polygon(inoutTriangulatorPtr, ncontours, cntr, vertices);
+
+  if (n < 0)
+    return n;
+  return triangulate_segments(*inoutTriangulatorPtr, n, n - 2 + 2 * (ncontours - 1), triangles);
+}
+
+
+/* triangulate_polygon() for the output of polygon_boolean(), which */
+/* may have several outer contours: nvert - 2 * nouter + 2 * #holes */
+/* triangles, straight from its buffers. SEIDEL_ERR_DEGENERATE if a */
+/* point occurs twice */
+int triangulate_contours(SeidelTriangulator** inoutTriangulatorPtr, SeidelContours *contours, int (*triangles)[3])
+{
+  int n, *dup, nholes = contours->ncontours - contours->nouter;
+
+  if (!contours->ncontours)
+    return 0;
+  /* contours that touch at a point would come out as wrong triangles; */
+  /* polygon_boolean() pulls them apart */
+  if (!(dup = (int *) malloc(sizeof(int) * (contours->nvert + 1))))
+    return SEIDEL_ERR_NOMEM;
+  n = find_repeats(contours->vertices + 1, contours->nvert, dup);
+  free(dup);
+  if (n)
+    return (n < 0) ? n : SEIDEL_ERR_DEGENERATE;
+  if ((n = load_polygon(inoutTriangulatorPtr, contours->ncontours, contours->cntr, contours->vertices)) < 0)
+    return n;
+  return triangulate_segments(*inoutTriangulatorPtr, n, n - 2 * contours->nouter + 2 * nholes, triangles);
+}
+
+
+/* Trapezoidal decomposition of the n segments in state->seg, in the */
+/* order and layout state->schedule asks for */
+static int build_trapezoids(SeidelTriangulator* state, int n)
+{
+  if (initialise(state, n) || construct_trapezoids(state, n) ||
+      ((state->schedule & SEIDEL_LAYOUT_COMPACT) && compact_tables(state)))
+    return state->error;
+  return 0;
+}
+
+/* The first half of triangulate_polygon(): build the trapezoidal
+ * decomposition of the polygon and stop there, for point location and
+ * for seidel_trapezoids() and seidel_rasterize(). Returns 0 or one of
+ * the negative SEIDEL_ERR_* codes.
+ */
+int trapezoidate_polygon(SeidelTriangulator** inoutTriangulatorPtr, int ncontours, int cntr[], double (*vertices)[2])
+{
+  SeidelTriangulator* state;
+  int n = load_polygon(inoutTriangulatorPtr, ncontours, cntr, vertices), err;
 
-  initialise(state, n);
-  construct_trapezoids(state, n);
-  nmonpoly = monotonate_trapezoids(state, n);
-  triangulate_monotone_polygons(state, n, nmonpoly, triangles);
+  if (n < 0)
+    return n;
+  state = *inoutTriangulatorPtr;
+  state->max_steps = step_budget(state, n);
+  err = build_trapezoids(state, n);
+  state->max_steps = 0;
+  return err;
+}
+
+
+/* triangulate_polygon() short of the triangles: split the polygon
+ * into y-monotone polygons and stop there, for seidel_monotone_polygons().
+ * Returns their number or one of the negative SEIDEL_ERR_* codes.
+ */
+int monotonate_polygon(SeidelTriangulator** inoutTriangulatorPtr, int ncontours, int cntr[], double (*vertices)[2])
+{
+  SeidelTriangulator* state;
+  int n = load_polygon(inoutTriangulatorPtr, ncontours, cntr, vertices), npoly;
+
+  if (n < 0)
+    return n;
+  state = *inoutTriangulatorPtr;
+  state->max_steps = step_budget(state, n);
+  state->maxtri = n - 2 + 2 * (ncontours - 1);
+  if (build_trapezoids(state, n))
+    npoly = state->error;
+  else
+    npoly = record_monotone_polygons(state, monotonate_trapezoids(state, n));
+  state->max_steps = 0;
+  return npoly;
+}
+
+
+/* Triangulate the n segments already linked into contours in */
+/* state->seg, which must give exactly maxtri triangles */
+int triangulate_segments(SeidelTriangulator* state, int n, int maxtri, int (*triangles)[3])
+{
+  int nmonpoly, ntriangles;
+
+  state->max_steps = step_budget(state, n);
+  state->maxtri = maxtri;
+
+  if (build_trapezoids(state, n))
+    ntriangles = state->error;
+  else if ((nmonpoly = monotonate_trapezoids(state, n)) < 0)
+    ntriangles = nmonpoly;
+  else
+    ntriangles = triangulate_monotone_polygons(state, n, nmonpoly, triangles);
+
+  state->max_steps = 0;		/* queries run unwatched */
+  return ntriangles;
 }
 
 
@@ -240,7 +507,11 @@ int is_point_inside_polygon(SeidelTriangulator* state, double vertex[2])
   v.x = vertex[0];
   v.y = vertex[1];
   
+  if (state->error)
+    return FALSE;
   trnum = locate_endpoint(state, &v, &v, 1);
+  if (trnum <= 0)
+    return FALSE;
   t = &state->tr[trnum];
   
   if (t->state == ST_INVALID)
@@ -253,4 +524,43 @@ int is_point_inside_polygon(SeidelTriangulator* state, double vertex[2])
 }
 
 
+#ifdef STANDALONE
+
+/* Read the contours from a file in the format described in misc.c */
+/* and print the triangles */
+int main(argc, argv)
+     int argc;
+     char *argv[];
+{
+  SeidelTriangulator *state = NULL;
+  int ncontours, *cntr;
+  double (*vertices)[2];
+  int (*op)[3];
+  int n, i, ntriangles;
+
+  if ((argc < 2) ||
+      ((n = read_segments(argv[1], &ncontours, &cntr, &vertices)) < 0))
+    {
+      fprintf(stderr, "usage: triangulate <filename>\n");
+      exit(1);
+    }
+
+  op = (int (*)[3]) malloc(sizeof(int) * 3 * (n + 2 * ncontours));
+  ntriangles = triangulate_polygon(&state, ncontours, cntr, vertices, op);
+  if (ntriangles < 0)
+    {
+      fprintf(stderr, "triangulate: error %d\n", ntriangles);
+      exit(1);
+    }
+
+  for (i = 0; i < ntriangles; i++)
+    printf("triangle #%d: %d %d %d\n", i, op[i][0], op[i][1], op[i][2]);
+
+  SeidelTriangulatorRelease(state);
+  free(op);
+  free(cntr);
+  free(vertices);
+  return 0;
+}
+
 #endif /* STANDALONE */
@@ -54,6 +54,22 @@ typedef struct {
 } monchain_t;			
 
 
+/* A distinct monotone polygon, located before any triangle is */
+/* emitted so that its slice of the output is known up front */
+
+typedef struct {
+  int posmax;			/* chain position of the topmost vertex */
+  int side;			/* TRI_LHS, TRI_RHS or 0 for a triangle */
+  int vcount;			/* #vertices, gives vcount - 2 triangles */
+  int op_ofs;			/* first output triangle */
+} monpoly_t;
+
+/* A trapezoid still to be visited, as traverse_polygon() takes it */
+typedef struct {
+  int mcur, trnum, from, dir;
+} visit_t;
+
+
 typedef struct {
   point_t pt;
   int vnext[4];			/* next vertices for the 4 chains */
@@ -70,6 +86,37 @@ typedef struct {
 #define QSIZE   8*SEGSIZE    /* maximum table sizes */
 #define TRSIZE  4*SEGSIZE    /* max# trapezoids */
 
+#define PAR_MIN_VERTICES 4096 /* below this many input points the */
+/* monotone polygons are always */
+/* triangulated on the calling thread. */
+/* Thread start-up costs more than */
+/* the work it would take over */
+
+#define STEPS_PER_SEGMENT 64 /* default step budget is this many */
+/* steps per segment and per level of */
+/* the query structure, see */
+/* SeidelTriangulatorSetStepBudget() */
+
+/* Insertion schedules, see SeidelTriangulatorSetSchedule(). An OR */
+/* of one SEIDEL_SCHEDULE_*, any SEIDEL_ORDER_* and the */
+/* SEIDEL_LAYOUT_COMPACT flags */
+
+#define SEIDEL_SCHEDULE_PHASED 0 /* Seidel's: log* n phases, after */
+/* each of which the segments still */
+/* to come locate their endpoints again */
+#define SEIDEL_SCHEDULE_NO_PHASES 1 /* an endpoint is located once, */
+/* from the root, when its segment goes */
+/* in. Gives up the O(n log* n) bound */
+/* for O(n log n) expected */
+#define SEIDEL_ORDER_HILBERT   2 /* insert the segments along a */
+/* Hilbert curve rather than at random */
+#define SEIDEL_ORDER_BRIO      4 /* random rounds of doubling size, */
+/* each along a Hilbert curve. Keeps the */
+/* expected bounds of a random order. */
+/* Overrides SEIDEL_ORDER_HILBERT */
+#define SEIDEL_LAYOUT_COMPACT  8 /* renumber the trapezoid and query */
+/* tables once built, see compact_tables() */
+
 //#define FIX_SIZED_ARRAY
 //#define GLOBAL_TRIANGULATOR
 
@@ -79,16 +126,23 @@ typedef struct {
     int segSize;
 #ifdef FIX_SIZED_ARRAY
     node_t qs[QSIZE];        /* Query structure */
+    trap_t tr_guard;        /* tr[-1] */
     trap_t tr[TRSIZE];        /* Trapezoid structure */
     segment_t seg[SEGSIZE];        /* Segment table */
 #else
     node_t* qs;//[QSIZE];        /* Query structure */
-    trap_t* tr;//[TRSIZE];        /* Trapezoid structure */
+    trap_t* tr;//[TRSIZE];        /* Trapezoid structure. tr[-1] is a */
+    /* guard entry: degenerate input can make the trapezoidation */
+    /* follow a -1 ("no neighbour") link, and the update then lands */
+    /* there instead of outside the table */
     segment_t* seg;//[SEGSIZE];        /* Segment table */
 #endif
     int q_idx;
-    int tr_idx;
-    
+    int tr_idx;			/* next free entry: the trapezoids in use */
+    /* are tr[1..tr_idx - 1]. Entries are cleared only as they are */
+    /* handed out, so tr[tr_idx] and beyond may hold stale trapezoids */
+    /* of an earlier, larger polygon; the same goes for q_idx and qs */
+
     int choose_idx;
 #ifdef FIX_SIZED_ARRAY
     int permute[SEGSIZE];
@@ -107,6 +161,9 @@ typedef struct {
     int mon[SEGSIZE]; /* contains position of any vertex in */
     /* the monotone chain for the polygon */
     int visited[TRSIZE];
+    monpoly_t mpoly[SEGSIZE]; /* distinct monotone polygons */
+    int rchain[SEGSIZE]; /* reflex chain of the monotone polygon */
+    /* being triangulated */
 #else
     int* permute;//[SEGSIZE];
     
@@ -124,8 +181,28 @@ typedef struct {
     int* mon;//[SEGSIZE]; /* contains position of any vertex in */
     /* the monotone chain for the polygon */
     int* visited;//[TRSIZE];
+    monpoly_t* mpoly;//[SEGSIZE]; /* distinct monotone polygons */
+    int* rchain;//[SEGSIZE]; /* reflex chain of the monotone polygon */
+    /* being triangulated */
 #endif
     int chain_idx, op_idx, mon_idx;
+    int mpoly_idx; /* distinct monotone polygons recorded in mpoly */
+    visit_t* visits; /* pending visits of traverse_polygon(), grown */
+    int visitSize; /* as needed and kept from run to run */
+    
+    int nthreads; /* worker threads for the monotone polygons */
+    
+    int error; /* first error met by the current run, 0 if none */
+    long step_budget; /* 0: default, < 0: unlimited */
+    int schedule; /* SEIDEL_SCHEDULE_* | SEIDEL_ORDER_* */
+    long steps, max_steps; /* watchdog for the current run */
+    int maxtri; /* output capacity of the current run, 0 if unchecked */
+    
+    int path_n, path_first; /* points of the path so far and first */
+    /* point of its open contour, 0 if none. See path.c */
+    int path_nccw, path_ncw; /* closed contours by orientation */
+    double path_maxarea; /* signed area of the largest contour */
+    double path_tolerance; /* curve flattening tolerance */
     
 } SeidelTriangulator;
 
@@ -133,6 +210,177 @@ typedef struct {
 extern SeidelTriangulator g_seidel;
 #endif
 
+/* Sweep-line status, a treap over caller items (see sweep.c) */
+
+typedef struct {
+  int left, right, parent;	/* node 0 is nil */
+  unsigned int prio;
+  int item;			/* caller's item, e.g. a segment */
+} sweepnode_t;
+
+typedef struct sweepline_s {
+  sweepnode_t *node;
+  int size, capacity;
+  int root, freelist;
+  unsigned int seed;
+  int (*cmp)(void *, int, int);	/* orders two items */
+  void (*update)(void *, struct sweepline_s *, int); /* subtree changed */
+  void *ctx;
+} sweepline_t;
+
+/* Edges added one at a time, for incremental simplicity checks */
+
+typedef struct {
+  point_t v0, v1;
+  double xmin, xmax;		/* x-extent of the edge */
+  double maxx;			/* largest xmax in its subtree */
+} edgeentry_t;
+
+typedef struct {
+  edgeentry_t *edge;		/* edge[1..nedges] */
+  int nedges, capacity;
+  sweepline_t tree;
+} SeidelEdgeSet;
+
+/* The same in a uniform grid of cells, see sweep.c */
+
+typedef struct {
+  point_t v0, v1;
+  int stamp;			/* last query that looked at it */
+} gridedge_t;
+
+typedef struct {
+  gridedge_t *edge;		/* edge[1..nedges] */
+  int nedges, capacity;
+  double x0, y0, cw, ch;	/* corner of the grid and cell size */
+  int side;			/* cells across and down */
+  int *head;			/* first entry of each cell, -1 if none */
+  int *next, *item;		/* entries: next in the cell, edge id */
+  int nentries, maxentries;
+  int stamp;
+} SeidelEdgeGrid;
+
+/* Triangulations keyed by their input, see cache.c */
+
+typedef struct SeidelCache_s SeidelCache;
+
+/* Level-of-detail pyramid, see simplify.c */
+
+typedef struct {
+  double tolerance;		/* simplified to this */
+  int ncontours, nvert;		/* what is left of the input */
+  int ntriangles;
+  int (*triangles)[3];		/* indices into the input vertices */
+} seidellevel_t;
+
+typedef struct {
+  seidellevel_t *level;		/* finest first */
+  int nlevels;
+} SeidelLOD;
+
+/* A polygon cut to a grid of tiles, see tile.c */
+
+typedef struct {
+  int col, row;
+  double x0, y0, x1, y1;	/* [x0, x1) x [y0, y1) */
+  int nvert;
+  double (*vertices)[2];	/* vertices[1..nvert] of the clipped piece */
+  int ntriangles;		/* or a negative error code */
+  int (*triangles)[3];		/* indices into vertices */
+} seideltile_t;
+
+typedef struct {
+  seideltile_t *tile;		/* row by row, cols * rows */
+  int cols, rows;
+} SeidelTiling;
+
+/* A trapezoid inside the polygon, see raster.c */
+
+typedef struct {
+  double y0, y1;		/* bottom and top, y0 < y1 */
+  double xl0, xr0;		/* left and right x at y0 */
+  double xl1, xr1;		/* and at y1 */
+} seideltrap_t;
+
+/* Area, centroid and second moments, see moments.c */
+
+typedef struct {
+  double area;
+  double cx, cy;		/* centroid */
+  double sxx, syy, sxy;		/* second moments about the centroid */
+} SeidelMoments;
+
+/* A polygon on its way through a SeidelPipeline, see pipeline.c. */
+/* The buffers stay with the job when it is recycled */
+
+typedef struct {
+  int ncontours, nvert;
+  int *cntr;			/* cntr[ncontours] */
+  double (*vertices)[2];	/* vertices[1..nvert] */
+  int ntriangles;		/* or a negative error code */
+  int (*triangles)[3];
+  void *user;			/* passed through untouched */
+  int maxcontours, maxvert, maxtriangles; /* room allocated */
+} seideljob_t;
+
+typedef struct SeidelPipeline_s SeidelPipeline;
+
+/* The result of polygon_boolean(), see clip.c: anticlockwise outer */
+/* contours first, then clockwise holes */
+
+#define SEIDEL_BOOL_UNION        0
+#define SEIDEL_BOOL_INTERSECTION 1
+#define SEIDEL_BOOL_DIFFERENCE   2 /* the first polygon less the second */
+#define SEIDEL_BOOL_XOR          3
+
+typedef struct {
+  int ncontours, nvert;
+  int nouter;			/* outer contours, the rest are holes */
+  int *cntr;			/* cntr[ncontours] */
+  double (*vertices)[2];	/* vertices[1..nvert] */
+  int maxcontours, maxvert;	/* room allocated */
+} SeidelContours;
+
+/* Buffer sizes for a polygon, see seidel_required_sizes() */
+
+typedef struct {
+  int npoints;			/* over all contours */
+  int ntriangles;		/* exactly n - 2 + 2 * #holes */
+  int initSegSize, initTrSize, initQSize; /* table entries a triangulator */
+				/* for the polygon starts with; */
+				/* the last two can grow */
+  size_t init_table_bytes;	/* and what they take at the start */
+  size_t triangle_bytes;	/* int (*)[3] output */
+  size_t index16_bytes;		/* SEIDEL_INDEX_UINT16 output, 0 if */
+				/* the points do not fit 16 bits */
+  size_t index32_bytes;		/* SEIDEL_INDEX_UINT32 output */
+} SeidelSizes;
+
+/* Index formats of seidel_write_indices(): bytes per index */
+
+#define SEIDEL_INDEX_UINT16 2
+#define SEIDEL_INDEX_UINT32 4
+
+/* Status codes. Every phase stops at the first error and */
+/* triangulate_polygon() returns it instead of a triangle count */
+
+#define SEIDEL_OK               0
+#define SEIDEL_ERR_INPUT       -1 /* a contour has fewer than 3 points */
+#define SEIDEL_ERR_NOMEM       -2 /* allocation failed */
+#define SEIDEL_ERR_CAPACITY    -3 /* more points than the triangulator */
+				  /* was created for */
+#define SEIDEL_ERR_QTABLE      -4 /* query-table overflow */
+#define SEIDEL_ERR_TRTABLE     -5 /* trapezoid-table overflow */
+#define SEIDEL_ERR_CHAIN       -6 /* monotone chain tables overflow */
+#define SEIDEL_ERR_DEGENERATE  -7 /* inconsistent structure, usually */
+				  /* input that is not a simple polygon */
+#define SEIDEL_ERR_BUDGET      -8 /* step budget used up */
+
+/* Count one step of work against the budget of the current run. */
+/* TRUE once the budget is used up */
+#define OVER_BUDGET(state) ((state)->max_steps > 0 && \
+			    ++(state)->steps > (state)->max_steps)
+
 /* Node types */
 
 #define T_X     1
@@ -156,6 +404,10 @@ extern SeidelTriangulator g_seidel;
 				/* spaced very close together */
 
 
+#define MAX_PHASES 7		/* log* n phases: 5 covers any int n */
+#define BRIO_MAX_ROUNDS 32	/* log2 n rounds of SEIDEL_ORDER_BRIO */
+
+
 #define S_LEFT 1		/* for merge-direction */
 #define S_RIGHT 2
 
@@ -198,19 +450,40 @@ extern "C" {
 
 int monotonate_trapezoids(SeidelTriangulator*, int);
 int triangulate_monotone_polygons(SeidelTriangulator*, int, int, int (*)[3]);
+int record_monotone_polygons(SeidelTriangulator*, int);
 
 int _greater_than(point_t *, point_t *);
 int _equal_to(point_t *, point_t *);
 int _greater_than_equal_to(point_t *, point_t *);
 int _less_than(point_t *, point_t *);
 int locate_endpoint(SeidelTriangulator*, point_t *, point_t *, int);
+int locate_beside(SeidelTriangulator*, point_t *, point_t *, int, int);
 int construct_trapezoids(SeidelTriangulator*, int);
+int compact_tables(SeidelTriangulator*);
+int triangulate_segments(SeidelTriangulator*, int, int, int (*)[3]);
+void SeidelTriangulatorReset(SeidelTriangulator*);
 
+int seidel_fail(SeidelTriangulator*, int);
 int generate_random_ordering(SeidelTriangulator*, int);
+int generate_hilbert_ordering(SeidelTriangulator*, int);
+int generate_brio_ordering(SeidelTriangulator*, int);
 int choose_segment(SeidelTriangulator*);
-int read_segments(char *, int *);
+int read_segments(char *, int *, int **, double (**)[2]);
 int math_logstar_n(int);
 int math_N(int, int);
+
+int sweepline_init(sweepline_t *, int, int (*)(void *, int, int), void (*)(void *, sweepline_t *, int), void *);
+void sweepline_free(sweepline_t *);
+int sweepline_insert(sweepline_t *, int);
+void sweepline_remove(sweepline_t *, int);
+int sweepline_prev(sweepline_t *, int);
+int sweepline_next(sweepline_t *, int);
+int segments_intersect(point_t *, point_t *, point_t *, point_t *);
+
+int find_repeats(double (*)[2], int, int *);
+int split_pinches(int, int *, int *, int, int *, int *);
+void pull_into_loop(double (*)[2], int, int, int, int);
+void separate_copies(double (*)[2], int *, int, int *, int *, int *, int);
     
 #ifdef __cplusplus
 }
@@ -2,6 +2,7 @@
 #define __interface_h
 
 #include "triangulate.h"
+#include <stdint.h>
 
 #define TRUE 1
 #define FALSE 0
@@ -12,9 +13,81 @@ extern "C" {
 
 SeidelTriangulator* SeidelTriangulatorCreate(int n);
 void SeidelTriangulatorRelease(SeidelTriangulator* state);
+void SeidelTriangulatorSetThreads(SeidelTriangulator* state, int nthreads);
+void SeidelTriangulatorSetStepBudget(SeidelTriangulator* state, long steps);
+void SeidelTriangulatorSetSchedule(SeidelTriangulator* state, int schedule);
 
-void triangulate_polygon(SeidelTriangulator**, int, int *, double (*)[2], int (*)[3]);
-int is_point_inside_polygon(double *);
+int triangulate_polygon(SeidelTriangulator**, int, int *, double (*)[2], int (*)[3]);
+int triangulate_polygon_welded(SeidelTriangulator**, int, int *, double (*)[2], double, int (*)[3], int *);
+int seidel_triangle_count(int, int *);
+int seidel_required_sizes(int, int *, SeidelSizes *);
+size_t seidel_index_bytes(int, int);
+int seidel_write_indices(int, int (*)[3], int, int, void *);
+int is_point_inside_polygon(SeidelTriangulator*, double [2]);
+
+int trapezoidate_polygon(SeidelTriangulator**, int, int *, double (*)[2]);
+int seidel_trapezoids(SeidelTriangulator*, seideltrap_t *);
+int monotonate_polygon(SeidelTriangulator**, int, int *, double (*)[2]);
+int seidel_monotone_polygons(SeidelTriangulator*, int *, int *);
+int convex_partition(double (*)[2], int, int (*)[3], int *, int *);
+int polygon_boolean(int, int, int *, double (*)[2], int, int *, double (*)[2], SeidelContours *);
+void seidel_contours_free(SeidelContours *);
+int triangulate_contours(SeidelTriangulator**, SeidelContours *, int (*)[3]);
+int seidel_rasterize(SeidelTriangulator*, float *, int, int, double, double, double, int);
+int seidel_polygon_moments(SeidelTriangulator*, SeidelMoments *);
+int seidel_segment_crossings(SeidelTriangulator*, double *, double *, int *, int);
+int seidel_nearest_edge(SeidelTriangulator*, double *, double *);
+
+int point_in_polygon(double, double, int, const double *, const double *);
+int points_in_polygon(int, const double *, const double *, int, const double *, const double *, unsigned char *);
+int point_edge_crossings(double, double, int, const double *, const double *, const double *, const double *);
+
+int validate_polygon(int, int *, double (*)[2], int *, int *);
+
+SeidelEdgeSet* SeidelEdgeSetCreate(int capacity);
+void SeidelEdgeSetRelease(SeidelEdgeSet* es);
+void edge_set_clear(SeidelEdgeSet*);
+int edge_set_add(SeidelEdgeSet*, double, double, double, double);
+int edge_set_intersects(SeidelEdgeSet*, double, double, double, double, int, int);
+
+SeidelEdgeGrid* SeidelEdgeGridCreate(double x0, double y0, double x1, double y1, int capacity);
+void SeidelEdgeGridRelease(SeidelEdgeGrid* eg);
+void edge_grid_clear(SeidelEdgeGrid*);
+int edge_grid_add(SeidelEdgeGrid*, double, double, double, double);
+int edge_grid_intersects(SeidelEdgeGrid*, double, double, double, double, int, int);
+int edge_grid_crossings(SeidelEdgeGrid*, double, double, int);
+
+SeidelCache* SeidelCacheCreate(size_t max_bytes, int nshards);
+void SeidelCacheRelease(SeidelCache* cache);
+void seidel_cache_clear(SeidelCache*);
+void seidel_cache_stats(SeidelCache*, long *, long *, int *, size_t *);
+int seidel_cache_triangulate(SeidelCache*, SeidelTriangulator**, int, int *, double (*)[2], int (*)[3], int *);
+uint64_t seidel_polygon_hash(int, int *, double (*)[2]);
+
+int simplify_polygon(int, int *, double (*)[2], double, int *, int *);
+SeidelLOD* SeidelLODCreate(int ncontours, int *cntr, double (*vertices)[2], int nlevels, double tolerance, double factor);
+void SeidelLODRelease(SeidelLOD* lod);
+int seidel_lod_select(SeidelLOD*, double);
+
+SeidelTiling* SeidelTilingCreate(int ncontours, int *cntr, double (*vertices)[2], double x0, double y0, double w, double h, int cols, int rows, int nthreads);
+void SeidelTilingRelease(SeidelTiling* tiling);
+
+SeidelPipeline* SeidelPipelineCreate(int depth, int nvert);
+void SeidelPipelineRelease(SeidelPipeline* pipeline);
+seideljob_t *seidel_pipeline_acquire(SeidelPipeline*, int, int);
+void seidel_pipeline_submit(SeidelPipeline*, seideljob_t *);
+void seidel_pipeline_finish(SeidelPipeline*);
+seideljob_t *seidel_pipeline_next(SeidelPipeline*);
+void seidel_pipeline_recycle(SeidelPipeline*, seideljob_t *);
+
+int seidel_path_begin(SeidelTriangulator**, double);
+int seidel_path_move_to(SeidelTriangulator*, double, double);
+int seidel_path_line_to(SeidelTriangulator*, double, double);
+int seidel_path_quad_to(SeidelTriangulator*, double, double, double, double);
+int seidel_path_cubic_to(SeidelTriangulator*, double, double, double, double, double, double);
+int seidel_path_close(SeidelTriangulator*);
+int seidel_path_vertices(SeidelTriangulator*, double (*)[2]);
+int triangulate_path(SeidelTriangulator*, int (*)[3]);
 
 #ifdef __cplusplus
 }
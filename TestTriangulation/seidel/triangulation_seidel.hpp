@@ -0,0 +1,316 @@
+#ifndef __interface_hpp
+#define __interface_hpp
+
+/* C++17 front end to the triangulator, header only.
+ *
+ * seidel::triangulator owns a SeidelTriangulator and its tables and
+ * releases them when it goes out of scope. It can be moved but not
+ * copied. Input is taken as views over the caller's arrays, point
+ * coordinates go straight into the segment table, and triangles are
+ * handed to a sink, so nothing is built in between. Once reserve() has
+ * made room for the largest polygon, or the first few calls have grown
+ * the tables to it, a loop of triangulate() calls allocates nothing
+ * under the default schedule. The Hilbert and BRIO orders,
+ * SEIDEL_LAYOUT_COMPACT and threads > 1 still allocate per run.
+ *
+ * The coordinate type and the tolerance are fixed at compile time by a
+ * configuration:
+ *
+ *	struct glyph_config {
+ *	  using coord_type = float;
+ *	  static constexpr double tolerance = 1.0e-4;
+ *	};
+ *	seidel::basic_triangulator<glyph_config> t(1024);
+ *
+ * The C code decides collinearity and left/right to within C_EPS. A
+ * different tolerance is had by scaling the points by C_EPS / tolerance
+ * on the way into the segment table, which moves no point relative to
+ * another and leaves the triangles as they were.
+ *
+ * Points are numbered from 0 here, not from 1 as in the C interface.
+ */
+
+#include "triangulation_seidel.h"
+#include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace seidel {
+
+/* Contiguous view, the part of C++20's std::span used here. Made from */
+/* a pointer and a size, a C array, or any container with data() and */
+/* size() */
+template <class T>
+class span
+{
+public:
+  using element_type = T;
+  using size_type = std::size_t;
+
+  constexpr span() noexcept : data_(nullptr), size_(0) {}
+  constexpr span(T *data, size_type size) noexcept : data_(data), size_(size) {}
+  template <std::size_t N>
+  constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+  template <class C, class = std::enable_if_t<
+    std::is_convertible_v<decltype(std::declval<C &>().data()), T *>>>
+  constexpr span(C &c) noexcept : data_(c.data()), size_(c.size()) {}
+
+  constexpr T *data() const noexcept { return data_; }
+  constexpr size_type size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+  constexpr T &operator[](size_type i) const noexcept { return data_[i]; }
+  constexpr T *begin() const noexcept { return data_; }
+  constexpr T *end() const noexcept { return data_ + size_; }
+
+private:
+  T *data_;
+  size_type size_;
+};
+
+/* The configuration of seidel::triangulator: double coordinates and */
+/* the tolerance of the C code */
+struct default_config
+{
+  using coord_type = double;
+  static constexpr double tolerance = C_EPS;
+};
+
+using triangle = std::array<int, 3>;
+static_assert(sizeof(triangle) == 3 * sizeof(int), "triangle must be int[3]");
+
+template <class Config = default_config>
+class basic_triangulator
+{
+public:
+  using coord_type = typename Config::coord_type;
+  static constexpr double tolerance = Config::tolerance;
+
+  static_assert(std::is_arithmetic_v<coord_type>, "coord_type must be a number");
+  static_assert(tolerance > 0, "tolerance must be positive");
+
+  basic_triangulator() noexcept = default;
+
+  /* Room for npoints points in ncontours contours */
+  explicit basic_triangulator(int npoints, int ncontours = 1)
+  {
+    reserve(npoints, ncontours);
+  }
+
+  ~basic_triangulator() { SeidelTriangulatorRelease(state_); }
+
+  basic_triangulator(const basic_triangulator &) = delete;
+  basic_triangulator &operator=(const basic_triangulator &) = delete;
+
+  basic_triangulator(basic_triangulator &&other) noexcept
+    : state_(std::exchange(other.state_, nullptr)),
+      out_(std::move(other.out_)),
+      threads_(other.threads_), budget_(other.budget_),
+      schedule_(other.schedule_)
+  {
+  }
+
+  basic_triangulator &operator=(basic_triangulator &&other) noexcept
+  {
+    if (this != &other)
+      {
+	SeidelTriangulatorRelease(state_);
+	state_ = std::exchange(other.state_, nullptr);
+	out_ = std::move(other.out_);
+	threads_ = other.threads_;
+	budget_ = other.budget_;
+	schedule_ = other.schedule_;
+      }
+    return *this;
+  }
+
+  /* Make room for npoints points in ncontours contours, so that */
+  /* triangulating that much allocates nothing. Throws std::bad_alloc */
+  void reserve(int npoints, int ncontours = 1)
+  {
+    if (grow(npoints, ncontours))
+      throw std::bad_alloc();
+  }
+
+  /* Most points triangulate() takes without growing */
+  int capacity() const noexcept { return state_ ? state_->segSize - 1 : 0; }
+
+  /* See SeidelTriangulatorSetThreads(), SeidelTriangulatorSetStepBudget() */
+  /* and SeidelTriangulatorSetSchedule() */
+  void set_threads(int nthreads) noexcept
+  {
+    threads_ = nthreads;
+    if (state_)
+      SeidelTriangulatorSetThreads(state_, nthreads);
+  }
+
+  void set_step_budget(long steps) noexcept
+  {
+    budget_ = steps;
+    if (state_)
+      SeidelTriangulatorSetStepBudget(state_, steps);
+  }
+
+  void set_schedule(int schedule) noexcept
+  {
+    schedule_ = schedule;
+    if (state_)
+      SeidelTriangulatorSetSchedule(state_, schedule);
+  }
+
+  /* Triangulate the contours of the polygon, as for triangulate_polygon(): */
+  /* contours[i] points in the i'th contour, the outer one anti-clockwise */
+  /* and the holes clockwise, xy holding x and y of every point in turn. */
+  /* sink(a, b, c) is called for each triangle. Returns the number of */
+  /* triangles or one of the negative SEIDEL_ERR_* codes, in which case */
+  /* the sink is not called */
+  template <class Sink, class = std::enable_if_t<std::is_invocable_v<Sink &, int, int, int>>>
+  int triangulate(span<const int> contours, span<const coord_type> xy, Sink &&sink)
+  {
+    int ntriangles = run(contours, xy);
+
+    for (int i = 0; i < ntriangles; i++)
+      sink(out_[i][0] - 1, out_[i][1] - 1, out_[i][2] - 1);
+    return ntriangles;
+  }
+
+  /* As above with the triangles written to out, SEIDEL_ERR_CAPACITY */
+  /* if they do not fit */
+  int triangulate(span<const int> contours, span<const coord_type> xy, span<triangle> out)
+  {
+    int ntriangles = run(contours, xy);
+
+    if ((ntriangles > 0) && (static_cast<std::size_t>(ntriangles) > out.size()))
+      return SEIDEL_ERR_CAPACITY;
+    for (int i = 0; i < ntriangles; i++)
+      out[i] = {out_[i][0] - 1, out_[i][1] - 1, out_[i][2] - 1};
+    return ntriangles;
+  }
+
+  /* A polygon without holes */
+  template <class Out>
+  int triangulate(span<const coord_type> xy, Out &&out)
+  {
+    int n = static_cast<int>(xy.size() / 2);
+
+    return triangulate(span<const int>(&n, 1), xy, std::forward<Out>(out));
+  }
+
+  /* Whether (x, y) is inside the polygon last triangulated, see */
+  /* is_point_inside_polygon() */
+  bool contains(coord_type x, coord_type y) const noexcept
+  {
+    double v[2] = { scaled(x), scaled(y) };
+
+    return state_ && is_point_inside_polygon(state_, v);
+  }
+
+  /* The C triangulator, for the calls this class does not wrap */
+  SeidelTriangulator *get() const noexcept { return state_; }
+
+private:
+  static constexpr double scale = C_EPS / tolerance;
+
+  static double scaled(coord_type v) noexcept
+  {
+    if constexpr (scale == 1.0)
+      return static_cast<double>(v);
+    else
+      return static_cast<double>(v) * scale;
+  }
+
+  /* Make room as reserve() does, growing by half at least. Returns 0 */
+  /* or SEIDEL_ERR_NOMEM */
+  int grow(int npoints, int ncontours) noexcept
+  {
+    if (!state_ || (npoints >= state_->segSize))
+      {
+	int size = state_ ? state_->segSize + state_->segSize / 2 : 0;
+	SeidelTriangulator *state;
+
+	state = SeidelTriangulatorCreate((npoints > size) ? npoints : size);
+	if (!state)
+	  return SEIDEL_ERR_NOMEM;
+	SeidelTriangulatorRelease(state_);
+	state_ = state;
+	SeidelTriangulatorSetThreads(state_, threads_);
+	SeidelTriangulatorSetStepBudget(state_, budget_);
+	SeidelTriangulatorSetSchedule(state_, schedule_);
+      }
+
+    std::size_t maxtri = static_cast<std::size_t>(npoints) + 2 * ncontours;
+    if (out_.size() < maxtri)
+      {
+	try
+	  {
+	    out_.resize(maxtri);
+	  }
+	catch (const std::bad_alloc &)
+	  {
+	    return SEIDEL_ERR_NOMEM;
+	  }
+      }
+    return 0;
+  }
+
+  /* Fill the segment table from the views and triangulate into out_ */
+  int run(span<const int> contours, span<const coord_type> xy)
+  {
+    int ncontours = static_cast<int>(contours.size());
+    int n = 0, i, j, first, last, err;
+    segment_t *seg;
+
+    if (ncontours <= 0)
+      return SEIDEL_ERR_INPUT;
+    for (int c : contours)
+      {
+	if (c < 3)
+	  return SEIDEL_ERR_INPUT;
+	n += c;
+      }
+    if (xy.size() != 2 * static_cast<std::size_t>(n))
+      return SEIDEL_ERR_INPUT;
+#ifdef FIX_SIZED_ARRAY
+    if (n >= SEGSIZE)
+      return SEIDEL_ERR_CAPACITY;
+#endif
+    if ((err = grow(n, ncontours)))
+      return err;
+
+    SeidelTriangulatorReset(state_);
+    seg = state_->seg;
+    i = 1;
+    for (int c : contours)
+      {
+	first = i;
+	last = first + c - 1;
+	for (j = first; j <= last; j++)
+	  {
+	    seg[j].v0.x = scaled(xy[2 * (j - 1)]);
+	    seg[j].v0.y = scaled(xy[2 * (j - 1) + 1]);
+	    seg[j].next = (j == last) ? first : j + 1;
+	    seg[j].prev = (j == first) ? last : j - 1;
+	  }
+	for (j = first; j <= last; j++)
+	  seg[j].v1 = seg[seg[j].next].v0;
+	i = last + 1;
+      }
+
+    return triangulate_segments(state_, n, n - 2 + 2 * (ncontours - 1),
+				reinterpret_cast<int (*)[3]>(out_.data()));
+  }
+
+  SeidelTriangulator *state_ = nullptr;
+  std::vector<triangle> out_;
+  int threads_ = 1;
+  long budget_ = 0;
+  int schedule_ = SEIDEL_SCHEDULE_PHASED;
+};
+
+using triangulator = basic_triangulator<>;
+
+} /* namespace seidel */
+
+#endif /* __interface_hpp */
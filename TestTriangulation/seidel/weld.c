@@ -0,0 +1,293 @@
+#include "triangulate.h"
+#include "triangulation_seidel.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/* Vertex welding. Points within a tolerance of each other are merged
+ * into the first of them met, found through a hash of a grid with cells
+ * the size of the tolerance, so that the pass takes linear expected
+ * time. The welded contours go straight into the segment table: a point
+ * welded to the one before it would make a segment of zero length and
+ * is dropped, and so is a hole left with fewer than 3 points. Points
+ * welded together that are not neighbours in a contour would leave
+ * contours that touch themselves or each other there, which the
+ * triangulator cannot take: split_welded() cuts and pulls them apart
+ * as polygon_boolean() does its results.
+ */
+
+#define WELD_EMPTY 0		/* end of a bucket chain */
+
+
+/* Bucket of grid cell (cx, cy) in a table of mask + 1 buckets */
+static uint32_t weld_bucket(long long cx, long long cy, uint32_t mask)
+{
+  uint64_t h = (uint64_t) cx * 0x9e3779b97f4a7c15ULL ^ (uint64_t) cy * 0xc2b2ae3d27d4eb4fULL;
+
+  return (uint32_t) (h ^ (h >> 29)) & mask;
+}
+
+/* Index of the point vertices[i] is welded to, i itself if it is */
+/* the first point of its cluster, in which case it is hashed */
+static int weld_point(double (*vertices)[2], int i, double tolerance, double cell,
+		      int *head, int *next, uint32_t mask)
+{
+  double x = vertices[i][0], y = vertices[i][1];
+  long long cx = (long long) floor(x / cell), cy = (long long) floor(y / cell);
+  int reach = (tolerance > 0) ? 1 : 0;
+  int dx, dy, k;
+  uint32_t b;
+
+  for (dx = -reach; dx <= reach; dx++)
+    for (dy = -reach; dy <= reach; dy++)
+      for (k = head[weld_bucket(cx + dx, cy + dy, mask)]; k != WELD_EMPTY; k = next[k])
+	if ((fabs(vertices[k][0] - x) <= tolerance) &&
+	    (fabs(vertices[k][1] - y) <= tolerance))
+	  return k;
+
+  b = weld_bucket(cx, cy, mask);
+  next[i] = head[b];
+  head[b] = i;
+  return i;
+}
+
+
+/* Cut the loops of pt[1 .. m], loop k being pt[start[k] .. start[k+1]-1],
+ * where welding made them touch themselves or each other. They are
+ * rewritten in place, orig[] alongside, as loops through each point
+ * once, the *nouter anticlockwise ones first and the flat ones dropped,
+ * and the copies of a point loops still share are pulled apart. start[]
+ * must have room for m + nloops + 2 entries. Returns the number of
+ * loops or SEIDEL_ERR_NOMEM.
+ */
+static int split_welded(double (*pt)[2], int *orig, int m, int nloops, int *start, int *nouter)
+{
+  int *dup, *order, *ostart, *from, *loopof, *link, *inner, *share;
+  double (*was)[2], *area;
+  int ngroups, nsplit, pass, i, j, k, l, c;
+
+  *nouter = 1;
+  dup = (int *) malloc(sizeof(int) * (8 * (size_t) (m + 1) + nloops + 1));
+  was = (double (*)[2]) malloc(sizeof(double) * (3 * (size_t) (m + 1) + nloops));
+  if (!dup || !was)
+    {
+      free(dup);
+      free(was);
+      return SEIDEL_ERR_NOMEM;
+    }
+  order = dup + m + 1;
+  from = order + m + 1;
+  loopof = from + m + 1;
+  link = loopof + m + 1;
+  inner = link + m + 1;
+  share = inner + m + 1;
+  ostart = share + m + 1;
+  area = (double *) (was + m + 1);
+
+  if (((ngroups = find_repeats(pt + 1, m, dup + 1)) <= 0) ||
+      ((nsplit = split_pinches(nloops, start, dup, ngroups, order, ostart)) < 0))
+    {
+      free(dup);
+      free(was);
+      return (ngroups < 0) ? ngroups : (ngroups ? nsplit : nloops);
+    }
+
+  memcpy(was, pt, sizeof(double) * 2 * (m + 1));
+  memcpy(from, orig, sizeof(int) * (m + 1));
+  for (l = 0; l < nsplit; l++)
+    for (area[l] = 0, i = ostart[l]; i < ostart[l + 1]; i++)
+      {
+	double *p = was[order[i]], *q = was[order[(i + 1 < ostart[l + 1]) ? i + 1 : ostart[l]]];
+
+	area[l] += p[0] * q[1] - q[0] * p[1];
+      }
+
+  /* anticlockwise loops, then the holes, each copy of a point linked */
+  /* to the one written before it */
+  for (i = 0; i < ngroups; i++)
+    share[i] = 0;
+  *nouter = 0;
+  start[0] = 1;
+  for (j = 0, k = 0, pass = 0; pass < 2; pass++)
+    for (l = 0; l < nsplit; l++)
+      if ((ostart[l + 1] - ostart[l] >= 3) && (area[l] != 0) && ((area[l] > 0) == (pass == 0)))
+	{
+	  for (i = ostart[l]; i < ostart[l + 1]; i++)
+	    {
+	      c = order[i];
+	      j++;
+	      pt[j][0] = was[c][0];
+	      pt[j][1] = was[c][1];
+	      orig[j] = from[c];
+	      loopof[j] = k;
+	      link[j] = (dup[c] >= 0) ? share[dup[c]] : 0;
+	      if (dup[c] >= 0)
+		share[dup[c]] = j;
+	    }
+	  start[++k] = j + 1;
+	  *nouter += (pass == 0);
+	}
+  for (i = 0; i < ngroups; i++)
+    if (share[i] && link[share[i]])
+      separate_copies(pt, start, *nouter, loopof, link, inner, share[i]);
+
+  free(dup);
+  free(was);
+  return k;
+}
+
+
+/* triangulate_polygon() for input that may repeat points. Points
+ * within tolerance of each other in x and y are welded, 0 welding
+ * only exact repeats. The triangles index the input vertices, each
+ * welded point standing for those welded to it; if remap is not NULL,
+ * remap[i] is the vertex that stands for vertices[i], for i in 1..n.
+ * Triangles left with two corners welded together are dropped. The
+ * outer contour must keep at least 3 points.
+ *
+ * Returns the number of triangles, at most n - 2 + 2 * #holes, or one
+ * of the negative SEIDEL_ERR_* codes: SEIDEL_ERR_CAPACITY if welding
+ * cuts so many holes off the contours that there would be more.
+ */
+int triangulate_polygon_welded(SeidelTriangulator** inoutTriangulatorPtr, int ncontours, int cntr[],
+			       double (*vertices)[2], double tolerance, int (*triangles)[3], int remap[])
+{
+  SeidelTriangulator* state;
+  segment_t *seg;
+  double (*pt)[2];
+  int *head, *next, *rep, *orig, *start;
+  int c, i, j, k, n = 0, m, first, nloops, nouter, maxtri, ntriangles;
+  uint32_t size = 1;
+
+  if ((ncontours <= 0) || !(tolerance >= 0))
+    return SEIDEL_ERR_INPUT;
+  for (c = 0; c < ncontours; c++)
+    {
+      if (cntr[c] < 0)
+	return SEIDEL_ERR_INPUT;
+      n += cntr[c];
+    }
+  if (cntr[0] < 3)
+    return SEIDEL_ERR_INPUT;
+
+  state = *inoutTriangulatorPtr;
+  if (NULL == state)
+    {
+      state = SeidelTriangulatorCreate(n);
+      *inoutTriangulatorPtr = state;
+      if (NULL == state)
+	return SEIDEL_ERR_NOMEM;
+    }
+  else
+    SeidelTriangulatorReset(state);
+  if (n >= state->segSize)
+    return SEIDEL_ERR_CAPACITY;
+#ifdef FIX_SIZED_ARRAY
+  if (n >= SEGSIZE)
+    return SEIDEL_ERR_CAPACITY;
+#endif
+
+  while (size < 2 * (uint32_t) n)
+    size <<= 1;
+  head = (int *) calloc(size + 4 * (size_t) (n + 1) + ncontours + 1, sizeof(int));
+  pt = (double (*)[2]) malloc(sizeof(double) * 2 * (n + 1));
+  if (!head || !pt)
+    {
+      free(head);
+      free(pt);
+      return SEIDEL_ERR_NOMEM;
+    }
+  next = head + size;
+  rep = next + n + 1;
+  orig = rep + n + 1;
+  start = orig + n + 1;
+
+  for (i = 1; i <= n; i++)
+    rep[i] = weld_point(vertices, i, tolerance, (tolerance > 0) ? tolerance : 1.0,
+			head, next, size - 1);
+
+  /* The welded contours into pt[1 .. m], orig[] keeping the input */
+  /* vertex of every point kept */
+  m = 0;
+  nloops = 0;
+  start[0] = 1;
+  for (c = 0, i = 1; c < ncontours; i += cntr[c++])
+    {
+      first = m + 1;
+      for (j = i; j < i + cntr[c]; j++)
+	{
+	  k = rep[j];
+	  if ((m >= first) && (orig[m] == k))
+	    continue;
+	  m++;
+	  pt[m][0] = vertices[k][0];
+	  pt[m][1] = vertices[k][1];
+	  orig[m] = k;
+	}
+      if ((m > first) && (orig[m] == orig[first]))
+	m--;
+
+      if (m - first < 2)
+	{
+	  if (c == 0)
+	    {
+	      ntriangles = SEIDEL_ERR_INPUT;
+	      goto done;
+	    }
+	  m = first - 1;
+	  continue;
+	}
+      start[++nloops] = m + 1;
+    }
+
+  if ((nloops = split_welded(pt, orig, m, nloops, start, &nouter)) < 0)
+    {
+      ntriangles = nloops;
+      goto done;
+    }
+  m = start[nloops] - 1;
+  maxtri = m - 2 * nouter + 2 * (nloops - nouter);
+  if (!nouter || (maxtri > n - 2 + 2 * (ncontours - 1)))
+    {
+      ntriangles = nouter ? SEIDEL_ERR_CAPACITY : SEIDEL_ERR_INPUT;
+      goto done;
+    }
+
+  seg = state->seg;
+  for (k = 0; k < nloops; k++)
+    {
+      for (j = start[k]; j < start[k + 1]; j++)
+	{
+	  seg[j].v0.x = pt[j][0];
+	  seg[j].v0.y = pt[j][1];
+	  seg[j].next = (j + 1 < start[k + 1]) ? j + 1 : start[k];
+	  seg[j].prev = (j > start[k]) ? j - 1 : start[k + 1] - 1;
+	  seg[j].is_inserted = FALSE;
+	}
+      for (j = start[k]; j < start[k + 1]; j++)
+	seg[j].v1 = seg[seg[j].next].v0;
+    }
+
+  /* back to the input vertices, dropping the slivers between copies */
+  /* of a point that were pulled apart */
+  ntriangles = triangulate_segments(state, m, maxtri, triangles);
+  for (i = 0, j = 0; j < ntriangles; j++)
+    {
+      for (k = 0; k < 3; k++)
+	triangles[i][k] = orig[triangles[j][k]];
+      if ((triangles[i][0] != triangles[i][1]) && (triangles[i][1] != triangles[i][2]) &&
+	  (triangles[i][2] != triangles[i][0]))
+	i++;
+    }
+  if (ntriangles > 0)
+    ntriangles = i;
+  if (remap)
+    for (i = 1; i <= n; i++)
+      remap[i] = rep[i];
+
+ done:
+  free(head);
+  free(pt);
+  return ntriangles;
+}
@@ -7,31 +7,1365 @@
 //
 
 #import <XCTest/XCTest.h>
+#import "triangulation_seidel.h"
+#import "oracle.h"
+#import "IndexBufferRing.h"
+
+// Index buffers in plain memory, to test IndexBufferRing off the GPU
+@interface FakeIndexBuffer : NSObject <IndexBuffer>
+@property (nonatomic, strong) NSMutableData* data;
+@end
+
+@implementation FakeIndexBuffer
+-(void*) contents {
+    return _data.mutableBytes;
+}
+-(NSUInteger) length {
+    return _data.length;
+}
+@end
+
+@interface FakeIndexBufferAllocator : NSObject <IndexBufferAllocator>
+@end
+
+@implementation FakeIndexBufferAllocator
+-(id<IndexBuffer>) newIndexBufferWithLength:(NSUInteger)length {
+    FakeIndexBuffer* buffer = [[FakeIndexBuffer alloc] init];
+    buffer.data = [NSMutableData dataWithLength:length];
+    return buffer;
+}
+@end
 
 @interface TestTriangulationTests : XCTestCase
 
 @end
 
+static int compare_triangles(const void *a, const void *b)
+{
+    const int *p = a, *q = b;
+    for (int k = 0; k < 3; k++)
+        if (p[k] != q[k])
+            return (p[k] < q[k]) ? -1 : 1;
+    return 0;
+}
+
+// Triangles as a set: each turned to start at its least index, then sorted
+static void sort_triangles(int (*triangles)[3], int ntriangles)
+{
+    for (int i = 0; i < ntriangles; i++)
+        while ((triangles[i][0] > triangles[i][1]) || (triangles[i][0] > triangles[i][2]))
+        {
+            int t = triangles[i][0];
+            triangles[i][0] = triangles[i][1];
+            triangles[i][1] = triangles[i][2];
+            triangles[i][2] = t;
+        }
+    qsort(triangles, ntriangles, sizeof(int) * 3, compare_triangles);
+}
+
+// Twice the area of the triangles, from the input vertices they index
+static double welded_area(double (*vertices)[2], int (*triangles)[3], int ntriangles)
+{
+    double twice = 0;
+    for (int k = 0; k < ntriangles; k++)
+    {
+        double *a = vertices[triangles[k][0]], *b = vertices[triangles[k][1]], *c = vertices[triangles[k][2]];
+        double t = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+        if (!(t > 0))
+            return -1;
+        twice += t;
+    }
+    return twice;
+}
+
 @implementation TestTriangulationTests
 
-- (void)setUp {
-    // Put setup code here. This method is called before the invocation of each test method in the class.
+- (void)assertTriangulates:(int)ncontours sizes:(int*)cntr vertices:(double(*)[2])vertices {
+    int n = 0;
+    for (int c = 0; c < ncontours; c++)
+        n += cntr[c];
+    int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 2 * ncontours));
+    SeidelTriangulator* seidel = NULL;
+    char why[256];
+
+    int ntriangles = triangulate_polygon(&seidel, ncontours, cntr, vertices, triangles);
+    XCTAssertEqual(ntriangles, n - 2 + 2 * (ncontours - 1));
+    if (ntriangles >= 0)
+    {
+        int code = check_triangulation(ncontours, cntr, vertices, triangles, ntriangles, why, sizeof(why));
+        XCTAssertEqual(code, 0, @"%s", why);
+    }
+
+    SeidelTriangulatorRelease(seidel);
+    free(triangles);
+}
+
+// The sample input shipped with the triangulator: a square with three triangular holes
+- (void)testSquareWithHoles {
+    int cntr[] = {4, 3, 3, 3};
+    double vertices[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {0.5, 1.0}, {1.0, 2.0}, {2.0, 1.5},
+        {0.5, 4.0}, {1.0, 5.0}, {2.0, 4.5},
+        {3.0, 3.0}, {5.0, 3.5}, {5.0, 2.5},
+    };
+    [self assertTriangulates:4 sizes:cntr vertices:vertices];
+}
+
+- (void)testRandomStarsWithHoles {
+    double vertices[1 + 64 + 9 * 16][2];
+    int cntr[10];
+    unsigned char data[1024];
+
+    srand(7);
+    for (int i = 0; i < 500; i++)
+    {
+        for (int k = 0; k < sizeof(data); k++)
+            data[k] = (unsigned char)rand();
+        int ncontours = make_star_with_holes(data, sizeof(data), cntr, vertices);
+        [self assertTriangulates:ncontours sizes:cntr vertices:vertices];
+    }
+}
+
+- (void)testParallelMonotoneTriangulation {
+    // A blob with holes past PAR_MIN_VERTICES points, so the monotone
+    // polygons are triangulated on four threads: the same triangles as
+    // on one, and a triangulation by the oracle
+    const int n = 6000, k = 4, nh = k * k, nv = n + 4 * nh;
+    double (*vertices)[2] = malloc(sizeof(double) * 2 * (nv + 1));
+    int (*triangles)[3] = malloc(sizeof(int) * 3 * (nv + 2 * nh));
+    int (*serial)[3] = malloc(sizeof(int) * 3 * (nv + 2 * nh));
+    int cntr[1 + k * k];
+    char why[256];
+    cntr[0] = n;
+    for (int i = 0; i < n; i++)
+    {
+        double t = 2 * M_PI * i / n;
+        double r = 1.0 + 0.3 * sin(7 * t) + 0.1 * cos(23 * t);
+        vertices[1 + i][0] = r * cos(t);
+        vertices[1 + i][1] = r * sin(t);
+    }
+    int m = n;
+    for (int i = 0; i < k; i++)
+        for (int j = 0; j < k; j++)
+        {
+            double box[][2] = {{0, 0}, {0, 0.05}, {0.05, 0.05}, {0.05, 0}};
+            cntr[1 + i * k + j] = 4;
+            for (int c = 0; c < 4; c++, m++)
+            {
+                vertices[1 + m][0] = -0.3 + 0.15 * i + box[c][0];
+                vertices[1 + m][1] = -0.3 + 0.15 * j + box[c][1];
+            }
+        }
+
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(nv);
+    int nserial = triangulate_polygon(&seidel, 1 + nh, cntr, vertices, serial);
+    XCTAssertEqual(nserial, nv - 2 + 2 * nh);
+    sort_triangles(serial, (nserial > 0) ? nserial : 0);
+
+    SeidelTriangulatorSetThreads(seidel, 4);
+    for (int run = 0; run < 3; run++)
+    {
+        int ntriangles = triangulate_polygon(&seidel, 1 + nh, cntr, vertices, triangles);
+        XCTAssertEqual(ntriangles, nserial);
+        if (ntriangles < 0)
+            continue;
+        XCTAssertEqual(check_triangulation(1 + nh, cntr, vertices, triangles, ntriangles, why, sizeof(why)), 0, @"%s", why);
+        sort_triangles(triangles, ntriangles);
+        if (ntriangles == nserial)
+            XCTAssertEqual(memcmp(triangles, serial, sizeof(int) * 3 * nserial), 0);
+    }
+
+    SeidelTriangulatorRelease(seidel);
+    free(serial);
+    free(triangles);
+    free(vertices);
+}
+
+- (void)testVectorCrossingsMatchScalar {
+    // The vector kernels against the scalar EDGE_CROSSES loop of
+    // point_in_polygon(), on a batch and an edge count that leave a
+    // tail past any lane width. A third of the points sit level with
+    // a vertex, where the y comparisons decide
+    const int nvert = 37, npoints = 1001;
+    double vx[nvert], vy[nvert], x1[nvert], y1[nvert];
+    double *px = malloc(sizeof(double) * npoints), *py = malloc(sizeof(double) * npoints);
+    unsigned char *inside = malloc(npoints);
+    for (int i = 0; i < nvert; i++)
+    {
+        double t = 2 * M_PI * i / nvert;
+        double r = 1.0 + 0.4 * sin(5 * t);
+        vx[i] = r * cos(t);
+        vy[i] = r * sin(t);
+    }
+    for (int i = 0; i < nvert; i++)
+    {
+        x1[i] = vx[(i + 1) % nvert];
+        y1[i] = vy[(i + 1) % nvert];
+    }
+    srand(27);
+    for (int k = 0; k < npoints; k++)
+    {
+        px[k] = 3.0 * rand() / RAND_MAX - 1.5;
+        py[k] = (k % 3) ? 3.0 * rand() / RAND_MAX - 1.5 : vy[k % nvert];
+    }
+
+    int count = 0;
+    for (int k = 0; k < npoints; k++)
+        count += point_in_polygon(px[k], py[k], nvert, vx, vy);
+    XCTAssertGreaterThan(count, 0);
+    XCTAssertLessThan(count, npoints);
+    XCTAssertEqual(points_in_polygon(npoints, px, py, nvert, vx, vy, inside), count);
+    for (int k = 0; k < npoints; k++)
+    {
+        int scalar = point_in_polygon(px[k], py[k], nvert, vx, vy);
+        XCTAssertEqual(inside[k], scalar, @"point %d", k);
+        // one edge at a time never reaches the vector loop
+        int crossings = 0;
+        for (int i = 0; i < nvert; i++)
+            crossings += point_edge_crossings(px[k], py[k], 1, vx + i, vy + i, x1 + i, y1 + i);
+        XCTAssertEqual(crossings & 1, scalar, @"point %d", k);
+        XCTAssertEqual(point_edge_crossings(px[k], py[k], nvert, vx, vy, x1, y1), crossings, @"point %d", k);
+    }
+
+    free(inside);
+    free(py);
+    free(px);
+}
+
+- (void)testSelfIntersectingPolygonIsRejected {
+    int cntr[] = {4};
+    double vertices[][2] = {{0, 0}, {0, 0}, {1, 1}, {1, 0}, {0, 1}};
+    int segA = 0, segB = 0;
+    XCTAssertFalse(validate_polygon(1, cntr, vertices, &segA, &segB));
+    XCTAssertNotEqual(segA, segB);
+
+    // Without validation the triangulator must still return, and never write more than n - 2 triangles
+    int triangles[3][3];
+    memset(triangles, 0xff, sizeof(triangles));
+    SeidelTriangulator* seidel = NULL;
+    int ntriangles = triangulate_polygon(&seidel, 1, cntr, vertices, triangles);
+    XCTAssertLessThanOrEqual(ntriangles, 2);
+    XCTAssertEqual(triangles[2][0], -1);
+    SeidelTriangulatorRelease(seidel);
+}
+
+- (void)testRandomOrderingIsAPermutation {
+    // The in-place shuffle must leave every segment in permute[1..n]
+    // exactly once, down to the polygons too small to shuffle
+    int sizes[] = {1, 2, 3, 100, 1000};
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(1000);
+    char *seen = malloc(1001);
+    for (int k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+    {
+        int n = sizes[k];
+        XCTAssertEqual(generate_random_ordering(seidel, n), 0);
+        memset(seen, 0, n + 1);
+        for (int i = 1; i <= n; i++)
+        {
+            int s = seidel->permute[i];
+            XCTAssertTrue(s >= 1 && s <= n && !seen[s], @"n %d, permute[%d] = %d", n, i, s);
+            if (s >= 1 && s <= n)
+                seen[s] = 1;
+        }
+    }
+    free(seen);
+    SeidelTriangulatorRelease(seidel);
+}
+
+- (void)testStepBudget {
+    double vertices[1 + 64 + 9 * 16][2];
+    int cntr[10];
+    unsigned char data[1024];
+    int triangles[64 + 9 * 16 + 2 * 9][3];
+
+    for (int k = 0; k < sizeof(data); k++)
+        data[k] = (unsigned char)(k * 37);
+    int ncontours = make_star_with_holes(data, sizeof(data), cntr, vertices);
+    int n = 0;
+    for (int c = 0; c < ncontours; c++)
+        n += cntr[c];
+
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(n);
+    SeidelTriangulatorSetStepBudget(seidel, 10);
+    XCTAssertEqual(triangulate_polygon(&seidel, ncontours, cntr, vertices, triangles), SEIDEL_ERR_BUDGET);
+    SeidelTriangulatorSetStepBudget(seidel, 0);
+    XCTAssertEqual(triangulate_polygon(&seidel, ncontours, cntr, vertices, triangles), n - 2 + 2 * (ncontours - 1));
+    SeidelTriangulatorRelease(seidel);
+}
+
+- (void)testEverySchedule {
+    double vertices[1 + 64 + 9 * 16][2];
+    int cntr[10];
+    unsigned char data[1024];
+    int triangles[64 + 9 * 16 + 2 * 9][3];
+    int schedules[] = {SEIDEL_SCHEDULE_PHASED, SEIDEL_SCHEDULE_NO_PHASES,
+                       SEIDEL_SCHEDULE_PHASED | SEIDEL_ORDER_HILBERT, SEIDEL_SCHEDULE_NO_PHASES | SEIDEL_ORDER_HILBERT,
+                       SEIDEL_SCHEDULE_PHASED | SEIDEL_ORDER_BRIO, SEIDEL_SCHEDULE_NO_PHASES | SEIDEL_ORDER_BRIO,
+                       SEIDEL_SCHEDULE_PHASED | SEIDEL_LAYOUT_COMPACT, SEIDEL_SCHEDULE_PHASED | SEIDEL_ORDER_BRIO | SEIDEL_LAYOUT_COMPACT};
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(64 + 9 * 16);
+    char why[256];
+
+    srand(17);
+    for (int i = 0; i < 200; i++)
+    {
+        for (int k = 0; k < sizeof(data); k++)
+            data[k] = (unsigned char)rand();
+        int ncontours = make_star_with_holes(data, sizeof(data), cntr, vertices);
+        int n = 0;
+        for (int c = 0; c < ncontours; c++)
+            n += cntr[c];
+
+        for (int k = 0; k < sizeof(schedules) / sizeof(schedules[0]); k++)
+        {
+            SeidelTriangulatorSetSchedule(seidel, schedules[k]);
+            int ntriangles = triangulate_polygon(&seidel, ncontours, cntr, vertices, triangles);
+            XCTAssertEqual(ntriangles, n - 2 + 2 * (ncontours - 1));
+            if (ntriangles >= 0)
+                XCTAssertEqual(check_triangulation(ncontours, cntr, vertices, triangles, ntriangles, why, sizeof(why)), 0, @"%s", why);
+        }
+    }
+    SeidelTriangulatorRelease(seidel);
+}
+
+- (void)testCacheReturnsStoredTriangles {
+    double vertices[1 + 64 + 9 * 16][2];
+    int cntr[10];
+    unsigned char data[1024];
+    int first[64 + 9 * 16 + 2 * 9][3], again[64 + 9 * 16 + 2 * 9][3];
+
+    for (int k = 0; k < sizeof(data); k++)
+        data[k] = (unsigned char)(k * 101 + 3);
+    int ncontours = make_star_with_holes(data, sizeof(data), cntr, vertices);
+
+    SeidelCache* cache = SeidelCacheCreate(1 << 20, 4);
+    SeidelTriangulator* seidel = NULL;
+    int hit = -1;
+    int ntriangles = seidel_cache_triangulate(cache, &seidel, ncontours, cntr, vertices, first, &hit);
+    XCTAssertGreaterThan(ntriangles, 0);
+    XCTAssertFalse(hit);
+    XCTAssertEqual(seidel_cache_triangulate(cache, &seidel, ncontours, cntr, vertices, again, &hit), ntriangles);
+    XCTAssertTrue(hit);
+    XCTAssertEqual(memcmp(first, again, sizeof(int) * 3 * ntriangles), 0);
+
+    // A hit does not load the triangulator: it still holds what it had
+    SeidelTriangulator* fresh = NULL;
+    XCTAssertEqual(seidel_cache_triangulate(cache, &fresh, ncontours, cntr, vertices, again, &hit), ntriangles);
+    XCTAssertTrue(hit);
+    XCTAssertTrue(fresh == NULL);
+
+    // Any change to the coordinates is a different key
+    vertices[1][0] += 1e-9;
+    XCTAssertEqual(seidel_cache_triangulate(cache, &seidel, ncontours, cntr, vertices, again, &hit), ntriangles);
+    XCTAssertFalse(hit);
+
+    long hits, misses;
+    int entries;
+    seidel_cache_stats(cache, &hits, &misses, &entries, NULL);
+    XCTAssertEqual(hits, 2);
+    XCTAssertEqual(misses, 2);
+    XCTAssertEqual(entries, 2);
+
+    SeidelTriangulatorRelease(seidel);
+    SeidelCacheRelease(cache);
+}
+
+- (void)testLevelsOfDetailStaySimple {
+    double vertices[1 + 64 + 9 * 16][2], simplified[1 + 64 + 9 * 16][2];
+    int cntr[10], outcntr[10], keep[64 + 9 * 16];
+    unsigned char data[1024];
+
+    srand(11);
+    for (int i = 0; i < 200; i++)
+    {
+        for (int k = 0; k < sizeof(data); k++)
+            data[k] = (unsigned char)rand();
+        int ncontours = make_star_with_holes(data, sizeof(data), cntr, vertices);
+
+        for (double tolerance = 0.002; tolerance < 0.5; tolerance *= 3)
+        {
+            int nkept = simplify_polygon(ncontours, cntr, vertices, tolerance, outcntr, keep);
+            XCTAssertGreaterThan(nkept, 0);
+            int m = 0;
+            for (int c = 0; c < nkept; c++)
+                m += outcntr[c];
+            for (int k = 0; k < m; k++)
+            {
+                simplified[1 + k][0] = vertices[keep[k]][0];
+                simplified[1 + k][1] = vertices[keep[k]][1];
+            }
+            XCTAssertTrue(validate_polygon(nkept, outcntr, simplified, NULL, NULL));
+            [self assertTriangulates:nkept sizes:outcntr vertices:simplified];
+        }
+
+        SeidelLOD* lod = SeidelLODCreate(ncontours, cntr, vertices, 4, 0.01, 2.0);
+        XCTAssertTrue(lod != NULL);
+        XCTAssertEqual(lod->nlevels, 4);
+        for (int k = 1; k < lod->nlevels; k++)
+            XCTAssertLessThanOrEqual(lod->level[k].ntriangles, lod->level[k - 1].ntriangles);
+        XCTAssertEqual(seidel_lod_select(lod, 0.05), 2);
+        SeidelLODRelease(lod);
+    }
+}
+
+- (double)tileArea:(seideltile_t*)tile {
+    double area = 0;
+    for (int k = 0; k < tile->ntriangles; k++)
+    {
+        double *a = tile->vertices[tile->triangles[k][0]];
+        double *b = tile->vertices[tile->triangles[k][1]];
+        double *c = tile->vertices[tile->triangles[k][2]];
+        double twice = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+        XCTAssertGreaterThanOrEqual(twice, 0);
+        for (int q = 0; q < 3; q++)
+        {
+            double *p = tile->vertices[tile->triangles[k][q]];
+            XCTAssertTrue(p[0] >= tile->x0 && p[0] <= tile->x1 && p[1] >= tile->y0 && p[1] <= tile->y1);
+        }
+        area += 0.5 * twice;
+    }
+    return area;
+}
+
+- (void)testTilesCoverThePolygon {
+    double vertices[1 + 64 + 9 * 16][2];
+    int cntr[10];
+    unsigned char data[1024];
+
+    srand(13);
+    for (int i = 0; i < 300; i++)
+    {
+        for (int k = 0; k < sizeof(data); k++)
+            data[k] = (unsigned char)rand();
+        int ncontours = make_star_with_holes(data, sizeof(data), cntr, vertices);
+
+        // Every other polygon is snapped to the grid lines, so that vertices and edges lie on seams
+        if (i & 1)
+        {
+            int n = 0;
+            for (int c = 0; c < ncontours; c++)
+                n += cntr[c];
+            for (int k = 1; k <= n; k++)
+            {
+                vertices[k][0] = round(vertices[k][0] * 40) / 40;
+                vertices[k][1] = round(vertices[k][1] * 40) / 40;
+            }
+            if (!validate_polygon(ncontours, cntr, vertices, NULL, NULL))
+                continue;
+        }
+
+        SeidelTiling* tiling = SeidelTilingCreate(ncontours, cntr, vertices, -1.2, -1.2, 0.1 * (1 + i % 4), 0.1 * (1 + i % 3), 24, 24, 1 + i % 3);
+        XCTAssertTrue(tiling != NULL);
+        double area = 0;
+        for (int t = 0; t < tiling->cols * tiling->rows; t++)
+        {
+            XCTAssertGreaterThanOrEqual(tiling->tile[t].ntriangles, 0);
+            area += [self tileArea:&tiling->tile[t]];
+        }
+        XCTAssertEqualWithAccuracy(area, polygon_area(ncontours, cntr, vertices), 1e-7);
+        SeidelTilingRelease(tiling);
+    }
+}
+
+// A circle of four cubic arcs, anti-clockwise or clockwise
+- (void)addCircle:(SeidelTriangulator*)seidel x:(double)cx y:(double)cy r:(double)r ccw:(BOOL)ccw {
+    double k = (ccw ? 0.5522847498 : -0.5522847498) * r, d = ccw ? 1 : -1;
+    seidel_path_move_to(seidel, cx + r, cy);
+    for (int q = 0; q < 4; q++)
+    {
+        double a0 = d * q * M_PI / 2, a1 = d * (q + 1) * M_PI / 2;
+        double x0 = cx + r * cos(a0), y0 = cy + r * sin(a0), x1 = cx + r * cos(a1), y1 = cy + r * sin(a1);
+        seidel_path_cubic_to(seidel, x0 - k * sin(a0), y0 + k * cos(a0), x1 + k * sin(a1), y1 - k * cos(a1), x1, y1);
+    }
+    seidel_path_close(seidel);
+}
+
+- (void)testPathFlattensToTolerance {
+    SeidelTriangulator* seidel = NULL;
+    int previous = 0;
+
+    // An "O" next to a dot, drawn clockwise as TrueType does, at growing sizes
+    for (double size = 8; size <= 512; size *= 2)
+    {
+        XCTAssertEqual(seidel_path_begin(&seidel, 0.25), 0);
+        [self addCircle:seidel x:0 y:0 r:size ccw:NO];
+        [self addCircle:seidel x:0 y:0 r:0.6 * size ccw:YES];
+        [self addCircle:seidel x:2 * size y:0 r:0.3 * size ccw:NO];
+
+        int n = seidel_path_vertices(seidel, NULL);
+        XCTAssertGreaterThan(n, previous);
+        previous = n;
+        double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+        int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 6));
+        int ntriangles = triangulate_path(seidel, triangles);
+        XCTAssertEqual(ntriangles, n - 2 * 2 + 2 * 1);
+        seidel_path_vertices(seidel, vertices);
+
+        // Every point is on one of the circles, give or take the error of the arcs themselves,
+        // and the area lost to the chords is within the tolerance times the perimeter
+        for (int k = 1; k <= n; k++)
+        {
+            double r = hypot(vertices[k][0], vertices[k][1]), rdot = hypot(vertices[k][0] - 2 * size, vertices[k][1]);
+            XCTAssertTrue(fabs(r - size) < 3e-4 * size || fabs(r - 0.6 * size) < 3e-4 * size || fabs(rdot - 0.3 * size) < 3e-4 * size);
+        }
+        double area = 0;
+        for (int k = 0; k < ntriangles; k++)
+        {
+            double *a = vertices[triangles[k][0]], *b = vertices[triangles[k][1]], *c = vertices[triangles[k][2]];
+            double twice = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+            XCTAssertGreaterThan(twice, 0);
+            area += 0.5 * twice;
+        }
+        double exact = M_PI * size * size * (1 - 0.36 + 0.09), perimeter = 2 * M_PI * size * (1 + 0.6 + 0.3);
+        XCTAssertEqualWithAccuracy(area, exact, 0.25 * perimeter + 3e-4 * exact);
+
+        free(vertices);
+        free(triangles);
+    }
+
+    // Drawing before moving is an error that sticks until the next path
+    XCTAssertEqual(seidel_path_begin(&seidel, 0.25), 0);
+    XCTAssertEqual(seidel_path_line_to(seidel, 1, 1), SEIDEL_ERR_INPUT);
+    XCTAssertEqual(triangulate_path(seidel, NULL), SEIDEL_ERR_INPUT);
+    SeidelTriangulatorRelease(seidel);
+}
+
+// Buffers sized from seidel_required_sizes() hold the triangulation exactly, and two polygons
+// batched into one index buffer keep to their own vertices
+- (void)testRequiredSizes {
+    int cntr[] = {4, 3, 3, 3};
+    double vertices[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {0.5, 1.0}, {1.0, 2.0}, {2.0, 1.5},
+        {0.5, 4.0}, {1.0, 5.0}, {2.0, 4.5},
+        {3.0, 3.0}, {5.0, 3.5}, {5.0, 2.5},
+    };
+    SeidelSizes sizes;
+    XCTAssertEqual(seidel_required_sizes(4, cntr, &sizes), 17);
+    XCTAssertEqual(sizes.npoints, 13);
+    XCTAssertEqual(sizes.ntriangles, 17);
+    XCTAssertEqual(sizes.triangle_bytes, sizeof(int) * 3 * 17);
+    XCTAssertEqual(sizes.index16_bytes, 2 * 3 * 17);
+    XCTAssertEqual(sizes.index32_bytes, 4 * 3 * 17);
+    XCTAssertGreaterThan(sizes.init_table_bytes, sizeof(SeidelTriangulator));
+    XCTAssertEqual(seidel_triangle_count(1, cntr), 2);
+
+    int (*triangles)[3] = malloc(sizes.triangle_bytes);
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(sizes.npoints);
+    XCTAssertEqual(seidel->segSize, sizes.initSegSize);
+    XCTAssertEqual(seidel->trSize, sizes.initTrSize);
+    XCTAssertEqual(seidel->qSize, sizes.initQSize);
+    XCTAssertEqual(triangulate_polygon(&seidel, 4, cntr, vertices, triangles), sizes.ntriangles);
+
+    uint16_t *indices = malloc(2 * sizes.index16_bytes);
+    XCTAssertEqual(seidel_write_indices(17, triangles, 0, SEIDEL_INDEX_UINT16, indices), 17);
+    XCTAssertEqual(seidel_write_indices(17, triangles, 13, SEIDEL_INDEX_UINT16, indices + 3 * 17), 17);
+    for (int k = 0; k < 3 * 17; k++)
+    {
+        XCTAssertEqual(indices[k], ((int *)triangles)[k] - 1);
+        XCTAssertEqual(indices[3 * 17 + k], indices[k] + 13);
+    }
+    XCTAssertEqual(seidel_write_indices(17, triangles, 65530, SEIDEL_INDEX_UINT16, indices), SEIDEL_ERR_CAPACITY);
+    XCTAssertEqual(indices[0], ((int *)triangles)[0] - 1);
+
+    int bad[] = {4, 2};
+    XCTAssertEqual(seidel_required_sizes(2, bad, &sizes), SEIDEL_ERR_INPUT);
+
+    SeidelTriangulatorRelease(seidel);
+    free(indices);
+    free(triangles);
+}
+
+// The sample square with holes written as a GIS export might: every point twice, the second
+// time a hair off, the outer contour closed on its first point, and a hole that is only a speck
+- (void)testWeldRepeatedPoints {
+    double clean[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {0.5, 1.0}, {1.0, 2.0}, {2.0, 1.5},
+        {0.5, 4.0}, {1.0, 5.0}, {2.0, 4.5},
+        {3.0, 3.0}, {5.0, 3.5}, {5.0, 2.5},
+    };
+    int cleanCntr[] = {4, 3, 3, 3};
+    int cntr[] = {9, 6, 6, 6, 3};
+    double vertices[1 + 30][2];
+    int remap[1 + 30];
+    int n = 0, first = 0;
+
+    for (int c = 0, k = 1; c < 4; k += cleanCntr[c++])
+        for (int j = 0; j < cleanCntr[c]; j++)
+        {
+            n++;
+            vertices[n][0] = clean[k + j][0];
+            vertices[n][1] = clean[k + j][1];
+            n++;
+            vertices[n][0] = clean[k + j][0] + 1e-9;
+            vertices[n][1] = clean[k + j][1] - 1e-9;
+            if (c == 0 && j == 3)
+            {
+                n++;
+                vertices[n][0] = clean[1][0];
+                vertices[n][1] = clean[1][1];
+            }
+        }
+    for (int j = 0; j < 3; j++)
+    {
+        n++;
+        vertices[n][0] = 4.0 + 1e-8 * j;
+        vertices[n][1] = 5.0 - 1e-8 * j;
+        if (j == 0)
+            first = n;
+    }
+    XCTAssertEqual(n, 30);
+
+    int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 2 * 5));
+    SeidelTriangulator* seidel = NULL;
+    int ntriangles = triangulate_polygon_welded(&seidel, 5, cntr, vertices, 1e-6, triangles, remap);
+    XCTAssertEqual(ntriangles, 13 - 2 + 2 * 3);
+
+    // Every second copy stands for itself no more, and the speck went as a whole
+    for (int i = 1; i <= 24; i++)
+    {
+        XCTAssertTrue(remap[i] <= i);
+        XCTAssertEqualWithAccuracy(vertices[remap[i]][0], vertices[i][0], 1e-6);
+    }
+    XCTAssertEqual(remap[2], 1);
+    XCTAssertEqual(remap[9], 1);
+    XCTAssertEqual(remap[first + 2], first);
+
+    double area = 0;
+    for (int k = 0; k < ntriangles; k++)
+    {
+        double *a = vertices[triangles[k][0]], *b = vertices[triangles[k][1]], *c = vertices[triangles[k][2]];
+        XCTAssertTrue(remap[triangles[k][0]] == triangles[k][0] && remap[triangles[k][1]] == triangles[k][1]);
+        double twice = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+        XCTAssertGreaterThan(twice, 0);
+        area += 0.5 * twice;
+    }
+    XCTAssertEqualWithAccuracy(area, 36 - 3 * 0.75, 1e-6);
+
+    // A negative tolerance, and an outer contour that welds away
+    XCTAssertEqual(triangulate_polygon_welded(&seidel, 5, cntr, vertices, -1, triangles, NULL), SEIDEL_ERR_INPUT);
+    XCTAssertEqual(triangulate_polygon_welded(&seidel, 1, cntr + 4, vertices + first - 1, 1e-6, triangles, NULL), SEIDEL_ERR_INPUT);
+
+    SeidelTriangulatorRelease(seidel);
+    free(triangles);
+}
+
+- (void)testWeldPointsThatAreNotNeighbours {
+    // Two lobes that welding joins at (1, 1)
+    int cntr[] = {6};
+    double lobes[][2] = {
+        {0, 0},
+        {0, 0}, {2, 0}, {1, 1}, {2, 2.0001}, {0, 2}, {1, 1.00001},
+    };
+    int triangles[8][3], remap[1 + 8];
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(8);
+    XCTAssertEqual(triangulate_polygon(&seidel, 1, cntr, lobes, triangles), 4);
+    XCTAssertEqual(triangulate_polygon_welded(&seidel, 1, cntr, lobes, 1e-3, triangles, remap), 2);
+    XCTAssertEqual(remap[6], 3);
+    XCTAssertEqualWithAccuracy(welded_area(lobes, triangles, 2), 4.0001, 1e-4);
+
+    // The same exactly, with nothing to weld but the repeat
+    lobes[4][1] = 2;
+    lobes[6][1] = 1;
+    XCTAssertEqual(triangulate_polygon_welded(&seidel, 1, cntr, lobes, 0, triangles, NULL), 2);
+    XCTAssertEqualWithAccuracy(welded_area(lobes, triangles, 2), 4, 1e-9);
+
+    // A hole with a corner on the outer contour: its copy is pulled
+    // into the hole, and the two slivers between the copies dropped
+    int cntr2[] = {5, 3};
+    double touching[][2] = {
+        {0, 0},
+        {0, 0}, {4, 0}, {4, 4}, {2, 4}, {0, 4},
+        {2, 4}, {3, 2}, {1, 2},
+    };
+    XCTAssertEqual(triangulate_polygon_welded(&seidel, 2, cntr2, touching, 0, triangles, remap), 6);
+    XCTAssertEqual(remap[6], 4);
+    XCTAssertEqualWithAccuracy(welded_area(touching, triangles, 6), 2 * (16 - 2), 1e-9);
+
+    // The same hole as a loop of the outer contour has two triangles
+    // more than an 8 point contour makes room for
+    int cntr1[] = {8};
+    double keyhole[][2] = {
+        {0, 0},
+        {0, 0}, {4, 0}, {4, 4}, {2, 4}, {3, 2}, {1, 2}, {2, 4}, {0, 4},
+    };
+    XCTAssertEqual(triangulate_polygon_welded(&seidel, 1, cntr1, keyhole, 0, triangles, NULL), SEIDEL_ERR_CAPACITY);
+
+    SeidelTriangulatorRelease(seidel);
+}
+
+// The trapezoids of the sample square with holes tile it, bottom up, and rasterizing them
+// antialiased gives its area back
+- (void)testRasterizeTrapezoids {
+    int cntr[] = {4, 3, 3, 3};
+    double vertices[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {0.5, 1.0}, {1.0, 2.0}, {2.0, 1.5},
+        {0.5, 4.0}, {1.0, 5.0}, {2.0, 4.5},
+        {3.0, 3.0}, {5.0, 3.5}, {5.0, 2.5},
+    };
+    const double area = 36 - 3 * 0.75;
+    SeidelTriangulator* seidel = NULL;
+    XCTAssertEqual(trapezoidate_polygon(&seidel, 4, cntr, vertices), 0);
+
+    int ntraps = seidel_trapezoids(seidel, NULL);
+    XCTAssertGreaterThan(ntraps, 0);
+    seideltrap_t *traps = malloc(sizeof(seideltrap_t) * ntraps);
+    XCTAssertEqual(seidel_trapezoids(seidel, traps), ntraps);
+    double sum = 0;
+    for (int k = 0; k < ntraps; k++)
+    {
+        XCTAssertLessThan(traps[k].y0, traps[k].y1);
+        XCTAssertLessThanOrEqual(traps[k].xl0, traps[k].xr0);
+        XCTAssertLessThanOrEqual(traps[k].xl1, traps[k].xr1);
+        if (k > 0)
+            XCTAssertLessThanOrEqual(traps[k - 1].y0, traps[k].y0);
+        sum += 0.5 * (traps[k].xr0 - traps[k].xl0 + traps[k].xr1 - traps[k].xl1) * (traps[k].y1 - traps[k].y0);
+    }
+    XCTAssertEqualWithAccuracy(sum, area, 1e-9);
+
+    // 10 pixels a unit, with a pixel's margin all round
+    const int size = 62;
+    float *coverage = malloc(sizeof(float) * size * size);
+    XCTAssertEqual(seidel_rasterize(seidel, coverage, size, size, -0.1, -0.1, 10, 16), 0);
+    double covered = 0;
+    for (int i = 0; i < size * size; i++)
+    {
+        XCTAssertTrue(coverage[i] >= 0 && coverage[i] <= 1);
+        covered += coverage[i];
+    }
+    XCTAssertEqualWithAccuracy(covered / 100, area, 1e-3);
+    XCTAssertEqual(coverage[0], 0);
+    // (2.5, 2.5) is inside and (4.0, 3.0) in the third hole
+    XCTAssertEqual(coverage[26 * size + 26], 1);
+    XCTAssertEqual(coverage[31 * size + 41], 0);
+
+    // Hard edges: every pixel is in or out, and about as many are in
+    XCTAssertEqual(seidel_rasterize(seidel, coverage, size, size, -0.1, -0.1, 10, 0), 0);
+    int in = 0;
+    for (int i = 0; i < size * size; i++)
+    {
+        XCTAssertTrue(coverage[i] == 0 || coverage[i] == 1);
+        in += (coverage[i] == 1);
+    }
+    XCTAssertEqualWithAccuracy(in, 100 * area, 60);
+
+    SeidelTriangulatorRelease(seidel);
+    free(traps);
+    free(coverage);
+}
+
+- (void)testRasterizeFarOffRaster {
+    // A spire 4e9 high over a 16 x 16 raster: only the bottom ten
+    // columns are covered, and the rest of it is skipped
+    int cntr[] = {5};
+    double spire[][2] = {
+        {0, 0},
+        {0, 0}, {10, 0}, {10, 3e9}, {5, 4e9}, {0, 3e9},
+    };
+    const int size = 16;
+    float coverage[size * size];
+    SeidelTriangulator* seidel = NULL;
+    XCTAssertEqual(trapezoidate_polygon(&seidel, 1, cntr, spire), 0);
+    for (int samples = 0; samples <= 4; samples += 4)
+    {
+        XCTAssertEqual(seidel_rasterize(seidel, coverage, size, size, 0, 0, 1, samples), 0);
+        for (int i = 0; i < size * size; i++)
+            XCTAssertEqual(coverage[i], i % size < 10 ? 1 : 0);
+    }
+
+    // a square 1e10 to the right covers nothing
+    int cntr4[] = {4};
+    double right[][2] = {
+        {0, 0},
+        {1e10, 0}, {1e10 + 10, 0}, {1e10 + 10, 10}, {1e10, 10},
+    };
+    XCTAssertEqual(trapezoidate_polygon(&seidel, 1, cntr4, right), 0);
+    for (int samples = 0; samples <= 4; samples += 4)
+    {
+        XCTAssertEqual(seidel_rasterize(seidel, coverage, size, size, 0, 0, 1, samples), 0);
+        for (int i = 0; i < size * size; i++)
+            XCTAssertEqual(coverage[i], 0);
+    }
+
+    // and a band 2e10 wide covers rows 2 and 3 from end to end
+    double band[][2] = {
+        {0, 0},
+        {-1e10, 2}, {1e10, 2}, {1e10, 4}, {-1e10, 4},
+    };
+    XCTAssertEqual(trapezoidate_polygon(&seidel, 1, cntr4, band), 0);
+    for (int samples = 0; samples <= 4; samples += 4)
+    {
+        XCTAssertEqual(seidel_rasterize(seidel, coverage, size, size, 0, 0, 1, samples), 0);
+        for (int i = 0; i < size * size; i++)
+            XCTAssertEqual(coverage[i], i / size == 2 || i / size == 3 ? 1 : 0);
+    }
+
+    SeidelTriangulatorRelease(seidel);
+}
+
+// Moments from the trapezoids against the same integrals around the contours (Green's theorem),
+// with the sample square with holes moved far from the origin
+- (void)testPolygonMoments {
+    int cntr[] = {4, 3, 3, 3};
+    double vertices[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {0.5, 1.0}, {1.0, 2.0}, {2.0, 1.5},
+        {0.5, 4.0}, {1.0, 5.0}, {2.0, 4.5},
+        {3.0, 3.0}, {5.0, 3.5}, {5.0, 2.5},
+    };
+    double a = 0, mx = 0, my = 0, mxx = 0, myy = 0, mxy = 0;
+    for (int c = 0, first = 1; c < 4; first += cntr[c++])
+        for (int i = first; i < first + cntr[c]; i++)
+        {
+            int j = (i + 1 < first + cntr[c]) ? i + 1 : first;
+            double x0 = vertices[i][0], y0 = vertices[i][1], x1 = vertices[j][0], y1 = vertices[j][1];
+            double cross = x0 * y1 - x1 * y0;
+            a += cross / 2;
+            mx += (x0 + x1) * cross / 6;
+            my += (y0 + y1) * cross / 6;
+            mxx += (x0 * x0 + x0 * x1 + x1 * x1) * cross / 12;
+            myy += (y0 * y0 + y0 * y1 + y1 * y1) * cross / 12;
+            mxy += (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * cross / 24;
+        }
+    XCTAssertEqualWithAccuracy(a, 36 - 3 * 0.75, 1e-12);
+    double cx = mx / a, cy = my / a;
+
+    for (int i = 1; i <= 13; i++)
+    {
+        vertices[i][0] += 1e6;
+        vertices[i][1] -= 3e6;
+    }
+    SeidelTriangulator* seidel = NULL;
+    SeidelMoments m;
+    XCTAssertEqual(trapezoidate_polygon(&seidel, 4, cntr, vertices), 0);
+    XCTAssertEqual(seidel_polygon_moments(seidel, &m), 0);
+    XCTAssertEqualWithAccuracy(m.area, a, 1e-9);
+    XCTAssertEqualWithAccuracy(m.cx, cx + 1e6, 1e-9);
+    XCTAssertEqualWithAccuracy(m.cy, cy - 3e6, 1e-9);
+    XCTAssertEqualWithAccuracy(m.sxx, mxx - a * cx * cx, 1e-8);
+    XCTAssertEqualWithAccuracy(m.syy, myy - a * cy * cy, 1e-8);
+    XCTAssertEqualWithAccuracy(m.sxy, mxy - a * cx * cy, 1e-8);
+
+    // The same after a full triangulation, which keeps the trapezoids
+    int triangles[13 + 2 * 4][3];
+    XCTAssertEqual(triangulate_polygon(&seidel, 4, cntr, vertices, triangles), 17);
+    SeidelMoments again;
+    XCTAssertEqual(seidel_polygon_moments(seidel, &again), 0);
+    XCTAssertEqualWithAccuracy(again.area, m.area, 1e-9);
+    XCTAssertEqualWithAccuracy(again.sxy, m.sxy, 1e-8);
+    SeidelTriangulatorRelease(seidel);
+}
+
+// A large star, then a small one on the same triangulator: the trapezoids
+// left over from the first must not count towards the second's moments.
+// In Hilbert order the entry just past the small star's is an inside one
+- (void)testMomentsAfterLargerPolygon {
+    const int sizes[2] = {500, 15};
+    double (*vertices)[2] = malloc(sizeof(double) * 2 * (sizes[0] + 1));
+    int (*triangles)[3] = malloc(sizeof(int) * 3 * sizes[0]);
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(sizes[0] + 1);
+    SeidelTriangulatorSetSchedule(seidel, SEIDEL_ORDER_HILBERT);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int n = sizes[pass];
+        for (int i = 0; i < n; i++)
+        {
+            double t = 2 * M_PI * i / n, r = 1.0 + 0.5 * ((i * 7919) % 13) / 13.0;
+            vertices[1 + i][0] = 5 + r * cos(t);
+            vertices[1 + i][1] = -2 + r * sin(t);
+        }
+        double a = 0, mx = 0, my = 0, mxx = 0, myy = 0, mxy = 0;
+        for (int i = 1; i <= n; i++)
+        {
+            int j = (i < n) ? i + 1 : 1;
+            double x0 = vertices[i][0], y0 = vertices[i][1], x1 = vertices[j][0], y1 = vertices[j][1];
+            double cross = x0 * y1 - x1 * y0;
+            a += cross / 2;
+            mx += (x0 + x1) * cross / 6;
+            my += (y0 + y1) * cross / 6;
+            mxx += (x0 * x0 + x0 * x1 + x1 * x1) * cross / 12;
+            myy += (y0 * y0 + y0 * y1 + y1 * y1) * cross / 12;
+            mxy += (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * cross / 24;
+        }
+        double cx = mx / a, cy = my / a;
+
+        XCTAssertEqual(triangulate_polygon(&seidel, 1, &n, vertices, triangles), n - 2);
+        SeidelMoments m;
+        XCTAssertEqual(seidel_polygon_moments(seidel, &m), 0);
+        XCTAssertEqualWithAccuracy(m.area, a, 1e-9);
+        XCTAssertEqualWithAccuracy(m.cx, cx, 1e-9);
+        XCTAssertEqualWithAccuracy(m.cy, cy, 1e-9);
+        XCTAssertEqualWithAccuracy(m.sxx, mxx - a * cx * cx, 1e-8);
+        XCTAssertEqualWithAccuracy(m.syy, myy - a * cy * cy, 1e-8);
+        XCTAssertEqualWithAccuracy(m.sxy, mxy - a * cx * cy, 1e-8);
+    }
+    SeidelTriangulatorRelease(seidel);
+    free(triangles);
+    free(vertices);
+}
+
+- (void)testSegmentAndNearestEdgeQueries {
+    int cntr[] = {4, 4};
+    double vertices[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {2.0, 2.0}, {2.0, 4.0}, {4.0, 4.0}, {4.0, 2.0},
+    };
+    SeidelTriangulator* seidel = NULL;
+    XCTAssertEqual(trapezoidate_polygon(&seidel, 2, cntr, vertices), 0);
+
+    // Across the hole, left to right, and up through its horizontal
+    // edges and out of the top, met from the lower end on
+    int segs[8];
+    double a[2] = {1, 3}, b[2] = {5, 3}, c[2] = {3, 7}, d[2] = {3, 1}, e[2] = {1, 1}, f[2] = {1, 5};
+    XCTAssertEqual(seidel_segment_crossings(seidel, b, a, segs, 8), 2);
+    XCTAssertEqual(segs[0], 5);
+    XCTAssertEqual(segs[1], 7);
+    XCTAssertEqual(seidel_segment_crossings(seidel, c, d, segs, 8), 3);
+    XCTAssertEqual(segs[0], 8);
+    XCTAssertEqual(segs[1], 6);
+    XCTAssertEqual(segs[2], 3);
+    XCTAssertEqual(seidel_segment_crossings(seidel, c, d, segs, 1), 1);
+    XCTAssertEqual(segs[0], 8);
+    XCTAssertEqual(seidel_segment_crossings(seidel, e, f, NULL, 8), 0);
+
+    double p[][2] = {{3, 1.5}, {5.5, 3}, {8, 3}, {3, 5.2}};
+    int edge[] = {8, 2, 2, 3};
+    double dist[] = {0.5, 0.5, 2, 0.8};
+    for (int i = 0; i < 4; i++)
+    {
+        double got = -1;
+        XCTAssertEqual(seidel_nearest_edge(seidel, p[i], &got), edge[i]);
+        XCTAssertEqualWithAccuracy(got, dist[i], 1e-12);
+    }
+    SeidelTriangulatorRelease(seidel);
 }
 
-- (void)tearDown {
-    // Put teardown code here. This method is called after the invocation of each test method in the class.
+- (void)testManyHolesThenSmallPolygon {
+    // A grid of square holes in a square, then a small polygon on the
+    // same triangulator, whose tables are cleared only as far as used.
+    // In Hilbert order the entry just past the small polygon's
+    // trapezoids is a stale one inside it
+    const int k = 16, nh = k * k, n = 4 + 4 * nh;
+    double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+    int (*triangles)[3] = malloc(sizeof(int) * 3 * (n + 2 * nh));
+    int *cntr = malloc(sizeof(int) * (nh + 1));
+    double outer[][2] = {{0, 0}, {k, 0}, {k, k}, {0, k}};
+    int m = 0;
+    cntr[0] = 4;
+    for (int i = 0; i < 4; i++, m++)
+    {
+        vertices[1 + m][0] = outer[i][0];
+        vertices[1 + m][1] = outer[i][1];
+    }
+    for (int i = 0; i < k; i++)
+        for (int j = 0; j < k; j++)
+        {
+            double box[][2] = {{0.25, 0.25}, {0.25, 0.75}, {0.75, 0.75}, {0.75, 0.25}};
+            cntr[1 + i * k + j] = 4;
+            for (int c = 0; c < 4; c++, m++)
+            {
+                vertices[1 + m][0] = i + box[c][0];
+                vertices[1 + m][1] = j + box[c][1];
+            }
+        }
+    SeidelTriangulator* seidel = SeidelTriangulatorCreate(n + 1);
+    SeidelTriangulatorSetSchedule(seidel, SEIDEL_ORDER_HILBERT);
+    XCTAssertEqual(triangulate_polygon(&seidel, nh + 1, cntr, vertices, triangles), n - 2 + 2 * nh);
+    double hole[2] = {7.5, 12.5}, between[2] = {7.1, 12.5};
+    XCTAssertFalse(is_point_inside_polygon(seidel, hole));
+    XCTAssertTrue(is_point_inside_polygon(seidel, between));
+
+    int small[] = {4, 4};
+    double square[][2] = {
+        {0, 0},
+        {0.0, 0.0}, {6.0, 0.0}, {6.0, 6.0}, {0.0, 6.0},
+        {2.0, 2.0}, {2.0, 4.0}, {4.0, 4.0}, {4.0, 2.0},
+    };
+    XCTAssertEqual(triangulate_polygon(&seidel, 2, small, square, triangles), 8);
+    double inside[2] = {1, 1}, inhole[2] = {3, 3};
+    XCTAssertTrue(is_point_inside_polygon(seidel, inside));
+    XCTAssertFalse(is_point_inside_polygon(seidel, inhole));
+    SeidelMoments moments;
+    XCTAssertEqual(seidel_polygon_moments(seidel, &moments), 0);
+    XCTAssertEqualWithAccuracy(moments.area, 32, 1e-9);
+
+    SeidelTriangulator* fresh = SeidelTriangulatorCreate(9);
+    SeidelTriangulatorSetSchedule(fresh, SEIDEL_ORDER_HILBERT);
+    XCTAssertEqual(triangulate_polygon(&fresh, 2, small, square, triangles), 8);
+    XCTAssertEqual(seidel_trapezoids(seidel, NULL), seidel_trapezoids(fresh, NULL));
+    float cover[32 * 32], expect[32 * 32];
+    XCTAssertEqual(seidel_rasterize(seidel, cover, 32, 32, -1, -1, 4, 0), 0);
+    XCTAssertEqual(seidel_rasterize(fresh, expect, 32, 32, -1, -1, 4, 0), 0);
+    XCTAssertEqual(memcmp(cover, expect, sizeof(cover)), 0);
+    SeidelTriangulatorRelease(fresh);
+
+    SeidelTriangulatorRelease(seidel);
+    free(cntr);
+    free(triangles);
+    free(vertices);
+}
+
+- (void)testPipelineKeepsOrder {
+    // Regular polygons of growing size through a pipeline three deep,
+    // produced and consumed on this thread, every fifth one invalid
+    SeidelPipeline* pipeline = SeidelPipelineCreate(3, 4);
+    XCTAssertTrue(pipeline != NULL);
+    const int npolys = 12;
+    int taken = 0;
+    for (int i = 0; i < npolys + 2; i++)
+    {
+        if (i < npolys)
+        {
+            int n = 4 + 3 * i;
+            seideljob_t* job = seidel_pipeline_acquire(pipeline, 1, n);
+            XCTAssertTrue(job != NULL);
+            for (int j = 1; j <= n; j++)
+            {
+                job->vertices[j][0] = cos(2 * M_PI * j / n);
+                job->vertices[j][1] = sin(2 * M_PI * j / n);
+            }
+            job->cntr[0] = (i % 5 == 4) ? 2 : n;
+            job->user = (void *) (intptr_t) i;
+            seidel_pipeline_submit(pipeline, job);
+        }
+        else if (i == npolys)
+            seidel_pipeline_finish(pipeline);
+        if (i < 2)
+            continue;
+
+        seideljob_t* job = seidel_pipeline_next(pipeline);
+        XCTAssertTrue(job != NULL);
+        XCTAssertEqual((int) (intptr_t) job->user, taken);
+        XCTAssertEqual(job->ntriangles, (taken % 5 == 4) ? SEIDEL_ERR_INPUT : 4 + 3 * taken - 2);
+        taken++;
+        seidel_pipeline_recycle(pipeline, job);
+    }
+    XCTAssertEqual(taken, npolys);
+    XCTAssertTrue(seidel_pipeline_next(pipeline) == NULL);
+    SeidelPipelineRelease(pipeline);
+}
+
+- (void)testIndexBufferRingReusesBuffers {
+    FakeIndexBufferAllocator* allocator = [[FakeIndexBufferAllocator alloc] init];
+    IndexBufferRing* ring = [[IndexBufferRing alloc] initWithAllocator:allocator count:3];
+    XCTAssertEqual([ring acquireFrameSlot], -1);
+
+    // Writes go round the three buffers, each allocated once
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        uint32_t* indices = (uint32_t*)[ring beginWriteWithLength:100];
+        XCTAssertTrue(indices != NULL);
+        indices[0] = i;
+        [ring endWrite];
+        NSInteger slot = [ring acquireFrameSlot];
+        XCTAssertEqual(slot, (NSInteger)(i % 3));
+        XCTAssertEqual(((uint32_t*)[ring bufferAtSlot:slot].contents)[0], i);
+        [ring releaseFrameSlot:slot];
+    }
+    XCTAssertEqual(ring.allocationCount, 3);
+
+    // A buffer too small at least doubles, and then has room for a while
+    for (int i = 0; i < 3; i++)
+    {
+        XCTAssertTrue([ring beginWriteWithLength:150] != NULL);
+        [ring endWrite];
+    }
+    XCTAssertEqual(ring.allocationCount, 6);
+    XCTAssertEqual([ring bufferAtSlot:1].length, 200);
+    XCTAssertTrue([ring beginWriteWithLength:180] != NULL);
+    [ring endWrite];
+    XCTAssertEqual(ring.allocationCount, 6);
+
+    // A write waits for the frames still drawing from its buffer
+    NSInteger held = [ring acquireFrameSlot];
+    for (int i = 0; i < 2; i++)
+    {
+        [ring beginWriteWithLength:100];
+        [ring endWrite];
+    }
+    __block BOOL released = NO;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        released = YES;
+        [ring releaseFrameSlot:held];
+    });
+    XCTAssertTrue([ring beginWriteWithLength:100] != NULL);
+    XCTAssertTrue(released);
+    [ring endWrite];
+    XCTAssertEqual([ring acquireFrameSlot], held);
 }
 
-- (void)testExample {
-    // This is an example of a functional test case.
-    // Use XCTAssert and related functions to verify your tests produce the correct results.
+- (void)testEdgeGridEditing {
+    // A 64-gon with a square hole, entered as the editor does, edge by edge into
+    // a grid that starts coarse and is refined on the way
+    SeidelEdgeGrid* grid = SeidelEdgeGridCreate(-1, -1, 1, 1, 4);
+    XCTAssertTrue(grid != NULL);
+    const int n = 64;
+    for (int i = 0; i < n; i++)
+    {
+        double t0 = 2 * M_PI * i / n, t1 = 2 * M_PI * (i + 1) / n;
+        XCTAssertEqual(edge_grid_add(grid, 0.9 * cos(t0), 0.9 * sin(t0), 0.9 * cos(t1), 0.9 * sin(t1)), i + 1);
+    }
+    double hole[4][2] = {{-0.2, -0.2}, {-0.2, 0.2}, {0.2, 0.2}, {0.2, -0.2}};
+    for (int i = 0; i < 4; i++)
+        edge_grid_add(grid, hole[i][0], hole[i][1], hole[(i + 1) % 4][0], hole[(i + 1) % 4][1]);
+    XCTAssertTrue(grid->side > 1);
+
+    // Odd crossings: inside the 64-gon and outside the hole, points off the grid included
+    XCTAssertEqual(edge_grid_crossings(grid, 0.5, 0.1, n + 4) & 1, 1);
+    XCTAssertEqual(edge_grid_crossings(grid, 0.05, 0.1, n + 4) & 1, 0);
+    XCTAssertEqual(edge_grid_crossings(grid, 0.05, 0.1, n) & 1, 1);
+    XCTAssertEqual(edge_grid_crossings(grid, 0.95, 0.95, n + 4) & 1, 0);
+    XCTAssertEqual(edge_grid_crossings(grid, -3.0, 0.1, n + 4) & 1, 0);
+
+    // Lines into the hole or out of the 64-gon meet an edge
+    XCTAssertEqual(edge_grid_intersects(grid, 0.5, 0.1, 0.1, 0.1, 0, 0), n + 3);
+    XCTAssertNotEqual(edge_grid_intersects(grid, 0.5, 0.1, 1.5, 0.1, 0, 0), 0);
+    XCTAssertEqual(edge_grid_intersects(grid, 0.5, 0.1, 0.5, 0.3, 0, 0), 0);
+
+    // A contour being drawn may go on from its last edge, but not double back over it
+    int last = edge_grid_add(grid, 0.4, 0.4, 0.6, 0.4);
+    XCTAssertEqual(edge_grid_intersects(grid, 0.6, 0.4, 0.6, 0.6, last, 0), 0);
+    XCTAssertEqual(edge_grid_intersects(grid, 0.6, 0.4, 0.5, 0.4, last, 0), last);
+
+    edge_grid_clear(grid);
+    XCTAssertEqual(edge_grid_intersects(grid, 0.5, 0.1, 0.1, 0.1, 0, 0), 0);
+    XCTAssertEqual(edge_grid_add(grid, 0, 0, 1, 1), 1);
+    SeidelEdgeGridRelease(grid);
 }
 
-- (void)testPerformanceExample {
-    // This is an example of a performance test case.
+- (void)testEdgeSetEditing {
+    // The same in a SeidelEdgeSet, which starts with room for 16 edges and grows
+    SeidelEdgeSet* es = SeidelEdgeSetCreate(4);
+    XCTAssertTrue(es != NULL);
+    const int n = 64;
+    for (int i = 0; i < n; i++)
+    {
+        double t0 = 2 * M_PI * i / n, t1 = 2 * M_PI * (i + 1) / n;
+        XCTAssertEqual(edge_set_add(es, 0.9 * cos(t0), 0.9 * sin(t0), 0.9 * cos(t1), 0.9 * sin(t1)), i + 1);
+    }
+    double hole[4][2] = {{-0.2, -0.2}, {-0.2, 0.2}, {0.2, 0.2}, {0.2, -0.2}};
+    for (int i = 0; i < 4; i++)
+        edge_set_add(es, hole[i][0], hole[i][1], hole[(i + 1) % 4][0], hole[(i + 1) % 4][1]);
+
+    XCTAssertEqual(edge_set_intersects(es, 0.5, 0.1, 0.1, 0.1, 0, 0), n + 3);
+    XCTAssertNotEqual(edge_set_intersects(es, 0.5, 0.1, 1.5, 0.1, 0, 0), 0);
+    XCTAssertEqual(edge_set_intersects(es, 0.5, 0.1, 0.5, 0.3, 0, 0), 0);
+
+    // Touching a corner of the hole is meeting it; naming one of its edges as
+    // adjacent there still leaves the other
+    XCTAssertNotEqual(edge_set_intersects(es, 0.5, 0.2, 0.2, 0.2, 0, 0), 0);
+    XCTAssertEqual(edge_set_intersects(es, 0.2, -0.2, 0.5, -0.5, n + 4, 0), n + 3);
+    XCTAssertEqual(edge_set_intersects(es, 0.5, -0.5, 0.2, -0.2, 0, n + 3), n + 4);
+
+    int last = edge_set_add(es, 0.4, 0.4, 0.6, 0.4);
+    XCTAssertEqual(last, n + 5);
+    XCTAssertEqual(edge_set_intersects(es, 0.6, 0.4, 0.6, 0.6, last, 0), 0);
+    XCTAssertEqual(edge_set_intersects(es, 0.6, 0.4, 0.5, 0.4, last, 0), last);
+
+    edge_set_clear(es);
+    XCTAssertEqual(edge_set_intersects(es, 0.5, 0.1, 0.1, 0.1, 0, 0), 0);
+    XCTAssertEqual(edge_set_add(es, 0, 0, 1, 1), 1);
+    SeidelEdgeSetRelease(es);
+}
+
+- (void)testMonotonePolygons {
+    // A U, which is not y-monotone: its two prongs make separate pieces
+    int cntr[1] = {8};
+    double vertices[9][2] = {{0, 0}, {0, 0}, {3, 0}, {3, 3}, {2, 3}, {2, 1}, {1, 1}, {1, 3}, {0, 3}};
+    SeidelTriangulator* state = NULL;
+    int npoly = monotonate_polygon(&state, 1, cntr, vertices);
+    XCTAssertGreaterThanOrEqual(npoly, 2);
+    XCTAssertLessThanOrEqual(npoly, 6);
+
+    int first[8], index[32];
+    XCTAssertEqual(seidel_monotone_polygons(state, first, NULL), npoly);
+    XCTAssertEqual(first[0], 0);
+    XCTAssertEqual(first[npoly], 6 + 2 * npoly);
+    XCTAssertEqual(seidel_monotone_polygons(state, first, index), npoly);
+
+    // Each piece anticlockwise from its topmost vertex, and together they cover the U
+    double area = 0;
+    for (int p = 0; p < npoly; p++)
+    {
+        int k = first[p + 1] - first[p];
+        const int* v = &index[first[p]];
+        XCTAssertGreaterThanOrEqual(k, 3);
+        double pieceArea = 0;
+        for (int j = 0; j < k; j++)
+        {
+            XCTAssertTrue(v[j] >= 1 && v[j] <= 8);
+            XCTAssertLessThanOrEqual(vertices[v[j]][1], vertices[v[0]][1]);
+            pieceArea += vertices[v[j]][0] * vertices[v[(j + 1) % k]][1] - vertices[v[(j + 1) % k]][0] * vertices[v[j]][1];
+        }
+        XCTAssertGreaterThan(pieceArea, 0);
+        area += pieceArea / 2;
+    }
+    XCTAssertEqualWithAccuracy(area, 7.0, 1e-12);
+
+    // Triangulating records the same pieces
+    int triangles[6][3];
+    XCTAssertEqual(triangulate_polygon(&state, 1, cntr, vertices, triangles), 6);
+    XCTAssertEqual(seidel_monotone_polygons(state, NULL, NULL), npoly);
+    SeidelTriangulatorRelease(state);
+}
+
+- (void)testConvexPartition {
+    // A convex hexagon comes back whole
+    int hexagonCntr[1] = {6};
+    double hexagon[7][2];
+    for (int i = 1; i <= 6; i++)
+    {
+        hexagon[i][0] = cos(M_PI / 3 * i);
+        hexagon[i][1] = sin(M_PI / 3 * i);
+    }
+    SeidelTriangulator* state = NULL;
+    int triangles[6][3], first[7], index[18];
+    int ntri = triangulate_polygon(&state, 1, hexagonCntr, hexagon, triangles);
+    XCTAssertEqual(ntri, 4);
+    XCTAssertEqual(convex_partition(hexagon, ntri, triangles, first, index), 1);
+    XCTAssertEqual(first[1], 6);
+
+    // A U needs three pieces at least, and Hertel-Mehlhorn no more than four times that
+    SeidelTriangulatorRelease(state);
+    state = NULL;
+    int cntr[1] = {8};
+    double vertices[9][2] = {{0, 0}, {0, 0}, {3, 0}, {3, 3}, {2, 3}, {2, 1}, {1, 1}, {1, 3}, {0, 3}};
+    ntri = triangulate_polygon(&state, 1, cntr, vertices, triangles);
+    XCTAssertEqual(ntri, 6);
+    int npoly = convex_partition(vertices, ntri, triangles, first, index);
+    XCTAssertGreaterThanOrEqual(npoly, 3);
+    XCTAssertLessThanOrEqual(npoly, ntri);
+
+    // Every piece convex and anticlockwise, together covering the U
+    double area = 0;
+    for (int p = 0; p < npoly; p++)
+    {
+        int k = first[p + 1] - first[p];
+        const int* v = &index[first[p]];
+        for (int j = 0; j < k; j++)
+        {
+            const double* a = vertices[v[j]];
+            const double* b = vertices[v[(j + 1) % k]];
+            const double* c = vertices[v[(j + 2) % k]];
+            XCTAssertGreaterThanOrEqual((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]), 0);
+            area += (a[0] * b[1] - b[0] * a[1]) / 2;
+        }
+    }
+    XCTAssertEqualWithAccuracy(area, 7.0, 1e-12);
+    SeidelTriangulatorRelease(state);
+}
+
+- (void)testPolygonBoolean {
+    // Two squares overlapping in a unit square, the second clockwise
+    int cntr[1] = {4};
+    double a[5][2] = {{0, 0}, {0, 0}, {2, 0}, {2, 2}, {0, 2}};
+    double b[5][2] = {{0, 0}, {1, 1}, {1, 3}, {3, 3}, {3, 1}};
+    double expected[4] = {7, 1, 3, 6};
+    SeidelContours out;
+    memset(&out, 0, sizeof(out));
+    for (int op = SEIDEL_BOOL_UNION; op <= SEIDEL_BOOL_XOR; op++)
+    {
+        int ncontours = polygon_boolean(op, 1, cntr, a, 1, cntr, b, &out);
+        XCTAssertEqual(ncontours, (op == SEIDEL_BOOL_XOR) ? 2 : 1);
+        XCTAssertEqual(out.nouter, ncontours);
+        double area = 0;
+        for (int k = 1, c = 0; c < out.ncontours; k += out.cntr[c++])
+            for (int j = 0; j < out.cntr[c]; j++)
+            {
+                const double* p = out.vertices[k + j];
+                const double* q = out.vertices[k + (j + 1) % out.cntr[c]];
+                area += (p[0] * q[1] - q[0] * p[1]) / 2;
+            }
+        // less the slivers where the two halves of the xor touch
+        XCTAssertEqualWithAccuracy(area, expected[op], 1e-5);
+    }
+
+    // The union has eight corners and is triangulated from the same buffers
+    XCTAssertEqual(polygon_boolean(SEIDEL_BOOL_UNION, 1, cntr, a, 1, cntr, b, &out), 1);
+    XCTAssertEqual(out.nvert, 8);
+    SeidelTriangulator* state = NULL;
+    int triangles[9][3];
+    XCTAssertEqual(triangulate_contours(&state, &out, triangles), 6);
+
+    // The xor is two L shapes touching at two corners, which are pulled
+    // apart; a point given twice is refused
+    XCTAssertEqual(polygon_boolean(SEIDEL_BOOL_XOR, 1, cntr, a, 1, cntr, b, &out), 2);
+    XCTAssertEqual(out.nvert, 12);
+    SeidelTriangulatorRelease(state);
+    state = NULL;
+    XCTAssertEqual(triangulate_contours(&state, &out, triangles), 8);
+    double covered = 0;
+    for (int t = 0; t < 8; t++)
+    {
+        const double* p = out.vertices[triangles[t][0]];
+        const double* q = out.vertices[triangles[t][1]];
+        const double* r = out.vertices[triangles[t][2]];
+        double twice = (q[0] - p[0]) * (r[1] - p[1]) - (r[0] - p[0]) * (q[1] - p[1]);
+        XCTAssertGreaterThan(twice, 0);
+        covered += twice / 2;
+    }
+    XCTAssertEqualWithAccuracy(covered, 6, 1e-5);
+    out.vertices[12][0] = out.vertices[1][0];
+    out.vertices[12][1] = out.vertices[1][1];
+    XCTAssertEqual(triangulate_contours(&state, &out, triangles), SEIDEL_ERR_DEGENERATE);
+
+    // A hole touching the outer contour: the face is cut at the point,
+    // which the outer contour keeps though it goes straight on there
+    double big[5][2] = {{0, 0}, {-2, -2}, {4, -2}, {4, 4}, {-2, 4}};
+    double notch[5][2] = {{0, 0}, {1, -2}, {2, -1}, {1, 0}, {0, -1}};
+    XCTAssertEqual(polygon_boolean(SEIDEL_BOOL_DIFFERENCE, 1, cntr, big, 1, cntr, notch, &out), 2);
+    XCTAssertEqual(out.nouter, 1);
+    XCTAssertEqual(out.nvert, 9);
+    SeidelTriangulatorRelease(state);
+    state = NULL;
+    XCTAssertEqual(triangulate_contours(&state, &out, triangles), 9);
+
+    // A square cut from the middle of a bigger one leaves a clockwise hole
+    XCTAssertEqual(polygon_boolean(SEIDEL_BOOL_DIFFERENCE, 1, cntr, big, 1, cntr, a, &out), 2);
+    XCTAssertEqual(out.nouter, 1);
+    XCTAssertEqual(out.nvert, 8);
+    SeidelTriangulatorRelease(state);
+    state = NULL;
+    XCTAssertEqual(triangulate_contours(&state, &out, triangles), 8);
+
+    // Nothing in common, nothing left
+    double far[5][2] = {{0, 0}, {5, 5}, {6, 5}, {6, 6}, {5, 6}};
+    XCTAssertEqual(polygon_boolean(SEIDEL_BOOL_INTERSECTION, 1, cntr, a, 1, cntr, far, &out), 0);
+    XCTAssertEqual(out.nvert, 0);
+    seidel_contours_free(&out);
+    SeidelTriangulatorRelease(state);
+}
+
+- (void)testPerformanceBlob {
+    const int n = 1000;
+    double (*vertices)[2] = malloc(sizeof(double) * 2 * (n + 1));
+    int (*triangles)[3] = malloc(sizeof(int) * 3 * n);
+    int cntr[] = {n};
+    for (int i = 0; i < n; i++)
+    {
+        double t = 2 * M_PI * i / n;
+        double r = 1.0 + 0.3 * sin(7 * t) + 0.1 * cos(23 * t);
+        vertices[1 + i][0] = r * cos(t);
+        vertices[1 + i][1] = r * sin(t);
+    }
+    __block SeidelTriangulator* seidel = SeidelTriangulatorCreate(n);
+
     [self measureBlock:^{
-        // Put the code you want to measure the time of here.
+        for (int k = 0; k < 100; k++)
+            XCTAssertEqual(triangulate_polygon(&seidel, 1, cntr, vertices, triangles), n - 2);
     }];
+
+    SeidelTriangulatorRelease(seidel);
+    free(triangles);
+    free(vertices);
 }
 
 @end
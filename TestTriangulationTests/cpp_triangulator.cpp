@@ -0,0 +1,264 @@
+//
+//  cpp_triangulator.cpp
+//  TestTriangulationTests
+//
+//  Checks of the C++17 front end in triangulation_seidel.hpp: that a
+//  triangulator owns its tables and can only be moved, that reserve()
+//  and growth keep the tables and settings they should, and that a
+//  configured tolerance scales the points and nothing else, and that a
+//  loop of triangulate() calls on reserved tables allocates nothing in
+//  the C code. Triangles are checked by the oracle.
+//
+//  Built and run by 'make check', under ASan and UBSan, linked with
+//  --wrap for malloc, calloc and realloc so that allocations are counted.
+//
+
+#include "triangulation_seidel.hpp"
+#include "oracle.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define CHECK(c)                                                        \
+    do {                                                                \
+        if (!(c))                                                       \
+        {                                                               \
+            fprintf(stderr, "cpp_triangulator:%d: %s\n", __LINE__, #c); \
+            abort();                                                    \
+        }                                                               \
+    } while (0)
+
+// Allocations made by the C code, which is linked to these
+extern "C" {
+void *__real_malloc(std::size_t);
+void *__real_calloc(std::size_t, std::size_t);
+void *__real_realloc(void *, std::size_t);
+
+static long allocations = 0;
+
+void *__wrap_malloc(std::size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(std::size_t n, std::size_t size)
+{
+    allocations++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, std::size_t size)
+{
+    allocations++;
+    return __real_realloc(p, size);
+}
+}
+
+static_assert(!std::is_copy_constructible_v<seidel::triangulator>, "copied");
+static_assert(!std::is_copy_assignable_v<seidel::triangulator>, "copied");
+static_assert(std::is_nothrow_move_constructible_v<seidel::triangulator>, "move throws");
+static_assert(std::is_nothrow_move_assignable_v<seidel::triangulator>, "move throws");
+
+// A tolerance 1024 times that of the C code: the points go in at
+// 1 / 1024 of their size, which is exact
+struct coarse_config
+{
+    using coord_type = double;
+    static constexpr double tolerance = 1024 * C_EPS;
+};
+
+struct glyph_config
+{
+    using coord_type = float;
+    static constexpr double tolerance = 1.0e-4;
+};
+
+// A blob of n points, x and y in turn
+static std::vector<double> blob(int n, double scale)
+{
+    std::vector<double> xy(2 * n);
+
+    for (int i = 0; i < n; i++)
+    {
+        double t = 2 * M_PI * i / n;
+        double r = 1.0 + 0.3 * sin(7 * t) + 0.1 * cos(23 * t);
+        xy[2 * i] = scale * r * cos(t);
+        xy[2 * i + 1] = scale * r * sin(t);
+    }
+    return xy;
+}
+
+// The oracle on triangles numbered from 0
+template <class T>
+static void check_triangles(const std::vector<int> &contours, const std::vector<T> &xy,
+                            std::vector<seidel::triangle> &triangles, int ntriangles)
+{
+    int n = static_cast<int>(xy.size() / 2);
+    std::vector<double> vertices(2 * (n + 1));
+    std::vector<int> tri(3 * triangles.size());
+    char why[256];
+
+    for (int i = 0; i < 2 * n; i++)
+        vertices[2 + i] = static_cast<double>(xy[i]);
+    for (int i = 0; i < ntriangles; i++)
+        for (int k = 0; k < 3; k++)
+            tri[3 * i + k] = triangles[i][k] + 1;
+    int code = check_triangulation(static_cast<int>(contours.size()), contours.data(),
+                                   reinterpret_cast<double (*)[2]>(vertices.data()),
+                                   reinterpret_cast<int (*)[3]>(tri.data()), ntriangles,
+                                   why, sizeof(why));
+    if (code)
+        fprintf(stderr, "cpp_triangulator: %s\n", why);
+    CHECK(code == 0);
+}
+
+static void test_move_only()
+{
+    std::vector<double> xy = blob(100, 1.0);
+    std::vector<int> contours = {100};
+    std::vector<seidel::triangle> triangles(100);
+
+    seidel::triangulator a(100);
+    SeidelTriangulator *state = a.get();
+    CHECK(state != nullptr);
+    a.set_schedule(SEIDEL_ORDER_HILBERT);
+    CHECK(a.triangulate(contours, xy, triangles) == 98);
+
+    // the tables go with the move, and the moved-from one starts afresh
+    seidel::triangulator b(std::move(a));
+    CHECK(b.get() == state);
+    CHECK(a.get() == nullptr);
+    CHECK(a.capacity() == 0);
+    CHECK(!a.contains(0, 0));
+    CHECK(b.contains(0, 0));
+    CHECK(b.get()->schedule == SEIDEL_ORDER_HILBERT);
+
+    seidel::triangulator c(10);
+    c = std::move(b);
+    CHECK(c.get() == state);
+    CHECK(b.get() == nullptr);
+    CHECK(c.triangulate(contours, xy, triangles) == 98);
+    check_triangles(contours, xy, triangles, 98);
+
+    CHECK(a.triangulate(contours, xy, triangles) == 98);
+    CHECK(a.get() != nullptr);
+    CHECK(a.get() != state);
+    check_triangles(contours, xy, triangles, 98);
+}
+
+static void test_reserve_and_growth()
+{
+    seidel::triangulator t;
+    CHECK(t.get() == nullptr);
+    CHECK(t.capacity() == 0);
+
+    t.reserve(200);
+    SeidelTriangulator *state = t.get();
+    CHECK(t.capacity() >= 200);
+    t.set_threads(2);
+    t.set_step_budget(1000000);
+    t.set_schedule(SEIDEL_ORDER_HILBERT);
+
+    // smaller polygons keep the tables
+    for (int n = 50; n <= 200; n += 50)
+    {
+        std::vector<double> xy = blob(n, 1.0);
+        std::vector<int> contours = {n};
+        std::vector<seidel::triangle> triangles(n);
+        CHECK(t.triangulate(contours, xy, triangles) == n - 2);
+        CHECK(t.get() == state);
+        check_triangles(contours, xy, triangles, n - 2);
+    }
+
+    // a bigger one grows them by half at least, keeping the settings
+    int before = t.capacity();
+    std::vector<double> xy = blob(before + 1, 1.0);
+    std::vector<int> contours = {before + 1};
+    std::vector<seidel::triangle> triangles(before + 1);
+    CHECK(t.triangulate(contours, xy, triangles) == before - 1);
+    CHECK(t.capacity() >= before + before / 2);
+    CHECK(t.get()->nthreads == 2);
+    CHECK(t.get()->step_budget == 1000000);
+    CHECK(t.get()->schedule == SEIDEL_ORDER_HILBERT);
+    check_triangles(contours, xy, triangles, before - 1);
+
+    // a sink, and an output too small for the triangles
+    int count = 0;
+    CHECK(t.triangulate(contours, xy, [&](int a, int b, int c) {
+        CHECK(a >= 0 && b >= 0 && c >= 0);
+        CHECK(a <= before && b <= before && c <= before);
+        count++;
+    }) == before - 1);
+    CHECK(count == before - 1);
+    std::vector<seidel::triangle> small(10);
+    CHECK(t.triangulate(contours, xy, small) == SEIDEL_ERR_CAPACITY);
+
+    std::vector<int> bad = {2};
+    CHECK(t.triangulate(bad, xy, triangles) == SEIDEL_ERR_INPUT);
+}
+
+static void test_tolerance()
+{
+    std::vector<double> xy = blob(300, 1.0), big = blob(300, 1024.0);
+    std::vector<int> contours = {300};
+    std::vector<seidel::triangle> fine(300), coarse(300);
+
+    // the same points inside, and the same triangles
+    seidel::triangulator t(300);
+    seidel::basic_triangulator<coarse_config> u(300);
+    t.set_schedule(SEIDEL_ORDER_HILBERT);
+    u.set_schedule(SEIDEL_ORDER_HILBERT);
+    CHECK(t.triangulate(contours, xy, fine) == 298);
+    CHECK(u.triangulate(contours, big, coarse) == 298);
+    for (int i = 1; i <= 300; i++)
+    {
+        CHECK(u.get()->seg[i].v0.x == t.get()->seg[i].v0.x);
+        CHECK(u.get()->seg[i].v0.y == t.get()->seg[i].v0.y);
+    }
+    CHECK(fine == coarse);
+    CHECK(u.contains(0, 0));
+    CHECK(u.contains(1024 * 0.5, 0));
+    CHECK(!u.contains(1024 * 1.5, 0));
+
+    // float coordinates
+    std::vector<float> glyph(xy.begin(), xy.end());
+    std::vector<seidel::triangle> triangles(300);
+    seidel::basic_triangulator<glyph_config> g(300);
+    CHECK(g.triangulate(glyph, triangles) == 298);
+    CHECK(g.get()->seg[1].v0.x == static_cast<double>(glyph[0]) * (C_EPS / 1.0e-4));
+    check_triangles(contours, glyph, triangles, 298);
+}
+
+static void test_no_allocation()
+{
+    std::vector<double> xy = blob(1000, 1.0);
+    std::vector<int> contours = {1000};
+    std::vector<seidel::triangle> triangles(1000);
+
+    // the default schedule, which draws a new random order each run
+    seidel::triangulator t;
+    t.reserve(1000);
+    CHECK(t.triangulate(contours, xy, triangles) == 998);
+    long before = allocations;
+    for (int run = 0; run < 20; run++)
+        CHECK(t.triangulate(contours, xy, triangles) == 998);
+    CHECK(allocations == before);
+    check_triangles(contours, xy, triangles, 998);
+
+    // the wrap is in place at all
+    SeidelTriangulator *state = SeidelTriangulatorCreate(10);
+    CHECK(allocations > before);
+    SeidelTriangulatorRelease(state);
+}
+
+int main()
+{
+    test_move_only();
+    test_reserve_and_growth();
+    test_tolerance();
+    test_no_allocation();
+    printf("cpp_triangulator: ok\n");
+    return 0;
+}
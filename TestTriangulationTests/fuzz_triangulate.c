@@ -0,0 +1,378 @@
+//
+//  fuzz_triangulate.c
+//  TestTriangulationTests
+//
+//  libFuzzer target for triangulate_polygon(). The first byte picks how
+//  the rest is read:
+//
+//    even  raw contours: a contour count, then per contour a length and
+//          that many (x, y) pairs of signed bytes. Anything goes; the
+//          triangulator must return without crashing, and when the
+//          input is a valid polygon any triangles it does return are
+//          checked by the oracle.
+//    odd   make_star_with_holes(), which is always valid: the
+//          triangulation must succeed and pass the oracle.
+//
+//  Bits 1 to 4 of the first byte pick the insertion schedule and layout.
+//
+//  Every input is also checked for simplicity three ways, which must
+//  agree: by validate_polygon(), by testing every pair of edges, and by
+//  adding the edges to a SeidelEdgeSet one by one, each tested against
+//  those before it.
+//
+//  Triangulations that pass are also checked point by point:
+//  is_point_inside_polygon() must agree with a crossing-number test,
+//  seidel_nearest_edge() with the distance to every edge, and
+//  seidel_segment_crossings() between one point and the next with a
+//  test of every edge.
+//
+//  Build with clang -fsanitize=fuzzer,address,undefined ('make fuzz'),
+//  or with -DSTANDALONE_FUZZ for a driver that feeds random inputs and
+//  the named files ('make check').
+//
+
+#include "triangulation_seidel.h"
+#include "oracle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define MAX_CONTOURS 16
+#define MAX_POINTS 512
+
+static int crossings(int ncontours, const int *cntr, double (*v)[2], double x, double y)
+{
+    int c, j, first = 1, in = 0;
+
+    for (c = 0; c < ncontours; c++)
+    {
+        for (j = 0; j < cntr[c]; j++)
+        {
+            int i = first + j, k = first + (j + 1) % cntr[c];
+            if (((v[i][1] > y) != (v[k][1] > y)) &&
+                (x < v[i][0] + (v[k][0] - v[i][0]) * (y - v[i][1]) / (v[k][1] - v[i][1])))
+                in = !in;
+        }
+        first += cntr[c];
+    }
+    return in;
+}
+
+static double edge_distance(int ncontours, const int *cntr, double (*v)[2], double x, double y)
+{
+    double best = HUGE_VAL;
+    int c, j, first = 1;
+
+    for (c = 0; c < ncontours; c++)
+    {
+        for (j = 0; j < cntr[c]; j++)
+        {
+            const double *p = v[first + j], *q = v[first + (j + 1) % cntr[c]];
+            double dx = q[0] - p[0], dy = q[1] - p[1];
+            double t = ((x - p[0]) * dx + (y - p[1]) * dy) / (dx * dx + dy * dy);
+            t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+            best = fmin(best, hypot(p[0] + t * dx - x, p[1] + t * dy - y));
+        }
+        first += cntr[c];
+    }
+    return best;
+}
+
+/* What triangulate_polygon() asks of its input, beyond simplicity: an
+ * anti-clockwise outer contour with clockwise holes inside it, none
+ * of them inside another. */
+static int well_formed(int ncontours, int *cntr, double (*v)[2])
+{
+    int c, d, first = 1 + cntr[0];
+
+    if (!validate_polygon(ncontours, cntr, v, NULL, NULL))
+        return 0;
+    if (polygon_area(1, cntr, v) <= 0)
+        return 0;
+    for (c = 1; c < ncontours; c++)
+    {
+        int other = 1;
+        if (polygon_area(1, cntr + c, v + first - 1) >= 0)
+            return 0;
+        if (!crossings(1, cntr, v, v[first][0], v[first][1]))
+            return 0;
+        for (d = 1; d < ncontours; d++)
+        {
+            other += cntr[d - 1];
+            if ((d != c) && crossings(1, cntr + d, v + other - 1, v[first][0], v[first][1]))
+                return 0;
+        }
+        first += cntr[c];
+    }
+    return 1;
+}
+
+/* Edges the closed segment (p, q) meets, and whether any vertex is */
+/* within eps of it */
+static int segment_meets(int ncontours, const int *cntr, double (*v)[2],
+                         double *p, double *q, double eps, int *near_vertex)
+{
+    point_t a, b, e0, e1;
+    int c, j, first = 1, n = 0;
+
+    a.x = p[0];
+    a.y = p[1];
+    b.x = q[0];
+    b.y = q[1];
+    *near_vertex = 0;
+    for (c = 0; c < ncontours; c++)
+    {
+        for (j = 0; j < cntr[c]; j++)
+        {
+            const double *w = v[first + j], *x = v[first + (j + 1) % cntr[c]];
+            double dx = b.x - a.x, dy = b.y - a.y;
+            double t = ((w[0] - a.x) * dx + (w[1] - a.y) * dy) / (dx * dx + dy * dy);
+            t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+            if (hypot(a.x + t * dx - w[0], a.y + t * dy - w[1]) < eps)
+                *near_vertex = 1;
+            e0.x = w[0];
+            e0.y = w[1];
+            e1.x = x[0];
+            e1.y = x[1];
+            n += segments_intersect(&a, &b, &e0, &e1);
+        }
+        first += cntr[c];
+    }
+    return n;
+}
+
+static void fail(const char *what, int ncontours, const int *cntr, double (*v)[2])
+{
+    int c, j, first = 1;
+
+    fprintf(stderr, "fuzz_triangulate: %s\n%d\n", what, ncontours);
+    for (c = 0; c < ncontours; c++)
+    {
+        fprintf(stderr, "\n%d\n", cntr[c]);
+        for (j = 0; j < cntr[c]; j++)
+            fprintf(stderr, "%.17g %.17g\n", v[first + j][0], v[first + j][1]);
+        first += cntr[c];
+    }
+    abort();
+}
+
+static void check_queries(SeidelTriangulator *state, int ncontours, int *cntr,
+                          double (*v)[2], const uint8_t *data, size_t size)
+{
+    double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+    double prev[2], d, eps;
+    int n = 0, c, i, have_prev = 0, near_vertex, expected, got;
+    char why[160];
+
+    for (c = 0; c < ncontours; c++)
+        n += cntr[c];
+    for (i = 1; i <= n; i++)
+    {
+        xmin = fmin(xmin, v[i][0]);
+        xmax = fmax(xmax, v[i][0]);
+        ymin = fmin(ymin, v[i][1]);
+        ymax = fmax(ymax, v[i][1]);
+    }
+
+    eps = 1e-6 * (xmax - xmin + ymax - ymin);
+
+    for (i = 0; i + 1 < (int) size && i < 64; i += 2)
+    {
+        double p[2];
+        p[0] = xmin + (xmax - xmin) * (data[i] + 0.5) / 256;
+        p[1] = ymin + (ymax - ymin) * (data[i + 1] + 0.5) / 256;
+
+        /* points on or near an edge may go either way */
+        if (edge_distance(ncontours, cntr, v, p[0], p[1]) < eps)
+            continue;
+        if (!is_point_inside_polygon(state, p) != !crossings(ncontours, cntr, v, p[0], p[1]))
+        {
+            snprintf(why, sizeof(why), "is_point_inside_polygon(%.17g, %.17g) disagrees", p[0], p[1]);
+            fail(why, ncontours, cntr, v);
+        }
+        if ((seidel_nearest_edge(state, p, &d) <= 0) ||
+            (fabs(d - edge_distance(ncontours, cntr, v, p[0], p[1])) > 1e-9 * (xmax - xmin + ymax - ymin)))
+        {
+            snprintf(why, sizeof(why), "seidel_nearest_edge(%.17g, %.17g) disagrees", p[0], p[1]);
+            fail(why, ncontours, cntr, v);
+        }
+
+        /* and the segment from the point before, unless it passes */
+        /* close to a vertex */
+        if (have_prev)
+        {
+            expected = segment_meets(ncontours, cntr, v, prev, p, eps, &near_vertex);
+            got = seidel_segment_crossings(state, prev, p, NULL, MAX_POINTS);
+            if (!near_vertex && (got != expected))
+            {
+                snprintf(why, sizeof(why), "seidel_segment_crossings(%.17g, %.17g, %.17g, %.17g) is %d, not %d",
+                         prev[0], prev[1], p[0], p[1], got, expected);
+                fail(why, ncontours, cntr, v);
+            }
+        }
+        prev[0] = p[0];
+        prev[1] = p[1];
+        have_prev = 1;
+    }
+}
+
+static void check_simplicity(int ncontours, int *cntr, double (*v)[2])
+{
+    SeidelEdgeSet *es;
+    int simple = simple_by_pairs(ncontours, cntr, v), met = 0, c, j, first = 1;
+
+    if (simple < 0)
+        return;
+    if (!validate_polygon(ncontours, cntr, v, NULL, NULL) != !simple)
+        fail("validate_polygon() disagrees with testing every pair of edges", ncontours, cntr, v);
+
+    if ((es = SeidelEdgeSetCreate(4)) == NULL)
+        return;
+    for (c = 0; c < ncontours && !met; c++)
+    {
+        int firstid = 0, prev = 0;
+        for (j = 0; j < cntr[c] && !met; j++)
+        {
+            const double *p = v[first + j], *q = v[first + (j + 1) % cntr[c]];
+            /* the closing edge follows the last and leads to the first */
+            if (edge_set_intersects(es, p[0], p[1], q[0], q[1], prev, (j == cntr[c] - 1) ? firstid : 0))
+                met = 1;
+            else if ((prev = edge_set_add(es, p[0], p[1], q[0], q[1])) == 0)
+            {
+                SeidelEdgeSetRelease(es);
+                return;
+            }
+            else if (j == 0)
+                firstid = prev;
+        }
+        first += cntr[c];
+    }
+    if (met == simple)
+        fail("a SeidelEdgeSet disagrees with testing every pair of edges", ncontours, cntr, v);
+    SeidelEdgeSetRelease(es);
+}
+
+static void run(int ncontours, int *cntr, double (*v)[2], int must_succeed,
+                int nthreads, int schedule, const uint8_t *data, size_t size)
+{
+    static int triangles[MAX_POINTS + 2 * MAX_CONTOURS][3];
+    SeidelTriangulator *state;
+    int n = 0, c, ntriangles, code;
+    char why[256];
+
+    for (c = 0; c < ncontours; c++)
+        n += cntr[c];
+    if ((state = SeidelTriangulatorCreate(n)) == NULL)
+        return;
+    SeidelTriangulatorSetThreads(state, nthreads);
+    SeidelTriangulatorSetSchedule(state, schedule);
+
+    ntriangles = triangulate_polygon(&state, ncontours, cntr, v, triangles);
+    if (ntriangles < 0)
+    {
+        if (must_succeed)
+        {
+            snprintf(why, sizeof(why), "triangulate_polygon() failed with %d", ntriangles);
+            fail(why, ncontours, cntr, v);
+        }
+    }
+    else if (must_succeed || well_formed(ncontours, cntr, v))
+    {
+        if ((code = check_triangulation(ncontours, cntr, v, triangles, ntriangles, why, sizeof(why))))
+            fail(why, ncontours, cntr, v);
+        check_queries(state, ncontours, cntr, v, data, size);
+    }
+    SeidelTriangulatorRelease(state);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static double vertices[1 + MAX_POINTS][2];
+    int cntr[MAX_CONTOURS];
+    int ncontours, c, j, n, pos;
+
+    if (size < 2)
+        return 0;
+
+    if (data[0] & 1)
+    {
+        ncontours = make_star_with_holes(data + 1, (int) size - 1, cntr, vertices);
+        check_simplicity(ncontours, cntr, vertices);
+        run(ncontours, cntr, vertices, 1, 1, (data[0] >> 1) & 15, data + 1, size - 1);
+        run(ncontours, cntr, vertices, 1, 4, (data[0] >> 1) & 15, data + 1, size - 1);
+        return 0;
+    }
+
+    ncontours = 1 + data[1] % MAX_CONTOURS;
+    for (c = 0, n = 0, pos = 2; c < ncontours; c++)
+    {
+        cntr[c] = (pos < (int) size) ? 3 + data[pos++] % 64 : 3;
+        if (n + cntr[c] > MAX_POINTS)
+            cntr[c] = MAX_POINTS - n;
+        for (j = 0; j < cntr[c]; j++, n++)
+        {
+            vertices[1 + n][0] = (pos < (int) size) ? (int8_t) data[pos++] : j;
+            vertices[1 + n][1] = (pos < (int) size) ? (int8_t) data[pos++] : j * j;
+        }
+        if (cntr[c] < 3)
+            break;
+    }
+    ncontours = c;
+    if (ncontours > 0)
+    {
+        check_simplicity(ncontours, cntr, vertices);
+        run(ncontours, cntr, vertices, 0, 1, (data[0] >> 1) & 15, data, size);
+    }
+    return 0;
+}
+
+
+#ifdef STANDALONE_FUZZ
+
+/* Replays the named files, then feeds random inputs: odd ones through
+ * the star generator, even ones as raw contours.
+ *	fuzz_triangulate [-n iterations] [-s seed] [file ...]
+ */
+int main(int argc, char *argv[])
+{
+    static uint8_t buf[1 << 16];
+    long iterations = 10000, seed = 1, i;
+    int a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (!strcmp(argv[a], "-n") && a + 1 < argc)
+            iterations = atol(argv[++a]);
+        else if (!strcmp(argv[a], "-s") && a + 1 < argc)
+            seed = atol(argv[++a]);
+        else
+        {
+            FILE *f = fopen(argv[a], "rb");
+            size_t len;
+            if (f == NULL)
+            {
+                perror(argv[a]);
+                return 1;
+            }
+            len = fread(buf, 1, sizeof(buf), f);
+            fclose(f);
+            LLVMFuzzerTestOneInput(buf, len);
+        }
+    }
+
+    srand((unsigned) seed);
+    for (i = 0; i < iterations; i++)
+    {
+        size_t len = 2 + rand() % 1024, k;
+        for (k = 0; k < len; k++)
+            buf[k] = (uint8_t) rand();
+        buf[0] = (uint8_t) i;
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    printf("fuzz_triangulate: %ld inputs ok\n", iterations);
+    return 0;
+}
+
+#endif /* STANDALONE_FUZZ */
@@ -0,0 +1,364 @@
+//
+//  oracle.c
+//  TestTriangulationTests
+//
+
+#include "oracle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static double tri_area(double (*v)[2], int a, int b, int c)
+{
+    return 0.5 * ((v[b][0] - v[a][0]) * (v[c][1] - v[a][1]) -
+                  (v[c][0] - v[a][0]) * (v[b][1] - v[a][1]));
+}
+
+double polygon_area(int ncontours, const int *cntr, double (*vertices)[2])
+{
+    double area = 0;
+    int c, j, first = 1;
+
+    for (c = 0; c < ncontours; c++)
+    {
+        for (j = 0; j < cntr[c]; j++)
+        {
+            int i = first + j, k = first + (j + 1) % cntr[c];
+            area += 0.5 * (vertices[i][0] * vertices[k][1] - vertices[k][0] * vertices[i][1]);
+        }
+        first += cntr[c];
+    }
+    return area;
+}
+
+/* Even-odd rule over all contours */
+static int inside(int ncontours, const int *cntr, double (*v)[2], double x, double y)
+{
+    int c, j, first = 1, in = 0;
+
+    for (c = 0; c < ncontours; c++)
+    {
+        for (j = 0; j < cntr[c]; j++)
+        {
+            int i = first + j, k = first + (j + 1) % cntr[c];
+            if (((v[i][1] > y) != (v[k][1] > y)) &&
+                (x < v[i][0] + (v[k][0] - v[i][0]) * (y - v[i][1]) / (v[k][1] - v[i][1])))
+                in = !in;
+        }
+        first += cntr[c];
+    }
+    return in;
+}
+
+/* Interiors of anti-clockwise triangles a and b are disjoint iff an edge
+ * of one has the whole of the other on its closed right side. */
+static int separated(double (*v)[2], const int *a, const int *b, double eps)
+{
+    int e, k;
+
+    for (e = 0; e < 3; e++)
+    {
+        const double *p = v[a[e]], *q = v[a[(e + 1) % 3]];
+        for (k = 0; k < 3; k++)
+        {
+            const double *r = v[b[k]];
+            if ((q[0] - p[0]) * (r[1] - p[1]) - (r[0] - p[0]) * (q[1] - p[1]) > eps)
+                break;
+        }
+        if (k == 3)
+            return 1;
+    }
+    return 0;
+}
+
+static int overlapping(double (*v)[2], int (*t)[3], int ntriangles, double eps, int *ta, int *tb)
+{
+    double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+    int i, j, k, g, cx, cy, found = 0;
+    int *count, *start, *cell;
+
+    for (i = 0; i < ntriangles; i++)
+        for (k = 0; k < 3; k++)
+        {
+            xmin = fmin(xmin, v[t[i][k]][0]);
+            xmax = fmax(xmax, v[t[i][k]][0]);
+            ymin = fmin(ymin, v[t[i][k]][1]);
+            ymax = fmax(ymax, v[t[i][k]][1]);
+        }
+
+    /* bucket the triangles' bounding boxes into a g x g grid */
+    for (g = 1; g * g < ntriangles; g++)
+        ;
+    count = (int *) calloc(g * g + 1, sizeof(int));
+    start = (int *) calloc(g * g + 1, sizeof(int));
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < ntriangles; i++)
+        {
+            double bx0 = HUGE_VAL, by0 = HUGE_VAL, bx1 = -HUGE_VAL, by1 = -HUGE_VAL;
+            for (k = 0; k < 3; k++)
+            {
+                bx0 = fmin(bx0, v[t[i][k]][0]);
+                bx1 = fmax(bx1, v[t[i][k]][0]);
+                by0 = fmin(by0, v[t[i][k]][1]);
+                by1 = fmax(by1, v[t[i][k]][1]);
+            }
+            int x0 = (int) ((bx0 - xmin) / (xmax - xmin + 1e-300) * (g - 1e-9));
+            int x1 = (int) ((bx1 - xmin) / (xmax - xmin + 1e-300) * (g - 1e-9));
+            int y0 = (int) ((by0 - ymin) / (ymax - ymin + 1e-300) * (g - 1e-9));
+            int y1 = (int) ((by1 - ymin) / (ymax - ymin + 1e-300) * (g - 1e-9));
+            for (cy = y0; cy <= y1; cy++)
+                for (cx = x0; cx <= x1; cx++)
+                {
+                    if (pass == 0)
+                        count[cy * g + cx]++;
+                    else
+                        cell[start[cy * g + cx] + count[cy * g + cx]++] = i;
+                }
+        }
+        if (pass == 0)
+        {
+            for (j = 0; j < g * g; j++)
+                start[j + 1] = start[j] + count[j];
+            cell = (int *) malloc(sizeof(int) * (start[g * g] + 1));
+            for (j = 0; j < g * g; j++)
+                count[j] = 0;
+        }
+    }
+
+    for (j = 0; j < g * g && !found; j++)
+        for (i = start[j]; i < start[j] + count[j] && !found; i++)
+            for (k = i + 1; k < start[j] + count[j]; k++)
+            {
+                int a = cell[i], b = cell[k];
+                if (!separated(v, t[a], t[b], eps) && !separated(v, t[b], t[a], eps))
+                {
+                    *ta = a;
+                    *tb = b;
+                    found = 1;
+                    break;
+                }
+            }
+
+    free(cell);
+    free(start);
+    free(count);
+    return found;
+}
+
+int check_triangulation(int ncontours, const int *cntr, double (*vertices)[2],
+                        int (*triangles)[3], int ntriangles,
+                        char *why, int whylen)
+{
+    double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+    double scale, area = 0, expected;
+    int n = 0, c, i, k, ta, tb;
+
+    for (c = 0; c < ncontours; c++)
+        n += cntr[c];
+    for (i = 1; i <= n; i++)
+    {
+        xmin = fmin(xmin, vertices[i][0]);
+        xmax = fmax(xmax, vertices[i][0]);
+        ymin = fmin(ymin, vertices[i][1]);
+        ymax = fmax(ymax, vertices[i][1]);
+    }
+    scale = fmax(xmax - xmin, ymax - ymin);
+
+    if (ntriangles != n - 2 + 2 * (ncontours - 1))
+    {
+        snprintf(why, whylen, "%d triangles for %d points and %d holes", ntriangles, n, ncontours - 1);
+        return 1;
+    }
+
+    for (i = 0; i < ntriangles; i++)
+        for (k = 0; k < 3; k++)
+            if ((triangles[i][k] < 1) || (triangles[i][k] > n))
+            {
+                snprintf(why, whylen, "triangle %d has vertex %d, out of 1..%d", i, triangles[i][k], n);
+                return 2;
+            }
+
+    for (i = 0; i < ntriangles; i++)
+    {
+        double a = tri_area(vertices, triangles[i][0], triangles[i][1], triangles[i][2]);
+        if (a < -1e-12 * scale * scale)
+        {
+            snprintf(why, whylen, "triangle %d (%d %d %d) is clockwise", i,
+                     triangles[i][0], triangles[i][1], triangles[i][2]);
+            return 3;
+        }
+        area += a;
+    }
+
+    expected = polygon_area(ncontours, cntr, vertices);
+    if (fabs(area - expected) > 1e-9 * scale * scale * (1 + ntriangles))
+    {
+        snprintf(why, whylen, "triangles cover %.17g, polygon has %.17g", area, expected);
+        return 4;
+    }
+
+    for (i = 0; i < ntriangles; i++)
+    {
+        int a = triangles[i][0], b = triangles[i][1], d = triangles[i][2];
+        if (tri_area(vertices, a, b, d) <= 1e-12 * scale * scale)
+            continue;   /* no interior to test */
+        double x = (vertices[a][0] + vertices[b][0] + vertices[d][0]) / 3;
+        double y = (vertices[a][1] + vertices[b][1] + vertices[d][1]) / 3;
+        if (!inside(ncontours, cntr, vertices, x, y))
+        {
+            snprintf(why, whylen, "triangle %d (%d %d %d) lies outside the polygon", i, a, b, d);
+            return 5;
+        }
+    }
+
+    if (overlapping(vertices, triangles, ntriangles, 1e-12 * scale * scale, &ta, &tb))
+    {
+        snprintf(why, whylen, "triangles %d and %d overlap", ta, tb);
+        return 6;
+    }
+
+    return 0;
+}
+
+/* Sign of the turn p, q, r, computed as the triangulator does */
+static int turn(const double *p, const double *q, const double *r)
+{
+    double a = (q[0] - p[0]) * (r[1] - p[1]) - (q[1] - p[1]) * (r[0] - p[0]);
+    return (a > 0) - (a < 0);
+}
+
+/* r, collinear with p and q, is on the segment between them */
+static int between(const double *p, const double *q, const double *r)
+{
+    return fmin(p[0], q[0]) <= r[0] && r[0] <= fmax(p[0], q[0]) &&
+           fmin(p[1], q[1]) <= r[1] && r[1] <= fmax(p[1], q[1]);
+}
+
+/* The closed segments (a, b) and (c, d) have a point in common */
+static int segments_meet(const double *a, const double *b, const double *c, const double *d)
+{
+    int o1 = turn(a, b, c), o2 = turn(a, b, d), o3 = turn(c, d, a), o4 = turn(c, d, b);
+
+    if (o1 != o2 && o3 != o4)
+        return 1;
+    return (o1 == 0 && between(a, b, c)) || (o2 == 0 && between(a, b, d)) ||
+           (o3 == 0 && between(c, d, a)) || (o4 == 0 && between(c, d, b));
+}
+
+/* Edges (u, v) and (v, w) of a contour run back over each other */
+static int doubles_back(const double *u, const double *v, const double *w)
+{
+    return turn(u, v, w) == 0 &&
+           (v[0] - u[0]) * (w[0] - v[0]) + (v[1] - u[1]) * (w[1] - v[1]) <= 0;
+}
+
+int simple_by_pairs(int ncontours, const int *cntr, double (*vertices)[2])
+{
+    int n = 0, c, i, j, first = 1, *next;
+
+    for (c = 0; c < ncontours; c++)
+    {
+        if (cntr[c] < 3)
+            return 0;
+        n += cntr[c];
+    }
+    if ((next = malloc(sizeof(int) * (n + 1))) == NULL)
+        return -1;
+    for (c = 0; c < ncontours; c++)
+    {
+        for (j = 0; j < cntr[c]; j++)
+            next[first + j] = first + (j + 1) % cntr[c];
+        first += cntr[c];
+    }
+
+    for (i = 1; i <= n; i++)
+        for (j = i + 1; j <= n; j++)
+        {
+            double *a = vertices[i], *b = vertices[next[i]];
+            double *c = vertices[j], *d = vertices[next[j]];
+            int meet;
+
+            if (next[i] == j)
+                meet = doubles_back(a, c, d);
+            else if (next[j] == i)
+                meet = doubles_back(c, a, b);
+            else
+                meet = segments_meet(a, b, c, d);
+            if (meet)
+            {
+                free(next);
+                return 0;
+            }
+        }
+    free(next);
+    return 1;
+}
+
+/* Distance from (x, y) to the nearest edge of the first contour */
+static double outer_distance(int n, double (*v)[2], double x, double y)
+{
+    double best = HUGE_VAL;
+    int j;
+
+    for (j = 0; j < n; j++)
+    {
+        const double *p = v[1 + j], *q = v[1 + (j + 1) % n];
+        double dx = q[0] - p[0], dy = q[1] - p[1];
+        double t = ((x - p[0]) * dx + (y - p[1]) * dy) / (dx * dx + dy * dy);
+        t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+        best = fmin(best, hypot(p[0] + t * dx - x, p[1] + t * dy - y));
+    }
+    return best;
+}
+
+int make_star_with_holes(const unsigned char *data, int size,
+                         int *cntr, double (*vertices)[2])
+{
+    int pos = 0, i, h, c = 0, n = 1;
+#define NEXT() ((pos < size) ? data[pos++] : 0)
+
+    /* outer contour: star-shaped around the origin, with the gaps
+     * between angles below pi so that it winds the right way, and
+     * radius in [0.5, 1) */
+    int nout = 3 + NEXT() % 62;
+    for (i = 0; i < nout; i++)
+    {
+        double t = 2 * M_PI * (i + 0.4 * NEXT() / 256.0) / nout;
+        double r = 0.5 + NEXT() / 512.0;
+        vertices[n][0] = r * cos(t);
+        vertices[n][1] = r * sin(t);
+        n++;
+    }
+    cntr[c++] = nout;
+
+    /* holes: clockwise stars of radius below 0.08, built the same
+     * way and centred in distinct cells of a 3 x 3 grid, kept only
+     * where the outer contour clears the centre by 0.1 */
+    int holes = NEXT();
+    for (h = 0; h < 9; h++)
+    {
+        if (!(holes & (1 << (h % 8))) || ((h == 8) && !(NEXT() & 1)))
+            continue;
+        int m = 3 + NEXT() % 14;
+        double cx = -0.2 + 0.2 * (h % 3), cy = -0.2 + 0.2 * (h / 3);
+        if (!inside(1, cntr, vertices, cx, cy) || (outer_distance(nout, vertices, cx, cy) < 0.1))
+            continue;
+        for (i = 0; i < m; i++)
+        {
+            double t = -2 * M_PI * (i + 0.4 * NEXT() / 256.0) / m;
+            double r = 0.03 + 0.05 * NEXT() / 256.0;
+            vertices[n][0] = cx + r * cos(t);
+            vertices[n][1] = cy + r * sin(t);
+            n++;
+        }
+        cntr[c++] = m;
+    }
+#undef NEXT
+    return c;
+}
@@ -0,0 +1,52 @@
+//
+//  oracle.h
+//  TestTriangulationTests
+//
+//  Checks the output of triangulate_polygon() against properties any
+//  triangulation of the input must have, computed independently of
+//  the triangulator.
+//
+
+#ifndef oracle_h
+#define oracle_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns 0 if triangles[0..ntriangles-1] triangulate the polygon
+ * given by ncontours, cntr and vertices (in the triangulate_polygon()
+ * layout), otherwise a nonzero code with a description in why:
+ *   1  wrong number of triangles, not n - 2 + 2 * #holes
+ *   2  a vertex index out of 1..n
+ *   3  a clockwise triangle
+ *   4  the areas do not add up to the area of the polygon
+ *   5  a triangle outside the polygon or inside a hole
+ *   6  two triangles overlap
+ */
+int check_triangulation(int ncontours, const int *cntr, double (*vertices)[2],
+                        int (*triangles)[3], int ntriangles,
+                        char *why, int whylen);
+
+/* Signed area of the polygon: outer contour minus holes when the
+ * contours are oriented as triangulate_polygon() wants them. */
+double polygon_area(int ncontours, const int *cntr, double (*vertices)[2]);
+
+/* Returns 1 if the contours form a simple polygon as validate_polygon()
+ * defines it, testing every pair of edges: only edges that follow each
+ * other along a contour meet, at their common vertex, and every contour
+ * has at least three points. 0 if not, -1 if out of memory. */
+int simple_by_pairs(int ncontours, const int *cntr, double (*vertices)[2]);
+
+/* A valid input built from bytes: a star-shaped anti-clockwise outer
+ * contour and up to nine small clockwise holes inside it. vertices
+ * must have room for 1 + 64 + 9 * 16 entries, cntr for 10. Returns
+ * the number of contours. */
+int make_star_with_holes(const unsigned char *data, int size,
+                         int *cntr, double (*vertices)[2]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* oracle_h */